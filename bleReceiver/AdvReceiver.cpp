@@ -6,6 +6,8 @@
 #include "AdvReceiver.h"
 #include <QDebug>
 
+#include "beacon_payload.h"
+
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/hci.h>
 #include <bluetooth/hci_lib.h>
@@ -14,6 +16,13 @@
 #include <signal.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <system_error>
+#include <vector>
+
 /**
  * @brief
  *
@@ -30,8 +39,118 @@ enum : uint8_t {
     EIR_NAME_COMPLETE = 0x09, /* complete local name */
     EIR_TX_POWER = 0x0A, /* transmit power level */
     EIR_DEVICE_ID = 0x10, /* device ID */
+    EIR_MANUFACTURER_DATA = 0xFF, /* manufacturer specific data */
+};
+
+/**
+ * @brief LE extended scanning, not covered by hci_lib
+ *
+ */
+enum : uint16_t {
+    OCF_LE_SET_EXT_SCAN_PARAMETERS = 0x0041,
+    OCF_LE_SET_EXT_SCAN_ENABLE = 0x0042,
+    OCF_LE_PERIODIC_ADV_CREATE_SYNC = 0x0044,
+    OCF_LE_PERIODIC_ADV_CREATE_SYNC_CANCEL = 0x0045,
+    OCF_LE_PERIODIC_ADV_TERMINATE_SYNC = 0x0046,
+};
+
+enum : uint8_t {
+    EVT_LE_ADVERTISING_REPORT = 0x02,
+    EVT_LE_EXT_ADVERTISING_REPORT = 0x0D,
+    EVT_LE_PERIODIC_ADV_SYNC_ESTABLISHED = 0x0E,
+    EVT_LE_PERIODIC_ADV_REPORT = 0x0F,
+    EVT_LE_PERIODIC_ADV_SYNC_LOST = 0x10,
+};
+
+enum : uint8_t {
+    LE_SCAN_PHY_1M = 0x01,
+    LE_SCAN_PHY_CODED = 0x04,
 };
 
+struct LeExtScanPhy {
+    uint8_t type;
+    uint16_t interval;
+    uint16_t window;
+} __attribute__((packed));
+
+struct LeSetExtScanParameters {
+    uint8_t ownAddrType;
+    uint8_t filterPolicy;
+    uint8_t phys;
+    LeExtScanPhy phy[2];
+} __attribute__((packed));
+
+struct LeSetExtScanEnable {
+    uint8_t enable;
+    uint8_t filterDup;
+    uint16_t duration;
+    uint16_t period;
+} __attribute__((packed));
+
+struct LeExtAdvertisingInfo {
+    uint16_t evtType;
+    uint8_t bdaddrType;
+    bdaddr_t bdaddr;
+    uint8_t primaryPhy;
+    uint8_t secondaryPhy;
+    uint8_t sid;
+    int8_t txPower;
+    int8_t rssi;
+    uint16_t periodicInterval;
+    uint8_t directAddrType;
+    bdaddr_t directAddr;
+    uint8_t length;
+    uint8_t data[0];
+} __attribute__((packed));
+
+struct LePeriodicAdvCreateSync {
+    uint8_t filterPolicy;
+    uint8_t sid;
+    uint8_t bdaddrType;
+    bdaddr_t bdaddr;
+    uint16_t skip;
+    uint16_t syncTimeout;
+    uint8_t unused;
+} __attribute__((packed));
+
+struct LePeriodicAdvSyncEstablished {
+    uint8_t status;
+    uint16_t syncHandle;
+    uint8_t sid;
+    uint8_t bdaddrType;
+    bdaddr_t bdaddr;
+    uint8_t phy;
+    uint16_t interval;
+    uint8_t clockAccuracy;
+} __attribute__((packed));
+
+struct LePeriodicAdvReport {
+    uint16_t syncHandle;
+    int8_t txPower;
+    int8_t rssi;
+    uint8_t unused;
+    uint8_t dataStatus;
+    uint8_t length;
+    uint8_t data[0];
+} __attribute__((packed));
+
+struct LePeriodicAdvSyncLost {
+    uint16_t syncHandle;
+} __attribute__((packed));
+
+constexpr uint16_t EXT_ADV_DATA_STATUS_MASK = 0x0060;
+constexpr uint16_t EXT_ADV_DATA_COMPLETE = 0x0000;
+constexpr uint16_t EXT_ADV_DATA_MORE = 0x0020;
+constexpr uint16_t EXT_ADV_SCAN_RESPONSE = 0x0008;
+
+constexpr uint8_t ADV_SCAN_RSP = 0x04; // Legacy report event type of a scan response
+
+constexpr uint8_t PERIODIC_ADV_DATA_COMPLETE = 0x00;
+constexpr uint8_t PERIODIC_ADV_DATA_MORE = 0x01;
+constexpr uint16_t PERIODIC_SYNC_TIMEOUT_MIN = 100; // 1 s in 10 ms units
+constexpr uint16_t PERIODIC_SYNC_TIMEOUT_MAX = 0x4000;
+constexpr unsigned PERIODIC_SYNC_TIMEOUT_EVENTS = 6; // Missed periodic events before the sync is lost
+
 /**
  * @brief
  *
@@ -40,7 +159,7 @@ enum : uint8_t {
 AdvReceiver::AdvReceiver(QObject* parent)
     : QObject(parent)
 {
-    uint8_t scan_type = 0x00; /* Passive */
+    uint8_t scan_type = 0x01; /* Active, scannable beacons answer with the detail payload */
 
     uint8_t own_type = 0x00;
     uint8_t filter_policy = 0x00;
@@ -54,14 +173,18 @@ AdvReceiver::AdvReceiver(QObject* parent)
         throw std::system_error(errno, std::system_category(), "Could not open HCI device");
     }
 
-    int retval = hci_le_set_scan_parameters(m_dd, scan_type, interval, window, own_type, filter_policy, 1000);
-    if (retval < 0) {
-        throw std::system_error(errno, std::system_category(), "Set scan parameters failed");
-    }
+    // Extended scanning also reports legacy adverts, legacy commands are used with older controllers
+    m_extended = setExtendedScan(true);
+    if (!m_extended) {
+        int retval = hci_le_set_scan_parameters(m_dd, scan_type, interval, window, own_type, filter_policy, 1000);
+        if (retval < 0) {
+            throw std::system_error(errno, std::system_category(), "Set scan parameters failed");
+        }
 
-    retval = hci_le_set_scan_enable(m_dd, 0x01, 1, 1000);
-    if (retval < 0) {
-        throw std::system_error(errno, std::system_category(), "Enable scan failed");
+        retval = hci_le_set_scan_enable(m_dd, 0x01, 1, 1000);
+        if (retval < 0) {
+            throw std::system_error(errno, std::system_category(), "Enable scan failed");
+        }
     }
 
     m_advReveiver = std::thread(&AdvReceiver::advReveiver, this);
@@ -77,14 +200,81 @@ AdvReceiver::~AdvReceiver()
     m_terminate = true;
     m_advReveiver.join();
 
-    int retval = hci_le_set_scan_enable(m_dd, 0x00, 1, 1000);
-    if (retval < 0) {
-        qDebug() << "Disable scan failed";
+    if (Sync::Established == m_sync) {
+        // Scanning is off while synced
+        if (!sendLeCommand(OCF_LE_PERIODIC_ADV_TERMINATE_SYNC, &m_syncHandle, sizeof(m_syncHandle))) {
+            qDebug() << "Terminate periodic sync failed";
+        }
+    } else if (m_extended) {
+        if (Sync::Pending == m_sync && !sendLeCommand(OCF_LE_PERIODIC_ADV_CREATE_SYNC_CANCEL, nullptr, 0)) {
+            qDebug() << "Cancel periodic sync failed";
+        }
+        if (!setExtendedScan(false)) {
+            qDebug() << "Disable scan failed";
+        }
+    } else {
+        int retval = hci_le_set_scan_enable(m_dd, 0x00, 1, 1000);
+        if (retval < 0) {
+            qDebug() << "Disable scan failed";
+        }
     }
 
     hci_close_dev(m_dd);
 }
 
+/**
+ * @brief Sends an LE controller command and checks its status
+ *
+ * @param ocf command
+ * @param param command parameters
+ * @param plen parameters length
+ * @param commandStatus the controller answers with Command Status instead of Command Complete
+ * @return bool
+ */
+bool AdvReceiver::sendLeCommand(uint16_t ocf, void* param, int plen, bool commandStatus)
+{
+    uint8_t status = 0xFF;
+    struct hci_request rq = {};
+    rq.ogf = OGF_LE_CTL;
+    rq.ocf = ocf;
+    rq.event = commandStatus ? EVT_CMD_STATUS : 0;
+    rq.cparam = param;
+    rq.clen = plen;
+    rq.rparam = &status;
+    rq.rlen = 1;
+    return hci_send_req(m_dd, &rq, 1000) >= 0 && 0 == status;
+}
+
+/**
+ * @brief Enables or disables active extended scanning, on LE Coded PHY too if the controller has it
+ *
+ * @param enable
+ * @return bool false if the controller does not support extended scanning
+ */
+bool AdvReceiver::setExtendedScan(bool enable)
+{
+    if (enable) {
+        LeSetExtScanParameters params = {};
+        params.phys = LE_SCAN_PHY_1M | LE_SCAN_PHY_CODED;
+        for (auto& phy : params.phy) {
+            phy.type = 0x01; /* Active */
+            phy.interval = htobs(0x0010);
+            phy.window = htobs(0x0010);
+        }
+        if (!sendLeCommand(OCF_LE_SET_EXT_SCAN_PARAMETERS, &params, sizeof(params))) {
+            params.phys = LE_SCAN_PHY_1M;
+            if (!sendLeCommand(OCF_LE_SET_EXT_SCAN_PARAMETERS, &params, sizeof(params) - sizeof(params.phy[1]))) {
+                return false;
+            }
+        }
+    }
+
+    LeSetExtScanEnable scanEnable = {};
+    scanEnable.enable = enable ? 0x01 : 0x00;
+    scanEnable.filterDup = 0x01;
+    return sendLeCommand(OCF_LE_SET_EXT_SCAN_ENABLE, &scanEnable, sizeof(scanEnable));
+}
+
 /**
  * @brief Thread function for receiving
  *
@@ -118,58 +308,405 @@ void AdvReceiver::advReveiver()
             break;
         }
 
-        uint8_t* ptr = buf + (1 + HCI_EVENT_HDR_SIZE);
-        len -= (1 + HCI_EVENT_HDR_SIZE);
+        if (len > 0) {
+            handleEvent(buf, static_cast<size_t>(len));
+        }
+    }
+
+    setsockopt(m_dd, SOL_HCI, HCI_FILTER, &of, sizeof(of));
+}
 
+/**
+ * @brief Handles one HCI event packet, as read from the socket
+ *
+ * @param buf packet, starting with the packet type
+ * @param len packet length
+ */
+void AdvReceiver::handleEvent(const uint8_t* buf, size_t len)
+{
+    if (len < 1 + HCI_EVENT_HDR_SIZE + EVT_LE_META_EVENT_SIZE) {
+        return;
+    }
+    const uint8_t* ptr = buf + (1 + HCI_EVENT_HDR_SIZE);
+    len -= (1 + HCI_EVENT_HDR_SIZE);
+
+    auto meta = reinterpret_cast<const evt_le_meta_event*>(ptr);
+    switch (meta->subevent) {
+    case EVT_LE_ADVERTISING_REPORT:
+        handleLegacyReports(meta->data, len - EVT_LE_META_EVENT_SIZE);
+        break;
+    case EVT_LE_EXT_ADVERTISING_REPORT:
+        handleExtendedReports(meta->data, len - EVT_LE_META_EVENT_SIZE);
+        break;
+    case EVT_LE_PERIODIC_ADV_SYNC_ESTABLISHED:
+        handlePeriodicSyncEstablished(meta->data, len - EVT_LE_META_EVENT_SIZE);
+        break;
+    case EVT_LE_PERIODIC_ADV_REPORT:
+        handlePeriodicReport(meta->data, len - EVT_LE_META_EVENT_SIZE);
+        break;
+    case EVT_LE_PERIODIC_ADV_SYNC_LOST:
+        handlePeriodicSyncLost(meta->data, len - EVT_LE_META_EVENT_SIZE);
+        break;
+    default:
         // Ignoring
-        auto meta = reinterpret_cast<evt_le_meta_event*>(ptr);
-        if (meta->subevent != 0x02) {
+        break;
+    }
+}
+
+/**
+ * @brief Handles LE Advertising Report event
+ *
+ * @param data event parameters after subevent code
+ * @param len parameters length
+ */
+void AdvReceiver::handleLegacyReports(const uint8_t* data, size_t len)
+{
+    uint8_t reports = data[0];
+    size_t offset = 1;
+
+    for (uint8_t i = 0; i < reports && offset + LE_ADVERTISING_INFO_SIZE <= len; i++) {
+        auto info = reinterpret_cast<const le_advertising_info*>(&data[offset]);
+        if (offset + LE_ADVERTISING_INFO_SIZE + info->length > len) {
             break;
         }
 
-        // Ignoring multiple reports
-        auto info = reinterpret_cast<le_advertising_info*>(meta->data + 1);
-        // We also can retrieve MAC address: ba2str(&info->bdaddr, addr);
-        auto name = getEirName(info->data, info->length);
+        char addr[18];
+        ba2str(&info->bdaddr, addr);
+        handleReport(addr, info->data, info->length, ADV_SCAN_RSP == info->evt_type);
 
-        // Filter by NAME
-        if ("tracker" == name) {
-            struct PositionDataStr {
-                int32_t latitude;
-                int32_t longitude;
-            } __attribute__((packed));
+        // Data is followed by RSSI
+        offset += LE_ADVERTISING_INFO_SIZE + info->length + 1;
+    }
+}
+
+/**
+ * @brief Handles LE Extended Advertising Report event, reassembling fragmented advertising data
+ *
+ * @param data event parameters after subevent code
+ * @param len parameters length
+ */
+void AdvReceiver::handleExtendedReports(const uint8_t* data, size_t len)
+{
+    uint8_t reports = data[0];
+    size_t offset = 1;
 
-            auto adv = reinterpret_cast<PositionDataStr*>(&info->data[7]);
-            double latitude = convertToDeg(adv->latitude);
-            double longitude = convertToDeg(adv->longitude);
-            emit positionReveived(latitude, longitude);
+    for (uint8_t i = 0; i < reports && offset + sizeof(LeExtAdvertisingInfo) <= len; i++) {
+        auto info = reinterpret_cast<const LeExtAdvertisingInfo*>(&data[offset]);
+        if (offset + sizeof(LeExtAdvertisingInfo) + info->length > len) {
+            break;
         }
+        offset += sizeof(LeExtAdvertisingInfo) + info->length;
+
+        char addr[18];
+        ba2str(&info->bdaddr, addr);
+
+        auto& fragments = m_fragments[addr];
+        fragments.insert(fragments.end(), info->data, info->data + info->length);
+
+        switch (btohs(info->evtType) & EXT_ADV_DATA_STATUS_MASK) {
+        case EXT_ADV_DATA_COMPLETE:
+            handleReport(addr, fragments.data(), fragments.size(), btohs(info->evtType) & EXT_ADV_SCAN_RESPONSE);
+            // A tracker pointing to a periodic advertising train is followed there, scanning stops
+            if (0 != info->periodicInterval && Sync::None == m_sync && m_beacons.count(addr)) {
+                createPeriodicSync(addr, info->bdaddrType, info->bdaddr.b, info->sid, btohs(info->periodicInterval));
+            }
+            break;
+        case EXT_ADV_DATA_MORE:
+            continue;
+        default:
+            // Truncated, the rest will not come
+            break;
+        }
+        m_fragments.erase(addr);
     }
+}
 
-    setsockopt(m_dd, SOL_HCI, HCI_FILTER, &of, sizeof(of));
+/**
+ * @brief Starts following the periodic advertising train of a beacon
+ *
+ * @details The controller keeps scanning until the train is found and reports it with
+ *          LE Periodic Advertising Sync Established.
+ *
+ * @param address beacon address
+ * @param addressType beacon address type
+ * @param bdaddr beacon address, as reported
+ * @param sid advertising set ID
+ * @param interval periodic advertising interval, 1.25 ms
+ */
+void AdvReceiver::createPeriodicSync(const std::string& address, uint8_t addressType, const uint8_t* bdaddr, uint8_t sid, uint16_t interval)
+{
+    LePeriodicAdvCreateSync params = {};
+    params.sid = sid;
+    params.bdaddrType = addressType;
+    std::copy(bdaddr, bdaddr + sizeof(params.bdaddr.b), params.bdaddr.b);
+    params.skip = 0; // Every event carries the newest fix
+
+    // Timeout in 10 ms units
+    unsigned timeout = interval * 125u * PERIODIC_SYNC_TIMEOUT_EVENTS / 1000u;
+    params.syncTimeout = htobs(static_cast<uint16_t>(std::min<unsigned>(std::max<unsigned>(timeout, PERIODIC_SYNC_TIMEOUT_MIN), PERIODIC_SYNC_TIMEOUT_MAX)));
+
+    if (!sendLeCommand(OCF_LE_PERIODIC_ADV_CREATE_SYNC, &params, sizeof(params), true)) {
+        qDebug() << "Create periodic sync failed";
+        return;
+    }
+    m_sync = Sync::Pending;
+    m_syncAddress = address;
+    qDebug() << address.c_str() << "periodic advertising every" << interval * 1.25 << "ms, syncing";
+}
+
+/**
+ * @brief Handles LE Periodic Advertising Sync Established event, scanning stops once synced
+ *
+ * @param data event parameters after subevent code
+ * @param len parameters length
+ */
+void AdvReceiver::handlePeriodicSyncEstablished(const uint8_t* data, size_t len)
+{
+    if (len < sizeof(LePeriodicAdvSyncEstablished) || Sync::Pending != m_sync) {
+        return;
+    }
+    auto event = reinterpret_cast<const LePeriodicAdvSyncEstablished*>(data);
+    if (0 != event->status) {
+        qDebug() << m_syncAddress.c_str() << "periodic sync failed, status" << static_cast<int>(event->status);
+        m_sync = Sync::None;
+        return;
+    }
+
+    m_sync = Sync::Established;
+    m_syncHandle = btohs(event->syncHandle);
+    m_periodicFragments.clear();
+    qDebug() << m_syncAddress.c_str() << "periodic sync established, scanning stops";
+    if (!setExtendedScan(false)) {
+        qDebug() << "Disable scan failed";
+    }
+}
+
+/**
+ * @brief Handles LE Periodic Advertising Report event, reassembling fragmented data
+ *
+ * @param data event parameters after subevent code
+ * @param len parameters length
+ */
+void AdvReceiver::handlePeriodicReport(const uint8_t* data, size_t len)
+{
+    if (len < sizeof(LePeriodicAdvReport) || Sync::Established != m_sync) {
+        return;
+    }
+    auto report = reinterpret_cast<const LePeriodicAdvReport*>(data);
+    if (btohs(report->syncHandle) != m_syncHandle || sizeof(LePeriodicAdvReport) + report->length > len) {
+        return;
+    }
+
+    m_periodicFragments.insert(m_periodicFragments.end(), report->data, report->data + report->length);
+    switch (report->dataStatus) {
+    case PERIODIC_ADV_DATA_COMPLETE: {
+        // The sync was made to a known beacon
+        const uint8_t* payload;
+        size_t payloadLen;
+        if (getEirManufData(m_periodicFragments.data(), m_periodicFragments.size(), payload, payloadLen)) {
+            handlePayload(m_syncAddress, payload, payloadLen);
+        }
+        break;
+    }
+    case PERIODIC_ADV_DATA_MORE:
+        return;
+    default:
+        // Truncated, the rest will not come
+        break;
+    }
+    m_periodicFragments.clear();
+}
+
+/**
+ * @brief Handles LE Periodic Advertising Sync Lost event, scanning restarts
+ *
+ * @param data event parameters after subevent code
+ * @param len parameters length
+ */
+void AdvReceiver::handlePeriodicSyncLost(const uint8_t* data, size_t len)
+{
+    if (len < sizeof(LePeriodicAdvSyncLost) || Sync::Established != m_sync
+        || btohs(reinterpret_cast<const LePeriodicAdvSyncLost*>(data)->syncHandle) != m_syncHandle) {
+        return;
+    }
+
+    m_sync = Sync::None;
+    qDebug() << m_syncAddress.c_str() << "periodic sync lost, scanning restarts";
+    if (!setExtendedScan(true)) {
+        qDebug() << "Enable scan failed";
+    }
+}
+
+/**
+ * @brief Handles complete advertising data of one device
+ *
+ * @param address device address
+ * @param eir advertising data
+ * @param eir_len advertising data length
+ * @param scanResponse the data is a scan response
+ */
+void AdvReceiver::handleReport(const std::string& address, const uint8_t* eir, size_t eir_len, bool scanResponse)
+{
+    const uint8_t* data;
+    size_t dataLen;
+
+    if (!getEirManufData(eir, eir_len, data, dataLen)) {
+        return;
+    }
+
+    if (scanResponse) {
+        // Only scan responses of devices known from their position payload are taken
+        if (m_beacons.count(address)) {
+            handleDetail(address, data, dataLen);
+        }
+        return;
+    }
+
+    // Filter by company identifier and payload version, adverts carry no name
+    uint8_t version = data[0] & ~BEACON_PAYLOAD_FLAG_PREDICTED;
+    if (BEACON_PAYLOAD_VERSION == version || BEACON_PAYLOAD_VERSION_ASSET == version) {
+        m_beacons[address]; // Known from now on, even before its first fix
+        handlePayload(address, data, dataLen);
+    }
+}
+
+/**
+ * @brief Emits positions from beacon payload, backfilling fixes missed since the last advert
+ *
+ * @details A prediction is emitted as such, the fix it follows is its first history entry and
+ *          is taken from there when its own advert was missed.
+ *
+ * @param address beacon address
+ * @param data payload after company identifier
+ * @param len payload length
+ */
+void AdvReceiver::handlePayload(const std::string& address, const uint8_t* data, size_t len)
+{
+    std::vector<beacon_fix_t> fixes(1 + len / 2);
+    beacon_info_t info;
+    size_t count = beacon_payload_decode(data, len, &info, fixes.data(), fixes.size());
+    if (0 == count || 0 == info.seq) {
+        return; // Other payload version, or no fix yet
+    }
+
+    if (info.predicted) {
+        emit positionPredicted(convertToDeg(fixes[0].latitude), convertToDeg(fixes[0].longitude));
+        fixes.erase(fixes.begin());
+        if (0 == --count) {
+            return; // The fix itself did not fit
+        }
+    }
+
+    if (BEACON_ASSET_NONE != info.asset) {
+        // Fleet gateway, every advert carries the newest position of one of its assets
+        auto& asset = m_beacons[address + "/" + std::to_string(info.asset)];
+        if (info.seq != asset.seq) {
+            asset.lost += (asset.received > 0) ? beacon_seq_distance(asset.seq, info.seq) - 1 : 0;
+            asset.seq = info.seq;
+            asset.received++;
+            emit assetPositionReceived(info.asset, convertToDeg(fixes[0].latitude), convertToDeg(fixes[0].longitude));
+        }
+        return;
+    }
+
+    size_t first = 0;
+    auto& beacon = m_beacons[address];
+    if (beacon.received > 0) {
+        uint8_t steps = beacon_seq_distance(beacon.seq, info.seq);
+        if (0 == steps) {
+            return; // Fix known already
+        }
+        first = std::min<size_t>(steps - 1, count - 1);
+        beacon.lost += steps - 1 - first;
+    }
+    beacon.seq = info.seq;
+    beacon.received += first + 1;
+
+    if (BEACON_TIME_UNKNOWN != info.time && !info.predicted) {
+        auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch());
+        int nowTime = static_cast<int>(now.count() / 100 % BEACON_TIME_PER_HOUR);
+        int age = (nowTime - info.time + BEACON_TIME_PER_HOUR) % BEACON_TIME_PER_HOUR;
+        qDebug() << address.c_str() << "seq" << static_cast<int>(info.seq) << "age" << age * 100 << "ms, lost"
+                 << beacon.lost << "of" << beacon.lost + beacon.received;
+    }
+
+    // Oldest first
+    for (size_t i = first + 1; i-- > 0;) {
+        emit positionReveived(convertToDeg(fixes[i].latitude), convertToDeg(fixes[i].longitude));
+    }
+}
+
+/**
+ * @brief Merges the detail payload of a scan response into what is known of the beacon
+ *
+ * @details Fields the response does not know keep the value of an earlier response.
+ *
+ * @param address beacon address
+ * @param data payload after company identifier
+ * @param len payload length
+ */
+void AdvReceiver::handleDetail(const std::string& address, const uint8_t* data, size_t len)
+{
+    beacon_detail_t detail;
+    if (!beacon_detail_decode(data, len, &detail)) {
+        return; // Other payload version
+    }
+
+    auto& merged = m_beacons[address].detail;
+    auto merge = [](uint8_t& field, uint8_t value) {
+        if (BEACON_DETAIL_UNKNOWN != value) {
+            field = value;
+        }
+    };
+    merged.seq = detail.seq;
+    if (BEACON_ALTITUDE_UNKNOWN != detail.altitude) {
+        merged.altitude = detail.altitude;
+    }
+    merge(merged.satellites, detail.satellites);
+    merge(merged.quality, detail.quality);
+    merge(merged.pdop, detail.pdop);
+    merge(merged.hdop, detail.hdop);
+    merge(merged.vdop, detail.vdop);
+    if (0 != detail.battery_mv) {
+        merged.battery_mv = detail.battery_mv;
+    }
+    merged.build = detail.build;
+
+    auto dop = [](uint8_t value) { return (BEACON_DETAIL_UNKNOWN != value) ? value / 10.0 : NAN; };
+    double altitude = (BEACON_ALTITUDE_UNKNOWN != merged.altitude) ? merged.altitude / 10.0 : NAN;
+    int satellites = (BEACON_DETAIL_UNKNOWN != merged.satellites) ? merged.satellites : -1;
+    int batteryMv = (0 != merged.battery_mv) ? merged.battery_mv : -1;
+
+    qDebug() << address.c_str() << "seq" << static_cast<int>(merged.seq) << "altitude" << altitude << "m, satellites"
+             << satellites << "quality" << ((BEACON_DETAIL_UNKNOWN != merged.quality) ? merged.quality : -1)
+             << "DOP" << dop(merged.pdop) << dop(merged.hdop) << dop(merged.vdop)
+             << "battery" << batteryMv << "mV, build" << merged.build;
+
+    emit detailReceived(altitude, satellites, dop(merged.hdop), batteryMv);
 }
 
 /**
- * @brief Convert a raw coordinate to a floating point DD.DDD... value.
+ * @brief Convert a payload coordinate (1e-7 degree) to a floating point DD.DDD... value.
  *
  * @param value
  * @return double
  */
 double AdvReceiver::convertToDeg(int32_t value)
 {
-    int32_t degrees = value / (100 * 1000);
-    int32_t minutes = value % (100 * 1000);
-    return static_cast<double>(degrees) + static_cast<double>(minutes) / (60 * 1000);
+    return static_cast<double>(value) / BEACON_COORD_PER_DEGREE;
 }
 
 /**
- * @brief Finds and returns name in advertising packet
+ * @brief Finds manufacturer specific data of the beacon company identifier in advertising packet
  *
  * @param eir pointer to advertising packet
  * @param eir_len packet len
- * @return std::string
+ * @param data set to the data following company identifier
+ * @param data_len set to the data length
+ * @return bool
  */
-std::string AdvReceiver::getEirName(const uint8_t* eir, size_t eir_len)
+bool AdvReceiver::getEirManufData(const uint8_t* eir, size_t eir_len, const uint8_t*& data, size_t& data_len)
 {
     size_t offset = 0;
 
@@ -181,18 +718,21 @@ std::string AdvReceiver::getEirName(const uint8_t* eir, size_t eir_len)
             break;
         }
 
-        if (offset + field_len > eir_len) {
+        /* Length byte and field must both be inside the packet */
+        if (offset + 1 + field_len > eir_len) {
             break;
         }
 
-        switch (eir[1]) {
-        case EIR_NAME_SHORT:
-        case EIR_NAME_COMPLETE:
-            return std::string(&eir[2], &eir[2] + field_len - 1);
+        /* Type and company identifier, followed by at least one byte */
+        if (EIR_MANUFACTURER_DATA == eir[1] && field_len > 3
+            && BEACON_COMPANY_IDENTIFIER == (eir[2] | eir[3] << 8)) {
+            data = &eir[4];
+            data_len = field_len - 3;
+            return true;
         }
 
         offset += field_len + 1;
         eir += field_len + 1;
     }
-    return "(unknown)";
+    return false;
 }
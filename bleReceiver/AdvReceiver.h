@@ -5,8 +5,12 @@
 *******************************************************************************/
 #pragma once
 
+#include "beacon_payload.h"
 #include <QObject>
+#include <map>
+#include <string>
 #include <thread>
+#include <vector>
 class AdvReceiver : public QObject {
     Q_OBJECT
 public:
@@ -15,13 +19,51 @@ public:
 
 signals:
     void positionReveived(double latitude, double longitude);
+    void positionPredicted(double latitude, double longitude); // Extrapolated by the beacon between fixes, not part of the track
+    void assetPositionReceived(int asset, double latitude, double longitude); // Newest position of an asset advertised by a fleet gateway
+    void detailReceived(double altitude, int satellites, double hdop, int batteryMv); // Scan response of a scannable beacon, NaN or -1 if not known
 
 private:
-    static std::string getEirName(const uint8_t* eir, size_t eir_len);
+    friend class AdvReceiverTest; // Feeds recorded HCI events, see tests/
+
+    static bool getEirManufData(const uint8_t* eir, size_t eir_len, const uint8_t*& data, size_t& data_len);
+    bool sendLeCommand(uint16_t ocf, void* param, int plen, bool commandStatus = false);
+    bool setExtendedScan(bool enable);
+    void createPeriodicSync(const std::string& address, uint8_t addressType, const uint8_t* bdaddr, uint8_t sid, uint16_t interval);
+    void handleEvent(const uint8_t* buf, size_t len);
+    void handleLegacyReports(const uint8_t* data, size_t len);
+    void handleExtendedReports(const uint8_t* data, size_t len);
+    void handlePeriodicSyncEstablished(const uint8_t* data, size_t len);
+    void handlePeriodicReport(const uint8_t* data, size_t len);
+    void handlePeriodicSyncLost(const uint8_t* data, size_t len);
+    void handleReport(const std::string& address, const uint8_t* eir, size_t eir_len, bool scanResponse);
     double convertToDeg(int32_t value);
+    void handlePayload(const std::string& address, const uint8_t* data, size_t len);
+    void handleDetail(const std::string& address, const uint8_t* data, size_t len);
     void advReveiver(void);
 
     bool m_terminate = false;
     std::thread m_advReveiver;
     int m_dd = -1;
+    bool m_extended = false; // Scanning with LE extended scan commands, reports come as subevent 0x0D
+    std::map<std::string, std::vector<uint8_t>> m_fragments; // Extended advertising data received so far per address
+
+    enum class Sync {
+        None, // Scanning, no periodic advertising train followed
+        Pending, // LE Periodic Advertising Create Sync sent, waiting for the train
+        Established // Following the train, scanning is off
+    };
+    Sync m_sync = Sync::None;
+    uint16_t m_syncHandle = 0;
+    std::string m_syncAddress; // Beacon the train belongs to
+    std::vector<uint8_t> m_periodicFragments; // Periodic advertising data received so far
+
+    struct Beacon {
+        uint8_t seq = 0; // Sequence number of the newest fix
+        uint64_t received = 0; // Fixes received, directly or from history
+        uint64_t lost = 0; // Fixes neither advertised nor recovered from history
+        beacon_detail_t detail = { 0, BEACON_ALTITUDE_UNKNOWN, BEACON_DETAIL_UNKNOWN, BEACON_DETAIL_UNKNOWN,
+            BEACON_DETAIL_UNKNOWN, BEACON_DETAIL_UNKNOWN, BEACON_DETAIL_UNKNOWN, 0, 0 }; // Scan responses merged so far
+    };
+    std::map<std::string, Beacon> m_beacons; // Per beacon address, and per asset of a fleet gateway
 };
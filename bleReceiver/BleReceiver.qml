@@ -24,6 +24,18 @@ ApplicationWindow {
             console.debug("longitude: " + longitude)
             map.addMarker(latitude, longitude)
         }
+        onPositionPredicted: {
+            map.movePrediction(latitude, longitude)
+        }
+        onAssetPositionReceived: {
+            map.moveAsset(asset, latitude, longitude)
+        }
+        onDetailReceived: {
+            detail.text = (isNaN(altitude) ? "-" : altitude.toFixed(1)) + " m, "
+                + (satellites < 0 ? "-" : satellites) + " satellites, HDOP "
+                + (isNaN(hdop) ? "-" : hdop.toFixed(1)) + ", "
+                + (batteryMv < 0 ? "-" : (batteryMv / 1000).toFixed(2)) + " V"
+        }
     }
 
     MouseArea {
@@ -50,6 +62,8 @@ ApplicationWindow {
 
         property variant centerLocation: QtPositioning.coordinate(0, 0)
         property bool updateCenterLocation: true
+        property variant prediction: null // Marker of the position predicted between fixes
+        property var assets: ({}) // Marker per asset of a fleet gateway, by asset ID
 
         function addMarker(latitude, longitude) {
             var marker = Qt.createQmlObject('Marker {}', map)
@@ -62,11 +76,49 @@ ApplicationWindow {
                 updateCenterLocation = false
             }
         }
+        function movePrediction(latitude, longitude) {
+            if (null === prediction) {
+                prediction = Qt.createQmlObject('Marker { opacity: 0.5 }', map)
+                map.addMapItem(prediction)
+                prediction.z = map.z + 2
+            }
+            prediction.coordinate = QtPositioning.coordinate(latitude, longitude)
+        }
+        function moveAsset(asset, latitude, longitude) {
+            var marker = assets[asset]
+            if (undefined === marker) {
+                marker = Qt.createQmlObject('Marker {}', map)
+                map.addMapItem(marker)
+                marker.z = map.z + 1
+                assets[asset] = marker
+            }
+            marker.coordinate = QtPositioning.coordinate(latitude, longitude)
+
+            if (updateCenterLocation) {
+                centerLocation = QtPositioning.coordinate(latitude, longitude)
+                updateCenterLocation = false
+            }
+        }
         function clearMarkers() {
             map.clearMapItems()
+            map.prediction = null
+            map.assets = {}
             map.updateCenterLocation = true
         }
     }
+
+    Label {
+        id: detail // Scan response of the beacon, empty until one arrives
+        anchors.left: parent.left
+        anchors.top: parent.top
+        anchors.margins: 8
+        padding: 4
+        background: Rectangle {
+            color: "white"
+            opacity: 0.8
+        }
+        visible: text.length > 0
+    }
 }
 
 /*##^## Designer {
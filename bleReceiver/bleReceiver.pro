@@ -1,12 +1,17 @@
 QT += quick network positioning location widgets
 
 
+INCLUDEPATH += \
+    ../firmware/src
+
 SOURCES += \
     main.cpp \
-    AdvReceiver.cpp
+    AdvReceiver.cpp \
+    ../firmware/src/beacon_payload.c
 
 HEADERS += \
-    AdvReceiver.h
+    AdvReceiver.h \
+    ../firmware/src/beacon_payload.h
 
 LIBS += \
     -lbluetooth
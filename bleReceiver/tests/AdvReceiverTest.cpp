@@ -0,0 +1,230 @@
+/*******************************************************************************
+* @brief    Replays recorded HCI events through AdvReceiver and checks what it decodes
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#include "AdvReceiver.h"
+#include "hci_stub.h"
+
+#include <bluetooth/hci.h>
+
+#include <cctype>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+ * @brief Feeds LE meta events to AdvReceiver and compares the positions,
+ *        details and HCI commands that come out with the expected ones.
+ *
+ * The events were recorded from the host simulation of the firmware playing
+ * nmeaSender/sample.nmea (legacy, extended and scannable builds, and the
+ * predictions of a Kalman filter build), wrapped in the LE meta events a
+ * controller sends for them.
+ */
+class AdvReceiverTest {
+public:
+    AdvReceiverTest();
+    ~AdvReceiverTest();
+
+    bool step(const char* name, const std::vector<const char*>& events, const std::vector<std::string>& expected);
+
+private:
+    void output(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    AdvReceiver m_receiver;
+    std::vector<std::string> m_output;
+};
+
+AdvReceiverTest::AdvReceiverTest()
+{
+    QObject::connect(&m_receiver, &AdvReceiver::positionReveived, [this](double latitude, double longitude) {
+        output("position %.7f %.7f", latitude, longitude);
+    });
+    QObject::connect(&m_receiver, &AdvReceiver::positionPredicted, [this](double latitude, double longitude) {
+        output("predicted %.7f %.7f", latitude, longitude);
+    });
+    QObject::connect(&m_receiver, &AdvReceiver::assetPositionReceived, [this](int asset, double latitude, double longitude) {
+        output("asset %d %.7f %.7f", asset, latitude, longitude);
+    });
+    QObject::connect(&m_receiver, &AdvReceiver::detailReceived, [this](double altitude, int satellites, double hdop, int batteryMv) {
+        output("detail %.1f %d %.1f %d", altitude, satellites, hdop, batteryMv);
+    });
+}
+
+AdvReceiverTest::~AdvReceiverTest()
+{
+    // Lets the receiver thread return from its read
+    hciStubHangUp();
+}
+
+void AdvReceiverTest::output(const char* format, ...)
+{
+    char line[128];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    m_output.push_back(line);
+}
+
+/*
+ * @brief Feeds events, then compares the output and the commands sent since the previous step with the expected lines.
+ *
+ * @param name Step name, printed on a mismatch
+ * @param events LE meta events in hex, from the subevent code on; spaces are skipped
+ * @param expected Output lines, commands as "command <OCF> <parameters>"
+ * @return bool False on a mismatch.
+ */
+bool AdvReceiverTest::step(const char* name, const std::vector<const char*>& events, const std::vector<std::string>& expected)
+{
+    m_output.clear();
+
+    for (auto event : events) {
+        std::vector<uint8_t> packet = { HCI_EVENT_PKT, EVT_LE_META_EVENT, 0 };
+        unsigned byte;
+        for (const char* p = event; *p;) {
+            if (isspace(static_cast<unsigned char>(*p))) {
+                p++;
+            } else if (1 == sscanf(p, "%2x", &byte)) {
+                packet.push_back(static_cast<uint8_t>(byte));
+                p += 2;
+            } else {
+                printf("%s: bad event %s\n", name, event);
+                return false;
+            }
+        }
+        packet[2] = static_cast<uint8_t>(packet.size() - 1 - HCI_EVENT_HDR_SIZE);
+        m_receiver.handleEvent(packet.data(), packet.size());
+    }
+
+    for (const auto& command : hciStubTakeCommands()) {
+        char line[16];
+        snprintf(line, sizeof(line), "command %04X ", command.ocf);
+        std::string text = line;
+        for (auto byte : command.param) {
+            snprintf(line, sizeof(line), "%02X", byte);
+            text += line;
+        }
+        m_output.push_back(text);
+    }
+
+    if (m_output == expected) {
+        printf("%s: ok\n", name);
+        return true;
+    }
+    printf("%s: FAILED\n  expected:\n", name);
+    for (const auto& line : expected) {
+        printf("    %s\n", line.c_str());
+    }
+    printf("  got:\n");
+    for (const auto& line : m_output) {
+        printf("    %s\n", line.c_str());
+    }
+    return false;
+}
+
+int main()
+{
+    bool ok = true;
+
+    {
+        AdvReceiverTest test;
+
+        ok &= test.step("extended scanning on 1M and Coded PHY", {},
+            { "command 0041 00000501100010000110001000",
+                "command 0042 010100000000" });
+
+        // Beacon 11:22:33:44:55:66, legacy ADV_NONCONN_IND and SCAN_RSP reports
+        ok &= test.step("legacy advert",
+            { "02 01 03 00 665544332211 1F 0201041BFFFFFF0101E76F6E23BB31C00EEC63FE4980808080808080808080 C4" },
+            { "position 59.4440167 24.7476667" });
+
+        ok &= test.step("legacy advert, fixes 2 to 5 from the history",
+            { "02 01 03 00 665544332211 1F 0201041BFFFFFF0106D4036E23E354C00E1E64FE9E0B0C12020B0D28010CC6 C4" },
+            { "position 59.4436500 24.7494067",
+                "position 59.4424500 24.7493767",
+                "position 59.4421200 24.7489867",
+                "position 59.4415800 24.7489267",
+                "position 59.4412500 24.7485667" });
+
+        ok &= test.step("legacy advert repeated",
+            { "02 01 03 00 665544332211 1F 0201041BFFFFFF0106D4036E23E354C00E1E64FE9E0B0C12020B0D28010CC6 C4" },
+            {});
+
+        ok &= test.step("legacy scan response",
+            { "02 01 04 00 665544332211 1E 14FFFFFF8101000000000C010A0A0AB60B000000000809747261636B6572 C4" },
+            { "detail 0.0 12 1.0 2998" });
+
+        ok &= test.step("scan response of an unknown device",
+            { "02 01 04 00 998877665544 1E 14FFFFFF8101000000000C010A0A0AB60B000000000809747261636B6572 C4" },
+            {});
+
+        // Beacon 11:22:33:44:55:77 advertising Kalman predictions between fixes
+        ok &= test.step("advert of a predicting beacon",
+            { "02 01 03 00 775544332211 1F 0201041BFFFFFF0101E76F6E23BB31C00EEC63FE4980808080808080808080 C4" },
+            { "position 59.4440167 24.7476667" });
+
+        ok &= test.step("prediction, the advert of its fix missed",
+            { "02 01 03 00 775544332211 1F 0201041BFFFFFF4102E3566E232B65C00EF763FE81040011D4808080808080 C4" },
+            { "predicted 59.4433763 24.7489835",
+                "position 59.4434963 24.7489835" });
+
+        ok &= test.step("prediction repeated",
+            { "02 01 03 00 775544332211 1F 0201041BFFFFFF41027B526E235F65C00EF863FE81080011D4808080808080 C4" },
+            { "predicted 59.4432635 24.7489887" });
+
+        ok &= test.step("fix after predictions",
+            { "02 01 03 00 775544332211 1F 0201041BFFFFFF0103B93B6E23AE63C00E0064ABA11B0112D4808080808080 C4" },
+            { "position 59.4426809 24.7489454" });
+
+        ok &= test.step("prediction after its fix",
+            { "02 01 03 00 775544332211 1F 0201041BFFFFFF41037E3A6E23AF61C00E0164ABA101021B0112D480808080 C4" },
+            { "predicted 59.4426494 24.7488943" });
+
+        // Beacon C0:FF:EE:00:00:01 (random), extended advert in two fragments, periodic train every 1 s on SID 3
+        ok &= test.step("extended advert, fragmented",
+            { "0D 01 2000 01 010000EEFFC0 01 01 03 7F C4 2003 00 000000000000 64"
+              "020104CFFFFFFF0101E76F6E23BB31C00EEC63FE49808080808080808080808080808080808080808080808080"
+              "8080808080808080808080808080808080808080808080808080808080808080808080808080808080808080"
+              "80808080808080808080808080808080808080808080",
+                "0D 01 0000 01 010000EEFFC0 01 01 03 7F C4 2003 00 000000000000 6F"
+                "8080808080808080808080808080808080808080808080808080808080808080808080808080808080808080"
+                "8080808080808080808080808080808080808080808080808080808080808080808080808080808080808080"
+                "808080808080808080808080808080808080808080808080808080808080808080" },
+            { "position 59.4440167 24.7476667",
+                "command 0044 000301010000EEFFC00000580200" });
+
+        ok &= test.step("sync established",
+            { "0E 00 0100 03 01 010000EEFFC0 01 2003 00" },
+            { "command 0042 000100000000" });
+
+        ok &= test.step("periodic report",
+            { "0F 0100 7F C4 FF 00 1F 0201041BFFFFFF010294616E237075C00EF663FE810CC68080808080808080" },
+            { "position 59.4436500 24.7494000" });
+
+        ok &= test.step("periodic report, fragmented",
+            { "0F 0100 7F C4 FF 01 0C 0201041BFFFFFF0103B4326E",
+                "0F 0100 7F C4 FF 00 13 232374C00E0064ABA128010CC6808080808080" },
+            { "position 59.4424500 24.7493667" });
+
+        ok &= test.step("periodic report of another sync",
+            { "0F 0200 7F C4 FF 00 1F 0201041BFFFFFF0104AF256E23D065C00E0A64F7860B0C28010CC780808080" },
+            {});
+
+        ok &= test.step("sync lost",
+            { "10 0100",
+                "0F 0100 7F C4 FF 00 1F 0201041BFFFFFF0104AF256E23D065C00E0A64F7860B0C28010CC780808080" },
+            { "command 0041 00000501100010000110001000",
+                "command 0042 010100000000" });
+
+        ok &= test.step("extended scan response",
+            { "0D 01 1A00 01 010000EEFFC0 01 00 FF 7F C4 0000 00 000000000000 1E"
+              "14FFFFFF8101000000000C010A0A0AB60B000000000809747261636B6572" },
+            { "detail 0.0 12 1.0 2998" });
+    }
+
+    printf("%s\n", ok ? "All passed" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+# Replays recorded HCI events through AdvReceiver, built against stub BlueZ headers.
+# Run: qmake && make && ./advReceiverTest
+
+TEMPLATE = app
+CONFIG += console c++11 thread
+CONFIG -= app_bundle
+QT = core
+
+INCLUDEPATH += \
+    stub \
+    .. \
+    ../../firmware/src
+
+SOURCES += \
+    AdvReceiverTest.cpp \
+    stub/hci_stub.cpp \
+    ../AdvReceiver.cpp \
+    ../../firmware/src/beacon_payload.c
+
+HEADERS += \
+    stub/hci_stub.h \
+    ../AdvReceiver.h \
+    ../../firmware/src/beacon_payload.h
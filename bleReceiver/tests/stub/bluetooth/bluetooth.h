@@ -0,0 +1,23 @@
+/*******************************************************************************
+* @brief    Stub of the BlueZ bluetooth.h, the parts AdvReceiver uses
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+typedef struct {
+    uint8_t b[6];
+} __attribute__((packed)) bdaddr_t;
+
+// Host byte order is little endian, as on the test machines
+#define htobs(d) (d)
+#define btohs(d) (d)
+
+inline int ba2str(const bdaddr_t* ba, char* str)
+{
+    return sprintf(str, "%2.2X:%2.2X:%2.2X:%2.2X:%2.2X:%2.2X",
+        ba->b[5], ba->b[4], ba->b[3], ba->b[2], ba->b[1], ba->b[0]);
+}
@@ -0,0 +1,44 @@
+/*******************************************************************************
+* @brief    Stub of the BlueZ hci.h, the parts AdvReceiver uses
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#pragma once
+
+#include <bluetooth/bluetooth.h>
+#include <sys/socket.h>
+
+#define HCI_MAX_EVENT_SIZE 260
+#define HCI_EVENT_PKT 0x04
+#define HCI_EVENT_HDR_SIZE 2
+
+#define SOL_HCI 0
+#define HCI_FILTER 2
+
+#define OGF_LE_CTL 0x08
+#define OCF_LE_SET_SCAN_PARAMETERS 0x000B
+#define OCF_LE_SET_SCAN_ENABLE 0x000C
+
+#define EVT_CMD_STATUS 0x0F
+#define EVT_LE_META_EVENT 0x3E
+
+typedef struct {
+    uint8_t subevent;
+    uint8_t data[0];
+} __attribute__((packed)) evt_le_meta_event;
+#define EVT_LE_META_EVENT_SIZE 1
+
+typedef struct {
+    uint8_t evt_type;
+    uint8_t bdaddr_type;
+    bdaddr_t bdaddr;
+    uint8_t length;
+    uint8_t data[0];
+} __attribute__((packed)) le_advertising_info;
+#define LE_ADVERTISING_INFO_SIZE 9
+
+struct hci_filter {
+    uint32_t type_mask;
+    uint32_t event_mask[2];
+    uint16_t opcode;
+};
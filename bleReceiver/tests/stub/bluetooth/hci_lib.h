@@ -0,0 +1,46 @@
+/*******************************************************************************
+* @brief    Stub of the BlueZ hci_lib.h, the parts AdvReceiver uses
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#pragma once
+
+#include <bluetooth/hci.h>
+
+struct hci_request {
+    uint16_t ogf;
+    uint16_t ocf;
+    int event;
+    void* cparam;
+    int clen;
+    void* rparam;
+    int rlen;
+};
+
+int hci_get_route(bdaddr_t* bdaddr);
+int hci_open_dev(int dev_id);
+int hci_close_dev(int dd);
+int hci_send_req(int dd, struct hci_request* req, int timeout);
+int hci_le_set_scan_parameters(int dev_id, uint8_t type, uint16_t interval, uint16_t window, uint8_t own_type, uint8_t filter, int to);
+int hci_le_set_scan_enable(int dev_id, uint8_t enable, uint8_t filter_dup, int to);
+
+inline void hci_filter_clear(struct hci_filter* f)
+{
+    *f = {};
+}
+
+inline void hci_filter_set_ptype(int t, struct hci_filter* f)
+{
+    f->type_mask |= 1u << t;
+}
+
+inline void hci_filter_set_event(int e, struct hci_filter* f)
+{
+    f->event_mask[e >> 5] |= 1u << (e & 31);
+}
+
+// The stub device is one end of a socket pair, which has no HCI socket options
+int hci_stub_getsockopt(int fd, int level, int optname, void* optval, socklen_t* optlen);
+int hci_stub_setsockopt(int fd, int level, int optname, const void* optval, socklen_t optlen);
+#define getsockopt hci_stub_getsockopt
+#define setsockopt hci_stub_setsockopt
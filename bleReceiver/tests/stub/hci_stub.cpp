@@ -0,0 +1,98 @@
+/*******************************************************************************
+* @brief    Stub HCI device, records the commands sent to it
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#include "hci_stub.h"
+
+#include <bluetooth/hci_lib.h>
+
+#include <cstring>
+#include <mutex>
+
+#include <unistd.h>
+
+namespace {
+
+std::mutex commandsMutex;
+std::vector<HciStubCommand> commands;
+int peer = -1; // Far end of the device socket pair
+
+void record(uint16_t ocf, const void* param, size_t len)
+{
+    auto bytes = static_cast<const uint8_t*>(param);
+    std::lock_guard<std::mutex> lock(commandsMutex);
+    commands.push_back({ ocf, std::vector<uint8_t>(bytes, bytes + len) });
+}
+
+}
+
+std::vector<HciStubCommand> hciStubTakeCommands()
+{
+    std::lock_guard<std::mutex> lock(commandsMutex);
+    std::vector<HciStubCommand> taken;
+    taken.swap(commands);
+    return taken;
+}
+
+void hciStubHangUp()
+{
+    if (0 <= peer) {
+        close(peer);
+        peer = -1;
+    }
+}
+
+int hci_get_route(bdaddr_t*)
+{
+    return 0;
+}
+
+int hci_open_dev(int)
+{
+    int sv[2];
+    if (0 > socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv)) {
+        return -1;
+    }
+    peer = sv[1];
+    return sv[0];
+}
+
+int hci_close_dev(int dd)
+{
+    return close(dd);
+}
+
+int hci_send_req(int, struct hci_request* req, int)
+{
+    record(req->ocf, req->cparam, req->clen);
+    if (0 < req->rlen) {
+        memset(req->rparam, 0, req->rlen); // Status: success
+    }
+    return 0;
+}
+
+int hci_le_set_scan_parameters(int, uint8_t type, uint16_t interval, uint16_t window, uint8_t own_type, uint8_t filter, int)
+{
+    uint8_t param[] = { type, uint8_t(interval), uint8_t(interval >> 8), uint8_t(window), uint8_t(window >> 8), own_type, filter };
+    record(OCF_LE_SET_SCAN_PARAMETERS, param, sizeof(param));
+    return 0;
+}
+
+int hci_le_set_scan_enable(int, uint8_t enable, uint8_t filter_dup, int)
+{
+    uint8_t param[] = { enable, filter_dup };
+    record(OCF_LE_SET_SCAN_ENABLE, param, sizeof(param));
+    return 0;
+}
+
+int hci_stub_getsockopt(int, int, int, void* optval, socklen_t* optlen)
+{
+    memset(optval, 0, *optlen);
+    return 0;
+}
+
+int hci_stub_setsockopt(int, int, int, const void*, socklen_t)
+{
+    return 0;
+}
@@ -0,0 +1,23 @@
+/*******************************************************************************
+* @brief    Stub HCI device, records the commands sent to it
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct HciStubCommand {
+    uint16_t ocf; // LE controller command
+    std::vector<uint8_t> param;
+};
+
+/*
+ * @brief Returns the commands sent since the last call and forgets them.
+ *
+ * Every command succeeds; the receiver thread blocks reading the device
+ * until hciStubHangUp().
+ */
+std::vector<HciStubCommand> hciStubTakeCommands();
+void hciStubHangUp();
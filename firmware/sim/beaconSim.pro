@@ -0,0 +1,55 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+
+TARGET = beaconSim
+
+# Firmware main() is entered from the simulator main()
+DEFINES += main=beacon_main
+
+QMAKE_CFLAGS += -std=gnu99
+
+# qmake CONFIG+=extended: BLE 5 extended advertising, CONFIG+=coded: on LE Coded PHY
+extended|coded: DEFINES += BEACON_ADV_EXTENDED=1
+coded: DEFINES += BEACON_ADV_CODED_PHY=1
+# Kalman filter on, as in app_config.h; qmake CONFIG+=nokalman advertises the fixes as received
+!nokalman: DEFINES += BEACON_KALMAN_FILTER=1
+# UART power gating on, as in app_config.h; qmake CONFIG+=nogating keeps the UART always on
+!nogating:!hwfc: DEFINES += BEACON_UART_POWER_GATING=1
+# qmake CONFIG+=hwfc: RTS/CTS flow control, without power gating; qmake BAUD=1000000: UART baud rate
+hwfc: DEFINES += BEACON_UART_HWFC=1
+!isEmpty(BAUD): DEFINES += BEACON_UART_BAUDRATE=$$BAUD
+# Command channel on, as in app_config.h; answers are printed to the advertising log
+!nocommand: DEFINES += BEACON_COMMAND_CHANNEL=1
+# qmake CONFIG+=profile: hot-path profiling, PROF lines are printed with -v 3
+profile: DEFINES += PROFILE_ENABLED=1
+# qmake CONFIG+=fleet: fleet gateway advertising the assets of $PBCA sentences in turn
+fleet: DEFINES += BEACON_FLEET=1
+# qmake CONFIG+=scannable: scan responses with the detail payload, printed after " rsp" in the advertising log
+scannable: DEFINES += BEACON_SCANNABLE=1
+# Fix restore on, as in app_config.h; a fleet gateway has no fix of its own
+!fleet: DEFINES += BEACON_FIX_RESTORE=1
+
+INCLUDEPATH += \
+    mock \
+    ../src
+
+SOURCES += \
+    sim.c \
+    ../src/adv_interval.c \
+    ../src/beacon_payload.c \
+    ../src/command_format.c \
+    ../src/fleet.c \
+    ../src/kalman.c \
+    ../src/main.c \
+    ../src/nmea_queue.c \
+    ../src/profile.c \
+    ../src/track_format.c \
+    ../src/track_log.c \
+    ../src/minmea/minmea.c
+
+LIBS += -lm
+
+HEADERS += \
+    mock/sdk_mock.h
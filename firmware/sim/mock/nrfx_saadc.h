@@ -0,0 +1,3 @@
+/* Host simulation, see sdk_mock.h */
+#pragma once
+#include "sdk_mock.h"
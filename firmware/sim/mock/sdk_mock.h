@@ -0,0 +1,462 @@
+/*******************************************************************************
+* @brief    Host simulation of the beacon firmware: nRF5 SDK and SoftDevice mock.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*
+* Only the subset of types, macros and functions used by the application is
+* declared here. SDK header names (app_timer.h, ble_advdata.h, ...) in this
+* directory include this file, so firmware sources compile unchanged.
+*******************************************************************************/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Errors */
+typedef uint32_t ret_code_t;
+
+#define NRF_SUCCESS 0
+#define NRF_ERROR_INTERNAL 3
+#define NRF_ERROR_NO_MEM 4
+#define NRF_ERROR_INVALID_PARAM 7
+#define NRF_ERROR_INVALID_STATE 8
+#define NRF_ERROR_INVALID_LENGTH 9
+#define NRF_ERROR_DATA_SIZE 12
+#define NRF_ERROR_INVALID_ADDR 16
+#define NRF_ERROR_BUSY 17
+
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t* p_file_name);
+
+#define APP_ERROR_HANDLER(ERR_CODE) \
+    app_error_handler((ERR_CODE), __LINE__, (uint8_t const*)__FILE__)
+
+#define APP_ERROR_CHECK(ERR_CODE)                  \
+    do {                                           \
+        const uint32_t LOCAL_ERR_CODE = (ERR_CODE); \
+        if (LOCAL_ERR_CODE != NRF_SUCCESS) {       \
+            APP_ERROR_HANDLER(LOCAL_ERR_CODE);     \
+        }                                          \
+    } while (0)
+
+#define APP_ERROR_CHECK_BOOL(BOOLEAN_VALUE)  \
+    do {                                     \
+        if (!(BOOLEAN_VALUE)) {              \
+            APP_ERROR_HANDLER(0);            \
+        }                                    \
+    } while (0)
+
+/* Utilities */
+#define UNIT_0_625_MS 625
+#define UNIT_1_25_MS 1250
+#define UNIT_10_MS 10000
+#define MSEC_TO_UNITS(TIME, RESOLUTION) (((TIME)*1000) / (RESOLUTION))
+#define UNUSED_PARAMETER(X) ((void)(X))
+#define UNUSED_VARIABLE(X) ((void)(X))
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+
+#define APP_IRQ_PRIORITY_HIGHEST 2
+#define APP_IRQ_PRIORITY_HIGH 2
+#define APP_IRQ_PRIORITY_MID 3
+#define APP_IRQ_PRIORITY_LOW_MID 6
+#define APP_IRQ_PRIORITY_LOW 6
+#define APP_IRQ_PRIORITY_LOWEST 7
+
+#define __DMB() __sync_synchronize()
+#define __CLZ(x) ((uint32_t)__builtin_clz(x))
+
+#define CRITICAL_REGION_ENTER()
+#define CRITICAL_REGION_EXIT()
+
+/* Core debug and DWT, CYCCNT counts SystemCoreClock cycles of host monotonic time */
+typedef struct {
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+DWT_Type* sim_dwt(void);
+extern CoreDebug_Type sim_core_debug;
+extern uint32_t SystemCoreClock;
+
+#define DWT (sim_dwt())
+#define CoreDebug (&sim_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+typedef struct {
+    uint16_t size;
+    uint8_t* p_data;
+} uint8_array_t;
+
+/* Board (PCA10040) */
+#define RX_PIN_NUMBER 8
+#define TX_PIN_NUMBER 6
+#define CTS_PIN_NUMBER 7
+#define RTS_PIN_NUMBER 5
+
+/* Logger, printed to stderr when the simulator runs with -v */
+void sim_log(int level, const char* p_fmt, ...);
+
+#define NRF_LOG_ERROR(...) sim_log(1, __VA_ARGS__)
+#define NRF_LOG_WARNING(...) sim_log(2, __VA_ARGS__)
+#define NRF_LOG_INFO(...) sim_log(3, __VA_ARGS__)
+#define NRF_LOG_DEBUG(...) sim_log(4, __VA_ARGS__)
+#define NRF_LOG_INIT(timestamp_func) NRF_SUCCESS
+#define NRF_LOG_DEFAULT_BACKENDS_INIT()
+#define NRF_LOG_PROCESS() false
+#define NRF_LOG_FLUSH()
+
+/* Application timer, one tick is 1 ms; timers fire from the simulated sleep */
+typedef void (*app_timer_timeout_handler_t)(void* p_context);
+
+typedef enum {
+    APP_TIMER_MODE_SINGLE_SHOT,
+    APP_TIMER_MODE_REPEATED
+} app_timer_mode_t;
+
+typedef struct {
+    app_timer_timeout_handler_t handler;
+    app_timer_mode_t mode;
+    void* p_context;
+    uint64_t interval_ns;
+    uint64_t expire_ns;
+    bool running;
+} sim_timer_t;
+
+typedef sim_timer_t* app_timer_id_t;
+
+#define APP_TIMER_DEF(timer_id)            \
+    static sim_timer_t timer_id##_data;     \
+    static const app_timer_id_t timer_id = &timer_id##_data
+#define APP_TIMER_TICKS(MS) ((uint32_t)(MS))
+#define APP_TIMER_CLOCK_FREQ 1000
+#define APP_TIMER_CONFIG_RTC_FREQUENCY 0
+
+ret_code_t app_timer_init(void);
+ret_code_t app_timer_create(app_timer_id_t const* p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler);
+ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void* p_context);
+ret_code_t app_timer_stop(app_timer_id_t timer_id);
+uint32_t app_timer_cnt_get(void);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from);
+
+/* Power management, runs the simulation event loop */
+ret_code_t nrf_pwr_mgmt_init(void);
+void nrf_pwr_mgmt_run(void);
+
+/* Flash storage on a RAM image of the flash; operations complete in the simulated sleep */
+typedef enum {
+    NRF_FSTORAGE_EVT_READ_RESULT,
+    NRF_FSTORAGE_EVT_WRITE_RESULT,
+    NRF_FSTORAGE_EVT_ERASE_RESULT
+} nrf_fstorage_evt_id_t;
+
+typedef struct {
+    nrf_fstorage_evt_id_t id;
+    ret_code_t result;
+    uint32_t addr;
+    void const* p_src;
+    uint32_t len;
+    void* p_param;
+} nrf_fstorage_evt_t;
+
+typedef void (*nrf_fstorage_evt_handler_t)(nrf_fstorage_evt_t* p_evt);
+
+typedef struct {
+    uint32_t erase_unit;
+} nrf_fstorage_api_t;
+
+typedef struct {
+    nrf_fstorage_api_t const* p_api;
+    nrf_fstorage_evt_handler_t evt_handler;
+    uint32_t start_addr;
+    uint32_t end_addr;
+} nrf_fstorage_t;
+
+#define NRF_FSTORAGE_DEF(inst) inst
+
+extern nrf_fstorage_api_t nrf_fstorage_sd;
+
+ret_code_t nrf_fstorage_init(nrf_fstorage_t* p_fs, nrf_fstorage_api_t* p_api, void* p_param);
+ret_code_t nrf_fstorage_read(nrf_fstorage_t const* p_fs, uint32_t src, void* p_dest, uint32_t len);
+ret_code_t nrf_fstorage_write(nrf_fstorage_t const* p_fs, uint32_t dest, void const* p_src, uint32_t len, void* p_param);
+ret_code_t nrf_fstorage_erase(nrf_fstorage_t const* p_fs, uint32_t page_addr, uint32_t len, void* p_param);
+
+/* SoftDevice handler */
+ret_code_t nrf_sdh_enable_request(void);
+ret_code_t nrf_sdh_ble_default_cfg_set(uint8_t conn_cfg_tag, uint32_t* p_ram_start);
+ret_code_t nrf_sdh_ble_enable(uint32_t* p_app_ram_start);
+
+/* SoftDevice GAP */
+#define BLE_GAP_ADV_SET_DATA_SIZE_MAX 31
+#define BLE_GAP_ADV_SET_DATA_SIZE_EXTENDED_MAX_SUPPORTED 255
+#define BLE_GAP_ADV_SET_HANDLE_NOT_SET 0xFF
+#define BLE_GAP_DEVNAME_MAX_LEN 248
+
+#define BLE_GAP_ADV_TYPE_CONNECTABLE_SCANNABLE_UNDIRECTED 0x01
+#define BLE_GAP_ADV_TYPE_NONCONNECTABLE_SCANNABLE_UNDIRECTED 0x04
+#define BLE_GAP_ADV_TYPE_NONCONNECTABLE_NONSCANNABLE_UNDIRECTED 0x05
+#define BLE_GAP_ADV_TYPE_EXTENDED_CONNECTABLE_NONSCANNABLE_UNDIRECTED 0x06
+#define BLE_GAP_ADV_TYPE_EXTENDED_NONCONNECTABLE_NONSCANNABLE_UNDIRECTED 0x0A
+
+#define BLE_GAP_ADV_FP_ANY 0x00
+#define BLE_GAP_ADV_FLAG_LE_GENERAL_DISC_MODE 0x02
+#define BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED 0x04
+
+#define BLE_GAP_PHY_AUTO 0x00
+#define BLE_GAP_PHY_1MBPS 0x01
+#define BLE_GAP_PHY_2MBPS 0x02
+#define BLE_GAP_PHY_CODED 0x04
+
+#define BLE_GAP_AD_TYPE_FLAGS 0x01
+#define BLE_GAP_AD_TYPE_SHORT_LOCAL_NAME 0x08
+#define BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME 0x09
+#define BLE_GAP_AD_TYPE_TX_POWER_LEVEL 0x0A
+#define BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA 0xFF
+
+typedef struct {
+    uint8_t* p_data;
+    uint16_t len;
+} ble_data_t;
+
+typedef struct {
+    ble_data_t adv_data;
+    ble_data_t scan_rsp_data;
+} ble_gap_adv_data_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t anonymous : 1;
+    uint8_t include_tx_power : 1;
+} ble_gap_adv_properties_t;
+
+typedef struct {
+    uint8_t addr_id_peer : 1;
+    uint8_t addr_type : 7;
+    uint8_t addr[6];
+} ble_gap_addr_t;
+
+typedef uint8_t ble_gap_ch_mask_t[5];
+
+typedef struct {
+    ble_gap_adv_properties_t properties;
+    ble_gap_addr_t const* p_peer_addr;
+    uint32_t interval;
+    uint16_t duration;
+    uint8_t max_adv_evts;
+    ble_gap_ch_mask_t channel_mask;
+    uint8_t filter_policy;
+    uint8_t primary_phy;
+    uint8_t secondary_phy;
+    uint8_t set_id : 4;
+    uint8_t scan_req_notification : 1;
+} ble_gap_adv_params_t;
+
+typedef struct {
+    uint8_t sm : 4;
+    uint8_t lv : 4;
+} ble_gap_conn_sec_mode_t;
+
+#define BLE_GAP_CONN_SEC_MODE_SET_OPEN(ptr) \
+    do {                                    \
+        (ptr)->sm = 1;                      \
+        (ptr)->lv = 1;                      \
+    } while (0)
+
+uint32_t sd_ble_gap_device_name_set(ble_gap_conn_sec_mode_t const* p_write_perm, uint8_t const* p_dev_name, uint16_t len);
+uint32_t sd_ble_gap_adv_set_configure(uint8_t* p_adv_handle, ble_gap_adv_data_t const* p_adv_data, ble_gap_adv_params_t const* p_adv_params);
+uint32_t sd_ble_gap_adv_start(uint8_t adv_handle, uint8_t conn_cfg_tag);
+uint32_t sd_ble_gap_adv_stop(uint8_t adv_handle);
+
+#define BLE_GAP_TX_POWER_ROLE_ADV 1
+
+uint32_t sd_ble_gap_tx_power_set(uint8_t role, uint16_t handle, int8_t tx_power);
+
+/* Radio notification, one radio event per advertising interval while advertising */
+#define NRF_RADIO_NOTIFICATION_DISTANCE_800US 1
+
+typedef void (*ble_radio_notification_evt_handler_t)(bool radio_active);
+
+uint32_t ble_radio_notification_init(uint32_t irq_priority, uint8_t distance, ble_radio_notification_evt_handler_t evt_handler);
+
+/* Advertising data encoder */
+typedef enum {
+    BLE_ADVDATA_NO_NAME,
+    BLE_ADVDATA_SHORT_NAME,
+    BLE_ADVDATA_FULL_NAME
+} ble_advdata_name_type_t;
+
+typedef struct {
+    uint16_t company_identifier;
+    uint8_array_t data;
+} ble_advdata_manuf_data_t;
+
+typedef struct {
+    ble_advdata_name_type_t name_type;
+    uint8_t short_name_len;
+    bool include_appearance;
+    uint8_t flags;
+    int8_t* p_tx_power_level;
+    ble_advdata_manuf_data_t* p_manuf_specific_data;
+} ble_advdata_t;
+
+ret_code_t ble_advdata_encode(ble_advdata_t const* const p_advdata, uint8_t* const p_encoded_data, uint16_t* const p_len);
+
+/* libuarte */
+#define NRF_LIBUARTE_PERIPHERAL_NOT_USED 255
+
+typedef enum {
+    NRF_UARTE_HWFC_DISABLED = 0,
+    NRF_UARTE_HWFC_ENABLED = 1
+} nrf_uarte_hwfc_t;
+
+typedef enum {
+    NRF_UARTE_PARITY_EXCLUDED = 0,
+    NRF_UARTE_PARITY_INCLUDED = 0x0E
+} nrf_uarte_parity_t;
+
+typedef enum {
+    NRF_UARTE_BAUDRATE_9600 = 0x00275000,
+    NRF_UARTE_BAUDRATE_19200 = 0x004EA000,
+    NRF_UARTE_BAUDRATE_38400 = 0x009D0000,
+    NRF_UARTE_BAUDRATE_57600 = 0x00EB0000,
+    NRF_UARTE_BAUDRATE_115200 = 0x01D60000,
+    NRF_UARTE_BAUDRATE_230400 = 0x03B00000,
+    NRF_UARTE_BAUDRATE_250000 = 0x04000000,
+    NRF_UARTE_BAUDRATE_460800 = 0x07400000,
+    NRF_UARTE_BAUDRATE_921600 = 0x0F000000,
+    NRF_UARTE_BAUDRATE_1000000 = 0x10000000
+} nrf_uarte_baudrate_t;
+
+typedef enum {
+    NRF_LIBUARTE_ASYNC_EVT_RX_DATA,
+    NRF_LIBUARTE_ASYNC_EVT_TX_DONE,
+    NRF_LIBUARTE_ASYNC_EVT_ERROR,
+    NRF_LIBUARTE_ASYNC_EVT_OVERRUN_ERROR
+} nrf_libuarte_async_evt_type_t;
+
+typedef struct {
+    uint8_t* p_data;
+    size_t length;
+} nrf_libuarte_async_data_t;
+
+typedef struct {
+    uint32_t overrun_length;
+} nrf_libuarte_async_overrun_err_evt_t;
+
+typedef struct {
+    nrf_libuarte_async_evt_type_t type;
+    union {
+        nrf_libuarte_async_data_t rxtx;
+        uint8_t errorsrc;
+        nrf_libuarte_async_overrun_err_evt_t overrun_err;
+    } data;
+} nrf_libuarte_async_evt_t;
+
+typedef void (*nrf_libuarte_async_evt_handler_t)(void* context, nrf_libuarte_async_evt_t* p_evt);
+
+typedef struct {
+    uint32_t tx_pin;
+    uint32_t rx_pin;
+    uint32_t cts_pin;
+    uint32_t rts_pin;
+    uint32_t timeout_us;
+    nrf_uarte_hwfc_t hwfc;
+    nrf_uarte_parity_t parity;
+    nrf_uarte_baudrate_t baudrate;
+    uint8_t int_prio;
+} nrf_libuarte_async_config_t;
+
+typedef struct {
+    size_t rx_buf_size;
+} nrf_libuarte_async_t;
+
+#define NRF_LIBUARTE_ASYNC_DEFINE(_name, _uarte_idx, _timer0_idx, _rtc1_idx, _timer1_idx, _rx_buf_size, _rx_buf_cnt) \
+    static const nrf_libuarte_async_t _name = { .rx_buf_size = (_rx_buf_size) }
+
+ret_code_t nrf_libuarte_async_init(const nrf_libuarte_async_t* const p_libuarte,
+    nrf_libuarte_async_config_t const* p_config,
+    nrf_libuarte_async_evt_handler_t evt_handler,
+    void* context);
+void nrf_libuarte_async_enable(const nrf_libuarte_async_t* const p_libuarte);
+void nrf_libuarte_async_uninit(const nrf_libuarte_async_t* const p_libuarte);
+void nrf_libuarte_async_rx_free(const nrf_libuarte_async_t* const p_libuarte, uint8_t* p_data, size_t length);
+ret_code_t nrf_libuarte_async_tx(const nrf_libuarte_async_t* const p_libuarte, uint8_t* p_data, size_t length);
+
+/* GPIOTE, only the RX pin edge that wakes the powered-down UART */
+typedef uint32_t nrf_drv_gpiote_pin_t;
+
+typedef enum {
+    NRF_GPIOTE_POLARITY_LOTOHI = 1,
+    NRF_GPIOTE_POLARITY_HITOLO,
+    NRF_GPIOTE_POLARITY_TOGGLE
+} nrf_gpiote_polarity_t;
+
+typedef enum {
+    NRF_GPIO_PIN_NOPULL = 0,
+    NRF_GPIO_PIN_PULLDOWN = 1,
+    NRF_GPIO_PIN_PULLUP = 3
+} nrf_gpio_pin_pull_t;
+
+typedef struct {
+    nrf_gpiote_polarity_t sense;
+    nrf_gpio_pin_pull_t pull;
+    bool is_watcher;
+    bool hi_accuracy;
+    bool skip_gpio_setup;
+} nrf_drv_gpiote_in_config_t;
+
+#define GPIOTE_CONFIG_IN_SENSE_HITOLO(hi_accu) \
+    { .sense = NRF_GPIOTE_POLARITY_HITOLO, .pull = NRF_GPIO_PIN_NOPULL, .is_watcher = false, .hi_accuracy = (hi_accu), .skip_gpio_setup = false }
+
+typedef void (*nrf_drv_gpiote_evt_handler_t)(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action);
+
+ret_code_t nrf_drv_gpiote_init(void);
+bool nrf_drv_gpiote_is_init(void);
+ret_code_t nrf_drv_gpiote_in_init(nrf_drv_gpiote_pin_t pin, nrf_drv_gpiote_in_config_t const* p_config, nrf_drv_gpiote_evt_handler_t evt_handler);
+void nrf_drv_gpiote_in_event_enable(nrf_drv_gpiote_pin_t pin, bool int_enable);
+void nrf_drv_gpiote_in_uninit(nrf_drv_gpiote_pin_t pin);
+
+/* SAADC, blocking conversions of the VDD input only */
+typedef int16_t nrf_saadc_value_t;
+
+typedef enum {
+    NRF_SAADC_INPUT_DISABLED = 0,
+    NRF_SAADC_INPUT_VDD = 9
+} nrf_saadc_input_t;
+
+typedef struct {
+    uint8_t resolution;
+    uint8_t oversample;
+    uint8_t interrupt_priority;
+    bool low_power_mode;
+} nrfx_saadc_config_t;
+
+typedef struct {
+    uint8_t gain;
+    uint8_t reference;
+    nrf_saadc_input_t pin_p;
+    nrf_saadc_input_t pin_n;
+} nrf_saadc_channel_config_t;
+
+#define NRFX_SAADC_DEFAULT_CONFIG \
+    { .resolution = 1, .oversample = 0, .interrupt_priority = APP_IRQ_PRIORITY_LOWEST, .low_power_mode = false }
+
+#define NRFX_SAADC_DEFAULT_CHANNEL_CONFIG_SE(PIN_P) \
+    { .gain = 0, .reference = 0, .pin_p = (PIN_P), .pin_n = NRF_SAADC_INPUT_DISABLED }
+
+typedef struct {
+    uint8_t type;
+} nrfx_saadc_evt_t;
+
+typedef void (*nrfx_saadc_event_handler_t)(nrfx_saadc_evt_t const* p_event);
+
+ret_code_t nrfx_saadc_init(nrfx_saadc_config_t const* p_config, nrfx_saadc_event_handler_t event_handler);
+ret_code_t nrfx_saadc_channel_init(uint8_t channel, nrf_saadc_channel_config_t const* const p_config);
+ret_code_t nrfx_saadc_sample_convert(uint8_t channel, nrf_saadc_value_t* p_value);
@@ -0,0 +1,1334 @@
+/*******************************************************************************
+* @brief    Host simulation of the beacon firmware.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*
+* Firmware main() runs unchanged (renamed to beacon_main() by the build).
+* The simulated "sleep" in nrf_pwr_mgmt_run() waits for UART bytes on the
+* input (stdin, file or pty) or for the next application timer, and delivers
+* the bytes as libuarte RX chunks, so the real interrupt and main loop code
+* paths are exercised. While advertising, a radio event ends every advertising
+* interval and is signalled to the radio notification handler.
+* A tty runs on the wall clock. Any other input (a file or a pipe) runs on a
+* simulated clock: bytes take their character time at the configured baud
+* rate and each burst of sentences with a new NMEA time starts its log time
+* after the previous one, as from a GNSS module, so a replayed log is advertised
+* and logged fix by fix however fast it is read.
+* The UART may be powered down by the firmware; its on/off transitions are
+* written to the output as a power-state timeline, and data arriving while it
+* is down fires the RX pin GPIOTE handler and loses the characters received
+* before the UART is up again. Every advertising payload handed to the SoftDevice is
+* written to the output with a timestamp, and decoded again to check that its
+* fix history agrees with the previous one.
+* Flash is a RAM image with the nRF52 rules (erase to 0xFF, word writes that
+* only clear bits), optionally loaded from and saved to a file, so the track
+* log survives a simulated reset.
+*******************************************************************************/
+#include "beacon_payload.h"
+#include "minmea/minmea.h"
+#include "sdk_mock.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#undef main
+int beacon_main(void);
+
+#define SIM_RX_BUF_MAX 1024
+#define SIM_TIMERS_MAX 8
+#define SIM_FIX_MAX (1 + BLE_GAP_ADV_SET_DATA_SIZE_EXTENDED_MAX_SUPPORTED / 2)
+#define SIM_FIX_TOLERANCE BEACON_DELTA_UNIT /**< Two reconstructions may differ by half a delta unit each. */
+#define SIM_FLASH_SIZE 0x80000 /**< nRF52832 flash. */
+#define SIM_FLASH_PAGE_SIZE 4096
+#define SIM_FLASH_OPS_MAX 4 /**< NRF_FSTORAGE_SD_QUEUE_SIZE. */
+#define SIM_UART_WAKE_LOST_BYTES 3 /**< Characters missed between the RX edge and the UART receiving, about 250 us at 115200. */
+#define SIM_VDD_MV 3000 /**< Supply voltage the SAADC measures. */
+#define SIM_UART_ON_UA 500 /**< Rough current of a receiving UART: HFCLK, UARTE0, TIMER1 and RTC2, uA. */
+#define SIM_INPUT_BUF_SIZE 4096 /**< Input read ahead on the simulated clock, to find the bursts. */
+#define SIM_DAY_MS 86400000 /**< NMEA time wraps at midnight. */
+#define SIM_UART_FRAME_BITS 10 /**< Start bit, 8 data bits and stop bit. */
+#define SIM_LFXO_START_NS 250000000u /**< 32.768 kHz crystal start-up, typical (nRF52832 PS), the SoftDevice enable waits for it. */
+
+static int m_input_fd = STDIN_FILENO; /**< UART input. */
+static FILE* m_adv_out = NULL; /**< Advertising payload log. */
+static int m_verbosity = 1; /**< Maximum printed NRF_LOG level. */
+static uint64_t m_start_ns = 0; /**< Simulation start time, the reset of the beacon. */
+static uint64_t m_modelled_ns = 0; /**< Hardware waits modelled in the init stages, not spent on the host. */
+static uint64_t m_first_adv_ns = 0; /**< Time advertising was first started, 0 before. */
+static uint64_t m_first_uart_ns = 0; /**< Time the receiver was first enabled, 0 before. */
+static uint64_t m_first_fix_ns = 0; /**< Time a payload with a fix was first configured, 0 before. */
+static bool m_first_fix_restored = false; /**< The first fix was advertised before any UART input, restored from before the reset. */
+
+static nrf_libuarte_async_evt_handler_t m_uart_handler = NULL; /**< Registered libuarte event handler. */
+static void* m_uart_context = NULL; /**< Context passed to the handler. */
+static size_t m_rx_buf_size = 0; /**< Chunk size, as configured by NRF_LIBUARTE_ASYNC_DEFINE. */
+static nrf_libuarte_async_config_t m_uart_config; /**< Baud rate and flow control set by the firmware. */
+static bool m_uart_enabled = false; /**< Receiver enabled by the firmware. */
+static uint64_t m_uart_on_ns = 0; /**< Time the receiver was enabled. */
+static nrf_drv_gpiote_evt_handler_t m_rx_pin_handler = NULL; /**< RX pin edge handler armed while the UART is down. */
+static bool m_gpiote_init = false; /**< GPIOTE driver initialized. */
+static bool m_saadc_init = false; /**< SAADC driver initialized. */
+static bool m_saadc_channel = false; /**< SAADC channel 0 configured. */
+static uint8_t m_wake_buf[SIM_RX_BUF_MAX]; /**< Rest of the chunk that woke the UART, delivered once it is enabled. */
+static size_t m_wake_len = 0; /**< Number of bytes in m_wake_buf. */
+static uint64_t m_rx_ns = 0; /**< Time the last UART chunk was delivered. */
+static bool m_rx_pending = false; /**< UART chunk delivered since the last payload update. */
+static bool m_input_eof = false; /**< Input ended, timers have fired one last time. */
+static bool m_tx_pending = false; /**< A UART transmission waits for its TX_DONE event. */
+static bool m_tx_to_input = false; /**< The input is a tty, transmissions are written back to it. */
+
+static bool m_sim_clock = false; /**< The input is not a tty, time is simulated. */
+static uint64_t m_sim_clock_ns = 0; /**< Simulated time. */
+static uint8_t m_input_buf[SIM_INPUT_BUF_SIZE]; /**< Input read ahead, not delivered yet. */
+static size_t m_input_len = 0; /**< Number of bytes in m_input_buf. */
+static bool m_input_end = false; /**< Nothing more to read into m_input_buf. */
+static size_t m_chunk_len = 0; /**< Length of the next RX chunk at the head of m_input_buf, 0 if not cut yet. */
+static uint64_t m_chunk_ns = 0; /**< Time the last byte of the next chunk is received. */
+static uint64_t m_line_free_ns = 0; /**< Time the UART line is free for the next byte. */
+static int64_t m_burst_log_ms = -1; /**< NMEA time of the current burst, ms of the day, -1 before the first. */
+static uint64_t m_burst_ns = 0; /**< Time the current burst started. */
+
+static sim_timer_t* m_timers[SIM_TIMERS_MAX]; /**< Created application timers. */
+static size_t m_timer_count = 0; /**< Number of entries in m_timers. */
+
+static DWT_Type m_dwt; /**< Cycle counter, updated on every read. */
+CoreDebug_Type sim_core_debug;
+uint32_t SystemCoreClock = 64000000;
+
+static uint8_t m_adv_handle = BLE_GAP_ADV_SET_HANDLE_NOT_SET; /**< Handle of the only advertising set. */
+static bool m_advertising = false; /**< Advertising is running. */
+static uint8_t const* m_p_adv_buf = NULL; /**< Buffer currently owned by the "SoftDevice". */
+static uint8_t m_dev_name[BLE_GAP_DEVNAME_MAX_LEN]; /**< Device name set by the firmware. */
+static uint16_t m_dev_name_len = 0; /**< Length of the device name. */
+static bool m_extended = false; /**< Advertising set uses an extended advertising PDU. */
+static bool m_scannable = false; /**< Advertising set answers scan requests. */
+static uint8_t const* m_p_scan_rsp_buf = NULL; /**< Scan response buffer currently owned by the "SoftDevice". */
+static uint64_t m_adv_interval_ns = 0; /**< Advertising interval of the set. */
+static ble_gap_adv_params_t m_adv_params; /**< Parameters of the set as configured. */
+static uint16_t m_adv_len = 0; /**< Advertising and scan response data length as configured. */
+static ble_gap_adv_params_t m_started_params; /**< Parameters when advertising last started. */
+static uint16_t m_started_len = 0; /**< Data length when advertising last started. */
+static bool m_adv_stopped = false; /**< Stopped by the firmware, the next start is a restart. */
+static uint64_t m_radio_next_ns = 0; /**< Time of the next advertising event. */
+static ble_radio_notification_evt_handler_t m_radio_handler = NULL; /**< Registered radio notification handler. */
+static unsigned m_event_updates = 0; /**< Payload updates since the last advertising event. */
+
+static beacon_fix_t m_prev_fixes[SIM_FIX_MAX]; /**< Fixes decoded from the previous payload, newest first. */
+static size_t m_prev_count = 0; /**< Number of entries in m_prev_fixes. */
+static beacon_info_t m_prev_info; /**< Newest fix fields of the previous payload. */
+static uint8_t m_air_asset = BEACON_ASSET_NONE; /**< Asset in the payload the next advertising event sends. */
+static uint64_t m_asset_event[BEACON_ASSET_NONE]; /**< Per asset, number of the last advertising event sending it, 0 if none. */
+
+/*
+ *@brief Struct that contains a queued flash operation.
+ */
+typedef struct {
+    nrf_fstorage_t const* p_fs;
+    nrf_fstorage_evt_t evt;
+} sim_flash_op_t;
+
+static uint8_t m_flash[SIM_FLASH_SIZE]; /**< Flash image. */
+static const char* m_p_flash_file = NULL; /**< Flash image file, saved at the end. */
+static sim_flash_op_t m_flash_ops[SIM_FLASH_OPS_MAX]; /**< Operations waiting for the "SoftDevice". */
+static size_t m_flash_op_count = 0; /**< Number of entries in m_flash_ops. */
+nrf_fstorage_api_t nrf_fstorage_sd = { .erase_unit = SIM_FLASH_PAGE_SIZE };
+
+/*
+ *@brief Counters printed at the end of the simulation.
+ */
+static struct {
+    uint64_t rx_bytes;
+    uint64_t rx_chunks;
+    uint64_t adv_configure;
+    uint64_t adv_update;
+    uint64_t adv_start;
+    uint64_t adv_stop;
+    uint64_t adv_needless_restarts;
+    uint64_t radio_events;
+    uint64_t radio_multi_updates;
+    uint64_t uart_on_ns;
+    uint64_t uart_power_ups;
+    uint64_t uart_edge_wakes;
+    uint64_t uart_lost_bytes;
+    uint64_t tx_bytes;
+    uint64_t tx_lines;
+    uint64_t latency_count;
+    uint64_t latency_sum_ns;
+    uint64_t latency_min_ns;
+    uint64_t latency_max_ns;
+    uint64_t payload_checked;
+    uint64_t payload_predicted;
+    uint64_t payload_mismatch;
+    uint64_t fleet_assets;
+    uint64_t fleet_gap_max;
+    uint64_t flash_writes;
+    uint64_t flash_erases;
+    uint64_t flash_overwrites;
+} m_stats = { .latency_min_ns = UINT64_MAX };
+
+static uint64_t sim_wall_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t sim_now_ns(void)
+{
+    return m_sim_clock ? m_sim_clock_ns : sim_wall_ns() + m_modelled_ns;
+}
+
+/*
+ *@brief Function for advancing the clock by a hardware wait the host does not spend.
+ */
+static void sim_model_wait(uint64_t ns)
+{
+    m_modelled_ns += ns;
+    if (m_sim_clock) {
+        m_sim_clock_ns += ns;
+    }
+}
+
+/*
+ *@brief Function for printing the summary and leaving the simulation.
+ */
+static void sim_finish(int status)
+{
+    uint64_t now = sim_now_ns();
+
+    fflush(m_adv_out);
+
+    // The BAUDRATE register holds the rate in units of 16 MHz / 2^32.
+    fprintf(stderr, "UART: %.0f baud%s, %" PRIu64 " bytes in %" PRIu64 " chunks, %" PRIu64 " bytes in %" PRIu64 " sentences sent\n",
+        m_uart_config.baudrate * 16e6 / 4294967296.0, (NRF_UARTE_HWFC_ENABLED == m_uart_config.hwfc) ? " RTS/CTS" : "",
+        m_stats.rx_bytes, m_stats.rx_chunks, m_stats.tx_bytes, m_stats.tx_lines);
+    fprintf(stderr, "Advertising: %" PRIu64 " configure, %" PRIu64 " data updates, %" PRIu64 " start, %" PRIu64 " stop, "
+                    "%" PRIu64 " restarts without an interval, PHY or format change\n",
+        m_stats.adv_configure, m_stats.adv_update, m_stats.adv_start, m_stats.adv_stop, m_stats.adv_needless_restarts);
+    if (m_uart_enabled) {
+        m_stats.uart_on_ns += now - m_uart_on_ns;
+    }
+    double on_share = (now > m_start_ns) ? (double)m_stats.uart_on_ns / (now - m_start_ns) : 1.0;
+    fprintf(stderr, "UART power: on %.2f s of %.2f s (%.1f%%), %" PRIu64 " power-ups, %" PRIu64 " by RX edge, %" PRIu64 " bytes lost; "
+                    "about %.0f uA average against %d uA always on\n",
+        m_stats.uart_on_ns / 1e9, (now - m_start_ns) / 1e9, on_share * 100, m_stats.uart_power_ups,
+        m_stats.uart_edge_wakes, m_stats.uart_lost_bytes, on_share * SIM_UART_ON_UA, SIM_UART_ON_UA);
+    fprintf(stderr, "Radio: %" PRIu64 " advertising events, %" PRIu64 " with more than one payload update before them\n",
+        m_stats.radio_events, m_stats.radio_multi_updates);
+    if (m_stats.latency_count > 0) {
+        fprintf(stderr, "UART chunk to payload update, us: min %.1f mean %.1f max %.1f (%" PRIu64 " updates)\n",
+            m_stats.latency_min_ns / 1000.0,
+            m_stats.latency_sum_ns / 1000.0 / m_stats.latency_count,
+            m_stats.latency_max_ns / 1000.0,
+            m_stats.latency_count);
+    }
+    fprintf(stderr, "Payload: %" PRIu64 " decoded, %" PRIu64 " predicted between fixes, %" PRIu64 " history mismatches\n",
+        m_stats.payload_checked, m_stats.payload_predicted, m_stats.payload_mismatch);
+    if (m_stats.fleet_assets > 0) {
+        fprintf(stderr, "Fleet: %" PRIu64 " assets, at most %" PRIu64 " advertising events between adverts of one asset\n",
+            m_stats.fleet_assets, m_stats.fleet_gap_max);
+    }
+
+    if (0 != m_first_adv_ns) {
+        fprintf(stderr, "Boot: first advert %.3f ms after reset, UART receiving ", (m_first_adv_ns - m_start_ns) / 1e6);
+        if (0 != m_first_uart_ns) {
+            fprintf(stderr, "after %.3f ms", (m_first_uart_ns - m_start_ns) / 1e6);
+        } else {
+            fputs("never", stderr);
+        }
+        if (0 != m_first_fix_ns) {
+            fprintf(stderr, ", first fix advertised after %.3f ms (%s)", (m_first_fix_ns - m_start_ns) / 1e6,
+                m_first_fix_restored ? "restored" : "from the UART");
+        }
+        fputc('\n', stderr);
+    }
+
+    fprintf(stderr, "Flash: %" PRIu64 " writes, %" PRIu64 " page erases, %" PRIu64 " writes to words not erased\n",
+        m_stats.flash_writes, m_stats.flash_erases, m_stats.flash_overwrites);
+
+    if (NULL != m_p_flash_file) {
+        FILE* p_file = fopen(m_p_flash_file, "wb");
+        if (NULL == p_file || fwrite(m_flash, 1, sizeof(m_flash), p_file) != sizeof(m_flash)) {
+            perror(m_p_flash_file);
+            status = EXIT_FAILURE;
+        }
+        if (NULL != p_file) {
+            fclose(p_file);
+        }
+    }
+
+    if (m_stats.payload_mismatch > 0 || m_stats.flash_overwrites > 0 || m_stats.adv_needless_restarts > 0) {
+        status = EXIT_FAILURE;
+    }
+    exit(status);
+}
+
+void sim_log(int level, const char* p_fmt, ...)
+{
+    if (level > m_verbosity) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, p_fmt);
+    vfprintf(stderr, p_fmt, args);
+    va_end(args);
+}
+
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t* p_file_name)
+{
+    fprintf(stderr, "Fatal error 0x%08" PRIX32 " at %s:%" PRIu32 "\n", error_code, (const char*)p_file_name, line_num);
+    sim_finish(EXIT_FAILURE);
+}
+
+DWT_Type* sim_dwt(void)
+{
+    // Cycles are spent on the host, also on the simulated clock, and in the modelled waits.
+    m_dwt.CYCCNT = (uint32_t)((sim_wall_ns() + m_modelled_ns) * (SystemCoreClock / 1000000u) / 1000u);
+    return &m_dwt;
+}
+
+ret_code_t app_timer_init(void)
+{
+    return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_create(app_timer_id_t const* p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler)
+{
+    if (m_timer_count == SIM_TIMERS_MAX) {
+        return NRF_ERROR_NO_MEM;
+    }
+    sim_timer_t* p_timer = *p_timer_id;
+    memset(p_timer, 0, sizeof(*p_timer));
+    p_timer->handler = timeout_handler;
+    p_timer->mode = mode;
+    m_timers[m_timer_count++] = p_timer;
+    return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void* p_context)
+{
+    timer_id->p_context = p_context;
+    timer_id->interval_ns = (uint64_t)timeout_ticks * 1000000u;
+    timer_id->expire_ns = sim_now_ns() + timer_id->interval_ns;
+    timer_id->running = true;
+    return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_stop(app_timer_id_t timer_id)
+{
+    timer_id->running = false;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_get(void)
+{
+    return (uint32_t)((sim_now_ns() - m_start_ns) / 1000000u) & 0xFFFFFF; // 24-bit RTC
+}
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from)
+{
+    return (ticks_to - ticks_from) & 0xFFFFFF;
+}
+
+/*
+ *@brief Function for getting the time the next timer expires, UINT64_MAX if none is running.
+ */
+static uint64_t timers_next_ns(void)
+{
+    uint64_t next = UINT64_MAX;
+
+    for (size_t i = 0; i < m_timer_count; i++) {
+        sim_timer_t const* p_timer = m_timers[i];
+        if (p_timer->running && p_timer->expire_ns < next) {
+            next = p_timer->expire_ns;
+        }
+    }
+    return next;
+}
+
+/*
+ *@brief Function for calling the handlers of expired timers, or of all running timers.
+ */
+static void timers_fire(bool all)
+{
+    uint64_t now = sim_now_ns();
+
+    for (size_t i = 0; i < m_timer_count; i++) {
+        sim_timer_t* p_timer = m_timers[i];
+        if (!p_timer->running || (!all && now < p_timer->expire_ns)) {
+            continue;
+        }
+        if (APP_TIMER_MODE_REPEATED == p_timer->mode) {
+            p_timer->expire_ns = now + p_timer->interval_ns;
+        } else {
+            p_timer->running = false;
+        }
+        p_timer->handler(p_timer->p_context);
+    }
+}
+
+uint32_t ble_radio_notification_init(uint32_t irq_priority, uint8_t distance, ble_radio_notification_evt_handler_t evt_handler)
+{
+    UNUSED_PARAMETER(irq_priority);
+    UNUSED_PARAMETER(distance);
+    m_radio_handler = evt_handler;
+    return NRF_SUCCESS;
+}
+
+/*
+ *@brief Function for getting the time of the next advertising event, UINT64_MAX if not advertising.
+ */
+static uint64_t radio_next_ns(void)
+{
+    return m_advertising ? m_radio_next_ns : UINT64_MAX;
+}
+
+/*
+ *@brief Function for running the advertising event if it is due, or right away.
+ *
+ * @details The radio notification handler sees the start and the end of the event. The
+ *          payload updates handed over since the previous event are counted, the
+ *          SoftDevice would send only the last of them.
+ */
+static void radio_event(bool now)
+{
+    uint64_t time = sim_now_ns();
+
+    if (!m_advertising || (!now && time < m_radio_next_ns)) {
+        return;
+    }
+    m_radio_next_ns = time + m_adv_interval_ns;
+    m_stats.radio_events++;
+    if (m_event_updates > 1) {
+        m_stats.radio_multi_updates++;
+    }
+    m_event_updates = 0;
+
+    if (BEACON_ASSET_NONE != m_air_asset) {
+        uint64_t* p_last = &m_asset_event[m_air_asset];
+        if (0 == *p_last) {
+            m_stats.fleet_assets++;
+        } else if (m_stats.radio_events - *p_last > m_stats.fleet_gap_max) {
+            m_stats.fleet_gap_max = m_stats.radio_events - *p_last;
+        }
+        *p_last = m_stats.radio_events;
+    }
+
+    if (NULL != m_radio_handler) {
+        m_radio_handler(true);
+        m_radio_handler(false);
+    }
+}
+
+/*
+ *@brief Function for checking that an fstorage operation stays within the instance.
+ */
+static ret_code_t flash_range_check(nrf_fstorage_t const* p_fs, uint32_t addr, uint32_t len)
+{
+    if (NULL == p_fs->p_api) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (addr < p_fs->start_addr || addr + len > p_fs->end_addr || p_fs->end_addr > SIM_FLASH_SIZE) {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    return NRF_SUCCESS;
+}
+
+/*
+ *@brief Function for queueing an fstorage operation, as the SoftDevice backend does.
+ */
+static ret_code_t flash_op_queue(nrf_fstorage_t const* p_fs, nrf_fstorage_evt_id_t id, uint32_t addr, void const* p_src, uint32_t len, void* p_param)
+{
+    if (SIM_FLASH_OPS_MAX == m_flash_op_count) {
+        return NRF_ERROR_NO_MEM;
+    }
+    sim_flash_op_t* p_op = &m_flash_ops[m_flash_op_count++];
+    p_op->p_fs = p_fs;
+    p_op->evt = (nrf_fstorage_evt_t){ .id = id, .result = NRF_SUCCESS, .addr = addr, .p_src = p_src, .len = len, .p_param = p_param };
+    return NRF_SUCCESS;
+}
+
+/*
+ *@brief Function for executing the queued flash operations and reporting their results.
+ *
+ * @details Like on the nRF52, a write can only clear bits, and each word is written
+ *          at most once between erases; writing a word that is not erased is counted.
+ */
+static void flash_ops_run(void)
+{
+    while (m_flash_op_count > 0) {
+        sim_flash_op_t op = m_flash_ops[0];
+        m_flash_op_count--;
+        memmove(&m_flash_ops[0], &m_flash_ops[1], m_flash_op_count * sizeof(m_flash_ops[0]));
+
+        if (NRF_FSTORAGE_EVT_ERASE_RESULT == op.evt.id) {
+            memset(&m_flash[op.evt.addr], 0xFF, op.evt.len * SIM_FLASH_PAGE_SIZE);
+            m_stats.flash_erases += op.evt.len;
+        } else {
+            uint8_t const* p_src = op.evt.p_src;
+            for (uint32_t i = 0; i < op.evt.len; i++) {
+                if (0 == i % sizeof(uint32_t) && UINT32_MAX != *(uint32_t const*)&m_flash[op.evt.addr + i]) {
+                    m_stats.flash_overwrites++;
+                }
+                m_flash[op.evt.addr + i] &= p_src[i];
+            }
+            m_stats.flash_writes++;
+        }
+        op.p_fs->evt_handler(&op.evt);
+    }
+}
+
+ret_code_t nrf_fstorage_init(nrf_fstorage_t* p_fs, nrf_fstorage_api_t* p_api, void* p_param)
+{
+    UNUSED_PARAMETER(p_param);
+    p_fs->p_api = p_api;
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_fstorage_read(nrf_fstorage_t const* p_fs, uint32_t src, void* p_dest, uint32_t len)
+{
+    ret_code_t err_code = flash_range_check(p_fs, src, len);
+    if (NRF_SUCCESS == err_code) {
+        memcpy(p_dest, &m_flash[src], len);
+    }
+    return err_code;
+}
+
+ret_code_t nrf_fstorage_write(nrf_fstorage_t const* p_fs, uint32_t dest, void const* p_src, uint32_t len, void* p_param)
+{
+    ret_code_t err_code = flash_range_check(p_fs, dest, len);
+    if (NRF_SUCCESS != err_code) {
+        return err_code;
+    }
+    if (0 != dest % sizeof(uint32_t) || 0 != (uintptr_t)p_src % sizeof(uint32_t)) {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (0 == len || 0 != len % sizeof(uint32_t)) {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    return flash_op_queue(p_fs, NRF_FSTORAGE_EVT_WRITE_RESULT, dest, p_src, len, p_param);
+}
+
+ret_code_t nrf_fstorage_erase(nrf_fstorage_t const* p_fs, uint32_t page_addr, uint32_t len, void* p_param)
+{
+    ret_code_t err_code = flash_range_check(p_fs, page_addr, len * SIM_FLASH_PAGE_SIZE);
+    if (NRF_SUCCESS != err_code) {
+        return err_code;
+    }
+    if (0 != page_addr % SIM_FLASH_PAGE_SIZE) {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (0 == len) {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    return flash_op_queue(p_fs, NRF_FSTORAGE_EVT_ERASE_RESULT, page_addr, NULL, len, p_param);
+}
+
+ret_code_t nrf_pwr_mgmt_init(void)
+{
+    return NRF_SUCCESS;
+}
+
+/*
+ *@brief Function for handing a received chunk to libuarte, or to the RX pin handler while the UART is down.
+ */
+static void uart_rx_deliver(uint8_t* p_data, size_t len)
+{
+    m_stats.rx_bytes += (uint64_t)len;
+    m_stats.rx_chunks++;
+
+    if (!m_uart_enabled) {
+        // The start bit wakes the firmware, the UART receives again a few characters later.
+        size_t lost = MIN(len, (NULL != m_rx_pin_handler) ? SIM_UART_WAKE_LOST_BYTES : len);
+        m_stats.uart_lost_bytes += lost;
+        m_wake_len = len - lost;
+        memcpy(m_wake_buf, &p_data[lost], m_wake_len);
+        if (NULL != m_rx_pin_handler) {
+            m_stats.uart_edge_wakes++;
+            m_rx_pin_handler(RX_PIN_NUMBER, NRF_GPIOTE_POLARITY_HITOLO);
+        }
+        return;
+    }
+    m_rx_ns = sim_now_ns();
+    m_rx_pending = true;
+
+    nrf_libuarte_async_evt_t evt = {
+        .type = NRF_LIBUARTE_ASYNC_EVT_RX_DATA,
+        .data.rxtx = { .p_data = p_data, .length = len }
+    };
+    m_uart_handler(m_uart_context, &evt);
+}
+
+/*
+ *@brief Function for getting the UTC time of day of an RMC, GGA or ZDA sentence, ms.
+ */
+static bool input_line_time(uint8_t const* p_data, size_t len, int64_t* p_time_ms)
+{
+    char line[MINMEA_MAX_LENGTH + 4];
+    struct minmea_time time = { -1, -1, -1, -1 };
+
+    if (len >= sizeof(line)) {
+        return false;
+    }
+    memcpy(line, p_data, len);
+    line[len] = '\0';
+
+    switch (minmea_sentence_id(line, false)) {
+    case MINMEA_SENTENCE_RMC: {
+        struct minmea_sentence_rmc frame;
+        if (minmea_parse_rmc(&frame, line)) {
+            time = frame.time;
+        }
+        break;
+    }
+    case MINMEA_SENTENCE_GGA: {
+        struct minmea_sentence_gga frame;
+        if (minmea_parse_gga(&frame, line)) {
+            time = frame.time;
+        }
+        break;
+    }
+    case MINMEA_SENTENCE_ZDA: {
+        struct minmea_sentence_zda frame;
+        if (minmea_parse_zda(&frame, line)) {
+            time = frame.time;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    if (time.hours < 0) {
+        return false;
+    }
+    *p_time_ms = ((int64_t)(time.hours * 60 + time.minutes) * 60 + time.seconds) * 1000 + time.microseconds / 1000;
+    return true;
+}
+
+/*
+ *@brief Function for cutting the next RX chunk from the input on the simulated clock.
+ *
+ * @details A chunk ends when the RX buffer is full, or before the first sentence of the next
+ *          burst, where the idle line would end it. A burst is the sentences sharing one
+ *          NMEA time; it starts when the line is free, but not earlier than its log time after
+ *          the start of the previous burst. Every byte takes its character time at the baud
+ *          rate the firmware configured.
+ *
+ * @return false at the end of the input.
+ */
+static bool input_chunk_cut(void)
+{
+    if (0 != m_chunk_len) {
+        return true;
+    }
+
+    while (!m_input_end && m_input_len < sizeof(m_input_buf)) {
+        ssize_t len = read(m_input_fd, &m_input_buf[m_input_len], sizeof(m_input_buf) - m_input_len);
+        if (len < 0 && EINTR == errno) {
+            continue;
+        }
+        if (len <= 0) {
+            m_input_end = true;
+            break;
+        }
+        m_input_len += (size_t)len;
+    }
+    if (0 == m_input_len) {
+        return false;
+    }
+
+    uint64_t start_ns = m_line_free_ns;
+    size_t len = 0;
+    while (len < m_input_len && len < m_rx_buf_size) {
+        uint8_t const* p_end = memchr(&m_input_buf[len], '\n', m_input_len - len);
+        size_t line_len = (NULL != p_end) ? (size_t)(p_end - &m_input_buf[len]) + 1 : m_input_len - len;
+        int64_t time_ms;
+
+        if (input_line_time(&m_input_buf[len], line_len, &time_ms) && time_ms != m_burst_log_ms) {
+            if (0 != len) {
+                break;
+            }
+            if (m_burst_log_ms >= 0) {
+                // A step back in time, e.g. another log, starts right away.
+                int64_t gap_ms = (time_ms - m_burst_log_ms + SIM_DAY_MS) % SIM_DAY_MS;
+                if (gap_ms < SIM_DAY_MS / 2) {
+                    start_ns = MAX(start_ns, m_burst_ns + (uint64_t)gap_ms * 1000000u);
+                }
+            }
+            m_burst_log_ms = time_ms;
+            m_burst_ns = start_ns;
+        }
+        len += line_len;
+    }
+    m_chunk_len = MIN(len, m_rx_buf_size);
+
+    // The BAUDRATE register holds the rate in units of 16 MHz / 2^32.
+    double char_ns = SIM_UART_FRAME_BITS * 1e9 * 4294967296.0 / (m_uart_config.baudrate * 16e6);
+    m_chunk_ns = start_ns + (uint64_t)(m_chunk_len * char_ns);
+    m_line_free_ns = m_chunk_ns;
+    return true;
+}
+
+/*
+ *@brief Simulated sleep: blocks until the next UART chunk, timer expiry or advertising event.
+ *
+ * @details Queued flash operations complete first, their events wake the main loop.
+ *          A UART transmission completes next, so queued answers go out also after the end of
+ *          the input. Expired timers and a due advertising event fire after the wake-up. At the
+ *          end of the input every running timer fires once more and one more advertising event
+ *          runs, so periodic reports and the last fix are flushed before the summary.
+ *          On the simulated clock the time jumps to the earliest of these instead of waiting.
+ */
+void nrf_pwr_mgmt_run(void)
+{
+    static uint8_t rx_buf[SIM_RX_BUF_MAX];
+
+    if (m_flash_op_count > 0) {
+        flash_ops_run();
+        return;
+    }
+
+    if (m_tx_pending) {
+        nrf_libuarte_async_evt_t evt = { .type = NRF_LIBUARTE_ASYNC_EVT_TX_DONE };
+        m_tx_pending = false;
+        m_uart_handler(m_uart_context, &evt);
+        return;
+    }
+
+    if ((!m_uart_enabled && NULL == m_rx_pin_handler) || m_input_eof) {
+        sim_finish(EXIT_SUCCESS);
+    }
+
+    if (m_uart_enabled && m_wake_len > 0) {
+        nrf_libuarte_async_evt_t evt = {
+            .type = NRF_LIBUARTE_ASYNC_EVT_RX_DATA,
+            .data.rxtx = { .p_data = m_wake_buf, .length = m_wake_len }
+        };
+        m_wake_len = 0;
+        m_uart_handler(m_uart_context, &evt);
+        return;
+    }
+
+    uint64_t wake_ns = MIN(timers_next_ns(), radio_next_ns());
+
+    if (m_sim_clock) {
+        if (!input_chunk_cut()) {
+            m_input_eof = true;
+            timers_fire(true);
+            radio_event(true);
+            return;
+        }
+        m_sim_clock_ns = MAX(m_sim_clock_ns, MIN(wake_ns, m_chunk_ns));
+        timers_fire(false);
+        radio_event(false);
+        if (m_chunk_ns > m_sim_clock_ns) {
+            return;
+        }
+
+        size_t len = m_chunk_len;
+        memcpy(rx_buf, m_input_buf, len);
+        m_input_len -= len;
+        memmove(m_input_buf, &m_input_buf[len], m_input_len);
+        m_chunk_len = 0;
+        uart_rx_deliver(rx_buf, len);
+        return;
+    }
+
+    uint64_t now = sim_now_ns();
+    int timeout = -1;
+    if (UINT64_MAX != wake_ns) {
+        timeout = (wake_ns <= now) ? 0 : (int)((wake_ns - now + 999999u) / 1000000u);
+    }
+
+    struct pollfd pfd = { .fd = m_input_fd, .events = POLLIN };
+    int ready = poll(&pfd, 1, timeout);
+    if (ready < 0 && EINTR == errno) {
+        return;
+    }
+    if (0 == ready) {
+        timers_fire(false);
+        radio_event(false);
+        return;
+    }
+
+    ssize_t len = read(m_input_fd, rx_buf, m_rx_buf_size);
+    if (len < 0 && EINTR == errno) {
+        return;
+    }
+    if (len <= 0) {
+        // End of file, or the other side of the pty was closed.
+        m_input_eof = true;
+        timers_fire(true);
+        radio_event(true);
+        return;
+    }
+    timers_fire(false);
+    radio_event(false);
+    uart_rx_deliver(rx_buf, (size_t)len);
+}
+
+ret_code_t nrf_sdh_enable_request(void)
+{
+    // NRF_SDH_CLOCK_LF_SRC is the crystal.
+    sim_model_wait(SIM_LFXO_START_NS);
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_sdh_ble_default_cfg_set(uint8_t conn_cfg_tag, uint32_t* p_ram_start)
+{
+    UNUSED_PARAMETER(conn_cfg_tag);
+    *p_ram_start = 0;
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_sdh_ble_enable(uint32_t* p_app_ram_start)
+{
+    UNUSED_PARAMETER(p_app_ram_start);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_device_name_set(ble_gap_conn_sec_mode_t const* p_write_perm, uint8_t const* p_dev_name, uint16_t len)
+{
+    UNUSED_PARAMETER(p_write_perm);
+    if (len > sizeof(m_dev_name)) {
+        return NRF_ERROR_DATA_SIZE;
+    }
+    memcpy(m_dev_name, p_dev_name, len);
+    m_dev_name_len = len;
+    return NRF_SUCCESS;
+}
+
+/*
+ *@brief Function for checking a payload against the previous one.
+ *
+ * @details The payload is decoded as a receiver would. Fixes carried over from the previous
+ *          payload, shifted by the sequence number difference, must decode to the same positions.
+ *          A prediction carries the fix of its sequence number as the first history entry, so
+ *          its fixes are checked one entry further down; an unflagged payload repeating the
+ *          sequence number must carry the same fix.
+ *          Asset payloads of a fleet gateway carry no history, only the asset is noted for
+ *          the staleness statistics.
+ */
+static void payload_check(uint8_t const* p_data, uint16_t len)
+{
+    beacon_fix_t fixes[SIM_FIX_MAX];
+    beacon_info_t info;
+    uint16_t offset = 0;
+
+    while (offset + 1 < len && BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA != p_data[offset + 1]) {
+        offset += p_data[offset] + 1;
+    }
+    if (offset + 1 >= len || p_data[offset] < 3) {
+        fprintf(stderr, "Payload: no manufacturer specific data\n");
+        m_stats.payload_mismatch++;
+        return;
+    }
+
+    size_t count = beacon_payload_decode(&p_data[offset + 4], p_data[offset] - 3, &info, fixes, SIM_FIX_MAX);
+    if (0 == count) {
+        fprintf(stderr, "Payload: not decoded\n");
+        m_stats.payload_mismatch++;
+        return;
+    }
+    m_stats.payload_checked++;
+
+    if (0 == info.seq) {
+        return; // No fix yet.
+    }
+    if (0 == m_first_fix_ns) {
+        m_first_fix_ns = sim_now_ns();
+        m_first_fix_restored = (0 == m_stats.rx_chunks);
+    }
+    if (BEACON_ASSET_NONE != info.asset) {
+        m_air_asset = info.asset;
+        return;
+    }
+
+    uint8_t shift = (0 == m_prev_info.seq) ? UINT8_MAX : beacon_seq_distance(m_prev_info.seq, info.seq);
+    size_t first = info.predicted ? 1 : 0;
+    for (size_t i = shift; i + first < count && i - shift < m_prev_count; i++) {
+        beacon_fix_t const* p_new = &fixes[i + first];
+        beacon_fix_t const* p_old = &m_prev_fixes[i - shift];
+        if (abs(p_new->latitude - p_old->latitude) > SIM_FIX_TOLERANCE
+            || abs(p_new->longitude - p_old->longitude) > SIM_FIX_TOLERANCE) {
+            fprintf(stderr, "Payload: seq %u%s fix %zu (%d,%d) differs from seq %u fix %zu (%d,%d)\n",
+                info.seq, info.predicted ? " predicted" : "", i + first, p_new->latitude, p_new->longitude,
+                m_prev_info.seq, i - shift, p_old->latitude, p_old->longitude);
+            m_stats.payload_mismatch++;
+            break;
+        }
+    }
+
+    if (info.predicted) {
+        m_stats.payload_predicted++;
+        return;
+    }
+    memcpy(m_prev_fixes, fixes, count * sizeof(fixes[0]));
+    m_prev_count = count;
+    m_prev_info = info;
+}
+
+/*
+ *@brief Function for checking a scan response: its detail payload must describe the fix of the
+ *       advertising data it goes out with.
+ */
+static void detail_check(uint8_t const* p_data, uint16_t len)
+{
+    beacon_detail_t detail;
+
+    if (len < 2 || p_data[0] < 3 || p_data[0] + 1 > len || BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA != p_data[1]
+        || !beacon_detail_decode(&p_data[4], p_data[0] - 3, &detail)) {
+        fprintf(stderr, "Scan response: detail not decoded\n");
+        m_stats.payload_mismatch++;
+        return;
+    }
+    if (detail.seq != m_prev_info.seq && 0 != m_prev_info.seq) {
+        fprintf(stderr, "Scan response: seq %u, advertising data seq %u\n", detail.seq, m_prev_info.seq);
+        m_stats.payload_mismatch++;
+    }
+}
+
+/*
+ *@brief Same rules as the SoftDevice: while advertising, parameters must be NULL and
+ *       data must come in a buffer different from the one in use.
+ */
+uint32_t sd_ble_gap_adv_set_configure(uint8_t* p_adv_handle, ble_gap_adv_data_t const* p_adv_data, ble_gap_adv_params_t const* p_adv_params)
+{
+    uint64_t now = sim_now_ns();
+
+    if (BLE_GAP_ADV_SET_HANDLE_NOT_SET == *p_adv_handle) {
+        if (NULL == p_adv_params) {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        *p_adv_handle = m_adv_handle = 0;
+    } else if (*p_adv_handle != m_adv_handle) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    if (m_advertising && NULL != p_adv_params) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (m_advertising && NULL != p_adv_data && p_adv_data->adv_data.p_data == m_p_adv_buf) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (m_advertising && NULL != p_adv_data && NULL != p_adv_data->scan_rsp_data.p_data
+        && p_adv_data->scan_rsp_data.p_data == m_p_scan_rsp_buf) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (NULL != p_adv_params) {
+        bool extended = p_adv_params->properties.type >= BLE_GAP_ADV_TYPE_EXTENDED_CONNECTABLE_NONSCANNABLE_UNDIRECTED;
+        if (!extended && (BLE_GAP_PHY_CODED == p_adv_params->primary_phy || BLE_GAP_PHY_CODED == p_adv_params->secondary_phy)) {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        m_extended = extended;
+        m_scannable = BLE_GAP_ADV_TYPE_CONNECTABLE_SCANNABLE_UNDIRECTED == p_adv_params->properties.type
+            || BLE_GAP_ADV_TYPE_NONCONNECTABLE_SCANNABLE_UNDIRECTED == p_adv_params->properties.type;
+        m_adv_interval_ns = (uint64_t)p_adv_params->interval * 625000u;
+        m_adv_params = *p_adv_params;
+        m_stats.adv_configure++;
+        fprintf(m_adv_out, "%.6f interval %.1f %s %s\n", (now - m_start_ns) / 1e9, p_adv_params->interval * 0.625,
+            m_extended ? "extended" : "legacy",
+            (BLE_GAP_PHY_CODED == p_adv_params->primary_phy) ? "coded" : (BLE_GAP_PHY_2MBPS == p_adv_params->secondary_phy) ? "2M" : "1M");
+    }
+    if (NULL == p_adv_data) {
+        return NRF_SUCCESS;
+    }
+    if (p_adv_data->adv_data.len > (m_extended ? BLE_GAP_ADV_SET_DATA_SIZE_EXTENDED_MAX_SUPPORTED : BLE_GAP_ADV_SET_DATA_SIZE_MAX)) {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if (0 != p_adv_data->scan_rsp_data.len
+        && (!m_scannable || p_adv_data->scan_rsp_data.len > BLE_GAP_ADV_SET_DATA_SIZE_MAX)) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (m_advertising) {
+        m_stats.adv_update++;
+        m_event_updates++;
+    }
+
+    m_p_adv_buf = p_adv_data->adv_data.p_data;
+    m_p_scan_rsp_buf = p_adv_data->scan_rsp_data.p_data;
+    m_adv_len = p_adv_data->adv_data.len + p_adv_data->scan_rsp_data.len;
+
+    uint64_t latency = 0;
+    if (m_rx_pending) {
+        latency = now - m_rx_ns;
+        m_rx_pending = false;
+
+        m_stats.latency_count++;
+        m_stats.latency_sum_ns += latency;
+        if (latency < m_stats.latency_min_ns) {
+            m_stats.latency_min_ns = latency;
+        }
+        if (latency > m_stats.latency_max_ns) {
+            m_stats.latency_max_ns = latency;
+        }
+    }
+
+    fprintf(m_adv_out, "%.6f %s %.1f ", (now - m_start_ns) / 1e9,
+        (NULL != p_adv_params) ? "configure" : "update", latency / 1000.0);
+    for (uint16_t i = 0; i < p_adv_data->adv_data.len; i++) {
+        fprintf(m_adv_out, "%02X", p_adv_data->adv_data.p_data[i]);
+    }
+    if (0 != p_adv_data->scan_rsp_data.len) {
+        fputs(" rsp ", m_adv_out);
+        for (uint16_t i = 0; i < p_adv_data->scan_rsp_data.len; i++) {
+            fprintf(m_adv_out, "%02X", p_adv_data->scan_rsp_data.p_data[i]);
+        }
+    }
+    fputc('\n', m_adv_out);
+
+    payload_check(p_adv_data->adv_data.p_data, p_adv_data->adv_data.len);
+    if (0 != p_adv_data->scan_rsp_data.len) {
+        detail_check(p_adv_data->scan_rsp_data.p_data, p_adv_data->scan_rsp_data.len);
+    }
+
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_adv_start(uint8_t adv_handle, uint8_t conn_cfg_tag)
+{
+    UNUSED_PARAMETER(conn_cfg_tag);
+    if (adv_handle != m_adv_handle || m_advertising) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    // A restart is only due to a new interval, PHY or advertising type, or a payload of another
+    // length (format change); position updates must go through the double buffer.
+    if (m_adv_stopped && m_adv_params.interval == m_started_params.interval
+        && m_adv_params.properties.type == m_started_params.properties.type
+        && m_adv_params.primary_phy == m_started_params.primary_phy
+        && m_adv_params.secondary_phy == m_started_params.secondary_phy
+        && m_adv_len == m_started_len) {
+        fprintf(stderr, "Advertising: restarted without an interval, PHY or format change\n");
+        m_stats.adv_needless_restarts++;
+    }
+    m_adv_stopped = false;
+    m_started_params = m_adv_params;
+    m_started_len = m_adv_len;
+
+    m_advertising = true;
+    m_radio_next_ns = sim_now_ns(); // The first event follows the start.
+    if (0 == m_first_adv_ns) {
+        m_first_adv_ns = m_radio_next_ns;
+    }
+    m_stats.adv_start++;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_adv_stop(uint8_t adv_handle)
+{
+    if (adv_handle != m_adv_handle || !m_advertising) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    m_advertising = false;
+    m_adv_stopped = true;
+    m_stats.adv_stop++;
+    return NRF_SUCCESS;
+}
+
+/*
+ *@brief Accepts the TX power steps of the nRF52832 radio.
+ */
+uint32_t sd_ble_gap_tx_power_set(uint8_t role, uint16_t handle, int8_t tx_power)
+{
+    static const int8_t steps[] = { -40, -20, -16, -12, -8, -4, 0, 3, 4 };
+
+    if (BLE_GAP_TX_POWER_ROLE_ADV != role || handle != m_adv_handle) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    for (size_t i = 0; i < ARRAY_SIZE(steps); i++) {
+        if (steps[i] == tx_power) {
+            fprintf(m_adv_out, "%.6f txpower %d\n", (sim_now_ns() - m_start_ns) / 1e9, tx_power);
+            return NRF_SUCCESS;
+        }
+    }
+    return NRF_ERROR_INVALID_PARAM;
+}
+
+/*
+ *@brief Encodes AD structures in the order used by the SDK: flags, manufacturer data, name.
+ */
+ret_code_t ble_advdata_encode(ble_advdata_t const* const p_advdata, uint8_t* const p_encoded_data, uint16_t* const p_len)
+{
+    uint16_t max_len = *p_len;
+    uint16_t offset = 0;
+
+    if (0 != p_advdata->flags) {
+        if (offset + 3 > max_len) {
+            return NRF_ERROR_DATA_SIZE;
+        }
+        p_encoded_data[offset++] = 2;
+        p_encoded_data[offset++] = BLE_GAP_AD_TYPE_FLAGS;
+        p_encoded_data[offset++] = p_advdata->flags;
+    }
+
+    if (NULL != p_advdata->p_manuf_specific_data) {
+        ble_advdata_manuf_data_t const* p_manuf = p_advdata->p_manuf_specific_data;
+        uint16_t field_len = 1 + sizeof(uint16_t) + p_manuf->data.size;
+        if (offset + 1 + field_len > max_len) {
+            return NRF_ERROR_DATA_SIZE;
+        }
+        p_encoded_data[offset++] = (uint8_t)field_len;
+        p_encoded_data[offset++] = BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA;
+        p_encoded_data[offset++] = (uint8_t)(p_manuf->company_identifier & 0xFF);
+        p_encoded_data[offset++] = (uint8_t)(p_manuf->company_identifier >> 8);
+        memcpy(&p_encoded_data[offset], p_manuf->data.p_data, p_manuf->data.size);
+        offset += p_manuf->data.size;
+    }
+
+    if (BLE_ADVDATA_NO_NAME != p_advdata->name_type) {
+        uint16_t name_len = m_dev_name_len;
+        uint8_t type = BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME;
+        if (BLE_ADVDATA_SHORT_NAME == p_advdata->name_type && p_advdata->short_name_len < name_len) {
+            name_len = p_advdata->short_name_len;
+            type = BLE_GAP_AD_TYPE_SHORT_LOCAL_NAME;
+        }
+        if (offset + 2 + name_len > max_len) {
+            return NRF_ERROR_DATA_SIZE;
+        }
+        p_encoded_data[offset++] = (uint8_t)(1 + name_len);
+        p_encoded_data[offset++] = type;
+        memcpy(&p_encoded_data[offset], m_dev_name, name_len);
+        offset += name_len;
+    }
+
+    *p_len = offset;
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_libuarte_async_init(const nrf_libuarte_async_t* const p_libuarte,
+    nrf_libuarte_async_config_t const* p_config,
+    nrf_libuarte_async_evt_handler_t evt_handler,
+    void* context)
+{
+    if (p_libuarte->rx_buf_size > SIM_RX_BUF_MAX) {
+        return NRF_ERROR_NO_MEM;
+    }
+    m_uart_config = *p_config;
+    m_uart_handler = evt_handler;
+    m_uart_context = context;
+    m_rx_buf_size = p_libuarte->rx_buf_size;
+    return NRF_SUCCESS;
+}
+
+void nrf_libuarte_async_enable(const nrf_libuarte_async_t* const p_libuarte)
+{
+    UNUSED_PARAMETER(p_libuarte);
+    if (m_uart_enabled) {
+        return;
+    }
+    m_uart_enabled = true;
+    m_uart_on_ns = sim_now_ns();
+    if (0 == m_first_uart_ns) {
+        m_first_uart_ns = m_uart_on_ns;
+    }
+    m_stats.uart_power_ups++;
+    fprintf(m_adv_out, "%.6f uart on\n", (m_uart_on_ns - m_start_ns) / 1e9);
+}
+
+void nrf_libuarte_async_uninit(const nrf_libuarte_async_t* const p_libuarte)
+{
+    uint64_t now = sim_now_ns();
+
+    UNUSED_PARAMETER(p_libuarte);
+    if (!m_uart_enabled) {
+        return;
+    }
+    m_uart_enabled = false;
+    m_uart_handler = NULL;
+    m_stats.uart_on_ns += now - m_uart_on_ns;
+    fprintf(m_adv_out, "%.6f uart off\n", (now - m_start_ns) / 1e9);
+}
+
+ret_code_t nrf_drv_gpiote_init(void)
+{
+    m_gpiote_init = true;
+    return NRF_SUCCESS;
+}
+
+bool nrf_drv_gpiote_is_init(void)
+{
+    return m_gpiote_init;
+}
+
+ret_code_t nrf_drv_gpiote_in_init(nrf_drv_gpiote_pin_t pin, nrf_drv_gpiote_in_config_t const* p_config, nrf_drv_gpiote_evt_handler_t evt_handler)
+{
+    UNUSED_PARAMETER(p_config);
+    if (!m_gpiote_init || RX_PIN_NUMBER != pin || m_uart_enabled) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    m_rx_pin_handler = evt_handler;
+    return NRF_SUCCESS;
+}
+
+void nrf_drv_gpiote_in_event_enable(nrf_drv_gpiote_pin_t pin, bool int_enable)
+{
+    UNUSED_PARAMETER(pin);
+    UNUSED_PARAMETER(int_enable);
+}
+
+void nrf_drv_gpiote_in_uninit(nrf_drv_gpiote_pin_t pin)
+{
+    UNUSED_PARAMETER(pin);
+    m_rx_pin_handler = NULL;
+}
+
+ret_code_t nrfx_saadc_init(nrfx_saadc_config_t const* p_config, nrfx_saadc_event_handler_t event_handler)
+{
+    UNUSED_PARAMETER(p_config);
+    if (m_saadc_init || NULL == event_handler) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    m_saadc_init = true;
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrfx_saadc_channel_init(uint8_t channel, nrf_saadc_channel_config_t const* const p_config)
+{
+    if (!m_saadc_init || 0 != channel || NRF_SAADC_INPUT_VDD != p_config->pin_p) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    m_saadc_channel = true;
+    return NRF_SUCCESS;
+}
+
+/*
+ *@brief VDD reads SIM_VDD_MV through gain 1/6 and the 0.6 V reference, 10 bits.
+ */
+ret_code_t nrfx_saadc_sample_convert(uint8_t channel, nrf_saadc_value_t* p_value)
+{
+    if (!m_saadc_channel || 0 != channel) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    *p_value = (nrf_saadc_value_t)(SIM_VDD_MV * 1024 / 3600);
+    return NRF_SUCCESS;
+}
+
+void nrf_libuarte_async_rx_free(const nrf_libuarte_async_t* const p_libuarte, uint8_t* p_data, size_t length)
+{
+    UNUSED_PARAMETER(p_libuarte);
+    UNUSED_PARAMETER(p_data);
+    UNUSED_PARAMETER(length);
+}
+
+/*
+ *@brief Logs the sent sentence and writes it back to a tty input, TX_DONE follows in nrf_pwr_mgmt_run().
+ */
+ret_code_t nrf_libuarte_async_tx(const nrf_libuarte_async_t* const p_libuarte, uint8_t* p_data, size_t length)
+{
+    UNUSED_PARAMETER(p_libuarte);
+    if (!m_uart_enabled) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (m_tx_pending) {
+        return NRF_ERROR_BUSY;
+    }
+    m_tx_pending = true;
+    m_stats.tx_bytes += length;
+    m_stats.tx_lines++;
+
+    fprintf(m_adv_out, "%.6f tx %.*s", (sim_now_ns() - m_start_ns) / 1e9, (int)length, (const char*)p_data);
+    if ('\n' != p_data[length - 1]) {
+        fputc('\n', m_adv_out);
+    }
+    if (m_tx_to_input && write(m_input_fd, p_data, length) < 0) {
+        perror("UART TX");
+    }
+    return NRF_SUCCESS;
+}
+
+static void usage(const char* p_name)
+{
+    fprintf(stderr,
+        "Usage: %s [-i INPUT] [-o OUTPUT] [-f FLASH] [-v LEVEL]\n"
+        "  -i INPUT   UART input: file, tty or pty slave, a tty also gets the UART output (default: stdin);\n"
+        "             input other than a tty runs on a simulated clock, at the UART baud rate and the NMEA times\n"
+        "  -f FLASH   flash image, loaded if it exists and saved at the end (default: erased)\n"
+        "  -o OUTPUT  advertising payload log (default: stdout)\n"
+        "  -v LEVEL   NRF_LOG level printed to stderr, 0..4 (default: 1, errors)\n",
+        p_name);
+}
+
+int main(int argc, char** argv)
+{
+    const char* p_input = NULL;
+    const char* p_output = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "i:o:f:v:")) != -1) {
+        switch (opt) {
+        case 'f':
+            m_p_flash_file = optarg;
+            break;
+        case 'i':
+            p_input = optarg;
+            break;
+        case 'o':
+            p_output = optarg;
+            break;
+        case 'v':
+            m_verbosity = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (NULL != p_input) {
+        m_input_fd = open(p_input, O_RDWR | O_NOCTTY);
+        if (m_input_fd < 0) {
+            m_input_fd = open(p_input, O_RDONLY | O_NOCTTY);
+        }
+        if (m_input_fd < 0) {
+            perror(p_input);
+            return EXIT_FAILURE;
+        }
+    }
+    if (isatty(m_input_fd)) {
+        struct termios tio;
+        if (0 == tcgetattr(m_input_fd, &tio)) {
+            cfmakeraw(&tio);
+            tcsetattr(m_input_fd, TCSANOW, &tio);
+        }
+        m_tx_to_input = (fcntl(m_input_fd, F_GETFL) & O_ACCMODE) != O_RDONLY;
+    } else {
+        m_sim_clock = true;
+        m_sim_clock_ns = sim_wall_ns();
+    }
+
+    memset(m_flash, 0xFF, sizeof(m_flash));
+    if (NULL != m_p_flash_file) {
+        FILE* p_file = fopen(m_p_flash_file, "rb");
+        if (NULL != p_file) {
+            size_t len = fread(m_flash, 1, sizeof(m_flash), p_file);
+            fclose(p_file);
+            if (len != sizeof(m_flash)) {
+                fprintf(stderr, "%s: not a %d byte flash image\n", m_p_flash_file, SIM_FLASH_SIZE);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    m_adv_out = stdout;
+    if (NULL != p_output) {
+        m_adv_out = fopen(p_output, "w");
+        if (NULL == m_adv_out) {
+            perror(p_output);
+            return EXIT_FAILURE;
+        }
+    }
+
+    m_start_ns = sim_now_ns();
+    m_line_free_ns = m_start_ns;
+    return beacon_main();
+}
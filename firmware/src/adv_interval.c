@@ -0,0 +1,71 @@
+/*******************************************************************************
+* @brief    Speed-adaptive advertising interval.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#include "adv_interval.h"
+
+#include <math.h>
+
+#define METERS_PER_DEGREE 111320.0f /**< Length of one degree of latitude. */
+#define DEG_TO_RAD 0.01745329252f
+
+static bool m_moving = false; /**< Current state. */
+static uint8_t m_slow_fixes = 0; /**< Consecutive fixes below the stationary speed. */
+static bool m_anchor_valid = false; /**< Parking position is known. */
+static float m_anchor_lat = 0; /**< Parking position, latitude. */
+static float m_anchor_lon = 0; /**< Parking position, longitude. */
+
+/*
+ *@brief Function for approximating the distance between two close points (equirectangular).
+ */
+static float distance_m(float lat1, float lon1, float lat2, float lon2)
+{
+    float dy = (lat2 - lat1) * METERS_PER_DEGREE;
+    float dx = (lon2 - lon1) * METERS_PER_DEGREE * cosf(lat1 * DEG_TO_RAD);
+
+    return sqrtf(dx * dx + dy * dy);
+}
+
+void adv_interval_init(void)
+{
+    m_moving = false;
+    m_slow_fixes = 0;
+    m_anchor_valid = false;
+}
+
+uint32_t adv_interval_on_fix(float latitude, float longitude, uint32_t speed_mmps)
+{
+    if (isnan(latitude) || isnan(longitude)) {
+        return adv_interval_get();
+    }
+
+    if (!m_anchor_valid) {
+        m_anchor_lat = latitude;
+        m_anchor_lon = longitude;
+        m_anchor_valid = true;
+    }
+
+    if (!m_moving) {
+        if (speed_mmps > ADV_SPEED_MOVING_MMPS
+            || distance_m(m_anchor_lat, m_anchor_lon, latitude, longitude) > ADV_DISTANCE_MOVING_M) {
+            m_moving = true;
+            m_slow_fixes = 0;
+        }
+    } else if (speed_mmps < ADV_SPEED_STATIONARY_MMPS) {
+        if (++m_slow_fixes >= ADV_STATIONARY_FIXES) {
+            m_moving = false;
+            m_anchor_lat = latitude;
+            m_anchor_lon = longitude;
+        }
+    } else {
+        m_slow_fixes = 0;
+    }
+
+    return adv_interval_get();
+}
+
+uint32_t adv_interval_get(void)
+{
+    return m_moving ? ADV_INTERVAL_MOVING_MS : ADV_INTERVAL_STATIONARY_MS;
+}
@@ -0,0 +1,59 @@
+/*******************************************************************************
+* @brief    Speed-adaptive advertising interval.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef ADV_INTERVAL_MOVING_MS
+#define ADV_INTERVAL_MOVING_MS 100 /**< Advertising interval while moving (100 ms..10.24 s). */
+#endif
+
+#ifndef ADV_INTERVAL_STATIONARY_MS
+#define ADV_INTERVAL_STATIONARY_MS 4000 /**< Advertising interval while stationary (100 ms..10.24 s). */
+#endif
+
+#ifndef ADV_SPEED_MOVING_MMPS
+#define ADV_SPEED_MOVING_MMPS 1000 /**< Speed above which the beacon is moving, mm/s. */
+#endif
+
+#ifndef ADV_SPEED_STATIONARY_MMPS
+#define ADV_SPEED_STATIONARY_MMPS 300 /**< Speed below which the beacon may be stationary, mm/s. */
+#endif
+
+#ifndef ADV_DISTANCE_MOVING_M
+#define ADV_DISTANCE_MOVING_M 15 /**< Distance from the parking position that counts as moving, m. */
+#endif
+
+#ifndef ADV_STATIONARY_FIXES
+#define ADV_STATIONARY_FIXES 10 /**< Consecutive slow fixes needed to fall back to the stationary interval. */
+#endif
+
+/*
+ *@brief Function for resetting the state to stationary with unknown position.
+ */
+void adv_interval_init(void);
+
+/*
+ *@brief Function for choosing the advertising interval after a new fix.
+ *
+ * @details Moving starts as soon as the speed or the distance from the parking position
+ *          exceeds its threshold. Stationary is entered only after ADV_STATIONARY_FIXES
+ *          consecutive fixes below ADV_SPEED_STATIONARY_MMPS, which gives hysteresis both
+ *          in speed and in time, so the interval does not flap around a threshold.
+ *
+ * @param[in]   latitude    Latitude, degrees.
+ * @param[in]   longitude   Longitude, degrees.
+ * @param[in]   speed_mmps  Speed over ground, mm/s.
+ *
+ * @return Advertising interval, ms.
+ */
+uint32_t adv_interval_on_fix(float latitude, float longitude, uint32_t speed_mmps);
+
+/*
+ *@brief Function for getting the current advertising interval, ms.
+ */
+uint32_t adv_interval_get(void);
@@ -18,6 +18,82 @@
 #define NRF_LOG_DEFAULT_LEVEL 4 //AKA Info
 
 
-#define APP_UART_ENABLED 1
-#define APP_FIFO_ENABLED 1
-#define APP_UART_DRIVER_INSTANCE 0
\ No newline at end of file
+// UART input uses libuarte: UARTE0 with EasyDMA, TIMER1 counts received bytes,
+// RTC2 generates the RX timeout, PPI connects them. app_uart is not used.
+#define APP_UART_ENABLED 0
+#define APP_FIFO_ENABLED 0
+#define UART_ENABLED 0
+#define UART0_ENABLED 0
+
+#define NRF_LIBUARTE_DRV_UARTE0 1
+#define TIMER_ENABLED 1
+#define TIMER1_ENABLED 1
+#define RTC_ENABLED 1
+#define RTC2_ENABLED 1
+#define PPI_ENABLED 1
+#define NRF_QUEUE_ENABLED 1
+
+// Modules of the SDK example this project started from, not used by the beacon.
+// Their sources are not in beacon.emProject either.
+#define BUTTON_ENABLED 0
+#define APP_SCHEDULER_ENABLED 0
+#define NRF_CRYPTO_ENABLED 0
+// NMEA input baud rate, up to 1 Mbaud, and RTS/CTS flow control; flow control needs
+// RTS and CTS wired and BEACON_UART_POWER_GATING cleared, see uart_init().
+#define BEACON_UART_BAUDRATE 115200
+#define BEACON_UART_HWFC 0
+// UART powered down between NMEA bursts, woken ahead of the next burst or by GPIOTE on RX.
+#define BEACON_UART_POWER_GATING 1
+// $PBCN commands on the NMEA input tune advertising at runtime, answers go out on UART TX, see command_format.h.
+#define BEACON_COMMAND_CHANNEL 1
+// Fleet gateway: advertises the positions of the assets a host sends as $PBCA sentences, one per advertising event, see fleet.h.
+#define BEACON_FLEET 0
+// Scannable adverts, the scan response carries altitude, DOPs, satellites, battery voltage and build, see beacon_payload.h.
+#define BEACON_SCANNABLE 0
+// The last known fix is advertised right after reset, before the GNSS has a new one; clear for a fleet gateway.
+#define BEACON_FIX_RESTORE 1
+
+#if BEACON_SCANNABLE
+// Battery voltage measured on VDD.
+#define SAADC_ENABLED 1
+#endif
+
+// BLE 5 extended advertising with a ~200 byte fix history instead of the 31 byte legacy advert.
+#define BEACON_ADV_EXTENDED 0
+// LE Coded PHY for long range, needs BEACON_ADV_EXTENDED and nRF52840 with S140.
+#define BEACON_ADV_CODED_PHY 0
+
+// Fixes smoothed by a Kalman filter, positions predicted between fixes advertised while moving, see kalman.h.
+#define BEACON_KALMAN_FILTER 1
+
+// Hot-path profiling with the DWT cycle counter, dumped to the RTT log, see profile.h.
+#define PROFILE_ENABLED 0
+
+#if PROFILE_ENABLED
+// nrf_pwr_mgmt prints the CPU usage every second next to the profile dumps.
+#define NRF_PWR_MGMT_CONFIG_CPU_USAGE_MONITOR_ENABLED 1
+#define NRF_PWR_MGMT_CONFIG_LOG_ENABLED 1
+#define NRF_PWR_MGMT_CONFIG_LOG_LEVEL 4
+// One dump is about 30 deferred log entries.
+#define NRF_LOG_BUFSIZE 4096
+#endif
+
+// Track log of fixes in flash, see track_log.h. fstorage schedules flash operations with the SoftDevice.
+#define NRF_FSTORAGE_ENABLED 1
+
+// Accept connections for the track log download, see track_service.h.
+// The SoftDevice needs more RAM for the link and the large MTU: raise RAM_START in
+// beacon.emProject to the value nrf_sdh_ble_enable() logs and shrink RAM_SIZE to match.
+#define BEACON_CONNECTABLE 0
+
+#if BEACON_CONNECTABLE
+#define NRF_SDH_BLE_PERIPHERAL_LINK_COUNT 1
+#define NRF_SDH_BLE_TOTAL_LINK_COUNT 1
+// 247 byte ATT MTU, 251 byte link layer packets: one 244 byte notification per packet.
+#define NRF_SDH_BLE_GATT_MAX_MTU_SIZE 247
+#define NRF_SDH_BLE_GAP_DATA_LENGTH 251
+// Connection events as long as the interval, extended while there is data to send.
+#define NRF_SDH_BLE_GAP_EVENT_LENGTH 320
+#define NRF_SDH_BLE_VS_UUID_COUNT 1
+#define NRF_BLE_GATT_ENABLED 1
+#endif
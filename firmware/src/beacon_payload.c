@@ -0,0 +1,198 @@
+/*******************************************************************************
+* @brief    Beacon manufacturer specific payload, shared by firmware and receivers.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#include "beacon_payload.h"
+
+static void put_int32(uint8_t* p_buf, int32_t value)
+{
+    uint32_t u = (uint32_t)value;
+
+    p_buf[0] = (uint8_t)u;
+    p_buf[1] = (uint8_t)(u >> 8);
+    p_buf[2] = (uint8_t)(u >> 16);
+    p_buf[3] = (uint8_t)(u >> 24);
+}
+
+static void put_uint16(uint8_t* p_buf, uint16_t value)
+{
+    p_buf[0] = (uint8_t)value;
+    p_buf[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t get_uint16(uint8_t const* p_buf)
+{
+    return (uint16_t)(p_buf[0] | (p_buf[1] << 8));
+}
+
+static int32_t get_int32(uint8_t const* p_buf)
+{
+    return (int32_t)((uint32_t)p_buf[0] | ((uint32_t)p_buf[1] << 8)
+        | ((uint32_t)p_buf[2] << 16) | ((uint32_t)p_buf[3] << 24));
+}
+
+/*
+ *@brief Function for quantizing a delta, returns BEACON_DELTA_NONE if it does not fit.
+ */
+static int8_t delta_encode(int32_t delta)
+{
+    int32_t half = (delta < 0) ? -(BEACON_DELTA_UNIT / 2) : (BEACON_DELTA_UNIT / 2);
+    int32_t steps = (delta + half) / BEACON_DELTA_UNIT;
+
+    if (steps <= BEACON_DELTA_NONE || steps > INT8_MAX) {
+        return BEACON_DELTA_NONE;
+    }
+    return (int8_t)steps;
+}
+
+int32_t beacon_coord_from_nmea(int32_t value, int32_t scale)
+{
+    if (scale <= 0) {
+        return 0;
+    }
+
+    int64_t sign = (value < 0) ? -1 : 1;
+    int64_t abs_value = (int64_t)value * sign;
+    int64_t degrees = abs_value / (100 * (int64_t)scale);
+    int64_t minutes = abs_value % (100 * (int64_t)scale); // Minutes multiplied by scale.
+
+    return (int32_t)(sign * (degrees * BEACON_COORD_PER_DEGREE
+                                + (minutes * BEACON_COORD_PER_DEGREE + 30 * scale) / (60 * (int64_t)scale)));
+}
+
+uint8_t beacon_seq_next(uint8_t seq)
+{
+    return (UINT8_MAX == seq) ? 1 : seq + 1;
+}
+
+uint8_t beacon_seq_distance(uint8_t from, uint8_t to)
+{
+    uint8_t distance = to - from;
+
+    // Wrapped past the skipped 0.
+    return (to < from) ? distance - 1 : distance;
+}
+
+size_t beacon_payload_encode(uint8_t* p_buf, size_t history, beacon_info_t const* p_info, beacon_fix_t const* p_fixes, size_t count)
+{
+    bool asset = (BEACON_ASSET_NONE != p_info->asset);
+
+    p_buf[0] = asset ? BEACON_PAYLOAD_VERSION_ASSET : BEACON_PAYLOAD_VERSION;
+    if (p_info->predicted) {
+        p_buf[0] |= BEACON_PAYLOAD_FLAG_PREDICTED;
+    }
+    p_buf[1] = p_info->seq;
+    put_int32(&p_buf[2], p_fixes[0].latitude);
+    put_int32(&p_buf[6], p_fixes[0].longitude);
+    put_uint16(&p_buf[10], p_info->time);
+    p_buf[12] = p_info->speed;
+    p_buf[13] = p_info->course;
+    if (asset) {
+        p_buf[BEACON_PAYLOAD_HEADER_LEN] = p_info->asset;
+    }
+
+    int32_t lat = p_fixes[0].latitude;
+    int32_t lon = p_fixes[0].longitude;
+    uint8_t* p_delta = &p_buf[asset ? BEACON_PAYLOAD_HEADER_LEN + 1 : BEACON_PAYLOAD_HEADER_LEN];
+    size_t i;
+
+    for (i = 0; i < history && i + 1 < count; i++) {
+        int8_t dlat = delta_encode(p_fixes[i + 1].latitude - lat);
+        int8_t dlon = delta_encode(p_fixes[i + 1].longitude - lon);
+
+        if (BEACON_DELTA_NONE == dlat || BEACON_DELTA_NONE == dlon) {
+            break;
+        }
+        p_delta[2 * i] = (uint8_t)dlat;
+        p_delta[2 * i + 1] = (uint8_t)dlon;
+
+        // Continue from what the receiver reconstructs.
+        lat += dlat * BEACON_DELTA_UNIT;
+        lon += dlon * BEACON_DELTA_UNIT;
+    }
+
+    for (; i < history; i++) {
+        p_delta[2 * i] = (uint8_t)BEACON_DELTA_NONE;
+        p_delta[2 * i + 1] = (uint8_t)BEACON_DELTA_NONE;
+    }
+
+    return asset ? BEACON_PAYLOAD_ASSET_LEN(history) : BEACON_PAYLOAD_LEN(history);
+}
+
+size_t beacon_payload_decode(uint8_t const* p_buf, size_t len, beacon_info_t* p_info, beacon_fix_t* p_fixes, size_t max)
+{
+    if (0 == len) {
+        return 0;
+    }
+
+    uint8_t version = p_buf[0] & ~BEACON_PAYLOAD_FLAG_PREDICTED;
+    size_t header_len = (BEACON_PAYLOAD_VERSION_ASSET == version) ? BEACON_PAYLOAD_HEADER_LEN + 1 : BEACON_PAYLOAD_HEADER_LEN;
+
+    if (len < header_len || (BEACON_PAYLOAD_VERSION != version && BEACON_PAYLOAD_VERSION_ASSET != version) || 0 == max) {
+        return 0;
+    }
+
+    p_info->predicted = (0 != (p_buf[0] & BEACON_PAYLOAD_FLAG_PREDICTED));
+    p_info->seq = p_buf[1];
+    p_fixes[0].latitude = get_int32(&p_buf[2]);
+    p_fixes[0].longitude = get_int32(&p_buf[6]);
+    p_info->time = get_uint16(&p_buf[10]);
+    p_info->speed = p_buf[12];
+    p_info->course = p_buf[13];
+    p_info->asset = (BEACON_PAYLOAD_HEADER_LEN < header_len) ? p_buf[BEACON_PAYLOAD_HEADER_LEN] : BEACON_ASSET_NONE;
+
+    int32_t lat = p_fixes[0].latitude;
+    int32_t lon = p_fixes[0].longitude;
+    size_t count = 1;
+
+    for (size_t offset = header_len; offset + 1 < len && count < max; offset += 2) {
+        int8_t dlat = (int8_t)p_buf[offset];
+        int8_t dlon = (int8_t)p_buf[offset + 1];
+
+        if (BEACON_DELTA_NONE == dlat || BEACON_DELTA_NONE == dlon) {
+            break;
+        }
+        lat += dlat * BEACON_DELTA_UNIT;
+        lon += dlon * BEACON_DELTA_UNIT;
+
+        p_fixes[count].latitude = lat;
+        p_fixes[count].longitude = lon;
+        count++;
+    }
+
+    return count;
+}
+
+size_t beacon_detail_encode(uint8_t* p_buf, beacon_detail_t const* p_detail)
+{
+    p_buf[0] = BEACON_DETAIL_VERSION;
+    p_buf[1] = p_detail->seq;
+    put_int32(&p_buf[2], p_detail->altitude);
+    p_buf[6] = p_detail->satellites;
+    p_buf[7] = p_detail->quality;
+    p_buf[8] = p_detail->pdop;
+    p_buf[9] = p_detail->hdop;
+    p_buf[10] = p_detail->vdop;
+    put_uint16(&p_buf[11], p_detail->battery_mv);
+    put_int32(&p_buf[13], (int32_t)p_detail->build);
+    return BEACON_DETAIL_LEN;
+}
+
+bool beacon_detail_decode(uint8_t const* p_buf, size_t len, beacon_detail_t* p_detail)
+{
+    if (len < BEACON_DETAIL_LEN || BEACON_DETAIL_VERSION != p_buf[0]) {
+        return false;
+    }
+
+    p_detail->seq = p_buf[1];
+    p_detail->altitude = get_int32(&p_buf[2]);
+    p_detail->satellites = p_buf[6];
+    p_detail->quality = p_buf[7];
+    p_detail->pdop = p_buf[8];
+    p_detail->hdop = p_buf[9];
+    p_detail->vdop = p_buf[10];
+    p_detail->battery_mv = get_uint16(&p_buf[11]);
+    p_detail->build = (uint32_t)get_int32(&p_buf[13]);
+    return true;
+}
@@ -0,0 +1,190 @@
+/*******************************************************************************
+* @brief    Beacon manufacturer specific payload, shared by firmware and receivers.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*
+* Layout version 1 (little endian), following the 16-bit company identifier:
+*   0  uint8   version, BEACON_PAYLOAD_VERSION, with BEACON_PAYLOAD_FLAG_PREDICTED
+*   1  uint8   sequence number of the newest fix, 0 before the first fix, then 1..255
+*   2  int32   latitude of the newest fix, 1e-7 degree
+*   6  int32   longitude of the newest fix, 1e-7 degree
+*  10  uint16  UTC time of the newest fix within the hour, 0.1 s; receivers derive the fix age
+*  12  uint8   speed over ground, BEACON_SPEED_UNIT_MMPS
+*  13  uint8   course over ground, 360/256 degree
+*  14  int8[2] per previous fix: latitude and longitude delta to the next newer fix,
+*              in BEACON_DELTA_UNIT; BEACON_DELTA_NONE ends the list
+* The number of history entries is given by the payload length, so legacy and
+* extended adverts share the format. Receivers recognise the payload by the
+* company identifier and the version byte, adverts carry no name.
+* Between fixes the beacon may advertise a position predicted from the newest
+* fix, flagged by BEACON_PAYLOAD_FLAG_PREDICTED: latitude, longitude and time
+* of the header are those of the prediction, the sequence number stays that of
+* the newest fix, which is the first history entry. A receiver that missed the
+* advert of the fix takes it from there. Receivers not knowing the flag see an
+* other version and ignore predictions.
+*
+* Layout version 2 is sent by a fleet gateway advertising many assets in turn:
+* the version 1 header, then
+*  14  uint8   asset ID; sequence number, fix and history are those of the asset
+*  15  int8[2] history as in version 1
+*
+* The scan response of a scannable beacon carries the detail payload, sent only
+* when an active scanner asks for it:
+*   0  uint8   version, BEACON_DETAIL_VERSION
+*   1  uint8   sequence number of the newest fix, as in the position payload
+*   2  int32   altitude above mean sea level, 0.1 m, BEACON_ALTITUDE_UNKNOWN if not known
+*   6  uint8   satellites used, BEACON_DETAIL_UNKNOWN if not known
+*   7  uint8   GGA fix quality (0 none, 1 GPS, 2 DGPS, 4 RTK, ...), BEACON_DETAIL_UNKNOWN if not known
+*   8  uint8   PDOP, HDOP and VDOP, 0.1 each, BEACON_DETAIL_UNKNOWN if not known
+*  11  uint16  battery voltage, mV, 0 if not measured
+*  13  uint32  firmware build
+*******************************************************************************/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BEACON_COMPANY_IDENTIFIER 0xFFFF /**< Company identifier of the payloads, 0xFFFF is for testing according to the Bluetooth SIG. */
+#define BEACON_PAYLOAD_VERSION 1 /**< Layout version, receivers ignore other versions. */
+#define BEACON_PAYLOAD_VERSION_ASSET 2 /**< Layout version of a payload carrying an asset ID. */
+#define BEACON_PAYLOAD_FLAG_PREDICTED 0x40 /**< Set in the version byte when the header carries a prediction. */
+
+#define BEACON_COORD_PER_DEGREE 10000000 /**< Coordinates are in 1e-7 degree. */
+#define BEACON_DELTA_UNIT 300 /**< Delta resolution, 1e-7 degree (about 3.3 m of latitude). */
+#define BEACON_DELTA_NONE INT8_MIN /**< Marks a missing fix or a step too large for a delta. */
+
+#define BEACON_TIME_UNKNOWN 0xFFFF /**< Fix time is not known. */
+#define BEACON_TIME_PER_HOUR 36000 /**< Fix time wraps every hour. */
+#define BEACON_SPEED_UNIT_MMPS 250 /**< Speed resolution, mm/s. */
+#define BEACON_SPEED_UNKNOWN 0xFF /**< Speed and course are not known. */
+#define BEACON_ASSET_NONE 0xFF /**< The fix is the beacon's own, the payload has no asset ID. */
+
+#ifndef BEACON_PAYLOAD_HISTORY_LEN
+#define BEACON_PAYLOAD_HISTORY_LEN 5 /**< Previous fixes carried in a legacy advert, fills it next to the flags. */
+#endif
+
+#ifndef BEACON_PAYLOAD_HISTORY_EXTENDED_LEN
+#define BEACON_PAYLOAD_HISTORY_EXTENDED_LEN 95 /**< Previous fixes carried in an extended advert, about 200 bytes. */
+#endif
+
+#define BEACON_PAYLOAD_HEADER_LEN 14 /**< Version, sequence number and the newest fix. */
+#define BEACON_PAYLOAD_LEN(history) (BEACON_PAYLOAD_HEADER_LEN + 2 * (history)) /**< Payload size for given history depth. */
+#define BEACON_PAYLOAD_ASSET_LEN(history) (BEACON_PAYLOAD_LEN(history) + 1) /**< Payload size with an asset ID. */
+
+#define BEACON_DETAIL_VERSION 0x81 /**< Detail payload layout version, apart from the position layouts. */
+#define BEACON_DETAIL_LEN 17 /**< Detail payload size. */
+#define BEACON_DETAIL_UNKNOWN 0xFF /**< 8-bit detail field is not known. */
+#define BEACON_ALTITUDE_UNKNOWN INT32_MIN /**< Altitude is not known. */
+
+/*
+ *@brief Struct that contains one fix.
+ */
+typedef struct {
+    int32_t latitude; /**< Latitude, 1e-7 degree. */
+    int32_t longitude; /**< Longitude, 1e-7 degree. */
+} beacon_fix_t;
+
+/*
+ *@brief Struct that contains the payload fields describing the newest fix.
+ */
+typedef struct {
+    uint8_t seq; /**< Sequence number, see beacon_seq_next(). */
+    uint16_t time; /**< UTC time within the hour, 0.1 s, or BEACON_TIME_UNKNOWN. */
+    uint8_t speed; /**< Speed over ground, BEACON_SPEED_UNIT_MMPS, or BEACON_SPEED_UNKNOWN. */
+    uint8_t course; /**< Course over ground, 360/256 degree. */
+    uint8_t asset; /**< Asset ID, or BEACON_ASSET_NONE. */
+    bool predicted; /**< The position and time are predicted, the fix of seq is the first history entry. */
+} beacon_info_t;
+
+/*
+ *@brief Struct that contains the detail payload fields.
+ */
+typedef struct {
+    uint8_t seq; /**< Sequence number of the newest fix. */
+    int32_t altitude; /**< Altitude above mean sea level, 0.1 m, or BEACON_ALTITUDE_UNKNOWN. */
+    uint8_t satellites; /**< Satellites used, or BEACON_DETAIL_UNKNOWN. */
+    uint8_t quality; /**< GGA fix quality, or BEACON_DETAIL_UNKNOWN. */
+    uint8_t pdop; /**< Position dilution of precision, 0.1, or BEACON_DETAIL_UNKNOWN. */
+    uint8_t hdop; /**< Horizontal dilution of precision, 0.1, or BEACON_DETAIL_UNKNOWN. */
+    uint8_t vdop; /**< Vertical dilution of precision, 0.1, or BEACON_DETAIL_UNKNOWN. */
+    uint16_t battery_mv; /**< Battery voltage, mV, or 0. */
+    uint32_t build; /**< Firmware build. */
+} beacon_detail_t;
+
+/*
+ *@brief Function for converting an NMEA DDMM.mmmm fixed-point coordinate to 1e-7 degree.
+ *
+ * @param[in]   value   Coordinate, DDMM.mmmm multiplied by scale.
+ * @param[in]   scale   Fixed-point scale of the value, as reported by the NMEA parser.
+ *
+ * @return Coordinate, 1e-7 degree; 0 if the scale is 0 (empty field).
+ */
+int32_t beacon_coord_from_nmea(int32_t value, int32_t scale);
+
+/*
+ *@brief Function for getting the sequence number following seq, 0 is skipped.
+ */
+uint8_t beacon_seq_next(uint8_t seq);
+
+/*
+ *@brief Function for counting sequence steps from one sequence number to another.
+ */
+uint8_t beacon_seq_distance(uint8_t from, uint8_t to);
+
+/*
+ *@brief Function for encoding the newest fix and the delta-encoded history.
+ *
+ * @details Each delta is taken against the position the receiver will reconstruct, not the
+ *          exact one, so rounding errors do not accumulate along the history.
+ *
+ * @param[out]  p_buf       Output buffer.
+ * @param[in]   history     Number of delta slots, the payload is BEACON_PAYLOAD_LEN(history) bytes,
+ *                          or BEACON_PAYLOAD_ASSET_LEN(history) with an asset ID.
+ * @param[in]   p_info      Sequence number, time, speed, course and asset of the newest fix,
+ *                          predicted sets BEACON_PAYLOAD_FLAG_PREDICTED.
+ * @param[in]   p_fixes     Fixes, newest first; a prediction goes first, before the fix of seq.
+ * @param[in]   count       Number of fixes in p_fixes, at least 1.
+ *
+ * @return Number of bytes written.
+ */
+size_t beacon_payload_encode(uint8_t* p_buf, size_t history, beacon_info_t const* p_info, beacon_fix_t const* p_fixes, size_t count);
+
+/*
+ *@brief Function for decoding a payload.
+ *
+ * @param[in]   p_buf       Payload, starting after the company identifier.
+ * @param[in]   len         Payload length.
+ * @param[out]  p_info      Sequence number, time, speed, course, asset and prediction flag.
+ * @param[out]  p_fixes     Fixes, newest first. Fix i is i sequence steps older than the newest,
+ *                          of a prediction fix i + 1 is.
+ * @param[in]   max         Capacity of p_fixes.
+ *
+ * @return Number of decoded fixes, 0 if the payload is too short or of another version.
+ */
+size_t beacon_payload_decode(uint8_t const* p_buf, size_t len, beacon_info_t* p_info, beacon_fix_t* p_fixes, size_t max);
+
+/*
+ *@brief Function for encoding the detail payload.
+ *
+ * @param[out]  p_buf       Output buffer of BEACON_DETAIL_LEN bytes.
+ * @param[in]   p_detail    Detail fields.
+ *
+ * @return Number of bytes written.
+ */
+size_t beacon_detail_encode(uint8_t* p_buf, beacon_detail_t const* p_detail);
+
+/*
+ *@brief Function for decoding the detail payload.
+ *
+ * @return false if the payload is too short or of another version.
+ */
+bool beacon_detail_decode(uint8_t const* p_buf, size_t len, beacon_detail_t* p_detail);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,294 @@
+/*******************************************************************************
+* @brief    UART command channel, shared by firmware and host.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#include "command_format.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* const m_command_names[COMMAND_COUNT] = { "PING", "INT", "TXP", "PHY", "FMT", "LAT", "STA" };
+static const char* const m_status_names[COMMAND_STATUS_COUNT] = { "OK", "INVALID", "RANGE", "UNSUPPORTED" };
+
+/*
+ *@brief Function for getting the NMEA checksum, XOR of the characters between '$' and '*'.
+ */
+static uint8_t checksum(const char* p_start, const char* p_end)
+{
+    uint8_t sum = 0;
+
+    while (p_start < p_end) {
+        sum ^= (uint8_t)*p_start++;
+    }
+    return sum;
+}
+
+/*
+ *@brief Function for verifying the checksum and finding the end of the fields.
+ *
+ * @return Pointer to '*', or NULL if the checksum is missing or wrong.
+ */
+static const char* checksum_check(const char* p_line)
+{
+    const char* p_star = strchr(p_line, '*');
+    char* p_end;
+
+    if (NULL == p_star) {
+        return NULL;
+    }
+    unsigned long sum = strtoul(p_star + 1, &p_end, 16);
+    if (p_end != p_star + 3 || sum != checksum(p_line + 1, p_star)) {
+        return NULL;
+    }
+    return p_star;
+}
+
+/*
+ *@brief Function for appending the checksum and line ending to a formatted sentence.
+ */
+static size_t finish(char* p_buf, size_t size, int len)
+{
+    if (len < 0 || (size_t)len + 5 >= size) {
+        return 0;
+    }
+    return (size_t)len + (size_t)snprintf(&p_buf[len], size - (size_t)len, "*%02X\r\n", checksum(p_buf + 1, p_buf + len));
+}
+
+/*
+ *@brief Function for reading a decimal field ending with ',' or at p_end.
+ */
+static bool field_int(const char** pp_field, const char* p_end, int32_t* p_value)
+{
+    char* p_next;
+    long value = strtol(*pp_field, &p_next, 10);
+
+    if (p_next == *pp_field || (p_next != p_end && ',' != *p_next)) {
+        return false;
+    }
+    *p_value = (int32_t)value;
+    *pp_field = (p_next == p_end) ? p_end : p_next + 1;
+    return true;
+}
+
+/*
+ *@brief Function for reading a decimal field that may be empty, ASSET_VALUE_UNKNOWN then.
+ */
+static bool field_int_opt(const char** pp_field, const char* p_end, int32_t* p_value)
+{
+    if (*pp_field != p_end && ',' == **pp_field) {
+        *p_value = ASSET_VALUE_UNKNOWN;
+        (*pp_field)++;
+        return true;
+    }
+    return field_int(pp_field, p_end, p_value) && *p_value >= 0;
+}
+
+/*
+ *@brief Function for reading a text field ending with ',' or at p_end and looking it up.
+ *
+ * @return Index of the name, or count if not found.
+ */
+static size_t field_name(const char** pp_field, const char* p_end, const char* const* p_names, size_t count)
+{
+    const char* p_comma = memchr(*pp_field, ',', (size_t)(p_end - *pp_field));
+    const char* p_stop = (NULL != p_comma) ? p_comma : p_end;
+    size_t len = (size_t)(p_stop - *pp_field);
+
+    for (size_t i = 0; i < count; i++) {
+        if (strlen(p_names[i]) == len && 0 == strncmp(*pp_field, p_names[i], len)) {
+            *pp_field = (NULL != p_comma) ? p_comma + 1 : p_end;
+            return i;
+        }
+    }
+    return count;
+}
+
+/*
+ *@brief Function for reading the command name and its value.
+ */
+static bool fields_command(const char* p_field, const char* p_end, command_t* p_cmd)
+{
+    size_t id = field_name(&p_field, p_end, m_command_names, COMMAND_COUNT);
+
+    if (COMMAND_COUNT == id) {
+        return false;
+    }
+    p_cmd->id = (command_id_t)id;
+    p_cmd->value = 0;
+    if (COMMAND_PING == p_cmd->id || COMMAND_STATS == p_cmd->id) {
+        return p_field == p_end;
+    }
+    return field_int(&p_field, p_end, &p_cmd->value) && p_field == p_end;
+}
+
+bool command_line_is(const char* p_line)
+{
+    return 0 == strncmp(p_line, COMMAND_PREFIX, sizeof(COMMAND_PREFIX) - 1);
+}
+
+command_status_t command_parse(const char* p_line, command_t* p_cmd)
+{
+    const char* p_field = p_line + sizeof(COMMAND_PREFIX) - 1;
+    const char* p_end;
+    int32_t seq;
+
+    p_cmd->seq = 0;
+    if (!command_line_is(p_line) || NULL == (p_end = checksum_check(p_line))) {
+        return COMMAND_STATUS_INVALID;
+    }
+    if (!field_int(&p_field, p_end, &seq) || seq < 0 || seq > UINT16_MAX) {
+        return COMMAND_STATUS_INVALID;
+    }
+    p_cmd->seq = (uint16_t)seq;
+    return fields_command(p_field, p_end, p_cmd) ? COMMAND_STATUS_OK : COMMAND_STATUS_INVALID;
+}
+
+size_t command_format(char* p_buf, size_t size, command_t const* p_cmd)
+{
+    int len;
+
+    if (p_cmd->id >= COMMAND_COUNT) {
+        return 0;
+    }
+    if (COMMAND_PING == p_cmd->id || COMMAND_STATS == p_cmd->id) {
+        len = snprintf(p_buf, size, COMMAND_PREFIX "%u,%s", p_cmd->seq, m_command_names[p_cmd->id]);
+    } else {
+        len = snprintf(p_buf, size, COMMAND_PREFIX "%u,%s,%ld", p_cmd->seq, m_command_names[p_cmd->id], (long)p_cmd->value);
+    }
+    return finish(p_buf, size, len);
+}
+
+bool command_from_text(const char* p_text, command_t* p_cmd)
+{
+    return fields_command(p_text, p_text + strlen(p_text), p_cmd);
+}
+
+size_t command_ack_format(char* p_buf, size_t size, uint16_t seq, command_status_t status, uint32_t rx_us, uint32_t tx_us)
+{
+    int len = snprintf(p_buf, size, COMMAND_PREFIX "ACK,%u,%s,%lu,%lu", seq,
+        m_status_names[(status < COMMAND_STATUS_COUNT) ? status : COMMAND_STATUS_INVALID],
+        (unsigned long)rx_us, (unsigned long)tx_us);
+    return finish(p_buf, size, len);
+}
+
+size_t command_report_format(char* p_buf, size_t size, uint8_t seq, uint32_t ingest_us, uint32_t adv_us)
+{
+    int len = snprintf(p_buf, size, COMMAND_PREFIX "ADV,%u,%lu,%lu", seq, (unsigned long)ingest_us, (unsigned long)adv_us);
+    return finish(p_buf, size, len);
+}
+
+size_t command_stats_format(char* p_buf, size_t size, uint16_t seq, command_stats_t const* p_stats)
+{
+    int len = snprintf(p_buf, size, COMMAND_PREFIX "STA,%u,%lu,%lu,%lu", seq, (unsigned long)p_stats->lines,
+        (unsigned long)p_stats->dropped, (unsigned long)p_stats->errors);
+    return finish(p_buf, size, len);
+}
+
+bool command_stats_parse(const char* p_line, uint16_t* p_seq, command_stats_t* p_stats)
+{
+    static const char prefix[] = COMMAND_PREFIX "STA,";
+    uint32_t* const p_fields[] = { &p_stats->lines, &p_stats->dropped, &p_stats->errors };
+    const char* p_end;
+    char* p_next;
+
+    if (0 != strncmp(p_line, prefix, sizeof(prefix) - 1) || NULL == (p_end = checksum_check(p_line))) {
+        return false;
+    }
+    unsigned long seq = strtoul(p_line + sizeof(prefix) - 1, &p_next, 10);
+    if (seq > UINT16_MAX) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(p_fields) / sizeof(p_fields[0]); i++) {
+        if (',' != *p_next) {
+            return false;
+        }
+        *p_fields[i] = (uint32_t)strtoul(p_next + 1, &p_next, 10);
+    }
+    *p_seq = (uint16_t)seq;
+    return p_next == p_end;
+}
+
+bool command_reply_parse(const char* p_line, command_reply_t* p_reply)
+{
+    static const char* const types[] = { "ACK", "ADV" };
+    const char* p_field = p_line + sizeof(COMMAND_PREFIX) - 1;
+    const char* p_end;
+    int32_t seq;
+
+    if (!command_line_is(p_line) || NULL == (p_end = checksum_check(p_line))) {
+        return false;
+    }
+    size_t type = field_name(&p_field, p_end, types, 2);
+    if (2 == type || !field_int(&p_field, p_end, &seq)) {
+        return false;
+    }
+    p_reply->ack = (0 == type);
+    p_reply->seq = (uint16_t)seq;
+    p_reply->status = COMMAND_STATUS_OK;
+    if (p_reply->ack) {
+        size_t status = field_name(&p_field, p_end, m_status_names, COMMAND_STATUS_COUNT);
+        if (COMMAND_STATUS_COUNT == status) {
+            return false;
+        }
+        p_reply->status = (command_status_t)status;
+    }
+
+    char* p_next;
+    p_reply->time1_us = (uint32_t)strtoul(p_field, &p_next, 10);
+    if (',' != *p_next) {
+        return false;
+    }
+    p_reply->time2_us = (uint32_t)strtoul(p_next + 1, &p_next, 10);
+    return p_next == p_end;
+}
+
+const char* command_status_name(command_status_t status)
+{
+    return (status < COMMAND_STATUS_COUNT) ? m_status_names[status] : "?";
+}
+
+bool asset_line_is(const char* p_line)
+{
+    return 0 == strncmp(p_line, ASSET_PREFIX, sizeof(ASSET_PREFIX) - 1);
+}
+
+bool asset_parse(const char* p_line, asset_update_t* p_update)
+{
+    const char* p_field = p_line + sizeof(ASSET_PREFIX) - 1;
+    const char* p_end;
+    int32_t id;
+
+    if (!asset_line_is(p_line) || NULL == (p_end = checksum_check(p_line))) {
+        return false;
+    }
+    if (!field_int(&p_field, p_end, &id) || id < 0 || id > ASSET_ID_MAX
+        || !field_int(&p_field, p_end, &p_update->latitude)
+        || !field_int(&p_field, p_end, &p_update->longitude)
+        || !field_int_opt(&p_field, p_end, &p_update->time_ms)
+        || !field_int_opt(&p_field, p_end, &p_update->speed_mmps)
+        || !field_int(&p_field, p_end, &p_update->course) || p_field != p_end) {
+        return false;
+    }
+    p_update->id = (uint8_t)id;
+    return p_update->latitude >= -900000000 && p_update->latitude <= 900000000
+        && p_update->longitude >= -1800000000 && p_update->longitude <= 1800000000
+        && p_update->time_ms < 86400000 && p_update->course >= 0 && p_update->course < 3600;
+}
+
+size_t asset_format(char* p_buf, size_t size, asset_update_t const* p_update)
+{
+    char time[12] = "";
+    char speed[12] = "";
+
+    if (p_update->time_ms >= 0) {
+        snprintf(time, sizeof(time), "%ld", (long)p_update->time_ms);
+    }
+    if (p_update->speed_mmps >= 0) {
+        snprintf(speed, sizeof(speed), "%ld", (long)p_update->speed_mmps);
+    }
+    int len = snprintf(p_buf, size, ASSET_PREFIX "%u,%ld,%ld,%s,%s,%ld", p_update->id, (long)p_update->latitude,
+        (long)p_update->longitude, time, speed, (long)p_update->course);
+    return finish(p_buf, size, len);
+}
@@ -0,0 +1,211 @@
+/*******************************************************************************
+* @brief    UART command channel, shared by firmware and host.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*
+* Commands are proprietary NMEA sentences on the GNSS input line, so they share
+* the framing and checksum of the NMEA stream:
+*   $PBCN,<seq>,<command>[,<value>]*hh
+*     PING          no-op, for round-trip timing
+*     INT,<ms>      advertising interval, 0 returns to the speed-adaptive interval
+*     TXP,<dBm>     advertising TX power, one of the radio's steps
+*     PHY,<phy>     advertising PHY: 1 (1M), 2 (2M, extended only), 4 (Coded, S140 only)
+*     FMT,<n>       previous fixes carried in the payload, 0..history of the build
+*     LAT,<0|1>     latency report of every advertised fix off/on
+*     STA           link statistics, sent ahead of the answer
+* The beacon answers every command, also a rejected one, on the UART TX line:
+*   $PBCN,ACK,<seq>,<status>,<rx_us>,<tx_us>*hh
+* rx_us is the beacon time the command was received, tx_us the time the answer
+* was queued. With latency reports on, every advertised fix is followed by
+*   $PBCN,ADV,<payload seq>,<ingest_us>,<adv_us>*hh
+* with the time the RMC sentence was received and its payload was handed to
+* the SoftDevice. Beacon times are microseconds of a free running clock that
+* wraps at 2^32, only their differences are meaningful.
+* The link statistics are
+*   $PBCN,STA,<seq>,<lines>,<dropped>,<errors>*hh
+* with the sentences received (lines starting with '$', this one included), the
+* lines dropped because the queue was full or they were too long, and the UART errors (framing, parity, break, overrun, all
+* RX buffers in use), all counted since boot.
+* A fleet gateway takes the positions of the assets it advertises from
+*   $PBCA,<asset>,<lat>,<lon>,<utc_ms>,<speed>,<course>*hh
+* with the asset ID 0..254, latitude and longitude in 1e-7 degree, the UTC time
+* of the fix in ms of the day, speed over ground in mm/s and course over ground
+* in 0.1 degree; time and speed may be empty when unknown. Asset sentences are
+* not answered, they come as often as the positions change.
+*******************************************************************************/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define COMMAND_PREFIX "$PBCN," /**< Start of every command channel sentence. */
+#define COMMAND_LINE_MAX 82 /**< Longest sentence including <CR><LF>, as for NMEA. */
+#define ASSET_PREFIX "$PBCA," /**< Start of an asset position sentence. */
+#define ASSET_ID_MAX 254 /**< Highest asset ID, 255 is BEACON_ASSET_NONE. */
+#define ASSET_VALUE_UNKNOWN (-1) /**< Empty time or speed field. */
+
+/*
+ *@brief Commands.
+ */
+typedef enum {
+    COMMAND_PING,
+    COMMAND_INTERVAL,
+    COMMAND_TX_POWER,
+    COMMAND_PHY,
+    COMMAND_FORMAT,
+    COMMAND_LATENCY,
+    COMMAND_STATS,
+    COMMAND_COUNT
+} command_id_t;
+
+/*
+ *@brief Answer status.
+ */
+typedef enum {
+    COMMAND_STATUS_OK,
+    COMMAND_STATUS_INVALID, /**< Malformed sentence, bad checksum or unknown command. */
+    COMMAND_STATUS_RANGE, /**< Value out of range for the command. */
+    COMMAND_STATUS_UNSUPPORTED, /**< Not available in this build or on this radio. */
+    COMMAND_STATUS_COUNT
+} command_status_t;
+
+/*
+ *@brief Struct that contains a command.
+ */
+typedef struct {
+    uint16_t seq; /**< Chosen by the host, returned in the answer. */
+    command_id_t id; /**< Command. */
+    int32_t value; /**< Argument, 0 for commands without one. */
+} command_t;
+
+/*
+ *@brief Struct that contains a sentence sent by the beacon.
+ */
+typedef struct {
+    bool ack; /**< Answer to a command, otherwise latency report. */
+    uint16_t seq; /**< Command sequence number, or payload sequence number of a report. */
+    command_status_t status; /**< Answer status. */
+    uint32_t time1_us; /**< Command received, or RMC sentence received. */
+    uint32_t time2_us; /**< Answer queued, or payload handed to the SoftDevice. */
+} command_reply_t;
+
+/*
+ *@brief Struct that contains the link statistics.
+ */
+typedef struct {
+    uint32_t lines; /**< Sentences received. */
+    uint32_t dropped; /**< Lines dropped, queue full or too long. */
+    uint32_t errors; /**< UART errors. */
+} command_stats_t;
+
+/*
+ *@brief Struct that contains the position of an asset.
+ */
+typedef struct {
+    uint8_t id; /**< Asset ID, 0..ASSET_ID_MAX. */
+    int32_t latitude; /**< Latitude, 1e-7 degree. */
+    int32_t longitude; /**< Longitude, 1e-7 degree. */
+    int32_t time_ms; /**< UTC time of the fix, ms of the day, or ASSET_VALUE_UNKNOWN. */
+    int32_t speed_mmps; /**< Speed over ground, mm/s, or ASSET_VALUE_UNKNOWN. */
+    int32_t course; /**< Course over ground, 0.1 degree. */
+} asset_update_t;
+
+/*
+ *@brief Function for checking whether a line belongs to the command channel.
+ */
+bool command_line_is(const char* p_line);
+
+/*
+ *@brief Function for parsing a command sentence.
+ *
+ * @param[in]   p_line  Zero-terminated sentence, line ending optional.
+ * @param[out]  p_cmd   Parsed command; seq is set whenever the sentence gets that far.
+ *
+ * @return COMMAND_STATUS_OK, or why the sentence was rejected.
+ */
+command_status_t command_parse(const char* p_line, command_t* p_cmd);
+
+/*
+ *@brief Function for formatting a command sentence with checksum and <CR><LF>.
+ *
+ * @return Length of the sentence, 0 if it does not fit.
+ */
+size_t command_format(char* p_buf, size_t size, command_t const* p_cmd);
+
+/*
+ *@brief Function for parsing a command name and value, e.g. "INT,100".
+ *
+ * @return false if the command is unknown or the value is missing.
+ */
+bool command_from_text(const char* p_text, command_t* p_cmd);
+
+/*
+ *@brief Function for formatting the answer to a command.
+ *
+ * @return Length of the sentence, 0 if it does not fit.
+ */
+size_t command_ack_format(char* p_buf, size_t size, uint16_t seq, command_status_t status, uint32_t rx_us, uint32_t tx_us);
+
+/*
+ *@brief Function for formatting the latency report of an advertised fix.
+ *
+ * @return Length of the sentence, 0 if it does not fit.
+ */
+size_t command_report_format(char* p_buf, size_t size, uint8_t seq, uint32_t ingest_us, uint32_t adv_us);
+
+/*
+ *@brief Function for formatting the link statistics.
+ *
+ * @return Length of the sentence, 0 if it does not fit.
+ */
+size_t command_stats_format(char* p_buf, size_t size, uint16_t seq, command_stats_t const* p_stats);
+
+/*
+ *@brief Function for parsing the link statistics.
+ *
+ * @return false if the line is not a statistics sentence.
+ */
+bool command_stats_parse(const char* p_line, uint16_t* p_seq, command_stats_t* p_stats);
+
+/*
+ *@brief Function for parsing an answer or a latency report.
+ *
+ * @return false if the line is neither.
+ */
+bool command_reply_parse(const char* p_line, command_reply_t* p_reply);
+
+/*
+ *@brief Function for getting the name of a status, e.g. for printing.
+ */
+const char* command_status_name(command_status_t status);
+
+/*
+ *@brief Function for checking whether a line is an asset position sentence.
+ */
+bool asset_line_is(const char* p_line);
+
+/*
+ *@brief Function for parsing an asset position sentence.
+ *
+ * @param[in]   p_line      Zero-terminated sentence, line ending optional.
+ * @param[out]  p_update    Parsed position.
+ *
+ * @return false if the sentence is malformed or a value is out of range.
+ */
+bool asset_parse(const char* p_line, asset_update_t* p_update);
+
+/*
+ *@brief Function for formatting an asset position sentence with checksum and <CR><LF>.
+ *
+ * @return Length of the sentence, 0 if it does not fit.
+ */
+size_t asset_format(char* p_buf, size_t size, asset_update_t const* p_update);
+
+#ifdef __cplusplus
+}
+#endif
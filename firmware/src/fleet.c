@@ -0,0 +1,116 @@
+/*******************************************************************************
+* @brief    Asset table of a fleet gateway and its advertising schedule.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#include "fleet.h"
+
+#include "beacon_payload.h"
+
+#include <stdbool.h>
+
+/*
+ *@brief Struct that contains one asset.
+ */
+typedef struct {
+    beacon_fix_t fix; /**< Newest position. */
+    beacon_info_t info; /**< Sequence number, time, speed, course and ID. */
+    uint16_t age; /**< Advertising events since the asset was last advertised. */
+    bool changed; /**< The position changed since the asset was last advertised. */
+    uint32_t updated; /**< Value of m_updates at the newest update, orders entries for replacement. */
+} fleet_asset_t;
+
+static fleet_asset_t m_assets[FLEET_ASSETS_MAX]; /**< Asset table, the first m_count entries are used. */
+static size_t m_count = 0; /**< Number of assets in the table. */
+static uint32_t m_updates = 0; /**< Updates so far. */
+
+/*
+ *@brief Function for finding the entry of an asset, or the one it is stored in.
+ */
+static fleet_asset_t* asset_entry(uint8_t id)
+{
+    fleet_asset_t* p_oldest = &m_assets[0];
+
+    for (size_t i = 0; i < m_count; i++) {
+        if (id == m_assets[i].info.asset) {
+            return &m_assets[i];
+        }
+        if (m_updates - m_assets[i].updated > m_updates - p_oldest->updated) {
+            p_oldest = &m_assets[i];
+        }
+    }
+    if (m_count < FLEET_ASSETS_MAX) {
+        p_oldest = &m_assets[m_count++];
+    }
+
+    // New asset, advertised first.
+    p_oldest->info.asset = id;
+    p_oldest->info.seq = 0;
+    p_oldest->fix.latitude = 0;
+    p_oldest->fix.longitude = 0;
+    p_oldest->age = UINT16_MAX - FLEET_CHANGED_PRIORITY;
+    return p_oldest;
+}
+
+void fleet_init(void)
+{
+    m_count = 0;
+    m_updates = 0;
+}
+
+void fleet_update(asset_update_t const* p_update)
+{
+    fleet_asset_t* p_asset = asset_entry(p_update->id);
+
+    if (p_update->latitude != p_asset->fix.latitude || p_update->longitude != p_asset->fix.longitude) {
+        p_asset->changed = true;
+    }
+    p_asset->fix.latitude = p_update->latitude;
+    p_asset->fix.longitude = p_update->longitude;
+    p_asset->info.seq = beacon_seq_next(p_asset->info.seq);
+    p_asset->info.time = BEACON_TIME_UNKNOWN;
+    if (ASSET_VALUE_UNKNOWN != p_update->time_ms) {
+        p_asset->info.time = (uint16_t)(((uint32_t)p_update->time_ms % 3600000u) / 100u);
+    }
+    p_asset->info.speed = BEACON_SPEED_UNKNOWN;
+    p_asset->info.course = 0;
+    if (ASSET_VALUE_UNKNOWN != p_update->speed_mmps) {
+        uint32_t speed = (uint32_t)p_update->speed_mmps / BEACON_SPEED_UNIT_MMPS;
+        p_asset->info.speed = (uint8_t)((speed < BEACON_SPEED_UNKNOWN) ? speed : BEACON_SPEED_UNKNOWN - 1);
+        // Tenths of a degree to 360/256 degree.
+        p_asset->info.course = (uint8_t)(((uint32_t)p_update->course * 256 + 1800) / 3600);
+    }
+    p_asset->updated = ++m_updates;
+}
+
+size_t fleet_payload_next(uint8_t* p_buf)
+{
+    fleet_asset_t* p_next = NULL;
+    uint32_t priority_max = 0;
+
+    for (size_t i = 0; i < m_count; i++) {
+        fleet_asset_t* p_asset = &m_assets[i];
+        uint32_t priority = (uint32_t)p_asset->age + (p_asset->changed ? FLEET_CHANGED_PRIORITY : 0);
+
+        if (p_asset->age < UINT16_MAX - FLEET_CHANGED_PRIORITY) {
+            p_asset->age++;
+        }
+        // Ties go to the asset waiting longer.
+        if (NULL == p_next || priority > priority_max || (priority == priority_max && p_asset->age > p_next->age)) {
+            p_next = p_asset;
+            priority_max = priority;
+        }
+    }
+    if (NULL == p_next) {
+        return 0;
+    }
+
+    p_next->age = 0;
+    p_next->changed = false;
+    return beacon_payload_encode(p_buf, 0, &p_next->info, &p_next->fix, 1);
+}
+
+size_t fleet_count(void)
+{
+    return m_count;
+}
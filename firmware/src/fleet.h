@@ -0,0 +1,65 @@
+/*******************************************************************************
+* @brief    Asset table of a fleet gateway and its advertising schedule.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*
+* A gateway advertises the positions of many assets that a host sends it as
+* $PBCA sentences, see command_format.h. Every advertising event carries one
+* asset, the payload is layout version 2 with the asset ID, see
+* beacon_payload.h.
+*
+* The asset to advertise is the one with the highest priority: the number of
+* advertising events since it was last advertised, plus FLEET_CHANGED_PRIORITY
+* if its position changed since. A changed asset thus goes out within a few
+* events, and an unchanged one is not starved: with N assets, none waits more
+* than N + FLEET_CHANGED_PRIORITY events, whatever the others do.
+*******************************************************************************/
+#pragma once
+
+#include "command_format.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef FLEET_ASSETS_MAX
+#define FLEET_ASSETS_MAX 32 /**< Assets in the table, the least recently updated one is replaced. */
+#endif
+
+#ifndef FLEET_CHANGED_PRIORITY
+#define FLEET_CHANGED_PRIORITY 8 /**< Head start of an asset whose position changed, advertising events. */
+#endif
+
+/*
+ *@brief Function for emptying the asset table.
+ */
+void fleet_init(void);
+
+/*
+ *@brief Function for storing the position of an asset.
+ *
+ * @details An unknown asset takes a free entry, or the entry of the asset updated
+ *          least recently. Every update starts a new sequence number of the asset.
+ */
+void fleet_update(asset_update_t const* p_update);
+
+/*
+ *@brief Function for encoding the payload of the next advertising event.
+ *
+ * @param[out]  p_buf   Output buffer of BEACON_PAYLOAD_ASSET_LEN(0) bytes.
+ *
+ * @return Number of bytes written, 0 if the table is empty.
+ */
+size_t fleet_payload_next(uint8_t* p_buf);
+
+/*
+ *@brief Function for getting the number of assets in the table.
+ */
+size_t fleet_count(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,258 @@
+/*******************************************************************************
+* @brief    Fixed-point constant-velocity Kalman filter of the beacon position.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#include "kalman.h"
+
+#include <stddef.h>
+
+#define MM_PER_COORD_Q16 729543 /**< Length of 1e-7 degree of latitude, 11.132 mm, Q16. */
+#define COORD_PER_TURN 3600000000LL /**< 360 degree in 1e-7 degree. */
+#define COORD_PER_DECIDEGREE 1000000 /**< 0.1 degree in 1e-7 degree. */
+#define REFERENCE_RANGE_MM 5000000 /**< The reference point is moved to the beacon when it is further, mm. */
+#define VEL_UNKNOWN_VAR 100000000LL /**< Velocity variance without a velocity measurement, (10 m/s)^2. */
+
+#define POS_VAR ((int64_t)KALMAN_POS_NOISE_MM * KALMAN_POS_NOISE_MM) /**< Position measurement variance, mm^2. */
+#define VEL_VAR ((int64_t)KALMAN_VEL_NOISE_MMPS * KALMAN_VEL_NOISE_MMPS) /**< Velocity measurement variance, mm^2/s^2. */
+#define ACCEL_VAR ((int64_t)KALMAN_ACCEL_NOISE_MMPS2 * KALMAN_ACCEL_NOISE_MMPS2) /**< Process noise, mm^2/s^4. */
+
+/*
+ *@brief Struct that contains the filter of one axis.
+ */
+typedef struct {
+    int32_t pos; /**< Position relative to the reference point, mm. */
+    int32_t vel; /**< Velocity, mm/s. */
+    int64_t p00; /**< Position variance, mm^2. */
+    int64_t p01; /**< Position-velocity covariance, mm^2/s. */
+    int64_t p11; /**< Velocity variance, mm^2/s^2. */
+} axis_t;
+
+enum {
+    AXIS_EAST,
+    AXIS_NORTH,
+    AXIS_COUNT
+};
+
+static const int16_t m_sin_table[91] = { /**< sin() of 0..90 degree, Q15. */
+    0, 572, 1144, 1715, 2286, 2856, 3425, 3993, 4560, 5126,
+    5690, 6252, 6813, 7371, 7927, 8481, 9032, 9580, 10126, 10668,
+    11207, 11743, 12275, 12803, 13328, 13848, 14364, 14876, 15383, 15886,
+    16383, 16876, 17364, 17846, 18323, 18794, 19260, 19720, 20173, 20621,
+    21062, 21497, 21925, 22347, 22762, 23170, 23571, 23964, 24351, 24730,
+    25101, 25465, 25821, 26169, 26509, 26841, 27165, 27481, 27788, 28087,
+    28377, 28659, 28932, 29196, 29451, 29697, 29934, 30162, 30381, 30591,
+    30791, 30982, 31163, 31335, 31498, 31650, 31794, 31927, 32051, 32165,
+    32269, 32364, 32448, 32523, 32587, 32642, 32687, 32722, 32747, 32762,
+    32767
+};
+
+static bool m_valid = false; /**< A fix has been applied. */
+static uint32_t m_time_ms = 0; /**< Time of the last fix. */
+static int32_t m_ref_latitude = 0; /**< Reference point, 1e-7 degree. */
+static int32_t m_ref_longitude = 0; /**< Reference point, 1e-7 degree. */
+static int32_t m_east_q16 = MM_PER_COORD_Q16; /**< Length of 1e-7 degree of longitude at the reference point, Q16. */
+static axis_t m_axis[AXIS_COUNT]; /**< East and north filters. */
+
+/*
+ *@brief Function for getting sin() of an angle in 0.1 degree, Q15.
+ */
+static int32_t sin_q15(int32_t angle)
+{
+    int32_t sign = 1;
+
+    angle %= 3600;
+    if (angle < 0) {
+        angle += 3600;
+    }
+    if (angle >= 1800) {
+        angle -= 1800;
+        sign = -1;
+    }
+    if (angle > 900) {
+        angle = 1800 - angle;
+    }
+
+    int32_t idx = angle / 10;
+    int32_t value = m_sin_table[idx];
+    if (idx < 90) {
+        value += (m_sin_table[idx + 1] - value) * (angle % 10) / 10;
+    }
+    return sign * value;
+}
+
+static int32_t cos_q15(int32_t angle)
+{
+    return sin_q15(angle + 900);
+}
+
+static int32_t clamp_int32(int64_t value, int32_t limit)
+{
+    if (value > limit) {
+        return limit;
+    }
+    if (value < -limit) {
+        return -limit;
+    }
+    return (int32_t)value;
+}
+
+/*
+ *@brief Function for wrapping a longitude difference or value to -180..180 degree.
+ */
+static int64_t longitude_wrap(int64_t longitude)
+{
+    if (longitude > COORD_PER_TURN / 2) {
+        longitude -= COORD_PER_TURN;
+    } else if (longitude < -COORD_PER_TURN / 2) {
+        longitude += COORD_PER_TURN;
+    }
+    return longitude;
+}
+
+static void reference_set(int32_t latitude, int32_t longitude)
+{
+    m_ref_latitude = latitude;
+    m_ref_longitude = longitude;
+    m_east_q16 = (int32_t)(((int64_t)MM_PER_COORD_Q16 * cos_q15(latitude / COORD_PER_DECIDEGREE)) >> 15);
+    if (m_east_q16 < 1) {
+        m_east_q16 = 1; // Pole
+    }
+}
+
+static void to_local(int32_t latitude, int32_t longitude, int64_t* p_east, int64_t* p_north)
+{
+    *p_north = ((int64_t)(latitude - m_ref_latitude) * MM_PER_COORD_Q16 + 0x8000) >> 16;
+    *p_east = (longitude_wrap((int64_t)longitude - m_ref_longitude) * m_east_q16 + 0x8000) >> 16;
+}
+
+static void to_global(int64_t east, int64_t north, int32_t* p_latitude, int32_t* p_longitude)
+{
+    *p_latitude = (int32_t)(m_ref_latitude + (north << 16) / MM_PER_COORD_Q16);
+    *p_longitude = (int32_t)longitude_wrap(m_ref_longitude + (east << 16) / m_east_q16);
+}
+
+static void axis_reset(axis_t* p_axis, int32_t pos, bool has_velocity, int32_t vel)
+{
+    p_axis->pos = pos;
+    p_axis->vel = has_velocity ? vel : 0;
+    p_axis->p00 = POS_VAR;
+    p_axis->p01 = 0;
+    p_axis->p11 = has_velocity ? VEL_VAR : VEL_UNKNOWN_VAR;
+}
+
+/*
+ *@brief Function for propagating an axis dt_ms ahead, dt_ms is at most KALMAN_RESET_GAP_MS.
+ *
+ * @details F = [1 dt; 0 1], Q = ACCEL_VAR * [dt^4/4 dt^3/2; dt^3/2 dt^2].
+ */
+static void axis_predict(axis_t* p_axis, int64_t dt_ms)
+{
+    int64_t q11 = ACCEL_VAR * dt_ms * dt_ms / 1000000;
+
+    p_axis->pos = clamp_int32(p_axis->pos + p_axis->vel * dt_ms / 1000, INT32_MAX);
+    p_axis->p00 += 2 * p_axis->p01 * dt_ms / 1000 + p_axis->p11 * dt_ms * dt_ms / 1000000 + q11 * dt_ms * dt_ms / 4000000;
+    p_axis->p01 += p_axis->p11 * dt_ms / 1000 + q11 * dt_ms / 2000;
+    p_axis->p11 += q11;
+}
+
+/*
+ *@brief Function for applying a scalar measurement of the position (state 0) or velocity (state 1).
+ */
+static void axis_measure(axis_t* p_axis, int state, int64_t value, int64_t variance)
+{
+    int64_t row0 = (0 == state) ? p_axis->p00 : p_axis->p01;
+    int64_t row1 = (0 == state) ? p_axis->p01 : p_axis->p11;
+    int64_t innovation = value - ((0 == state) ? p_axis->pos : p_axis->vel);
+    int64_t s = ((0 == state) ? p_axis->p00 : p_axis->p11) + variance;
+    int64_t k0 = (row0 << 16) / s; // Q16
+    int64_t k1 = (row1 << 16) / s; // Q16, 1/s for the position measurement
+
+    p_axis->pos = clamp_int32(p_axis->pos + ((k0 * innovation) >> 16), INT32_MAX);
+    p_axis->vel = clamp_int32(p_axis->vel + ((k1 * innovation) >> 16), KALMAN_SPEED_MAX_MMPS);
+    p_axis->p00 -= (k0 * row0) >> 16;
+    p_axis->p01 -= (k0 * row1) >> 16;
+    p_axis->p11 -= (k1 * row1) >> 16;
+    if (p_axis->p00 < 1) {
+        p_axis->p00 = 1;
+    }
+    if (p_axis->p11 < 1) {
+        p_axis->p11 = 1;
+    }
+}
+
+void kalman_init(void)
+{
+    m_valid = false;
+}
+
+void kalman_update(uint32_t time_ms, int32_t latitude, int32_t longitude, bool has_velocity, uint32_t speed_mmps, int32_t course)
+{
+    int64_t speed = (speed_mmps < KALMAN_SPEED_MAX_MMPS) ? speed_mmps : KALMAN_SPEED_MAX_MMPS;
+    int32_t vel[AXIS_COUNT];
+    int64_t pos[AXIS_COUNT];
+    uint32_t dt_ms = time_ms - m_time_ms;
+
+    vel[AXIS_EAST] = (int32_t)((speed * sin_q15(course)) >> 15);
+    vel[AXIS_NORTH] = (int32_t)((speed * cos_q15(course)) >> 15);
+    m_time_ms = time_ms;
+
+    if (m_valid && dt_ms <= KALMAN_RESET_GAP_MS) {
+        for (size_t i = 0; i < AXIS_COUNT; i++) {
+            axis_predict(&m_axis[i], dt_ms);
+        }
+        to_local(latitude, longitude, &pos[AXIS_EAST], &pos[AXIS_NORTH]);
+        if (pos[AXIS_EAST] - m_axis[AXIS_EAST].pos > KALMAN_RESET_DISTANCE_MM
+            || m_axis[AXIS_EAST].pos - pos[AXIS_EAST] > KALMAN_RESET_DISTANCE_MM
+            || pos[AXIS_NORTH] - m_axis[AXIS_NORTH].pos > KALMAN_RESET_DISTANCE_MM
+            || m_axis[AXIS_NORTH].pos - pos[AXIS_NORTH] > KALMAN_RESET_DISTANCE_MM) {
+            m_valid = false; // Jump, e.g. a replayed log restarted elsewhere
+        }
+    } else {
+        m_valid = false;
+    }
+
+    if (!m_valid) {
+        reference_set(latitude, longitude);
+        for (size_t i = 0; i < AXIS_COUNT; i++) {
+            axis_reset(&m_axis[i], 0, has_velocity, vel[i]);
+        }
+        m_valid = true;
+        return;
+    }
+
+    for (size_t i = 0; i < AXIS_COUNT; i++) {
+        axis_measure(&m_axis[i], 0, pos[i], POS_VAR);
+        if (has_velocity) {
+            axis_measure(&m_axis[i], 1, vel[i], VEL_VAR);
+        }
+    }
+
+    if (m_axis[AXIS_EAST].pos > REFERENCE_RANGE_MM || m_axis[AXIS_EAST].pos < -REFERENCE_RANGE_MM
+        || m_axis[AXIS_NORTH].pos > REFERENCE_RANGE_MM || m_axis[AXIS_NORTH].pos < -REFERENCE_RANGE_MM) {
+        int32_t ref_latitude, ref_longitude;
+        to_global(m_axis[AXIS_EAST].pos, m_axis[AXIS_NORTH].pos, &ref_latitude, &ref_longitude);
+        reference_set(ref_latitude, ref_longitude);
+        m_axis[AXIS_EAST].pos = 0;
+        m_axis[AXIS_NORTH].pos = 0;
+    }
+}
+
+bool kalman_position(uint32_t time_ms, int32_t* p_latitude, int32_t* p_longitude)
+{
+    int32_t dt_ms = (int32_t)(time_ms - m_time_ms);
+
+    if (!m_valid) {
+        return false;
+    }
+    if (dt_ms < 0) {
+        dt_ms = 0;
+    } else if (dt_ms > KALMAN_PREDICT_MAX_MS) {
+        dt_ms = KALMAN_PREDICT_MAX_MS;
+    }
+
+    to_global((int64_t)m_axis[AXIS_EAST].pos + (int64_t)m_axis[AXIS_EAST].vel * dt_ms / 1000,
+        (int64_t)m_axis[AXIS_NORTH].pos + (int64_t)m_axis[AXIS_NORTH].vel * dt_ms / 1000,
+        p_latitude, p_longitude);
+    return true;
+}
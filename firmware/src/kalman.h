@@ -0,0 +1,83 @@
+/*******************************************************************************
+* @brief    Fixed-point constant-velocity Kalman filter of the beacon position.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*
+* Fixes are projected to a local east/north plane in mm around a reference
+* point that follows the beacon. Each axis is an independent two-state filter
+* (position mm, velocity mm/s) with a white acceleration process model;
+* RMC position and speed/course are applied as two scalar measurements, so the
+* update needs no matrix inversion. All arithmetic is integer: int32 state,
+* int64 covariance and Q16 gains.
+*
+* Between fixes the position is extrapolated with the filtered velocity, at
+* most KALMAN_PREDICT_MAX_MS ahead, which bounds the error when fixes stop.
+*******************************************************************************/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef KALMAN_POS_NOISE_MM
+#define KALMAN_POS_NOISE_MM 2500 /**< Standard deviation of a GNSS position, per axis, mm. */
+#endif
+
+#ifndef KALMAN_VEL_NOISE_MMPS
+#define KALMAN_VEL_NOISE_MMPS 500 /**< Standard deviation of the GNSS velocity, per axis, mm/s. */
+#endif
+
+#ifndef KALMAN_ACCEL_NOISE_MMPS2
+#define KALMAN_ACCEL_NOISE_MMPS2 2000 /**< Standard deviation of the unmodelled acceleration, mm/s^2. */
+#endif
+
+#ifndef KALMAN_RESET_GAP_MS
+#define KALMAN_RESET_GAP_MS 10000 /**< Fixes further apart restart the filter from the new fix. */
+#endif
+
+#ifndef KALMAN_RESET_DISTANCE_MM
+#define KALMAN_RESET_DISTANCE_MM 500000 /**< A fix this far from the prediction restarts the filter, per axis. */
+#endif
+
+#ifndef KALMAN_PREDICT_MAX_MS
+#define KALMAN_PREDICT_MAX_MS 2000 /**< Longest extrapolation after the last fix. */
+#endif
+
+#ifndef KALMAN_SPEED_MAX_MMPS
+#define KALMAN_SPEED_MAX_MMPS 150000 /**< Speeds above are clamped, mm/s (540 km/h). */
+#endif
+
+/*
+ *@brief Function for resetting the filter, the next fix starts it again.
+ */
+void kalman_init(void);
+
+/*
+ *@brief Function for applying a fix.
+ *
+ * @param[in]   time_ms     Time of the fix, ms, any monotonic clock that wraps at 2^32.
+ * @param[in]   latitude    Latitude, 1e-7 degree.
+ * @param[in]   longitude   Longitude, 1e-7 degree.
+ * @param[in]   has_velocity Speed and course are valid.
+ * @param[in]   speed_mmps  Speed over ground, mm/s.
+ * @param[in]   course      Course over ground, 0.1 degree.
+ */
+void kalman_update(uint32_t time_ms, int32_t latitude, int32_t longitude, bool has_velocity, uint32_t speed_mmps, int32_t course);
+
+/*
+ *@brief Function for getting the estimated position.
+ *
+ * @param[in]   time_ms     Time of the estimate, the time of the last fix gives the filtered fix.
+ * @param[out]  p_latitude  Latitude, 1e-7 degree.
+ * @param[out]  p_longitude Longitude, 1e-7 degree.
+ *
+ * @return false before the first fix.
+ */
+bool kalman_position(uint32_t time_ms, int32_t* p_latitude, int32_t* p_longitude);
+
+#ifdef __cplusplus
+}
+#endif
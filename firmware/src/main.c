@@ -3,13 +3,24 @@
 * @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
 * @date     July 23, 2019
 *******************************************************************************/
+#include "adv_interval.h"
 #include "app_timer.h"
-#include "app_uart.h"
+#include "beacon_payload.h"
+#include "command_format.h"
+#include "fleet.h"
 
 #include "ble_advdata.h"
 #include "ble_radio_notification.h"
-#include "bsp.h"
+#include "boards.h"
 #include "minmea/minmea.h"
+#include "nrf_libuarte_async.h"
+#if BEACON_UART_POWER_GATING
+#include "nrf_drv_gpiote.h"
+#endif
+#if BEACON_SCANNABLE
+#include "nrfx_saadc.h"
+#endif
+#include "nmea_queue.h"
 #include "nordic_common.h"
 #include "nrf_log.h"
 #include "nrf_log_ctrl.h"
@@ -18,39 +29,282 @@
 #include "nrf_sdh.h"
 #include "nrf_sdh_ble.h"
 #include "nrf_soc.h"
+#if BEACON_CONNECTABLE
+#include "nrf_ble_gatt.h"
+#include "track_service.h"
+#endif
+#include "kalman.h"
+#include "profile.h"
+#include "track_log.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define DEVICE_NAME "tracker"
-#define APP_COMPANY_IDENTIFIER 0xFFFF // For testing according Bluetooth SIG
+#define APP_COMPANY_IDENTIFIER BEACON_COMPANY_IDENTIFIER
 
 #define APP_BLE_CONN_CFG_TAG 1 /**< A tag identifying the SoftDevice BLE configuration. */
-#define NON_CONNECTABLE_ADV_INTERVAL MSEC_TO_UNITS(1000, UNIT_0_625_MS) /**< The advertising interval for non-connectable advertisement (100 ms). This value can vary between 100ms to 10.24s). */
+#define APP_BLE_OBSERVER_PRIO 3 /**< Application's BLE observer priority, after nrf_ble_gatt and the track service. */
+
+#ifndef BEACON_ADV_EXTENDED
+#define BEACON_ADV_EXTENDED 0 /**< Use BLE 5 extended advertising carrying a long fix history. */
+#endif
+
+#ifndef BEACON_ADV_CODED_PHY
+#define BEACON_ADV_CODED_PHY 0 /**< Advertise on LE Coded PHY (long range), needs extended advertising. */
+#endif
+
+#ifndef BEACON_CONNECTABLE
+#define BEACON_CONNECTABLE 0 /**< Accept connections for the track log download, see track_service.h. */
+#endif
+
+#ifndef BEACON_KALMAN_FILTER
+#define BEACON_KALMAN_FILTER 0 /**< Smooth fixes and advertise predicted positions between them, see kalman.h. */
+#endif
+
+#ifndef BEACON_UART_POWER_GATING
+#define BEACON_UART_POWER_GATING 0 /**< Power the UART down between NMEA bursts, see uart_power_process(). */
+#endif
+
+#ifndef BEACON_UART_BAUDRATE
+#define BEACON_UART_BAUDRATE 115200 /**< NMEA input baud rate, up to 1000000, see uart_baudrate(). */
+#endif
+
+#ifndef BEACON_UART_HWFC
+#define BEACON_UART_HWFC 0 /**< RTS/CTS flow control on the NMEA input, RTS_PIN_NUMBER and CTS_PIN_NUMBER. */
+#endif
+
+#ifndef BEACON_COMMAND_CHANNEL
+#define BEACON_COMMAND_CHANNEL 0 /**< Accept tuning commands on the NMEA input and answer them, see command_format.h. */
+#endif
+
+#ifndef BEACON_FLEET
+#define BEACON_FLEET 0 /**< Advertise the positions of many assets sent over UART instead of the own fix, see fleet.h. */
+#endif
+
+#ifndef BEACON_SCANNABLE
+#define BEACON_SCANNABLE 0 /**< Answer active scanners with altitude, DOPs, satellites, battery and build in the scan response. */
+#endif
+
+#ifndef BEACON_FIX_RESTORE
+#define BEACON_FIX_RESTORE 0 /**< Advertise the last known fix from retained RAM or the track log right after reset. */
+#endif
+
+#ifndef BEACON_FW_BUILD
+#define BEACON_FW_BUILD 0 /**< Firmware build in the scan response, e.g. -DBEACON_FW_BUILD=$(git rev-list --count HEAD). */
+#endif
+
+#if BEACON_CONNECTABLE
+#define MIN_CONN_INTERVAL MSEC_TO_UNITS(15, UNIT_1_25_MS) /**< Minimum acceptable connection interval. */
+#define MAX_CONN_INTERVAL MSEC_TO_UNITS(50, UNIT_1_25_MS) /**< Maximum acceptable connection interval, long events carry more packets. */
+#define SLAVE_LATENCY 0 /**< Slave latency. */
+#define CONN_SUP_TIMEOUT MSEC_TO_UNITS(4000, UNIT_10_MS) /**< Connection supervisory time-out. */
+#define HVN_TX_QUEUE_SIZE 16 /**< Notifications queued in the SoftDevice, enough to fill a long connection event. */
+#endif
+
+#if BEACON_ADV_CODED_PHY && !BEACON_ADV_EXTENDED
+#error "LE Coded PHY is only available with extended advertising, set BEACON_ADV_EXTENDED"
+#endif
+
+#if BEACON_ADV_CODED_PHY && defined(S132)
+#error "nRF52832 and S132 do not support LE Coded PHY, it needs nRF52840 with S140"
+#endif
+
+#if BEACON_UART_BAUDRATE > 1000000
+#error "The UARTE runs at 1 Mbaud at most"
+#endif
+
+#if BEACON_UART_HWFC && BEACON_UART_POWER_GATING
+#error "With flow control the host holds its data while the UART is down and no RX edge wakes it; clear BEACON_UART_POWER_GATING"
+#endif
+
+#if BEACON_SCANNABLE && BEACON_ADV_EXTENDED
+#error "Extended scannable adverts carry no advertising data, the position would go to the scan response; clear BEACON_SCANNABLE"
+#endif
+
+#if BEACON_FLEET && BEACON_CONNECTABLE
+#error "A fleet gateway has no track log of its own to download, clear BEACON_CONNECTABLE"
+#endif
+
+#if BEACON_FLEET && BEACON_FIX_RESTORE
+#error "A fleet gateway has no fix of its own to restore, clear BEACON_FIX_RESTORE"
+#endif
+
+#if BEACON_FLEET && BEACON_SCANNABLE
+#error "The scan response describes the beacon's own fix, not the assets of a fleet gateway; clear BEACON_SCANNABLE"
+#endif
+
+#if BEACON_ADV_EXTENDED
+#define ADV_HISTORY_LEN BEACON_PAYLOAD_HISTORY_EXTENDED_LEN /**< Previous fixes in every advert. */
+#define ADV_DATA_SIZE_MAX BLE_GAP_ADV_SET_DATA_SIZE_EXTENDED_MAX_SUPPORTED /**< Size of an advertising data buffer. */
+#else
+#define ADV_HISTORY_LEN BEACON_PAYLOAD_HISTORY_LEN
+#define ADV_DATA_SIZE_MAX BLE_GAP_ADV_SET_DATA_SIZE_MAX
+#endif
+
+#if BEACON_ADV_EXTENDED && BEACON_CONNECTABLE
+#define ADV_TYPE BLE_GAP_ADV_TYPE_EXTENDED_CONNECTABLE_NONSCANNABLE_UNDIRECTED /**< Advertising PDU type. */
+#elif BEACON_ADV_EXTENDED
+#define ADV_TYPE BLE_GAP_ADV_TYPE_EXTENDED_NONCONNECTABLE_NONSCANNABLE_UNDIRECTED
+#elif BEACON_CONNECTABLE
+#define ADV_TYPE BLE_GAP_ADV_TYPE_CONNECTABLE_SCANNABLE_UNDIRECTED
+#elif BEACON_SCANNABLE
+#define ADV_TYPE BLE_GAP_ADV_TYPE_NONCONNECTABLE_SCANNABLE_UNDIRECTED
+#else
+#define ADV_TYPE BLE_GAP_ADV_TYPE_NONCONNECTABLE_NONSCANNABLE_UNDIRECTED
+#endif
+
+#if BEACON_ADV_CODED_PHY
+#define ADV_PHY BLE_GAP_PHY_CODED /**< Primary and secondary advertising PHY. */
+#else
+#define ADV_PHY BLE_GAP_PHY_1MBPS
+#endif
+
+#if BEACON_FLEET
+#define ADV_PAYLOAD_LEN BEACON_PAYLOAD_ASSET_LEN(0) /**< Length of the advertised payload, one asset without history. */
+#else
+#define ADV_PAYLOAD_LEN BEACON_PAYLOAD_LEN(m_adv_history)
+#endif
+
+#ifndef FLEET_ADV_INTERVAL_MS
+#define FLEET_ADV_INTERVAL_MS 100 /**< Advertising interval of a fleet gateway, one asset per event. */
+#endif
 
 #define DEAD_BEEF 0xDEADBEEF /**< Value used as error code on stack dump, can be used to identify stack location on stack unwind. */
 
-#define UART_TX_BUF_SIZE 256 /**< UART TX buffer size. */
-#define UART_RX_BUF_SIZE 256 /**< UART RX buffer size. */
-#define NMEA_BUFFER 82 /**< NMEA buffer size. */
+#define UART_RX_BUF_SIZE 255 /**< UART RX DMA buffer size, limited by the 8-bit EasyDMA MAXCNT on nRF52832. */
+#define UART_RX_BUF_COUNT 3 /**< Number of UART RX DMA buffers. */
+#define PREDICT_INTERVAL_MS ADV_INTERVAL_MOVING_MS /**< Payload refresh with a predicted position between fixes while moving. */
+#define TICKS_TO_MS(ticks) ((uint32_t)((uint64_t)(ticks) * 1000 * (APP_TIMER_CONFIG_RTC_FREQUENCY + 1) / APP_TIMER_CLOCK_FREQ)) /**< app_timer counter ticks to ms. */
+
+#define UART_RX_TIMEOUT_US 1000 /**< Idle line time after which received data is handed over (about 11 characters at 115200, 100 at 1 Mbaud). */
+
+#ifndef UART_IDLE_OFF_MS
+#define UART_IDLE_OFF_MS 50 /**< Silence after a burst before the UART is powered down. */
+#endif
+#define UART_WAKE_GUARD_MS 20 /**< The UART is powered up this long before the next expected burst. */
+#define UART_BURST_PERIOD_MAX_MS 5000 /**< Bursts further apart are not scheduled, their RX edge wakes the UART. */
+
+#define UART_TX_QUEUE_SIZE 4 /**< Answers and latency reports waiting for the UART TX line. */
+#define ADV_INTERVAL_CMD_MIN_MS 20 /**< Shortest advertising interval accepted by the INT command. */
+#define ADV_INTERVAL_CMD_MAX_MS 10240 /**< Longest advertising interval accepted by the INT command. */
+#define TX_POWER_CMD_MIN_DBM -40 /**< Lowest TX power accepted by the TXP command, the radio checks the step. */
+#define TX_POWER_CMD_MAX_DBM 4
+
+#define BATTERY_MEAS_INTERVAL_MS 60000 /**< Battery voltage is measured this often for the scan response. */
+#define BATTERY_MV_PER_LSB_Q10 3600 /**< SAADC VDD input, 10-bit, gain 1/6, 0.6 V reference: mV per LSB, Q10. */
+
+NRF_LIBUARTE_ASYNC_DEFINE(m_libuarte, 0, 1, 2, NRF_LIBUARTE_PERIPHERAL_NOT_USED, UART_RX_BUF_SIZE, UART_RX_BUF_COUNT); /**< UARTE0 with TIMER1 counting bytes and RTC2 detecting idle line. */
 
 static ble_gap_adv_params_t m_adv_params; /**< Parameters to be passed to the stack when starting advertising. */
 static uint8_t m_adv_handle = BLE_GAP_ADV_SET_HANDLE_NOT_SET; /**< Advertising handle used to identify an advertising set. */
-static uint8_t m_enc_advdata[BLE_GAP_ADV_SET_DATA_SIZE_MAX]; /**< Buffer for storing an encoded advertising set. */
+static uint8_t m_enc_advdata[2][ADV_DATA_SIZE_MAX]; /**< Two buffers for storing an encoded advertising set, one is owned by the SoftDevice. */
+static uint8_t m_adv_buf_idx = 0; /**< Index of the buffer currently used by the SoftDevice. */
+static uint16_t m_adv_pos_offset = 0; /**< Offset of the position data inside the encoded advertising set. */
+#if BEACON_SCANNABLE
+static uint8_t m_enc_scan_rsp[2][BLE_GAP_ADV_SET_DATA_SIZE_MAX]; /**< Scan response buffers, used in turns with the advertising data buffers. */
+static uint16_t m_scan_rsp_detail_offset = 0; /**< Offset of the detail payload inside the encoded scan response. */
+static beacon_detail_t m_detail = { .altitude = BEACON_ALTITUDE_UNKNOWN, .satellites = BEACON_DETAIL_UNKNOWN,
+    .quality = BEACON_DETAIL_UNKNOWN, .pdop = BEACON_DETAIL_UNKNOWN, .hdop = BEACON_DETAIL_UNKNOWN,
+    .vdop = BEACON_DETAIL_UNKNOWN, .build = BEACON_FW_BUILD }; /**< Detail of the newest fix, GGA and GSA fields, and the beacon. */
+static uint8_t m_detail_payload[BEACON_DETAIL_LEN]; /**< Encoded detail payload, see beacon_payload.h. */
+APP_TIMER_DEF(m_battery_timer); /**< Measures the battery voltage every BATTERY_MEAS_INTERVAL_MS. */
+static volatile bool m_battery_pending = true; /**< Battery timer expired, measured in the main loop; first measurement at start. */
+#endif
 /*
- *@brief Struct that contains pointers to the encoded advertising data. 
+ *@brief Structs that contain pointers to the encoded advertising data. 
+ *
+ * @details The SoftDevice accepts new advertising data while advertising only if it is
+ *          passed in a different buffer, so the buffers are used in turns; with a scan
+ *          response its buffer goes along.
  */
-static ble_gap_adv_data_t m_adv_data = {
-    .adv_data = { .p_data = m_enc_advdata, .len = BLE_GAP_ADV_SET_DATA_SIZE_MAX },
-    .scan_rsp_data = { .p_data = NULL, .len = 0 }
+static ble_gap_adv_data_t m_adv_data[2] = {
+    { .adv_data = { .p_data = m_enc_advdata[0], .len = ADV_DATA_SIZE_MAX },
+        .scan_rsp_data = { .p_data = NULL, .len = 0 } },
+    { .adv_data = { .p_data = m_enc_advdata[1], .len = ADV_DATA_SIZE_MAX },
+        .scan_rsp_data = { .p_data = NULL, .len = 0 } }
 };
 
+static beacon_fix_t m_fix_history[ADV_HISTORY_LEN + 1]; /**< Recent fixes, newest first. */
+static uint8_t m_fix_count = 0; /**< Number of valid entries in m_fix_history. */
+// A fleet gateway advertises asset 0 without a fix until the first asset arrives.
+static beacon_info_t m_fix_info = { .seq = 0, .time = BEACON_TIME_UNKNOWN, .speed = BEACON_SPEED_UNKNOWN,
+    .asset = BEACON_FLEET ? 0 : BEACON_ASSET_NONE }; /**< Sequence number, time, speed and course of the newest fix. */
+static uint8_t m_beacon_info[BEACON_PAYLOAD_ASSET_LEN(ADV_HISTORY_LEN)]; /**< Encoded position payload, see beacon_payload.h. */
+static uint8_t m_adv_history = ADV_HISTORY_LEN; /**< Previous fixes carried in the payload, up to ADV_HISTORY_LEN. */
+
+#if BEACON_FIX_RESTORE
+#define FIX_RETAINED_MAGIC 0x46495852 /**< "FIXR", m_fix_retained was written by this firmware. */
+
+/*
+ *@brief Struct that contains the newest fix, kept in RAM that the startup code does not clear.
+ */
+typedef struct {
+    uint32_t magic; /**< FIX_RETAINED_MAGIC. */
+    beacon_info_t info; /**< Sequence number, time, speed and course of the fix. */
+    beacon_fix_t fix; /**< Position of the fix. */
+    uint32_t check; /**< Checksum of the fields above, RAM is random after a power cycle. */
+} fix_retained_t;
+
+static fix_retained_t m_fix_retained __attribute__((section(".non_init"))); /**< Survives a reset other than power-on. */
+#endif
+
 /*
- *@brief Struct that contains position data. 
+ *@brief Struct that contains the newest parsed fix waiting for the next advertising event.
+ *
+ * @details Latest wins: a fix parsed before the previous one was advertised overwrites it,
+ *          so the work after parsing is done once per advertising event, not once per fix.
  */
-struct PositionDataStr {
-    int32_t latitude;
-    int32_t longitude;
-} __attribute__((packed)) m_beacon_info = { 0, 0 };
+typedef struct {
+    struct minmea_sentence_rmc frame; /**< Parsed RMC sentence with a valid fix. */
+    uint32_t speed_mmps; /**< Speed over ground, mm/s. */
+    uint32_t time; /**< app_timer counter when the sentence was received. */
+    bool full; /**< A fix is waiting. */
+} fix_mailbox_t;
+
+static fix_mailbox_t m_fix_mailbox = { .full = false }; /**< Written and read in the main loop only. */
+static volatile bool m_radio_idle = false; /**< A radio event has ended, the payload may be refreshed once. */
+static volatile uint32_t m_uart_errors = 0; /**< UART errors since boot, counted in the interrupt. */
+static uint32_t m_nmea_lines = 0; /**< Sentences received since boot, empty lines and fragments not counted. */
+
+#if BEACON_KALMAN_FILTER
+APP_TIMER_DEF(m_predict_timer); /**< Refreshes the payload between fixes while moving. */
+static volatile bool m_predict_pending = false; /**< Predict timer expired, the payload is refreshed after the next radio event. */
+static bool m_fix_time_valid = false; /**< The newest fix went through the filter, m_fix_time_ms is valid. */
+static uint32_t m_fix_time_ms = 0; /**< UTC time of the newest fix, ms, wraps at 2^32. */
+static uint32_t m_fix_ticks = 0; /**< app_timer counter when the newest fix was handled. */
+#endif
+
+#if BEACON_UART_POWER_GATING
+APP_TIMER_DEF(m_uart_idle_timer); /**< Powers the UART down UART_IDLE_OFF_MS after the last received data. */
+APP_TIMER_DEF(m_uart_wake_timer); /**< Powers the UART up ahead of the next expected burst. */
+static volatile bool m_uart_rx = false; /**< Data received since the main loop last looked. */
+static volatile bool m_uart_idle = false; /**< Idle timer expired. */
+static volatile bool m_uart_wake = false; /**< RX edge or wake timer while the UART is down. */
+static bool m_uart_on = false; /**< The UART is powered and receiving. */
+static bool m_uart_burst = false; /**< A burst is being received. */
+static bool m_burst_timed = false; /**< m_burst_ticks is valid. */
+static uint32_t m_burst_ticks = 0; /**< app_timer counter at the start of the last burst. */
+static uint32_t m_burst_period_ms = 0; /**< Time between the last two burst starts, 0 if unknown. */
+#endif
+
+#if BEACON_COMMAND_CHANNEL
+static char m_tx_queue[UART_TX_QUEUE_SIZE][COMMAND_LINE_MAX]; /**< Sentences to send, the oldest is owned by libuarte while sent. */
+static uint8_t m_tx_len[UART_TX_QUEUE_SIZE]; /**< Length of every queued sentence. */
+static uint8_t m_tx_head = 0; /**< Oldest queued sentence. */
+static uint8_t m_tx_count = 0; /**< Number of queued sentences. */
+static bool m_tx_busy = false; /**< The oldest sentence is being sent. */
+static volatile bool m_tx_done = false; /**< libuarte has sent it. */
+static uint32_t m_interval_override_ms = 0; /**< Advertising interval set by command, 0 for the speed-adaptive interval. */
+static bool m_latency_report = false; /**< Every advertised fix is reported on the UART. */
+static uint32_t m_adv_update_ticks = 0; /**< app_timer counter when the payload was last handed to the SoftDevice. */
+#endif
+
+#if BEACON_CONNECTABLE
+NRF_BLE_GATT_DEF(m_gatt); /**< GATT module instance, negotiates ATT MTU and data length. */
+static uint16_t m_conn_handle = BLE_CONN_HANDLE_INVALID; /**< Handle of the current connection. */
+static volatile bool m_adv_restart = false; /**< Central has disconnected, advertising is restarted from the main loop. */
+#endif
 
 /*
  *@brief Callback function for asserts in the SoftDevice.
@@ -70,40 +324,140 @@ void assert_nrf_callback(uint16_t line_num, const uint8_t* p_file_name)
 }
 
 /*
- *@brief Function for initializing the Advertising functionality.
+ *@brief Function for finding the manufacturer specific payload in encoded advertising data.
  *
- * @details Encodes the required advertising data and passes it to the stack.
- *          Also builds a structure to be passed to the stack when starting advertising.
+ * @param[in]   p_data  Encoded advertising data.
+ * @param[in]   len     Length of the encoded advertising data.
+ *
+ * @return Offset of the first byte after the company identifier, or 0 if not found.
  */
-static void advertising_init(void)
+static uint16_t adv_manuf_data_offset(uint8_t const* p_data, uint16_t len)
+{
+    uint16_t offset = 0;
+
+    while (offset + 1 < len) {
+        uint8_t field_len = p_data[offset];
+        if (0 == field_len) {
+            break;
+        }
+        if (BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA == p_data[offset + 1]) {
+            return offset + 2 + sizeof(uint16_t);
+        }
+        offset += field_len + 1;
+    }
+    return 0;
+}
+
+/*
+ *@brief Function for encoding the advertising data into both buffers, advertising is stopped.
+ *
+ * @details The payload is m_adv_history previous fixes long, which sets the layout.
+ */
+static void advertising_data_encode(void)
 {
     static ble_advdata_t advdata;
     uint32_t err_code;
+#if BEACON_CONNECTABLE
+    uint8_t flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+#else
     uint8_t flags = BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED;
-    ble_gap_conn_sec_mode_t sec_mode;
-
+#endif
     ble_advdata_manuf_data_t manuf_specific_data;
 
     manuf_specific_data.company_identifier = APP_COMPANY_IDENTIFIER;
 
-    manuf_specific_data.data.p_data = (uint8_t*)&m_beacon_info;
-    manuf_specific_data.data.size = sizeof(m_beacon_info);
+    if (0 == m_fix_count) {
+        beacon_fix_t const no_fix = { 0, 0 };
+        beacon_payload_encode(m_beacon_info, m_adv_history, &m_fix_info, &no_fix, 1);
+    } else {
+        beacon_payload_encode(m_beacon_info, m_adv_history, &m_fix_info, m_fix_history, m_fix_count);
+    }
+
+    manuf_specific_data.data.p_data = m_beacon_info;
+    manuf_specific_data.data.size = ADV_PAYLOAD_LEN;
 
     // Build and set advertising data.
     memset(&advdata, 0, sizeof(advdata));
 
-    advdata.name_type = BLE_ADVDATA_SHORT_NAME;
-    advdata.short_name_len = strlen(DEVICE_NAME);
+    // No name: receivers know the payload by company identifier and version, the room
+    // goes to the fix history.
+    advdata.name_type = BLE_ADVDATA_NO_NAME;
     advdata.flags = flags;
     advdata.p_manuf_specific_data = &manuf_specific_data;
 
+    m_adv_data[0].adv_data.len = ADV_DATA_SIZE_MAX;
+    err_code = ble_advdata_encode(&advdata, m_adv_data[0].adv_data.p_data, &m_adv_data[0].adv_data.len);
+    APP_ERROR_CHECK(err_code);
+
+    // Both buffers share the layout, only the position bytes are patched later.
+    memcpy(m_enc_advdata[1], m_enc_advdata[0], m_adv_data[0].adv_data.len);
+    m_adv_data[1].adv_data.len = m_adv_data[0].adv_data.len;
+    m_adv_pos_offset = adv_manuf_data_offset(m_enc_advdata[0], m_adv_data[0].adv_data.len);
+    APP_ERROR_CHECK_BOOL(m_adv_pos_offset != 0);
+    m_adv_buf_idx = 0;
+
+#if BEACON_SCANNABLE
+    // The scan response holds the detail payload and the name the advert has no room for, no flags.
+    static ble_advdata_t srdata;
+    ble_advdata_manuf_data_t detail_data;
+
+    m_detail.seq = m_fix_info.seq;
+    beacon_detail_encode(m_detail_payload, &m_detail);
+    detail_data.company_identifier = APP_COMPANY_IDENTIFIER;
+    detail_data.data.p_data = m_detail_payload;
+    detail_data.data.size = BEACON_DETAIL_LEN;
+
+    memset(&srdata, 0, sizeof(srdata));
+    srdata.name_type = BLE_ADVDATA_SHORT_NAME;
+    srdata.short_name_len = strlen(DEVICE_NAME);
+    srdata.p_manuf_specific_data = &detail_data;
+
+    for (size_t i = 0; i < ARRAY_SIZE(m_adv_data); i++) {
+        m_adv_data[i].scan_rsp_data.p_data = m_enc_scan_rsp[i];
+        m_adv_data[i].scan_rsp_data.len = BLE_GAP_ADV_SET_DATA_SIZE_MAX;
+        err_code = ble_advdata_encode(&srdata, m_adv_data[i].scan_rsp_data.p_data, &m_adv_data[i].scan_rsp_data.len);
+        APP_ERROR_CHECK(err_code);
+    }
+    m_scan_rsp_detail_offset = adv_manuf_data_offset(m_enc_scan_rsp[0], m_adv_data[0].scan_rsp_data.len);
+    APP_ERROR_CHECK_BOOL(m_scan_rsp_detail_offset != 0);
+#endif
+}
+
+/*
+ *@brief Function for getting the advertising interval when no command has set one.
+ */
+static uint32_t advertising_interval_default(void)
+{
+#if BEACON_FLEET
+    return FLEET_ADV_INTERVAL_MS;
+#else
+    return adv_interval_get();
+#endif
+}
+
+/*
+ *@brief Function for initializing the Advertising functionality.
+ *
+ * @details Encodes the required advertising data and passes it to the stack.
+ *          Also builds a structure to be passed to the stack when starting advertising.
+ *          With BEACON_ADV_EXTENDED the payload is sent in an extended advertising PDU on the
+ *          secondary channels, which fits a trajectory of ADV_HISTORY_LEN previous fixes, so a
+ *          receiver that misses a long run of adverts still gets every fix.
+ */
+static void advertising_init(void)
+{
+    uint32_t err_code;
+    ble_gap_conn_sec_mode_t sec_mode;
+
     // Initialize advertising parameters (used when starting advertising).
     memset(&m_adv_params, 0, sizeof(m_adv_params));
 
-    m_adv_params.properties.type = BLE_GAP_ADV_TYPE_NONCONNECTABLE_NONSCANNABLE_UNDIRECTED;
+    m_adv_params.properties.type = ADV_TYPE;
+    m_adv_params.primary_phy = ADV_PHY;
+    m_adv_params.secondary_phy = ADV_PHY;
     m_adv_params.p_peer_addr = NULL; // Undirected advertisement.
     m_adv_params.filter_policy = BLE_GAP_ADV_FP_ANY;
-    m_adv_params.interval = NON_CONNECTABLE_ADV_INTERVAL;
+    m_adv_params.interval = MSEC_TO_UNITS(advertising_interval_default(), UNIT_0_625_MS);
     m_adv_params.duration = 0; // Never time out.
 
     BLE_GAP_CONN_SEC_MODE_SET_OPEN(&sec_mode);
@@ -111,11 +465,39 @@ static void advertising_init(void)
     err_code = sd_ble_gap_device_name_set(&sec_mode, (const uint8_t*)DEVICE_NAME, strlen(DEVICE_NAME));
     APP_ERROR_CHECK(err_code);
 
-    err_code = ble_advdata_encode(&advdata, m_adv_data.adv_data.p_data, &m_adv_data.adv_data.len);
+    advertising_data_encode();
+
+    err_code = sd_ble_gap_adv_set_configure(&m_adv_handle, &m_adv_data[m_adv_buf_idx], &m_adv_params);
     APP_ERROR_CHECK(err_code);
+}
+
+/*
+ *@brief Function for updating the position in the advertising data while advertising.
+ *
+ * @details Patches the position bytes of the buffer not used by the SoftDevice and hands it over.
+ *          Advertising parameters are not passed, so the advertising is not interrupted.
+ */
+static void advertising_update(void)
+{
+    ret_code_t err_code;
+    uint8_t idle_idx = m_adv_buf_idx ^ 1;
 
-    err_code = sd_ble_gap_adv_set_configure(&m_adv_handle, &m_adv_data, &m_adv_params);
+    PROFILE_START(start);
+    memcpy(&m_enc_advdata[idle_idx][m_adv_pos_offset], &m_beacon_info, ADV_PAYLOAD_LEN);
+#if BEACON_SCANNABLE
+    // The SoftDevice takes the scan response buffer along, so the detail goes out with the position.
+    m_detail.seq = m_fix_info.seq;
+    beacon_detail_encode(&m_enc_scan_rsp[idle_idx][m_scan_rsp_detail_offset], &m_detail);
+#endif
+
+    err_code = sd_ble_gap_adv_set_configure(&m_adv_handle, &m_adv_data[idle_idx], NULL);
     APP_ERROR_CHECK(err_code);
+    PROFILE_STOP(PROFILE_ADV_UPDATE, start, 0);
+#if BEACON_COMMAND_CHANNEL
+    m_adv_update_ticks = app_timer_cnt_get();
+#endif
+
+    m_adv_buf_idx = idle_idx;
 }
 
 /*
@@ -126,6 +508,12 @@ static void advertising_start(void)
     ret_code_t err_code;
 
     err_code = sd_ble_gap_adv_start(m_adv_handle, APP_BLE_CONN_CFG_TAG);
+#if BEACON_CONNECTABLE
+    if (NRF_ERROR_CONN_COUNT == err_code) {
+        // A central is connected, advertising resumes when it disconnects.
+        return;
+    }
+#endif
     APP_ERROR_CHECK(err_code);
 }
 
@@ -137,13 +525,170 @@ static void advertising_stop(void)
     ret_code_t err_code;
 
     err_code = sd_ble_gap_adv_stop(m_adv_handle);
+#if BEACON_CONNECTABLE
+    if (NRF_ERROR_INVALID_STATE == err_code) {
+        // Connectable advertising stops by itself when a central connects.
+        return;
+    }
+#endif
+    APP_ERROR_CHECK(err_code);
+}
+
+/*
+ *@brief Function for applying changed advertising parameters.
+ *
+ * @details Advertising parameters can not be changed while advertising, so advertising is
+ *          restarted. While a central is connected only the parameters are updated.
+ *
+ * @param[in]   encode  The payload length has changed, the advertising data is encoded again.
+ */
+static void advertising_restart(bool encode)
+{
+    ret_code_t err_code;
+
+    PROFILE_START(start);
+    advertising_stop();
+
+    if (encode) {
+        advertising_data_encode();
+    }
+    err_code = sd_ble_gap_adv_set_configure(&m_adv_handle, &m_adv_data[m_adv_buf_idx], &m_adv_params);
+    APP_ERROR_CHECK(err_code);
+
+    advertising_start();
+    PROFILE_STOP(PROFILE_ADV_RESTART, start, 0);
+}
+
+/*
+ *@brief Function for changing the advertising interval.
+ *
+ * @details This happens only when the beacon starts or stops moving, or by command.
+ *
+ * @param[in]   interval_ms  New advertising interval, ms.
+ */
+static void advertising_interval_set(uint32_t interval_ms)
+{
+    NRF_LOG_INFO("Advertising interval %d ms\n", interval_ms);
+
+    m_adv_params.interval = MSEC_TO_UNITS(interval_ms, UNIT_0_625_MS);
+    advertising_restart(false);
+}
+
+#if BEACON_CONNECTABLE
+/*
+ *@brief Function for handling BLE events of the connection.
+ *
+ * @details Runs in the SoftDevice event interrupt. Every connection is moved to 2M PHY;
+ *          ATT MTU and data length are negotiated by nrf_ble_gatt.
+ */
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context)
+{
+    ret_code_t err_code;
+    ble_gap_phys_t const phys_2m = { .tx_phys = BLE_GAP_PHY_2MBPS, .rx_phys = BLE_GAP_PHY_2MBPS };
+    ble_gap_phys_t const phys_auto = { .tx_phys = BLE_GAP_PHY_AUTO, .rx_phys = BLE_GAP_PHY_AUTO };
+
+    UNUSED_PARAMETER(p_context);
+
+    switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+        NRF_LOG_INFO("Connected\n");
+        m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+        err_code = sd_ble_gap_phy_update(m_conn_handle, &phys_2m);
+        APP_ERROR_CHECK(err_code);
+        break;
+    case BLE_GAP_EVT_DISCONNECTED:
+        NRF_LOG_INFO("Disconnected, reason 0x%x\n", p_ble_evt->evt.gap_evt.params.disconnected.reason);
+        m_conn_handle = BLE_CONN_HANDLE_INVALID;
+        m_adv_restart = true;
+        break;
+    case BLE_GAP_EVT_PHY_UPDATE_REQUEST:
+        err_code = sd_ble_gap_phy_update(p_ble_evt->evt.gap_evt.conn_handle, &phys_auto);
+        APP_ERROR_CHECK(err_code);
+        break;
+    case BLE_GAP_EVT_PHY_UPDATE:
+        NRF_LOG_INFO("PHY tx %d rx %d\n", p_ble_evt->evt.gap_evt.params.phy_update.tx_phy,
+            p_ble_evt->evt.gap_evt.params.phy_update.rx_phy);
+        break;
+    case BLE_GAP_EVT_SEC_PARAMS_REQUEST:
+        err_code = sd_ble_gap_sec_params_reply(m_conn_handle, BLE_GAP_SEC_STATUS_PAIRING_NOT_SUPP, NULL, NULL);
+        APP_ERROR_CHECK(err_code);
+        break;
+    case BLE_GATTS_EVT_SYS_ATTR_MISSING:
+        err_code = sd_ble_gatts_sys_attr_set(m_conn_handle, NULL, 0, 0);
+        APP_ERROR_CHECK(err_code);
+        break;
+    case BLE_GATTC_EVT_TIMEOUT:
+    case BLE_GATTS_EVT_TIMEOUT:
+        err_code = sd_ble_gap_disconnect(m_conn_handle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+        APP_ERROR_CHECK(err_code);
+        break;
+    default:
+        break;
+    }
+}
+
+NRF_SDH_BLE_OBSERVER(m_ble_observer, APP_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
+
+/*
+ *@brief Function for handling nrf_ble_gatt events.
+ */
+static void gatt_evt_handler(nrf_ble_gatt_t* p_gatt, nrf_ble_gatt_evt_t const* p_evt)
+{
+    UNUSED_PARAMETER(p_gatt);
+
+    switch (p_evt->evt_id) {
+    case NRF_BLE_GATT_EVT_ATT_MTU_UPDATED:
+        track_service_mtu_set(p_evt->params.att_mtu_effective);
+        break;
+    case NRF_BLE_GATT_EVT_DATA_LENGTH_UPDATED:
+        NRF_LOG_INFO("Data length %d\n", p_evt->params.data_length);
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ *@brief Function for setting the preferred connection parameters.
+ */
+static void gap_params_init(void)
+{
+    ret_code_t err_code;
+    ble_gap_conn_params_t gap_conn_params;
+
+    memset(&gap_conn_params, 0, sizeof(gap_conn_params));
+    gap_conn_params.min_conn_interval = MIN_CONN_INTERVAL;
+    gap_conn_params.max_conn_interval = MAX_CONN_INTERVAL;
+    gap_conn_params.slave_latency = SLAVE_LATENCY;
+    gap_conn_params.conn_sup_timeout = CONN_SUP_TIMEOUT;
+
+    err_code = sd_ble_gap_ppcp_set(&gap_conn_params);
     APP_ERROR_CHECK(err_code);
 }
 
+/*
+ *@brief Function for initializing the GATT module and the track download service.
+ */
+static void gatt_init(void)
+{
+    ret_code_t err_code;
+
+    err_code = nrf_ble_gatt_init(&m_gatt, gatt_evt_handler);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = nrf_ble_gatt_att_mtu_periph_set(&m_gatt, NRF_SDH_BLE_GATT_MAX_MTU_SIZE);
+    APP_ERROR_CHECK(err_code);
+
+    track_service_init();
+}
+#endif
+
 /*
  *@brief Function for initializing the BLE stack.
  *
  * @details Initializes the SoftDevice and the BLE event interrupt.
+ *          A connectable beacon gets a deeper notification queue and connection event
+ *          length extension, so a download fills whole connection events.
  */
 static void ble_stack_init(void)
 {
@@ -158,9 +703,54 @@ static void ble_stack_init(void)
     err_code = nrf_sdh_ble_default_cfg_set(APP_BLE_CONN_CFG_TAG, &ram_start);
     APP_ERROR_CHECK(err_code);
 
+#if BEACON_CONNECTABLE
+    ble_cfg_t ble_cfg;
+
+    memset(&ble_cfg, 0, sizeof(ble_cfg));
+    ble_cfg.conn_cfg.conn_cfg_tag = APP_BLE_CONN_CFG_TAG;
+    ble_cfg.conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size = HVN_TX_QUEUE_SIZE;
+    err_code = sd_ble_cfg_set(BLE_CONN_CFG_GATTS, &ble_cfg, ram_start);
+    APP_ERROR_CHECK(err_code);
+#endif
+
     // Enable BLE stack.
     err_code = nrf_sdh_ble_enable(&ram_start);
     APP_ERROR_CHECK(err_code);
+
+#if BEACON_CONNECTABLE
+    ble_opt_t opt;
+
+    memset(&opt, 0, sizeof(opt));
+    opt.common_opt.conn_evt_ext.enable = 1;
+    err_code = sd_ble_opt_set(BLE_COMMON_OPT_CONN_EVT_EXT, &opt);
+    APP_ERROR_CHECK(err_code);
+#endif
+}
+
+/*
+ *@brief Function for handling radio notifications.
+ *
+ * @details Runs in the radio notification interrupt. The end of a radio event, which is an
+ *          advertising event unless a central is connected, lets the main loop refresh the
+ *          payload once; the SoftDevice sends it in the next event.
+ */
+static void radio_notification_handler(bool radio_active)
+{
+    if (!radio_active) {
+        m_radio_idle = true;
+    }
+}
+
+/*
+ *@brief Function for initializing the radio notification, after the SoftDevice is enabled.
+ */
+static void radio_notification_init(void)
+{
+    ret_code_t err_code;
+
+    err_code = ble_radio_notification_init(APP_IRQ_PRIORITY_LOW, NRF_RADIO_NOTIFICATION_DISTANCE_800US,
+        radio_notification_handler);
+    APP_ERROR_CHECK(err_code);
 }
 
 /*
@@ -174,6 +764,42 @@ static void log_init(void)
     NRF_LOG_DEFAULT_BACKENDS_INIT();
 }
 
+#if BEACON_KALMAN_FILTER
+/*
+ *@brief Function for handling the predict timer, the payload is refreshed after the next radio event.
+ */
+static void predict_timer_handler(void* p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    m_predict_pending = true;
+}
+#endif
+
+#if BEACON_SCANNABLE
+/*
+ *@brief Function for handling the battery timer, the voltage is measured in the main loop.
+ */
+static void battery_timer_handler(void* p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    m_battery_pending = true;
+}
+#endif
+
+#if BEACON_UART_POWER_GATING
+static void uart_idle_timer_handler(void* p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    m_uart_idle = true;
+}
+
+static void uart_wake_timer_handler(void* p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    m_uart_wake = true;
+}
+#endif
+
 /*
  *@brief Function for initializing timers. 
  */
@@ -181,6 +807,21 @@ static void timers_init(void)
 {
     ret_code_t err_code = app_timer_init();
     APP_ERROR_CHECK(err_code);
+
+#if BEACON_KALMAN_FILTER
+    err_code = app_timer_create(&m_predict_timer, APP_TIMER_MODE_REPEATED, predict_timer_handler);
+    APP_ERROR_CHECK(err_code);
+#endif
+#if BEACON_UART_POWER_GATING
+    err_code = app_timer_create(&m_uart_idle_timer, APP_TIMER_MODE_SINGLE_SHOT, uart_idle_timer_handler);
+    APP_ERROR_CHECK(err_code);
+    err_code = app_timer_create(&m_uart_wake_timer, APP_TIMER_MODE_SINGLE_SHOT, uart_wake_timer_handler);
+    APP_ERROR_CHECK(err_code);
+#endif
+#if BEACON_SCANNABLE
+    err_code = app_timer_create(&m_battery_timer, APP_TIMER_MODE_REPEATED, battery_timer_handler);
+    APP_ERROR_CHECK(err_code);
+#endif
 }
 
 /*
@@ -193,133 +834,1073 @@ static void power_management_init(void)
     APP_ERROR_CHECK(err_code);
 }
 
+#if BEACON_KALMAN_FILTER
 /*
- *@brief Function for handling the idle state (main loop).
+ *@brief Function for smoothing a fix with the Kalman filter.
+ *
+ * @details The filter runs on the UTC time of the fix, so UART latency does not disturb it.
+ *          A fix without time resets the filter and is advertised as received.
+ *
+ * @param[in]     p_frame     Parsed RMC sentence with a valid fix.
+ * @param[in]     speed_mmps  Speed over ground, mm/s.
+ * @param[in,out] p_fix       Position of the fix, replaced by the filtered position.
  */
-static void idle_state_handle(void)
+static void fix_filter(struct minmea_sentence_rmc* p_frame, uint32_t speed_mmps, beacon_fix_t* p_fix)
 {
-    if (NRF_LOG_PROCESS() == false) {
-        nrf_pwr_mgmt_run();
+    PROFILE_START(start);
+    m_fix_ticks = app_timer_cnt_get();
+    m_fix_time_valid = (p_frame->time.hours >= 0);
+    if (!m_fix_time_valid) {
+        kalman_init();
+        return;
+    }
+
+    m_fix_time_ms = (uint32_t)(p_frame->time.hours * 3600 + p_frame->time.minutes * 60 + p_frame->time.seconds) * 1000u
+        + (uint32_t)p_frame->time.microseconds / 1000u;
+    if (p_frame->date.year >= 0) {
+        // Keeps the time monotonic over midnight, the filter would restart otherwise.
+        m_fix_time_ms += track_unix_time(2000 + p_frame->date.year, p_frame->date.month, p_frame->date.day, 0) * 1000u;
     }
+
+    kalman_update(m_fix_time_ms, p_fix->latitude, p_fix->longitude, 0 != p_frame->speed.scale, speed_mmps,
+        minmea_rescale(&p_frame->course, 10));
+    kalman_position(m_fix_time_ms, &p_fix->latitude, &p_fix->longitude);
+    PROFILE_STOP(PROFILE_KALMAN_UPDATE, start, 0);
 }
 
 /*
- *@brief   Function for handling app_uart events.
- *
- * @details This function receives a single character from the app_uart module and appends it to
- *          a string. The string is parsed and sent over BLE advertising when the last character received is a
- *          'new line' '\n' (hex 0x0A) or if the string reaches the maximum data length.
+ *@brief Function for starting the payload refresh between fixes while moving, or stopping it.
  */
-void uart_event_handle(app_uart_evt_t* p_event)
+static void predict_timer_restart(bool moving)
 {
-    static uint8_t data_array[NMEA_BUFFER] = { 0 };
-    static uint16_t index = 0;
+    ret_code_t err_code;
 
-    switch (p_event->evt_type) {
-    case APP_UART_DATA_READY: {
-        uint8_t data = 0;
-        uint32_t ret_val = app_uart_get(&data);
-        if (NRF_SUCCESS != ret_val) {
-            NRF_LOG_ERROR("Failed to pop data from FIFO!\n")
-            return;
-        }
-        data_array[index++] = data;
-
-        if ((data_array[index - 1] == '\n') || (index >= (NMEA_BUFFER))) {
-            switch (minmea_sentence_id(data_array, false)) {
-            case MINMEA_SENTENCE_RMC: {
-                struct minmea_sentence_rmc frame;
-                if (minmea_parse_rmc(&frame, data_array)) {
-                    int32_t latitude = frame.latitude.value;
-                    int32_t longitude = frame.longitude.value;
-                    int32_t speed = minmea_rescale(&frame.speed, 1000);
-
-                    NRF_LOG_DEBUG("$xxRMC fixed-point RAW coordinates and speed: (%d,%d) %d\n",
-                        latitude, longitude, speed);
-
-                    m_beacon_info.latitude = latitude;
-                    m_beacon_info.longitude = longitude;
-                    // FIXME: Dirty hack, make it without stop/start
-                    advertising_stop();
-                    advertising_init();
-                    advertising_start();
-                } else {
-                    NRF_LOG_ERROR("$xxRMC sentence is not parsed\n");
-                }
-                break;
-            }
-            // TODO: Parse more data!
-            default: {
-                NRF_LOG_INFO("Unhandled header id\n");
-            }
-            }
+    err_code = app_timer_stop(m_predict_timer);
+    APP_ERROR_CHECK(err_code);
+    m_predict_pending = false;
 
-            index = 0;
-            memset(data_array, 0, sizeof(data_array));
-        }
-        break;
-    }
-    case APP_UART_COMMUNICATION_ERROR: {
-        NRF_LOG_ERROR("Communication error occurred while handling UART.\n");
-        index = 0;
-        memset(data_array, 0, sizeof(data_array));
-        break;
-    }
-    case APP_UART_FIFO_ERROR: {
-        NRF_LOG_ERROR("Error occurred in FIFO module used by UART.\n");
-        index = 0;
-        memset(data_array, 0, sizeof(data_array));
-        break;
-    }
-    default: {
-        break;
-    }
+    if (moving && m_fix_time_valid) {
+        err_code = app_timer_start(m_predict_timer, APP_TIMER_TICKS(PREDICT_INTERVAL_MS), NULL);
+        APP_ERROR_CHECK(err_code);
     }
 }
 
 /*
- *@brief Function for initializing the UART.
+ *@brief Function for advertising the position predicted for now.
+ *
+ * @details The payload is flagged as a prediction, its header carries the prediction and its
+ *          time, and the newest fix goes first in the history under its own sequence number,
+ *          see beacon_payload.h. The history is shifted by one for the encoding, so the oldest
+ *          entry is not advertised meanwhile. Predictions stop KALMAN_PREDICT_MAX_MS after the
+ *          fix, the last one is advertised until the next fix.
  */
-static void uart_init(void)
+static void prediction_advertise(void)
 {
-    ret_code_t err_code;
+    uint32_t elapsed_ms = TICKS_TO_MS(app_timer_cnt_diff_compute(app_timer_cnt_get(), m_fix_ticks));
+    beacon_fix_t oldest = m_fix_history[ARRAY_SIZE(m_fix_history) - 1];
+    beacon_info_t info = m_fix_info;
 
-    app_uart_comm_params_t const comm_params = {
-        .rx_pin_no = RX_PIN_NUMBER,
-        .tx_pin_no = TX_PIN_NUMBER,
-        .rts_pin_no = RTS_PIN_NUMBER,
-        .cts_pin_no = CTS_PIN_NUMBER,
-        .flow_control = APP_UART_FLOW_CONTROL_DISABLED,
-        .use_parity = false,
-        .baud_rate = UART_BAUDRATE_BAUDRATE_Baud115200
-    };
+    if (elapsed_ms > KALMAN_PREDICT_MAX_MS) {
+        predict_timer_restart(false);
+        return;
+    }
 
-    APP_UART_FIFO_INIT(&comm_params,
-        UART_RX_BUF_SIZE,
-        UART_TX_BUF_SIZE,
-        uart_event_handle,
-        APP_IRQ_PRIORITY_LOWEST,
-        err_code);
+    PROFILE_START(start);
+    memmove(&m_fix_history[1], &m_fix_history[0], sizeof(m_fix_history) - sizeof(m_fix_history[0]));
+    kalman_position(m_fix_time_ms + elapsed_ms, &m_fix_history[0].latitude, &m_fix_history[0].longitude);
+    if (BEACON_TIME_UNKNOWN != info.time) {
+        info.time = (uint16_t)((info.time + elapsed_ms / 100) % BEACON_TIME_PER_HOUR);
+    }
+    info.predicted = true;
+    beacon_payload_encode(m_beacon_info, m_adv_history, &info, m_fix_history, MIN((size_t)m_fix_count + 1, ARRAY_SIZE(m_fix_history)));
+    memmove(&m_fix_history[0], &m_fix_history[1], sizeof(m_fix_history) - sizeof(m_fix_history[0]));
+    m_fix_history[ARRAY_SIZE(m_fix_history) - 1] = oldest;
+    PROFILE_STOP(PROFILE_KALMAN_PREDICT, start, 0);
 
-    APP_ERROR_CHECK(err_code);
+    advertising_update();
 }
+#endif
 
+#if BEACON_FIX_RESTORE
 /*
- *@brief Function for application main entry.
+ *@brief Function for computing the checksum of the retained fix, FNV-1a.
  */
-int main(void)
+static uint32_t fix_retained_check(fix_retained_t const* p_retained)
 {
-    // Initialize.
-    log_init();
-    timers_init();
-    uart_init();
-    power_management_init();
+    uint8_t const* p_byte = (uint8_t const*)p_retained;
+    uint32_t check = 2166136261u;
+
+    for (size_t i = 0; i < offsetof(fix_retained_t, check); i++) {
+        check = (check ^ p_byte[i]) * 16777619u;
+    }
+    return check;
+}
+
+/*
+ *@brief Function for keeping the newest fix in retained RAM.
+ */
+static void fix_retain(void)
+{
+    m_fix_retained.magic = FIX_RETAINED_MAGIC;
+    m_fix_retained.info = m_fix_info;
+    m_fix_retained.fix = m_fix_history[0];
+    m_fix_retained.check = fix_retained_check(&m_fix_retained);
+}
+
+/*
+ *@brief Function for restoring the last known fix, advertised until the GNSS delivers a new one.
+ *
+ * @details The fix in retained RAM survives a reset other than power-on and keeps its sequence
+ *          number, receivers see no new fix. After a power cycle the newest track log record
+ *          is advertised as sequence number 1; its time tells receivers how old it is.
+ *          Must be called after track_log_init() and before advertising_init().
+ */
+static void fix_restore(void)
+{
+    track_record_t record;
+    uint32_t first = track_log_first();
+    uint32_t index = track_log_end();
+
+    if (FIX_RETAINED_MAGIC == m_fix_retained.magic && fix_retained_check(&m_fix_retained) == m_fix_retained.check) {
+        m_fix_info = m_fix_retained.info;
+        m_fix_history[0] = m_fix_retained.fix;
+        m_fix_count = 1;
+        NRF_LOG_INFO("Fix %u restored from RAM\n", m_fix_info.seq);
+        return;
+    }
+
+    // The newest records may have been torn by the reset.
+    while (index > first) {
+        index--;
+        if (!track_log_read(index, &record)) {
+            continue;
+        }
+        m_fix_history[0].latitude = record.latitude;
+        m_fix_history[0].longitude = record.longitude;
+        m_fix_count = 1;
+        m_fix_info.seq = beacon_seq_next(0);
+        m_fix_info.time = BEACON_TIME_UNKNOWN;
+        if (TRACK_TIME_UNKNOWN != record.time) {
+            m_fix_info.time = (uint16_t)((record.time % 3600) * 10);
+        }
+        m_fix_info.speed = record.speed;
+        m_fix_info.course = record.course;
+        fix_retain();
+        NRF_LOG_INFO("Fix restored from track log record %u\n", index);
+        return;
+    }
+}
+#endif
+
+/*
+ *@brief Function for adding a fix to the history and encoding the position payload.
+ *
+ * @param[in]   p_frame     Parsed RMC sentence with a valid fix.
+ * @param[in]   speed_mmps  Speed over ground, mm/s.
+ */
+static void fix_history_add(struct minmea_sentence_rmc* p_frame, uint32_t speed_mmps)
+{
+    beacon_fix_t fix;
+
+    fix.latitude = beacon_coord_from_nmea(p_frame->latitude.value, p_frame->latitude.scale);
+    fix.longitude = beacon_coord_from_nmea(p_frame->longitude.value, p_frame->longitude.scale);
+#if BEACON_KALMAN_FILTER
+    fix_filter(p_frame, speed_mmps, &fix);
+#endif
+
+    PROFILE_START(start);
+    memmove(&m_fix_history[1], &m_fix_history[0], sizeof(m_fix_history) - sizeof(m_fix_history[0]));
+    m_fix_history[0] = fix;
+    if (m_fix_count < ARRAY_SIZE(m_fix_history)) {
+        m_fix_count++;
+    }
+
+    m_fix_info.seq = beacon_seq_next(m_fix_info.seq);
+    m_fix_info.time = BEACON_TIME_UNKNOWN;
+    if (p_frame->time.hours >= 0) {
+        m_fix_info.time = (uint16_t)((p_frame->time.minutes * 60 + p_frame->time.seconds) * 10
+            + p_frame->time.microseconds / 100000);
+    }
+    m_fix_info.speed = BEACON_SPEED_UNKNOWN;
+    m_fix_info.course = 0;
+    if (0 != p_frame->speed.scale) {
+        m_fix_info.speed = (uint8_t)MIN(speed_mmps / BEACON_SPEED_UNIT_MMPS, BEACON_SPEED_UNKNOWN - 1);
+        // Tenths of a degree to 360/256 degree.
+        m_fix_info.course = (uint8_t)((minmea_rescale(&p_frame->course, 10) * 256 + 1800) / 3600);
+    }
+
+    beacon_payload_encode(m_beacon_info, m_adv_history, &m_fix_info, m_fix_history, m_fix_count);
+    PROFILE_STOP(PROFILE_PAYLOAD_ENCODE, start, 0);
+#if BEACON_FIX_RESTORE
+    fix_retain();
+#endif
+}
+
+/*
+ *@brief Function for writing the newest fix to the track log.
+ *
+ * @details Every fix is logged while moving, while stationary one per
+ *          TRACK_LOG_STATIONARY_INTERVAL_S, which keeps parked hours from flushing the ring.
+ *
+ * @param[in]   p_frame     Parsed RMC sentence of the newest fix.
+ * @param[in]   moving      The beacon is moving.
+ */
+static void track_log_fix(struct minmea_sentence_rmc const* p_frame, bool moving)
+{
+    static uint32_t last_time = TRACK_TIME_UNKNOWN;
+    track_record_t record;
+
+    record.time = TRACK_TIME_UNKNOWN;
+    if (p_frame->date.year >= 0 && p_frame->time.hours >= 0) {
+        record.time = track_unix_time(2000 + p_frame->date.year, p_frame->date.month, p_frame->date.day,
+            (uint32_t)(p_frame->time.hours * 3600 + p_frame->time.minutes * 60 + p_frame->time.seconds));
+    }
+
+    if (!moving && TRACK_TIME_UNKNOWN != record.time && TRACK_TIME_UNKNOWN != last_time
+        && record.time - last_time < TRACK_LOG_STATIONARY_INTERVAL_S) {
+        return;
+    }
+    last_time = record.time;
+
+    record.latitude = m_fix_history[0].latitude;
+    record.longitude = m_fix_history[0].longitude;
+    record.speed = m_fix_info.speed;
+    record.course = m_fix_info.course;
+    track_log_append(&record);
+}
+
+#if BEACON_COMMAND_CHANNEL
+/*
+ *@brief Function for converting an app_timer counter value to beacon time, us.
+ *
+ * @details The 24-bit counter is extended on every call, which happens at least per NMEA
+ *          line; a silence longer than the counter period only shifts the clock, the answers
+ *          carry differences of close times.
+ *
+ * @param[in]   ticks   Counter value, not newer than now.
+ *
+ * @return Microseconds, wraps at 2^32.
+ */
+static uint32_t device_time_us(uint32_t ticks)
+{
+    static uint64_t total = 0;
+    static uint32_t last = 0;
+    uint32_t now = app_timer_cnt_get();
+
+    total += app_timer_cnt_diff_compute(now, last);
+    last = now;
+    return (uint32_t)((total - app_timer_cnt_diff_compute(now, ticks)) * 1000000u * (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)
+        / APP_TIMER_CLOCK_FREQ);
+}
+
+/*
+ *@brief Function for queueing a sentence for the UART TX line, sent by uart_tx_process().
+ */
+static void uart_tx_send(char const* p_line, size_t len)
+{
+    if (0 == len) {
+        NRF_LOG_WARNING("UART TX sentence not formatted\n");
+        return;
+    }
+    if (UART_TX_QUEUE_SIZE == m_tx_count) {
+        NRF_LOG_WARNING("UART TX queue full, sentence dropped\n");
+        return;
+    }
+    uint8_t idx = (m_tx_head + m_tx_count) % UART_TX_QUEUE_SIZE;
+    memcpy(m_tx_queue[idx], p_line, len);
+    m_tx_len[idx] = (uint8_t)len;
+    m_tx_count++;
+}
+
+/*
+ *@brief Function for reporting when the fix just advertised was received and handed over.
+ *
+ * @param[in]   rx_ticks    app_timer counter when its RMC sentence was received.
+ */
+static void latency_report(uint32_t rx_ticks)
+{
+    char line[COMMAND_LINE_MAX];
+
+    if (!m_latency_report) {
+        return;
+    }
+    uart_tx_send(line, command_report_format(line, sizeof(line), m_fix_info.seq, device_time_us(rx_ticks),
+                           device_time_us(m_adv_update_ticks)));
+}
+
+/*
+ *@brief Function for setting the advertising PHY.
+ *
+ * @details Legacy advertising is on 1M only. Extended advertising keeps the primary channels
+ *          on 1M for 1M and 2M; Coded needs the long range feature, which S132 does not have.
+ */
+static command_status_t command_phy_set(int32_t phy)
+{
+#if BEACON_ADV_EXTENDED
+    uint8_t primary_phy;
+    uint8_t secondary_phy;
+
+    switch (phy) {
+    case 1:
+        primary_phy = BLE_GAP_PHY_1MBPS;
+        secondary_phy = BLE_GAP_PHY_1MBPS;
+        break;
+    case 2:
+        primary_phy = BLE_GAP_PHY_1MBPS;
+        secondary_phy = BLE_GAP_PHY_2MBPS;
+        break;
+    case 4:
+#if defined(S132)
+        return COMMAND_STATUS_UNSUPPORTED;
+#else
+        primary_phy = BLE_GAP_PHY_CODED;
+        secondary_phy = BLE_GAP_PHY_CODED;
+        break;
+#endif
+    default:
+        return COMMAND_STATUS_RANGE;
+    }
+    if (primary_phy != m_adv_params.primary_phy || secondary_phy != m_adv_params.secondary_phy) {
+        m_adv_params.primary_phy = primary_phy;
+        m_adv_params.secondary_phy = secondary_phy;
+        advertising_restart(false);
+    }
+    return COMMAND_STATUS_OK;
+#else
+    if (1 == phy) {
+        return COMMAND_STATUS_OK;
+    }
+    return (2 == phy || 4 == phy) ? COMMAND_STATUS_UNSUPPORTED : COMMAND_STATUS_RANGE;
+#endif
+}
+
+/*
+ *@brief Function for executing a parsed command.
+ */
+static command_status_t command_execute(command_t const* p_cmd)
+{
+    ret_code_t err_code;
+
+    switch (p_cmd->id) {
+    case COMMAND_PING:
+        return COMMAND_STATUS_OK;
+    case COMMAND_INTERVAL: {
+        if (0 != p_cmd->value && (p_cmd->value < ADV_INTERVAL_CMD_MIN_MS || p_cmd->value > ADV_INTERVAL_CMD_MAX_MS)) {
+            return COMMAND_STATUS_RANGE;
+        }
+        m_interval_override_ms = (uint32_t)p_cmd->value;
+        uint32_t interval_ms = (0 != m_interval_override_ms) ? m_interval_override_ms : advertising_interval_default();
+        if (MSEC_TO_UNITS(interval_ms, UNIT_0_625_MS) != m_adv_params.interval) {
+            advertising_interval_set(interval_ms);
+        }
+        return COMMAND_STATUS_OK;
+    }
+    case COMMAND_TX_POWER:
+        if (p_cmd->value < TX_POWER_CMD_MIN_DBM || p_cmd->value > TX_POWER_CMD_MAX_DBM) {
+            return COMMAND_STATUS_RANGE;
+        }
+        err_code = sd_ble_gap_tx_power_set(BLE_GAP_TX_POWER_ROLE_ADV, m_adv_handle, (int8_t)p_cmd->value);
+        return (NRF_SUCCESS == err_code) ? COMMAND_STATUS_OK : COMMAND_STATUS_RANGE;
+    case COMMAND_PHY:
+        return command_phy_set(p_cmd->value);
+    case COMMAND_FORMAT:
+        if (BEACON_FLEET) {
+            // Asset payloads carry no history.
+            return COMMAND_STATUS_UNSUPPORTED;
+        }
+        if (p_cmd->value < 0 || p_cmd->value > ADV_HISTORY_LEN) {
+            return COMMAND_STATUS_RANGE;
+        }
+        if (m_adv_history != p_cmd->value) {
+            m_adv_history = (uint8_t)p_cmd->value;
+            advertising_restart(true);
+        }
+        return COMMAND_STATUS_OK;
+    case COMMAND_LATENCY:
+        if (p_cmd->value < 0 || p_cmd->value > 1) {
+            return COMMAND_STATUS_RANGE;
+        }
+        m_latency_report = (1 == p_cmd->value);
+        return COMMAND_STATUS_OK;
+    case COMMAND_STATS: {
+        command_stats_t const stats = { .lines = m_nmea_lines, .dropped = nmea_queue_dropped(), .errors = m_uart_errors };
+        char line[COMMAND_LINE_MAX];
+
+        uart_tx_send(line, command_stats_format(line, sizeof(line), p_cmd->seq, &stats));
+        return COMMAND_STATUS_OK;
+    }
+    default:
+        return COMMAND_STATUS_INVALID;
+    }
+}
+
+/*
+ *@brief Function for handling a command sentence and queueing its answer.
+ *
+ * @details Every sentence is answered, also a rejected one, so the host can time the round
+ *          trip. The answer carries the receive time of the sentence and the time it was
+ *          queued, their difference is the time spent in the beacon.
+ *
+ * @param[in]   p_line  Queued line starting with COMMAND_PREFIX.
+ */
+static void command_handle(nmea_line_t const* p_line)
+{
+    command_t cmd;
+    char line[COMMAND_LINE_MAX];
+    uint32_t rx_us = device_time_us(p_line->time);
+
+    command_status_t status = command_parse(p_line->data, &cmd);
+    if (COMMAND_STATUS_OK == status) {
+        status = command_execute(&cmd);
+    }
+    NRF_LOG_INFO("Command %d: %s\n", cmd.seq, command_status_name(status));
+
+    uart_tx_send(line, command_ack_format(line, sizeof(line), cmd.seq, status, rx_us, device_time_us(app_timer_cnt_get())));
+}
+#endif
+
+#if BEACON_SCANNABLE
+/*
+ *@brief Function for handling SAADC events, conversions are blocking and raise none.
+ */
+static void saadc_event_handler(nrfx_saadc_evt_t const* p_event)
+{
+    UNUSED_PARAMETER(p_event);
+}
+
+/*
+ *@brief Function for initializing the battery voltage measurement, VDD through the SAADC.
+ */
+static void battery_init(void)
+{
+    ret_code_t err_code;
+    nrfx_saadc_config_t const config = NRFX_SAADC_DEFAULT_CONFIG;
+    nrf_saadc_channel_config_t const channel = NRFX_SAADC_DEFAULT_CHANNEL_CONFIG_SE(NRF_SAADC_INPUT_VDD);
+
+    err_code = nrfx_saadc_init(&config, saadc_event_handler);
+    APP_ERROR_CHECK(err_code);
+    err_code = nrfx_saadc_channel_init(0, &channel);
+    APP_ERROR_CHECK(err_code);
+    err_code = app_timer_start(m_battery_timer, APP_TIMER_TICKS(BATTERY_MEAS_INTERVAL_MS), NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+/*
+ *@brief Function for measuring the battery voltage when due, runs in the main loop.
+ *
+ * @details One blocking conversion takes a few tens of us. The voltage goes out with the
+ *          next payload update.
+ */
+static void battery_process(void)
+{
+    ret_code_t err_code;
+    nrf_saadc_value_t value;
+
+    if (!m_battery_pending) {
+        return;
+    }
+    m_battery_pending = false;
+
+    err_code = nrfx_saadc_sample_convert(0, &value);
+    APP_ERROR_CHECK(err_code);
+    m_detail.battery_mv = (value > 0) ? (uint16_t)(((uint32_t)value * BATTERY_MV_PER_LSB_Q10) >> 10) : 0;
+}
+
+/*
+ *@brief Function for converting a dilution of precision to the detail payload, 0.1.
+ */
+static uint8_t detail_dop(struct minmea_float* p_dop)
+{
+    int32_t dop = minmea_rescale(p_dop, 10);
+
+    if (0 == p_dop->scale || dop <= 0) {
+        return BEACON_DETAIL_UNKNOWN;
+    }
+    return (uint8_t)MIN(dop, BEACON_DETAIL_UNKNOWN - 1);
+}
+
+/*
+ *@brief Function for taking altitude, satellites, fix quality and HDOP from a GGA sentence.
+ */
+static void detail_gga_handle(char const* p_sentence)
+{
+    struct minmea_sentence_gga frame;
+
+    if (!minmea_parse_gga(&frame, p_sentence)) {
+        NRF_LOG_ERROR("$xxGGA sentence is not parsed\n");
+        return;
+    }
+    m_detail.quality = (uint8_t)MIN((uint32_t)frame.fix_quality, BEACON_DETAIL_UNKNOWN - 1);
+    m_detail.satellites = (uint8_t)MIN((uint32_t)frame.satellites_tracked, BEACON_DETAIL_UNKNOWN - 1);
+    m_detail.hdop = detail_dop(&frame.hdop);
+    m_detail.altitude = BEACON_ALTITUDE_UNKNOWN;
+    if (0 != frame.altitude.scale && 'M' == frame.altitude_units) {
+        m_detail.altitude = minmea_rescale(&frame.altitude, 10);
+    }
+}
+
+/*
+ *@brief Function for taking the dilutions of precision from a GSA sentence.
+ */
+static void detail_gsa_handle(char const* p_sentence)
+{
+    struct minmea_sentence_gsa frame;
+
+    if (!minmea_parse_gsa(&frame, p_sentence)) {
+        NRF_LOG_ERROR("$xxGSA sentence is not parsed\n");
+        return;
+    }
+    m_detail.pdop = detail_dop(&frame.pdop);
+    m_detail.hdop = detail_dop(&frame.hdop);
+    m_detail.vdop = detail_dop(&frame.vdop);
+}
+#endif
+
+/*
+ *@brief Function for advertising a fix and adapting the advertising interval to it.
+ *
+ * @param[in]   p_frame     Parsed RMC sentence with a valid fix.
+ * @param[in]   speed_mmps  Speed over ground, mm/s.
+ */
+static void fix_advertise(struct minmea_sentence_rmc* p_frame, uint32_t speed_mmps)
+{
+    uint32_t interval_ms;
+    bool moving;
+
+    fix_history_add(p_frame, speed_mmps);
+    advertising_update();
+
+    interval_ms = adv_interval_on_fix(minmea_tocoord(&p_frame->latitude),
+        minmea_tocoord(&p_frame->longitude), speed_mmps);
+    moving = (ADV_INTERVAL_MOVING_MS == interval_ms);
+#if BEACON_COMMAND_CHANNEL
+    if (0 != m_interval_override_ms) {
+        interval_ms = m_interval_override_ms;
+    }
+#endif
+    if (MSEC_TO_UNITS(interval_ms, UNIT_0_625_MS) != m_adv_params.interval) {
+        advertising_interval_set(interval_ms);
+    }
+
+    track_log_fix(p_frame, moving);
+#if BEACON_KALMAN_FILTER
+    predict_timer_restart(moving);
+#endif
+}
+
+/*
+ *@brief Function for refreshing the payload once after a radio event.
+ *
+ * @details The newest fix in the mailbox is advertised, or else a due prediction. Fixes
+ *          arriving faster than the advertising interval only overwrite the mailbox, so the
+ *          filter, encoding, SoftDevice update and track log run at most once per event.
+ */
+static void payload_refresh(void)
+{
+    if (!m_radio_idle) {
+        return;
+    }
+    m_radio_idle = false;
+
+#if BEACON_FLEET
+    // Every event carries the next asset in turn, see fleet.h.
+    PROFILE_START(start);
+    size_t len = fleet_payload_next(m_beacon_info);
+    PROFILE_STOP(PROFILE_PAYLOAD_ENCODE, start, 0);
+    if (0 != len) {
+        advertising_update();
+    }
+    return;
+#endif
+
+    if (m_fix_mailbox.full) {
+        m_fix_mailbox.full = false;
+        fix_advertise(&m_fix_mailbox.frame, m_fix_mailbox.speed_mmps);
+#if BEACON_COMMAND_CHANNEL
+        latency_report(m_fix_mailbox.time);
+#endif
+        return;
+    }
+#if BEACON_KALMAN_FILTER
+    if (m_predict_pending) {
+        m_predict_pending = false;
+        prediction_advertise();
+    }
+#endif
+}
+
+/*
+ *@brief Function for handling a complete NMEA line.
+ *
+ * @details The line is parsed and a valid fix is put to the mailbox, it is advertised after
+ *          the next radio event. GGA and GSA fields go to the scan response of a scannable
+ *          beacon. Command sentences are executed right away. A fleet gateway
+ *          stores asset positions and ignores its own fixes. Runs in the main loop context.
+ *
+ * @param[in]   p_line  Queued NMEA line.
+ */
+static void nmea_line_handle(nmea_line_t const* p_line)
+{
+#if BEACON_COMMAND_CHANNEL
+    if (command_line_is(p_line->data)) {
+        command_handle(p_line);
+        return;
+    }
+#endif
+#if BEACON_FLEET
+    asset_update_t update;
+
+    if (!asset_line_is(p_line->data)) {
+        return;
+    }
+    if (asset_parse(p_line->data, &update)) {
+        fleet_update(&update);
+    } else {
+        NRF_LOG_ERROR("$PBCA sentence is not parsed\n");
+    }
+    return;
+#endif
+
+    PROFILE_START(check_start);
+    enum minmea_sentence_id id = minmea_sentence_id(p_line->data, false);
+    PROFILE_STOP(PROFILE_NMEA_CHECK, check_start, p_line->len);
+
+    switch (id) {
+    case MINMEA_SENTENCE_RMC: {
+        struct minmea_sentence_rmc frame;
+        PROFILE_START(parse_start);
+        bool parsed = minmea_parse_rmc(&frame, p_line->data);
+        PROFILE_STOP(PROFILE_NMEA_PARSE, parse_start, 0);
+        if (parsed) {
+            int32_t speed = minmea_rescale(&frame.speed, 1000);
+
+            NRF_LOG_DEBUG("$xxRMC fixed-point RAW coordinates and speed: (%d,%d) %d\n",
+                frame.latitude.value, frame.longitude.value, speed);
+
+            if (!frame.valid) {
+                // Keep advertising the last fix, its time tells receivers how old it is.
+                break;
+            }
+
+            m_fix_mailbox.frame = frame;
+            // Knots to mm/s, speed is scaled by 1000.
+            m_fix_mailbox.speed_mmps = (speed > 0) ? (uint32_t)((uint64_t)speed * 514u / 1000u) : 0;
+            m_fix_mailbox.time = p_line->time;
+            m_fix_mailbox.full = true;
+        } else {
+            NRF_LOG_ERROR("$xxRMC sentence is not parsed\n");
+        }
+        break;
+    }
+#if BEACON_SCANNABLE
+    case MINMEA_SENTENCE_GGA:
+        detail_gga_handle(p_line->data);
+        break;
+    case MINMEA_SENTENCE_GSA:
+        detail_gsa_handle(p_line->data);
+        break;
+#endif
+    // TODO: Parse more data!
+    default: {
+        NRF_LOG_INFO("Unhandled header id\n");
+    }
+    }
+}
+
+/*
+ *@brief Function for handling all NMEA lines queued by the UART interrupt.
+ */
+static void nmea_process(void)
+{
+    static uint32_t dropped = 0;
+    nmea_line_t const* p_line;
+
+    while ((p_line = nmea_queue_peek()) != NULL) {
+        if ('$' == p_line->data[0]) {
+            m_nmea_lines++;
+        }
+        nmea_line_handle(p_line);
+        nmea_queue_pop();
+    }
+
+    if (dropped != nmea_queue_dropped()) {
+        dropped = nmea_queue_dropped();
+        NRF_LOG_WARNING("NMEA lines dropped: %d\n", dropped);
+    }
+}
+
+/*
+ *@brief   Function for handling libuarte events.
+ *
+ * @details Received data arrives in chunks, either when a DMA buffer is full or when the line
+ *          has been idle for UART_RX_TIMEOUT_US, so a whole NMEA burst usually costs a single
+ *          interrupt. The chunk is framed into lines queued for the main loop, nothing is parsed
+ *          here, and the DMA buffer is returned to the driver right away.
+ */
+void uart_event_handle(void* context, nrf_libuarte_async_evt_t* p_evt)
+{
+    nrf_libuarte_async_t* p_libuarte = (nrf_libuarte_async_t*)context;
+
+    switch (p_evt->type) {
+    case NRF_LIBUARTE_ASYNC_EVT_RX_DATA: {
+        PROFILE_START(start);
+        nmea_queue_write(p_evt->data.rxtx.p_data, p_evt->data.rxtx.length, app_timer_cnt_get());
+        nrf_libuarte_async_rx_free(p_libuarte, p_evt->data.rxtx.p_data, p_evt->data.rxtx.length);
+#if BEACON_UART_POWER_GATING
+        m_uart_rx = true;
+#endif
+        PROFILE_STOP(PROFILE_UART_RX, start, p_evt->data.rxtx.length);
+        break;
+    }
+#if BEACON_COMMAND_CHANNEL
+    case NRF_LIBUARTE_ASYNC_EVT_TX_DONE: {
+        m_tx_done = true;
+        break;
+    }
+#endif
+    case NRF_LIBUARTE_ASYNC_EVT_ERROR: {
+        NRF_LOG_ERROR("Communication error occurred while handling UART.\n");
+        nmea_queue_discard();
+        m_uart_errors++;
+        break;
+    }
+    case NRF_LIBUARTE_ASYNC_EVT_OVERRUN_ERROR: {
+        NRF_LOG_ERROR("All UART RX buffers are in use, data lost.\n");
+        nmea_queue_discard();
+        m_uart_errors++;
+        break;
+    }
+    default: {
+        break;
+    }
+    }
+}
+
+/*
+ *@brief Function for getting the UARTE setting of a baud rate.
+ *
+ * @details The standard rates take the values of the SDK. Any other rate is set directly:
+ *          the BAUDRATE register holds the rate in units of 16 MHz / 2^32, and the UARTE
+ *          ignores its 12 lowest bits.
+ */
+static nrf_uarte_baudrate_t uart_baudrate(uint32_t baudrate)
+{
+    switch (baudrate) {
+    case 9600:
+        return NRF_UARTE_BAUDRATE_9600;
+    case 19200:
+        return NRF_UARTE_BAUDRATE_19200;
+    case 38400:
+        return NRF_UARTE_BAUDRATE_38400;
+    case 57600:
+        return NRF_UARTE_BAUDRATE_57600;
+    case 115200:
+        return NRF_UARTE_BAUDRATE_115200;
+    case 230400:
+        return NRF_UARTE_BAUDRATE_230400;
+    case 250000:
+        return NRF_UARTE_BAUDRATE_250000;
+    case 460800:
+        return NRF_UARTE_BAUDRATE_460800;
+    case 921600:
+        return NRF_UARTE_BAUDRATE_921600;
+    case 1000000:
+        return NRF_UARTE_BAUDRATE_1000000;
+    default:
+        return (nrf_uarte_baudrate_t)(((((uint64_t)baudrate << 32) + 8000000) / 16000000) & 0xFFFFF000);
+    }
+}
+
+/*
+ *@brief Function for initializing the UART.
+ *
+ * @details UARTE receives with EasyDMA into UART_RX_BUF_COUNT buffers, the next buffer is
+ *          always armed, so the CPU is not woken up per received character. With flow control
+ *          the UARTE deasserts RTS when no buffer is left, the host then waits instead of
+ *          overrunning it.
+ */
+static void uart_init(void)
+{
+    ret_code_t err_code;
+
+    nrf_libuarte_async_config_t const config = {
+        .tx_pin = TX_PIN_NUMBER,
+        .rx_pin = RX_PIN_NUMBER,
+        .cts_pin = CTS_PIN_NUMBER,
+        .rts_pin = RTS_PIN_NUMBER,
+        .timeout_us = UART_RX_TIMEOUT_US,
+        .hwfc = BEACON_UART_HWFC ? NRF_UARTE_HWFC_ENABLED : NRF_UARTE_HWFC_DISABLED,
+        .parity = NRF_UARTE_PARITY_EXCLUDED,
+        .baudrate = uart_baudrate(BEACON_UART_BAUDRATE),
+        .int_prio = APP_IRQ_PRIORITY_LOWEST
+    };
+
+    err_code = nrf_libuarte_async_init(&m_libuarte, &config, uart_event_handle, (void*)&m_libuarte);
+    APP_ERROR_CHECK(err_code);
+
+    nrf_libuarte_async_enable(&m_libuarte);
+}
+
+#if BEACON_UART_POWER_GATING
+/*
+ *@brief Function for handling the RX pin edge while the UART is down.
+ */
+static void uart_rx_pin_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action)
+{
+    UNUSED_PARAMETER(pin);
+    UNUSED_PARAMETER(action);
+    m_uart_wake = true;
+}
+
+/*
+ *@brief Function for initializing the UART power gating, the UART is on after uart_init().
+ */
+static void uart_power_init(void)
+{
+    ret_code_t err_code;
+
+    if (!nrf_drv_gpiote_is_init()) {
+        err_code = nrf_drv_gpiote_init();
+        APP_ERROR_CHECK(err_code);
+    }
+
+    m_uart_on = true;
+    err_code = app_timer_start(m_uart_idle_timer, APP_TIMER_TICKS(UART_IDLE_OFF_MS), NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+/*
+ *@brief Function for powering the UART down, the RX pin is watched by GPIOTE.
+ *
+ * @details libuarte releases UARTE0, TIMER1, RTC2 and the PPI channels, so nothing keeps the
+ *          HFCLK running. The pin uses the low-power PORT event, which needs no HFCLK either.
+ *
+ * @param[in]   wake_ms     Time until the next expected burst less the guard, 0 if unknown.
+ */
+static void uart_power_down(uint32_t wake_ms)
+{
+    ret_code_t err_code;
+    nrf_drv_gpiote_in_config_t config = GPIOTE_CONFIG_IN_SENSE_HITOLO(false);
+
+    nrf_libuarte_async_uninit(&m_libuarte);
+    m_uart_on = false;
+
+    config.pull = NRF_GPIO_PIN_PULLUP;
+    err_code = nrf_drv_gpiote_in_init(RX_PIN_NUMBER, &config, uart_rx_pin_handler);
+    APP_ERROR_CHECK(err_code);
+    nrf_drv_gpiote_in_event_enable(RX_PIN_NUMBER, true);
+
+    if (wake_ms > 0) {
+        err_code = app_timer_start(m_uart_wake_timer, APP_TIMER_TICKS(wake_ms), NULL);
+        APP_ERROR_CHECK(err_code);
+    }
+    NRF_LOG_DEBUG("UART off, wake in %d ms\n", wake_ms);
+}
+
+/*
+ *@brief Function for powering the UART up, the RX pin goes back from GPIOTE to UARTE.
+ *
+ * @details When the RX edge woke the UART, the start of the sentence is lost while it powers
+ *          up; the framer drops characters up to the next '$', so exactly that sentence is lost.
+ */
+static void uart_power_up(void)
+{
+    ret_code_t err_code;
+
+    nrf_drv_gpiote_in_uninit(RX_PIN_NUMBER);
+    err_code = app_timer_stop(m_uart_wake_timer);
+    APP_ERROR_CHECK(err_code);
+
+    nmea_queue_resync();
+    uart_init();
+    m_uart_on = true;
+    m_uart_burst = false;
+
+    // Down again if no burst follows.
+    err_code = app_timer_start(m_uart_idle_timer, APP_TIMER_TICKS(UART_IDLE_OFF_MS), NULL);
+    APP_ERROR_CHECK(err_code);
+    NRF_LOG_DEBUG("UART on\n");
+}
+
+/*
+ *@brief Function for gating the UART power between NMEA bursts, runs in the main loop.
+ *
+ * @details A GNSS module sends a burst of sentences per fix. The start of every burst is timed
+ *          and UART_IDLE_OFF_MS after its last data the UART is powered down. When two bursts
+ *          were less than UART_BURST_PERIOD_MAX_MS apart, the UART is powered up again
+ *          UART_WAKE_GUARD_MS before the next one, so no character is lost. Otherwise the RX
+ *          edge of the burst wakes it and its first sentence is lost. A scheduled wake-up that
+ *          sees no burst forgets the period.
+ */
+static void uart_power_process(void)
+{
+    ret_code_t err_code;
+
+    if (m_uart_rx) {
+        m_uart_rx = false;
+        if (!m_uart_burst) {
+            uint32_t now = app_timer_cnt_get();
+            uint32_t period_ms = TICKS_TO_MS(app_timer_cnt_diff_compute(now, m_burst_ticks));
+
+            m_burst_period_ms = (m_burst_timed && period_ms <= UART_BURST_PERIOD_MAX_MS) ? period_ms : 0;
+            m_burst_ticks = now;
+            m_burst_timed = true;
+            m_uart_burst = true;
+        }
+        err_code = app_timer_stop(m_uart_idle_timer);
+        APP_ERROR_CHECK(err_code);
+        err_code = app_timer_start(m_uart_idle_timer, APP_TIMER_TICKS(UART_IDLE_OFF_MS), NULL);
+        APP_ERROR_CHECK(err_code);
+    }
+
+    if (m_uart_idle) {
+        uint32_t wake_ms = 0;
+
+        m_uart_idle = false;
+#if BEACON_COMMAND_CHANNEL
+        if (m_tx_busy || 0 != m_tx_count) {
+            // Answers are still going out.
+            err_code = app_timer_start(m_uart_idle_timer, APP_TIMER_TICKS(UART_IDLE_OFF_MS), NULL);
+            APP_ERROR_CHECK(err_code);
+            return;
+        }
+#endif
+        if (!m_uart_burst) {
+            m_burst_period_ms = 0;
+        }
+        m_uart_burst = false;
+
+        if (0 != m_burst_period_ms) {
+            uint32_t elapsed_ms = TICKS_TO_MS(app_timer_cnt_diff_compute(app_timer_cnt_get(), m_burst_ticks));
+            if (elapsed_ms + UART_WAKE_GUARD_MS >= m_burst_period_ms) {
+                // The next burst is due, stay powered; checked again if it does not come.
+                err_code = app_timer_start(m_uart_idle_timer, APP_TIMER_TICKS(UART_IDLE_OFF_MS), NULL);
+                APP_ERROR_CHECK(err_code);
+                return;
+            }
+            wake_ms = m_burst_period_ms - elapsed_ms - UART_WAKE_GUARD_MS;
+        }
+        uart_power_down(wake_ms);
+    }
+
+    if (m_uart_wake) {
+        m_uart_wake = false;
+        if (!m_uart_on) {
+            uart_power_up();
+        }
+    }
+}
+#endif
+
+#if BEACON_COMMAND_CHANNEL
+/*
+ *@brief Function for sending the queued sentences one after another, runs in the main loop.
+ *
+ * @details A powered-down UART is powered up for sending, it goes down again once the queue
+ *          is empty and the line has been idle for UART_IDLE_OFF_MS.
+ */
+static void uart_tx_process(void)
+{
+    ret_code_t err_code;
+
+    if (m_tx_done) {
+        m_tx_done = false;
+        m_tx_busy = false;
+        m_tx_head = (m_tx_head + 1) % UART_TX_QUEUE_SIZE;
+        m_tx_count--;
+    }
+    if (m_tx_busy || 0 == m_tx_count) {
+        return;
+    }
+#if BEACON_UART_POWER_GATING
+    if (!m_uart_on) {
+        uart_power_up();
+    }
+#endif
+
+    err_code = nrf_libuarte_async_tx(&m_libuarte, (uint8_t*)m_tx_queue[m_tx_head], m_tx_len[m_tx_head]);
+    APP_ERROR_CHECK(err_code);
+    m_tx_busy = true;
+}
+#endif
+
+/*
+ *@brief Function for handling the idle state (main loop).
+ */
+static void idle_state_handle(void)
+{
+    nmea_process();
+#if BEACON_UART_POWER_GATING
+    uart_power_process();
+#endif
+    track_log_process();
+#if BEACON_SCANNABLE
+    battery_process();
+#endif
+    payload_refresh();
+#if BEACON_COMMAND_CHANNEL
+    uart_tx_process();
+#endif
+    PROFILE_PROCESS();
+
+#if BEACON_CONNECTABLE
+    if (m_adv_restart) {
+        m_adv_restart = false;
+        advertising_start();
+    }
+#endif
+
+    if (NRF_LOG_PROCESS() == false) {
+        nrf_pwr_mgmt_run();
+    }
+}
+
+/*
+ *@brief Function for application main entry.
+ */
+int main(void)
+{
+    // Initialize. Advertising starts before the UART and the GNSS are up, with the fix
+    // restored from before the reset if there is one.
+    PROFILE_BOOT_START();
+    log_init();
+    PROFILE_BOOT_STAGE(PROFILE_BOOT_LOG);
+    timers_init();
+    PROFILE_BOOT_STAGE(PROFILE_BOOT_TIMERS);
+    PROFILE_INIT();
+    nmea_queue_init();
+    adv_interval_init();
+    kalman_init();
+    fleet_init();
     ble_stack_init();
+    PROFILE_BOOT_STAGE(PROFILE_BOOT_BLE_STACK);
+    radio_notification_init();
+    track_log_init();
+    PROFILE_BOOT_STAGE(PROFILE_BOOT_TRACK_LOG);
+#if BEACON_FIX_RESTORE
+    fix_restore();
+#endif
+#if BEACON_CONNECTABLE
+    gap_params_init();
+    gatt_init();
+#endif
     advertising_init();
+    advertising_start();
+    PROFILE_BOOT_STAGE(PROFILE_BOOT_FIRST_ADV);
+
+    uart_init();
+#if BEACON_UART_POWER_GATING
+    uart_power_init();
+#endif
+    power_management_init();
+#if BEACON_SCANNABLE
+    battery_init();
+#endif
+    PROFILE_BOOT_STAGE(PROFILE_BOOT_READY);
 
     // Start execution.
     NRF_LOG_INFO("Position Beacon Transmitter Demo Application\n");
-    advertising_start();
+    PROFILE_BOOT_DUMP();
 
     // Enter main loop.
     for (;;) {
@@ -0,0 +1,163 @@
+/*******************************************************************************
+* @brief    Lock-free queue of NMEA lines between UART and main loop.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#include "nmea_queue.h"
+
+#include "nrf.h"
+#include <string.h>
+
+#if (NMEA_QUEUE_SIZE & (NMEA_QUEUE_SIZE - 1)) != 0
+#error "NMEA_QUEUE_SIZE must be a power of two"
+#endif
+
+/*
+ * Single producer (UART interrupt) / single consumer (main loop).
+ * m_head is written by the producer only, m_tail by the consumer only,
+ * so no critical sections are needed. The producer frames directly into
+ * the pool slot m_head points to; the slot is owned by the producer until
+ * m_head is advanced.
+ */
+static nmea_line_t m_lines[NMEA_QUEUE_SIZE]; /**< Pool of line buffers. */
+static volatile uint32_t m_head = 0; /**< Number of lines published by the producer. */
+static volatile uint32_t m_tail = 0; /**< Number of lines released by the consumer. */
+static volatile uint32_t m_dropped = 0; /**< Number of lines dropped by the producer. */
+static uint16_t m_index = 0; /**< Write position in the line being framed. */
+static bool m_skip = false; /**< Current line is being dropped until 'new line'. */
+static bool m_hunt = false; /**< Characters are dropped until '$' starts a line. */
+
+void nmea_queue_init(void)
+{
+    m_head = 0;
+    m_tail = 0;
+    m_dropped = 0;
+    m_index = 0;
+    m_skip = false;
+    m_hunt = false;
+}
+
+void nmea_queue_put(uint8_t data, uint32_t time)
+{
+    if (m_hunt) {
+        if ('$' != data) {
+            return;
+        }
+        m_hunt = false;
+    }
+
+    if (0 == m_index && !m_skip && (m_head - m_tail) >= NMEA_QUEUE_SIZE) {
+        // All buffers are waiting for the main loop.
+        m_skip = true;
+    }
+
+    if (m_skip) {
+        if ('\n' == data) {
+            m_dropped++;
+            m_skip = false;
+        }
+        return;
+    }
+
+    nmea_line_t* p_line = &m_lines[m_head & (NMEA_QUEUE_SIZE - 1)];
+
+    if (m_index >= NMEA_BUFFER) {
+        // Too long for a valid sentence, drop the rest of it.
+        m_index = 0;
+        m_skip = ('\n' != data);
+        if (!m_skip) {
+            m_dropped++;
+        }
+        return;
+    }
+
+    p_line->data[m_index++] = (char)data;
+
+    if ('\n' == data) {
+        p_line->data[m_index] = '\0';
+        p_line->len = m_index;
+        p_line->time = time;
+        m_index = 0;
+
+        // Line content must be visible before the consumer sees the new head.
+        __DMB();
+        m_head = m_head + 1;
+    }
+}
+
+void nmea_queue_write(uint8_t const* p_data, size_t len, uint32_t time)
+{
+    if (m_hunt) {
+        uint8_t const* p_start = memchr(p_data, '$', len);
+        if (NULL == p_start) {
+            return;
+        }
+        len -= (size_t)(p_start - p_data);
+        p_data = p_start;
+        m_hunt = false;
+    }
+
+    while (len > 0) {
+        if (m_skip || 0 == m_index) {
+            // Line start and dropping are rare, handle them one character at a time.
+            nmea_queue_put(*p_data++, time);
+            len--;
+            continue;
+        }
+
+        uint8_t const* p_eol = memchr(p_data, '\n', len);
+        size_t run = (NULL != p_eol) ? (size_t)(p_eol - p_data) : len;
+
+        if (run > (size_t)(NMEA_BUFFER - m_index)) {
+            run = NMEA_BUFFER - m_index;
+        }
+
+        nmea_line_t* p_line = &m_lines[m_head & (NMEA_QUEUE_SIZE - 1)];
+        memcpy(&p_line->data[m_index], p_data, run);
+        m_index += run;
+        p_data += run;
+        len -= run;
+
+        if (len > 0) {
+            // 'new line' or overflow, both are handled by nmea_queue_put().
+            nmea_queue_put(*p_data++, time);
+            len--;
+        }
+    }
+}
+
+void nmea_queue_discard(void)
+{
+    m_index = 0;
+    m_skip = false;
+}
+
+void nmea_queue_resync(void)
+{
+    m_index = 0;
+    m_skip = false;
+    m_hunt = true;
+}
+
+nmea_line_t const* nmea_queue_peek(void)
+{
+    uint32_t tail = m_tail;
+
+    if (m_head == tail) {
+        return NULL;
+    }
+    __DMB();
+    return &m_lines[tail & (NMEA_QUEUE_SIZE - 1)];
+}
+
+void nmea_queue_pop(void)
+{
+    // Line content must be read before the producer may reuse the slot.
+    __DMB();
+    m_tail = m_tail + 1;
+}
+
+uint32_t nmea_queue_dropped(void)
+{
+    return m_dropped;
+}
@@ -0,0 +1,86 @@
+/*******************************************************************************
+* @brief    Lock-free queue of NMEA lines between UART and main loop.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define NMEA_BUFFER 82 /**< NMEA buffer size, maximum sentence length including <CR><LF>. */
+
+#ifndef NMEA_QUEUE_SIZE
+#define NMEA_QUEUE_SIZE 16 /**< Number of line buffers in the pool, must be a power of two; holds the lines of all RX DMA buffers. */
+#endif
+
+/*
+ *@brief Struct that contains one framed NMEA line.
+ */
+typedef struct {
+    uint16_t len; /**< Number of characters, including line ending. */
+    uint32_t time; /**< Time given with the characters that completed the line. */
+    char data[NMEA_BUFFER + 1]; /**< Zero-terminated line. */
+} nmea_line_t;
+
+/*
+ *@brief Function for resetting the queue. Must not be called while UART is running.
+ */
+void nmea_queue_init(void);
+
+/*
+ *@brief Function for appending a received character to the line being framed.
+ *
+ * @details Producer side, called from the UART interrupt only. When the character is 'new line'
+ *          the line is published to the main loop. Lines not fitting into NMEA_BUFFER, or
+ *          received while all buffers are in use, are dropped.
+ *
+ * @param[in]   data    Received character.
+ * @param[in]   time    Receive time, stored with the line it completes.
+ */
+void nmea_queue_put(uint8_t data, uint32_t time);
+
+/*
+ *@brief Function for framing a chunk of received characters.
+ *
+ * @details Producer side, same rules as nmea_queue_put(). Runs of characters without
+ *          'new line' are copied at once, so the cost is dominated by memcpy.
+ *
+ * @param[in]   p_data  Received characters.
+ * @param[in]   len     Number of characters.
+ * @param[in]   time    Receive time, stored with the lines they complete.
+ */
+void nmea_queue_write(uint8_t const* p_data, size_t len, uint32_t time);
+
+/*
+ *@brief Function for dropping the partially received line, e.g. after a UART error.
+ *
+ * @details Producer side, called from the UART interrupt only.
+ */
+void nmea_queue_discard(void);
+
+/*
+ *@brief Function for dropping characters up to the next '$', e.g. when the UART has missed
+ *       the start of a sentence. Must not be called while UART is running.
+ */
+void nmea_queue_resync(void);
+
+/*
+ *@brief Function for getting the oldest line without removing it.
+ *
+ * @details Consumer side, called from the main loop only.
+ *
+ * @return Pointer to the line, or NULL if the queue is empty.
+ */
+nmea_line_t const* nmea_queue_peek(void);
+
+/*
+ *@brief Function for releasing the line returned by nmea_queue_peek() back to the pool.
+ */
+void nmea_queue_pop(void);
+
+/*
+ *@brief Function for getting the number of lines dropped since init.
+ */
+uint32_t nmea_queue_dropped(void);
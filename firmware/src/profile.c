@@ -0,0 +1,156 @@
+/*******************************************************************************
+* @brief    Cycle-level profiling of the firmware hot paths.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#include "profile.h"
+
+#if PROFILE_ENABLED
+
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "nrf_log.h"
+#include <string.h>
+
+/*
+ *@brief Struct that contains the aggregates of one span.
+ */
+typedef struct {
+    uint32_t count; /**< Number of spans. */
+    uint32_t min; /**< Shortest span, cycles. */
+    uint32_t max; /**< Longest span, cycles. */
+    uint64_t sum; /**< Total cycles. */
+    uint32_t units; /**< Total units of work. */
+    uint32_t hist[PROFILE_HIST_BUCKETS]; /**< Log2 histogram of span length. */
+} profile_stats_t;
+
+static char const* const m_span_names[PROFILE_SPAN_COUNT] = {
+    [PROFILE_UART_RX] = "uart_rx",
+    [PROFILE_NMEA_CHECK] = "nmea_check",
+    [PROFILE_NMEA_PARSE] = "nmea_parse",
+    [PROFILE_PAYLOAD_ENCODE] = "payload_encode",
+    [PROFILE_ADV_UPDATE] = "adv_update",
+    [PROFILE_ADV_RESTART] = "adv_restart",
+    [PROFILE_KALMAN_UPDATE] = "kalman_update",
+    [PROFILE_KALMAN_PREDICT] = "kalman_predict",
+};
+
+static char const* const m_boot_stage_names[PROFILE_BOOT_STAGE_COUNT] = {
+    [PROFILE_BOOT_LOG] = "log",
+    [PROFILE_BOOT_TIMERS] = "timers",
+    [PROFILE_BOOT_BLE_STACK] = "ble_stack",
+    [PROFILE_BOOT_TRACK_LOG] = "track_log",
+    [PROFILE_BOOT_FIRST_ADV] = "first_adv",
+    [PROFILE_BOOT_READY] = "ready",
+};
+
+static profile_stats_t m_stats[PROFILE_SPAN_COUNT]; /**< Aggregates since the last dump. */
+static uint32_t m_boot_start = 0; /**< Cycle counter at main() entry. */
+static uint32_t m_boot_cycles[PROFILE_BOOT_STAGE_COUNT]; /**< Cycles from main() entry to the end of every stage. */
+static volatile bool m_dump_pending = false; /**< Dump timer has expired. */
+static uint32_t m_dump_seq = 0; /**< Number of dumps written. */
+
+APP_TIMER_DEF(m_dump_timer);
+
+static void dump_timer_handler(void* p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    m_dump_pending = true;
+}
+
+/*
+ *@brief Function for enabling the cycle counter, it keeps counting from its current value.
+ */
+static void cycle_counter_enable(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void profile_boot_start(void)
+{
+    cycle_counter_enable();
+    m_boot_start = DWT->CYCCNT;
+}
+
+void profile_boot_stage(profile_boot_stage_t stage)
+{
+    m_boot_cycles[stage] = DWT->CYCCNT - m_boot_start;
+}
+
+void profile_boot_dump(void)
+{
+    NRF_LOG_INFO("PROF boot clock=%u\n", SystemCoreClock);
+    for (uint32_t stage = 0; stage < PROFILE_BOOT_STAGE_COUNT; stage++) {
+        NRF_LOG_INFO("PROF boot %s=%u\n", m_boot_stage_names[stage], m_boot_cycles[stage]);
+    }
+}
+
+void profile_init(void)
+{
+    ret_code_t err_code;
+
+    // Spans are differences, the counter is not cleared so the boot stages stay valid.
+    cycle_counter_enable();
+
+    memset(m_stats, 0, sizeof(m_stats));
+
+    err_code = app_timer_create(&m_dump_timer, APP_TIMER_MODE_REPEATED, dump_timer_handler);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = app_timer_start(m_dump_timer, APP_TIMER_TICKS(PROFILE_DUMP_INTERVAL_MS), NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+void profile_record(profile_span_t span, uint32_t cycles, uint32_t units)
+{
+    profile_stats_t* p_stats = &m_stats[span];
+    uint32_t bucket = (0 == cycles) ? 0 : 31 - __CLZ(cycles);
+
+    if (0 == p_stats->count || cycles < p_stats->min) {
+        p_stats->min = cycles;
+    }
+    if (cycles > p_stats->max) {
+        p_stats->max = cycles;
+    }
+    p_stats->count++;
+    p_stats->sum += cycles;
+    p_stats->units += units;
+    p_stats->hist[MIN(bucket, PROFILE_HIST_BUCKETS - 1)]++;
+}
+
+void profile_process(void)
+{
+    if (!m_dump_pending) {
+        return;
+    }
+    m_dump_pending = false;
+
+    // Copy first, spans recorded from interrupts keep going into the cleared aggregates.
+    static profile_stats_t stats[PROFILE_SPAN_COUNT];
+    CRITICAL_REGION_ENTER();
+    memcpy(stats, m_stats, sizeof(stats));
+    memset(m_stats, 0, sizeof(m_stats));
+    CRITICAL_REGION_EXIT();
+
+    NRF_LOG_INFO("PROF dump=%u clock=%u window_ms=%u\n", m_dump_seq++, SystemCoreClock, PROFILE_DUMP_INTERVAL_MS);
+
+    for (uint32_t span = 0; span < PROFILE_SPAN_COUNT; span++) {
+        profile_stats_t const* p_stats = &stats[span];
+        if (0 == p_stats->count) {
+            continue;
+        }
+
+        NRF_LOG_INFO("PROF %s n=%u min=%u mean=%u max=%u\n", m_span_names[span], p_stats->count,
+            p_stats->min, (uint32_t)(p_stats->sum / p_stats->count), p_stats->max);
+        if (p_stats->units > 0) {
+            NRF_LOG_INFO("PROF %s units=%u cycles=%u\n", m_span_names[span], p_stats->units, (uint32_t)p_stats->sum);
+        }
+        for (uint32_t i = 0; i < PROFILE_HIST_BUCKETS; i += 4) {
+            NRF_LOG_INFO("PROF %s h%u=%u,%u,%u,%u\n", m_span_names[span], i,
+                p_stats->hist[i], p_stats->hist[i + 1], p_stats->hist[i + 2], p_stats->hist[i + 3]);
+        }
+    }
+}
+
+#endif // PROFILE_ENABLED
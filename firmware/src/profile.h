@@ -0,0 +1,116 @@
+/*******************************************************************************
+* @brief    Cycle-level profiling of the firmware hot paths.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*
+* Spans are timed with the DWT cycle counter and aggregated in RAM (count,
+* min, mean, max and a log2 histogram). Every PROFILE_DUMP_INTERVAL_MS the
+* aggregates are written to the log, i.e. RTT, as "PROF" lines and reset;
+* firmware/tools/profile_decode.py turns them into tables.
+* The boot is profiled once: the cycle count from main() entry to the end of
+* every init stage is written as "PROF boot" lines when the main loop starts.
+* With PROFILE_ENABLED 0 all macros compile to nothing.
+*******************************************************************************/
+#pragma once
+
+#include "nrf.h"
+#include "sdk_common.h"
+#include <stdint.h>
+
+#ifndef PROFILE_ENABLED
+#define PROFILE_ENABLED 0 /**< Build with hot-path profiling. */
+#endif
+
+#ifndef PROFILE_DUMP_INTERVAL_MS
+#define PROFILE_DUMP_INTERVAL_MS 10000 /**< Period of the aggregate dump, ms. */
+#endif
+
+#define PROFILE_HIST_BUCKETS 16 /**< Bucket i counts spans of 2^i..2^(i+1)-1 cycles, the last one everything longer. */
+
+/*
+ *@brief Profiled spans.
+ */
+typedef enum {
+    PROFILE_UART_RX, /**< libuarte RX chunk framed into lines, units are bytes. */
+    PROFILE_NMEA_CHECK, /**< Sentence identification and checksum, units are bytes. */
+    PROFILE_NMEA_PARSE, /**< RMC parsing. */
+    PROFILE_PAYLOAD_ENCODE, /**< Fix history update and payload encoding. */
+    PROFILE_ADV_UPDATE, /**< Advertising data update, sd_ble_gap_adv_set_configure(). */
+    PROFILE_ADV_RESTART, /**< Advertising restart with a new interval. */
+    PROFILE_KALMAN_UPDATE, /**< Kalman filter update with a fix. */
+    PROFILE_KALMAN_PREDICT, /**< Position extrapolation and payload encoding between fixes. */
+    PROFILE_SPAN_COUNT
+} profile_span_t;
+
+/*
+ *@brief Boot stages, in the order main() completes them.
+ */
+typedef enum {
+    PROFILE_BOOT_LOG, /**< Logging initialized. */
+    PROFILE_BOOT_TIMERS, /**< app_timer initialized. */
+    PROFILE_BOOT_BLE_STACK, /**< SoftDevice enabled, includes the low-frequency clock start. */
+    PROFILE_BOOT_TRACK_LOG, /**< Track log head and tail found in flash. */
+    PROFILE_BOOT_FIRST_ADV, /**< Advertising started, the first advert is on air. */
+    PROFILE_BOOT_READY, /**< UART and the remaining modules initialized, the main loop starts. */
+    PROFILE_BOOT_STAGE_COUNT
+} profile_boot_stage_t;
+
+#if PROFILE_ENABLED
+
+/*
+ *@brief Function for enabling the cycle counter and taking the boot start, first thing in main().
+ */
+void profile_boot_start(void);
+
+/*
+ *@brief Function for recording the end of a boot stage.
+ */
+void profile_boot_stage(profile_boot_stage_t stage);
+
+/*
+ *@brief Function for writing the boot stages to the log, once the main loop is about to start.
+ */
+void profile_boot_dump(void);
+
+/*
+ *@brief Function for enabling the cycle counter and starting the dump timer.
+ *
+ * @details Requires app_timer to be initialized.
+ */
+void profile_init(void);
+
+/*
+ *@brief Function for adding a measured span to the aggregates.
+ *
+ * @param[in]   span    Span identifier.
+ * @param[in]   cycles  Duration, CPU cycles.
+ * @param[in]   units   Amount of work done in the span (bytes), 0 if not applicable.
+ */
+void profile_record(profile_span_t span, uint32_t cycles, uint32_t units);
+
+/*
+ *@brief Function for writing the aggregates to the log when the dump timer has expired.
+ *
+ * @details Called from the main loop, so logging does not run in interrupt context.
+ */
+void profile_process(void);
+
+#define PROFILE_BOOT_START() profile_boot_start()
+#define PROFILE_BOOT_STAGE(stage) profile_boot_stage(stage)
+#define PROFILE_BOOT_DUMP() profile_boot_dump()
+#define PROFILE_INIT() profile_init()
+#define PROFILE_PROCESS() profile_process()
+#define PROFILE_START(name) uint32_t name = DWT->CYCCNT
+#define PROFILE_STOP(span, name, units) profile_record((span), DWT->CYCCNT - (name), (units))
+
+#else
+
+#define PROFILE_BOOT_START()
+#define PROFILE_BOOT_STAGE(stage)
+#define PROFILE_BOOT_DUMP()
+#define PROFILE_INIT()
+#define PROFILE_PROCESS()
+#define PROFILE_START(name)
+#define PROFILE_STOP(span, name, units)
+
+#endif
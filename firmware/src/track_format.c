@@ -0,0 +1,70 @@
+/*******************************************************************************
+* @brief    Track log record and bulk download protocol, shared by firmware and host.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#include "track_format.h"
+
+#define CHECK_SEED 0xA5 /**< Check byte of an all-zero record is not 0, of an erased one not 0xFF. */
+
+static void put_uint32(uint8_t* p_buf, uint32_t value)
+{
+    p_buf[0] = (uint8_t)value;
+    p_buf[1] = (uint8_t)(value >> 8);
+    p_buf[2] = (uint8_t)(value >> 16);
+    p_buf[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get_uint32(uint8_t const* p_buf)
+{
+    return (uint32_t)p_buf[0] | ((uint32_t)p_buf[1] << 8)
+        | ((uint32_t)p_buf[2] << 16) | ((uint32_t)p_buf[3] << 24);
+}
+
+static uint8_t check_byte(uint8_t const* p_buf)
+{
+    uint8_t check = CHECK_SEED;
+
+    for (size_t i = 0; i < TRACK_RECORD_SIZE - 1; i++) {
+        check = (uint8_t)((check << 1) | (check >> 7)) ^ p_buf[i];
+    }
+    return check;
+}
+
+uint32_t track_unix_time(int year, int month, int day, uint32_t seconds)
+{
+    // Days from civil, proleptic Gregorian calendar with March as the first month.
+    int y = year - (month <= 2);
+    int era = y / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int32_t days = era * 146097 + doe - 719468;
+
+    return (uint32_t)days * 86400u + seconds;
+}
+
+void track_record_encode(uint8_t* p_buf, track_record_t const* p_record)
+{
+    put_uint32(&p_buf[0], p_record->time);
+    put_uint32(&p_buf[4], (uint32_t)p_record->latitude);
+    put_uint32(&p_buf[8], (uint32_t)p_record->longitude);
+    p_buf[12] = p_record->speed;
+    p_buf[13] = p_record->course;
+    p_buf[14] = 0xFF;
+    p_buf[15] = check_byte(p_buf);
+}
+
+bool track_record_decode(uint8_t const* p_buf, track_record_t* p_record)
+{
+    if (p_buf[15] != check_byte(p_buf)) {
+        return false;
+    }
+
+    p_record->time = get_uint32(&p_buf[0]);
+    p_record->latitude = (int32_t)get_uint32(&p_buf[4]);
+    p_record->longitude = (int32_t)get_uint32(&p_buf[8]);
+    p_record->speed = p_buf[12];
+    p_record->course = p_buf[13];
+    return true;
+}
@@ -0,0 +1,98 @@
+/*******************************************************************************
+* @brief    Track log record and bulk download protocol, shared by firmware and host.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*
+* Record (TRACK_RECORD_SIZE bytes, little endian):
+*   0  uint32  UTC time of the fix, seconds since 1970-01-01
+*   4  int32   latitude, 1e-7 degree
+*   8  int32   longitude, 1e-7 degree
+*  12  uint8   speed over ground, BEACON_SPEED_UNIT_MMPS
+*  13  uint8   course over ground, 360/256 degree
+*  14  uint8   reserved, 0xFF
+*  15  uint8   check byte, detects records torn by a reset during the flash write
+* Records are addressed by a log index that keeps growing across resets.
+*
+* GATT service TRACK_UUID_SERVICE:
+*   control (write, notify): TRACK_OP_* request, answered with a notification
+*           { opcode, status, uint32 first index, uint32 end index }
+*   data (notify): { uint32 index of the first record, records... }; a packet
+*           with the index only marks the end of the transfer, index is then
+*           the end index (or the byte count for TRACK_OP_BENCH)
+*******************************************************************************/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACK_RECORD_SIZE 16 /**< Size of a record in flash and in download packets. */
+#define TRACK_TIME_UNKNOWN 0 /**< Record time when the NMEA date or time was empty. */
+
+#define TRACK_UUID_BASE { 0x10, 0x8F, 0x7D, 0x4A, 0x1C, 0x5E, 0x2B, 0x9D, 0x3C, 0x4F, 0x5E, 0x6C, 0x00, 0x00, 0xA3, 0xB5 } /**< b5a3xxxx-6c5e-4f3c-9d2b-5e1c4a7d8f10, little endian. */
+#define TRACK_UUID_SERVICE 0x0001 /**< Track download service. */
+#define TRACK_UUID_CONTROL 0x0002 /**< Control point characteristic. */
+#define TRACK_UUID_DATA 0x0003 /**< Data characteristic. */
+
+#define TRACK_PACKET_HEADER_LEN 4 /**< Index in front of the records of a data packet. */
+#define TRACK_CONTROL_RSP_LEN 10 /**< Length of a control point response. */
+
+/*
+ *@brief Control point opcodes.
+ */
+enum {
+    TRACK_OP_DOWNLOAD = 0x01, /**< uint32 first index: stream records from it to the current end. */
+    TRACK_OP_ABORT = 0x02, /**< Stop the running transfer. */
+    TRACK_OP_BENCH = 0x03, /**< uint32 byte count: stream filler packets, for throughput tests. */
+};
+
+/*
+ *@brief Control point response status.
+ */
+enum {
+    TRACK_STATUS_OK = 0x00,
+    TRACK_STATUS_BUSY = 0x01, /**< A transfer is running. */
+    TRACK_STATUS_INVALID = 0x02, /**< Unknown opcode or wrong length. */
+    TRACK_STATUS_NOTIFY_DISABLED = 0x03, /**< Notifications of the data characteristic are off. */
+};
+
+/*
+ *@brief Struct that contains one track record.
+ */
+typedef struct {
+    uint32_t time; /**< UTC, seconds since 1970-01-01, or TRACK_TIME_UNKNOWN. */
+    int32_t latitude; /**< Latitude, 1e-7 degree. */
+    int32_t longitude; /**< Longitude, 1e-7 degree. */
+    uint8_t speed; /**< Speed over ground, BEACON_SPEED_UNIT_MMPS. */
+    uint8_t course; /**< Course over ground, 360/256 degree. */
+} track_record_t;
+
+/*
+ *@brief Function for converting a UTC calendar date and time to seconds since 1970-01-01.
+ *
+ * @param[in]   year    Year, e.g. 2019.
+ * @param[in]   month   Month, 1..12.
+ * @param[in]   day     Day of month, 1..31.
+ * @param[in]   seconds Seconds since midnight.
+ */
+uint32_t track_unix_time(int year, int month, int day, uint32_t seconds);
+
+/*
+ *@brief Function for encoding a record, TRACK_RECORD_SIZE bytes.
+ */
+void track_record_encode(uint8_t* p_buf, track_record_t const* p_record);
+
+/*
+ *@brief Function for decoding a record.
+ *
+ * @return false if the record is erased or torn.
+ */
+bool track_record_decode(uint8_t const* p_buf, track_record_t* p_record);
+
+#ifdef __cplusplus
+}
+#endif
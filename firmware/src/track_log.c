@@ -0,0 +1,292 @@
+/*******************************************************************************
+* @brief    Append-only ring log of fixes in flash.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#include "track_log.h"
+
+#include "nrf_fstorage.h"
+#include "nrf_fstorage_sd.h"
+#include "nrf_log.h"
+#include "sdk_common.h"
+#include <string.h>
+
+#define PAGE_MAGIC 0x314B5254 /**< "TRK1". */
+
+#define PAGE_ADDR(seq) (TRACK_LOG_START_ADDR + ((seq) % TRACK_LOG_PAGES) * TRACK_LOG_PAGE_SIZE)
+#define RECORD_ADDR(seq, slot) (PAGE_ADDR(seq) + TRACK_LOG_PAGE_HEADER_SIZE + (slot) * TRACK_RECORD_SIZE)
+
+/*
+ *@brief Flash operation in progress.
+ */
+typedef enum {
+    LOG_OP_NONE,
+    LOG_OP_ERASE, /**< Erasing the page m_end points to. */
+    LOG_OP_HEADER, /**< Writing the header of that page. */
+    LOG_OP_RECORD, /**< Writing the record at the queue tail. */
+} log_op_t;
+
+static void fstorage_evt_handler(nrf_fstorage_evt_t* p_evt);
+
+NRF_FSTORAGE_DEF(nrf_fstorage_t m_fstorage) = {
+    .evt_handler = fstorage_evt_handler,
+    .start_addr = TRACK_LOG_START_ADDR,
+    .end_addr = TRACK_LOG_START_ADDR + TRACK_LOG_PAGES * TRACK_LOG_PAGE_SIZE,
+};
+
+/*
+ * The queue and the write state belong to the main loop. The fstorage handler,
+ * called from the SoftDevice event interrupt, only posts the result. Readers in
+ * other contexts see the log bounds through the single words m_first and m_end.
+ */
+static track_record_t m_queue[TRACK_LOG_QUEUE_SIZE]; /**< Records waiting for flash. */
+static uint32_t m_queue_tail = 0; /**< Oldest queued record. */
+static uint32_t m_queue_count = 0; /**< Number of queued records. */
+static uint32_t m_write_buf[TRACK_RECORD_SIZE / sizeof(uint32_t)]; /**< Source of the write in progress, word aligned. */
+
+static log_op_t m_op = LOG_OP_NONE; /**< Operation in progress. */
+static volatile bool m_op_done = false; /**< Operation has completed. */
+static volatile ret_code_t m_op_result = NRF_SUCCESS; /**< Result of the completed operation. */
+
+static volatile uint32_t m_first = 0; /**< Index of the oldest record. */
+static volatile uint32_t m_end = 0; /**< Index of the next record to write. */
+static bool m_page_ready = false; /**< Page m_end points to is erased and has a header. */
+static uint32_t m_dropped = 0; /**< Records lost to a full queue or a failed write. */
+
+static void fstorage_evt_handler(nrf_fstorage_evt_t* p_evt)
+{
+    m_op_result = p_evt->result;
+    m_op_done = true;
+}
+
+/*
+ *@brief Function for reading a page header.
+ *
+ * @return true if the page has a valid header, its page sequence number is stored in p_seq.
+ */
+static bool page_header_read(uint32_t page, uint32_t* p_seq)
+{
+    uint32_t header[2];
+    ret_code_t err_code;
+
+    err_code = nrf_fstorage_read(&m_fstorage, TRACK_LOG_START_ADDR + page * TRACK_LOG_PAGE_SIZE, header, sizeof(header));
+    APP_ERROR_CHECK(err_code);
+
+    if (PAGE_MAGIC != header[0] || page != header[1] % TRACK_LOG_PAGES) {
+        return false;
+    }
+    *p_seq = header[1];
+    return true;
+}
+
+/*
+ *@brief Function for finding the newest page, the next free slot in it and the oldest page.
+ */
+static void log_scan(void)
+{
+    uint32_t newest = 0;
+    bool found = false;
+    uint32_t seq;
+
+    for (uint32_t page = 0; page < TRACK_LOG_PAGES; page++) {
+        if (page_header_read(page, &seq) && (!found || seq > newest)) {
+            newest = seq;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        NRF_LOG_INFO("Track log is empty\n");
+        return;
+    }
+
+    // Pages older than the newest one, as long as none is missing.
+    uint32_t oldest = newest;
+    while (oldest > 0 && newest - (oldest - 1) < TRACK_LOG_PAGES
+        && page_header_read((oldest - 1) % TRACK_LOG_PAGES, &seq) && oldest - 1 == seq) {
+        oldest--;
+    }
+
+    // Slots after the last one written are erased, a torn record in between is skipped.
+    uint32_t slot = TRACK_LOG_RECORDS_PER_PAGE;
+    while (slot > 0) {
+        uint32_t record[TRACK_RECORD_SIZE / sizeof(uint32_t)];
+        ret_code_t err_code = nrf_fstorage_read(&m_fstorage, RECORD_ADDR(newest, slot - 1), record, sizeof(record));
+        APP_ERROR_CHECK(err_code);
+
+        if (record[0] != UINT32_MAX || record[1] != UINT32_MAX || record[2] != UINT32_MAX || record[3] != UINT32_MAX) {
+            break;
+        }
+        slot--;
+    }
+
+    m_first = oldest * TRACK_LOG_RECORDS_PER_PAGE;
+    m_end = newest * TRACK_LOG_RECORDS_PER_PAGE + slot;
+    m_page_ready = (slot < TRACK_LOG_RECORDS_PER_PAGE);
+
+    NRF_LOG_INFO("Track log: records %d..%d\n", m_first, track_log_end());
+}
+
+/*
+ *@brief Function for starting the next flash operation, if any.
+ */
+static void op_start(void)
+{
+    ret_code_t err_code;
+
+    if (LOG_OP_NONE != m_op || 0 == m_queue_count) {
+        return;
+    }
+
+    uint32_t seq = m_end / TRACK_LOG_RECORDS_PER_PAGE;
+
+    if (!m_page_ready) {
+        // The page to be erased holds the oldest records.
+        if (seq >= TRACK_LOG_PAGES) {
+            m_first = MAX(m_first, (seq - TRACK_LOG_PAGES + 1) * TRACK_LOG_RECORDS_PER_PAGE);
+        }
+        err_code = nrf_fstorage_erase(&m_fstorage, PAGE_ADDR(seq), 1, NULL);
+        m_op = LOG_OP_ERASE;
+    } else {
+        track_record_encode((uint8_t*)m_write_buf, &m_queue[m_queue_tail]);
+        err_code = nrf_fstorage_write(&m_fstorage, RECORD_ADDR(seq, m_end % TRACK_LOG_RECORDS_PER_PAGE),
+            m_write_buf, TRACK_RECORD_SIZE, NULL);
+        m_op = LOG_OP_RECORD;
+    }
+
+    if (NRF_SUCCESS != err_code) {
+        // fstorage queue is full, other users are writing; retried from the main loop.
+        m_op = LOG_OP_NONE;
+    }
+}
+
+/*
+ *@brief Function for releasing the oldest queued record.
+ */
+static void queue_pop(bool written)
+{
+    m_queue_tail = (m_queue_tail + 1) % TRACK_LOG_QUEUE_SIZE;
+    m_queue_count--;
+    if (!written) {
+        m_dropped++;
+    }
+}
+
+/*
+ *@brief Function for handling a completed flash operation.
+ */
+static void op_complete(ret_code_t result)
+{
+    log_op_t op = m_op;
+    uint32_t seq = m_end / TRACK_LOG_RECORDS_PER_PAGE;
+    ret_code_t err_code;
+
+    m_op = LOG_OP_NONE;
+
+    if (NRF_SUCCESS != result) {
+        NRF_LOG_ERROR("Track log flash operation %d failed: 0x%x\n", op, result);
+    }
+
+    switch (op) {
+    case LOG_OP_ERASE:
+        if (NRF_SUCCESS != result) {
+            // Give up on this record so a dead page does not stall the queue; the erase is retried.
+            queue_pop(false);
+            break;
+        }
+        m_write_buf[0] = PAGE_MAGIC;
+        m_write_buf[1] = seq;
+        m_write_buf[2] = UINT32_MAX;
+        m_write_buf[3] = UINT32_MAX;
+        err_code = nrf_fstorage_write(&m_fstorage, PAGE_ADDR(seq), m_write_buf, TRACK_LOG_PAGE_HEADER_SIZE, NULL);
+        if (NRF_SUCCESS == err_code) {
+            m_op = LOG_OP_HEADER;
+        }
+        // Otherwise the page is erased again on the next attempt.
+        break;
+    case LOG_OP_HEADER:
+        // Without a header the page is lost after a reset, but it is still usable until then.
+        m_page_ready = true;
+        break;
+    case LOG_OP_RECORD:
+        // A failed slot stays unreadable, it is skipped.
+        queue_pop(NRF_SUCCESS == result);
+        m_end++;
+        m_page_ready = (0 != m_end % TRACK_LOG_RECORDS_PER_PAGE);
+        break;
+    default:
+        break;
+    }
+}
+
+void track_log_init(void)
+{
+    ret_code_t err_code;
+
+    err_code = nrf_fstorage_init(&m_fstorage, &nrf_fstorage_sd, NULL);
+    APP_ERROR_CHECK(err_code);
+
+    m_queue_tail = 0;
+    m_queue_count = 0;
+    m_op = LOG_OP_NONE;
+    m_op_done = false;
+    m_first = 0;
+    m_end = 0;
+    m_page_ready = false;
+    m_dropped = 0;
+
+    log_scan();
+}
+
+void track_log_append(track_record_t const* p_record)
+{
+    if (m_queue_count >= TRACK_LOG_QUEUE_SIZE) {
+        m_dropped++;
+        return;
+    }
+    m_queue[(m_queue_tail + m_queue_count) % TRACK_LOG_QUEUE_SIZE] = *p_record;
+    m_queue_count++;
+
+    op_start();
+}
+
+void track_log_process(void)
+{
+    if (m_op_done) {
+        m_op_done = false;
+        op_complete(m_op_result);
+    }
+    op_start();
+}
+
+uint32_t track_log_first(void)
+{
+    return m_first;
+}
+
+uint32_t track_log_end(void)
+{
+    return m_end;
+}
+
+bool track_log_read(uint32_t index, track_record_t* p_record)
+{
+    uint32_t record[TRACK_RECORD_SIZE / sizeof(uint32_t)];
+    ret_code_t err_code;
+
+    if (index < m_first || index >= m_end) {
+        return false;
+    }
+
+    err_code = nrf_fstorage_read(&m_fstorage,
+        RECORD_ADDR(index / TRACK_LOG_RECORDS_PER_PAGE, index % TRACK_LOG_RECORDS_PER_PAGE), record, sizeof(record));
+    if (NRF_SUCCESS != err_code) {
+        return false;
+    }
+    return track_record_decode((uint8_t const*)record, p_record);
+}
+
+uint32_t track_log_dropped(void)
+{
+    return m_dropped;
+}
@@ -0,0 +1,83 @@
+/*******************************************************************************
+* @brief    Append-only ring log of fixes in flash.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*
+* The log occupies TRACK_LOG_PAGES flash pages above the application. Every
+* page starts with a header { magic, page sequence number } followed by
+* TRACK_LOG_RECORDS_PER_PAGE records, see track_format.h. Page sequence number
+* s lives in page s % TRACK_LOG_PAGES and holds the records with log index
+* s * TRACK_LOG_RECORDS_PER_PAGE + slot, so indexes keep growing across resets
+* and the oldest page is erased when the writer wraps around.
+*
+* Flash operations go through fstorage, which schedules them with the
+* SoftDevice between radio events. They run one at a time, driven from the
+* main loop by track_log_process(); fixes arriving meanwhile wait in a small
+* RAM queue.
+*******************************************************************************/
+#pragma once
+
+#include "track_format.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef TRACK_LOG_START_ADDR
+#define TRACK_LOG_START_ADDR 0x60000 /**< First flash page of the log, FLASH_SIZE of the application ends here. */
+#endif
+
+#ifndef TRACK_LOG_PAGES
+#define TRACK_LOG_PAGES 32 /**< Number of flash pages, 8160 records, more than two hours at 1 Hz. */
+#endif
+
+#ifndef TRACK_LOG_QUEUE_SIZE
+#define TRACK_LOG_QUEUE_SIZE 8 /**< Records waiting for a flash write, an erase takes up to 90 ms. */
+#endif
+
+#ifndef TRACK_LOG_STATIONARY_INTERVAL_S
+#define TRACK_LOG_STATIONARY_INTERVAL_S 60 /**< Period of logged fixes while stationary, every fix is logged while moving. */
+#endif
+
+#define TRACK_LOG_PAGE_SIZE 4096 /**< nRF52 flash page. */
+#define TRACK_LOG_PAGE_HEADER_SIZE TRACK_RECORD_SIZE /**< Page header, keeps the records aligned. */
+#define TRACK_LOG_RECORDS_PER_PAGE ((TRACK_LOG_PAGE_SIZE - TRACK_LOG_PAGE_HEADER_SIZE) / TRACK_RECORD_SIZE)
+
+/*
+ *@brief Function for initializing fstorage and finding the head and the tail of the log.
+ *
+ * @details Must be called after the SoftDevice is enabled.
+ */
+void track_log_init(void);
+
+/*
+ *@brief Function for queueing a record for writing.
+ *
+ * @details The record is dropped, and counted, if the queue is full.
+ */
+void track_log_append(track_record_t const* p_record);
+
+/*
+ *@brief Function for completing flash operations and starting the next one, call from the main loop.
+ */
+void track_log_process(void);
+
+/*
+ *@brief Function for getting the index of the oldest record in the log.
+ */
+uint32_t track_log_first(void);
+
+/*
+ *@brief Function for getting the index following the newest record written to flash.
+ */
+uint32_t track_log_end(void);
+
+/*
+ *@brief Function for reading a record.
+ *
+ * @return false if the index is outside the log or the record was torn by a reset.
+ */
+bool track_log_read(uint32_t index, track_record_t* p_record);
+
+/*
+ *@brief Function for getting the number of records dropped since boot.
+ */
+uint32_t track_log_dropped(void);
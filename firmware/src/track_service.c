@@ -0,0 +1,317 @@
+/*******************************************************************************
+* @brief    GATT service for bulk download of the track log.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#include "track_service.h"
+
+#include "sdk_common.h"
+
+#if BEACON_CONNECTABLE
+
+#include "ble.h"
+#include "ble_srv_common.h"
+#include "nrf_log.h"
+#include "nrf_sdh_ble.h"
+#include "track_format.h"
+#include "track_log.h"
+#include <string.h>
+
+#define PACKET_MAX (NRF_SDH_BLE_GATT_MAX_MTU_SIZE - 3) /**< Largest notification, ATT MTU less the ATT header. */
+#define BENCH_FILL 0x5A /**< Filler byte of benchmark packets. */
+
+/*
+ *@brief Transfer in progress.
+ */
+typedef enum {
+    TRANSFER_NONE,
+    TRANSFER_DOWNLOAD, /**< Records m_transfer.next..m_transfer.end. */
+    TRANSFER_BENCH, /**< m_transfer.end bytes of filler, m_transfer.next bytes sent. */
+} transfer_mode_t;
+
+/*
+ *@brief Struct that contains the state of the transfer.
+ */
+typedef struct {
+    transfer_mode_t mode;
+    uint32_t next; /**< Next record index, or bytes sent. */
+    uint32_t end; /**< End record index, or bytes to send. */
+    uint8_t packet[PACKET_MAX]; /**< Packet built but not yet accepted by the SoftDevice. */
+    uint16_t packet_len; /**< Length of the pending packet, 0 if none. */
+    bool last; /**< Pending packet is the end marker. */
+} transfer_t;
+
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context);
+
+NRF_SDH_BLE_OBSERVER(m_track_service_obs, TRACK_SERVICE_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
+
+static uint8_t m_uuid_type; /**< Vendor specific UUID type of TRACK_UUID_BASE. */
+static uint16_t m_service_handle; /**< Handle of the service. */
+static ble_gatts_char_handles_t m_control_handles; /**< Handles of the control point. */
+static ble_gatts_char_handles_t m_data_handles; /**< Handles of the data characteristic. */
+static uint16_t m_conn_handle = BLE_CONN_HANDLE_INVALID; /**< Current connection. */
+static uint16_t m_payload_max = BLE_GATT_ATT_MTU_DEFAULT - 3; /**< Notification size for the current MTU. */
+static bool m_data_notify = false; /**< Notifications of the data characteristic are enabled. */
+static transfer_t m_transfer; /**< Transfer in progress. */
+
+static void put_uint32(uint8_t* p_buf, uint32_t value)
+{
+    p_buf[0] = (uint8_t)value;
+    p_buf[1] = (uint8_t)(value >> 8);
+    p_buf[2] = (uint8_t)(value >> 16);
+    p_buf[3] = (uint8_t)(value >> 24);
+}
+
+/*
+ *@brief Function for sending a notification.
+ */
+static uint32_t notify(uint16_t handle, uint8_t const* p_data, uint16_t len)
+{
+    ble_gatts_hvx_params_t hvx_params;
+
+    memset(&hvx_params, 0, sizeof(hvx_params));
+    hvx_params.handle = handle;
+    hvx_params.type = BLE_GATT_HVX_NOTIFICATION;
+    hvx_params.p_len = &len;
+    hvx_params.p_data = p_data;
+
+    return sd_ble_gatts_hvx(m_conn_handle, &hvx_params);
+}
+
+/*
+ *@brief Function for building the next download packet.
+ *
+ * @details Records that can not be read, torn ones or ones overwritten by the ring
+ *          since the transfer started, are skipped; a packet always holds consecutive records.
+ */
+static void download_packet_build(void)
+{
+    track_record_t record;
+    uint32_t first = track_log_first();
+    uint16_t len = TRACK_PACKET_HEADER_LEN;
+
+    if (m_transfer.next < first) {
+        m_transfer.next = first;
+    }
+    while (m_transfer.next < m_transfer.end && !track_log_read(m_transfer.next, &record)) {
+        m_transfer.next++;
+    }
+
+    put_uint32(m_transfer.packet, m_transfer.next);
+    if (m_transfer.next >= m_transfer.end) {
+        put_uint32(m_transfer.packet, m_transfer.end);
+        m_transfer.last = true;
+    }
+
+    while (!m_transfer.last && len + TRACK_RECORD_SIZE <= m_payload_max) {
+        track_record_encode(&m_transfer.packet[len], &record);
+        len += TRACK_RECORD_SIZE;
+        m_transfer.next++;
+        if (m_transfer.next >= m_transfer.end || !track_log_read(m_transfer.next, &record)) {
+            break;
+        }
+    }
+    m_transfer.packet_len = len;
+}
+
+/*
+ *@brief Function for building the next benchmark packet.
+ */
+static void bench_packet_build(void)
+{
+    uint32_t left = m_transfer.end - m_transfer.next;
+    uint16_t len = (uint16_t)MIN(m_payload_max, left);
+
+    put_uint32(m_transfer.packet, m_transfer.next);
+    if (len <= TRACK_PACKET_HEADER_LEN) {
+        m_transfer.packet_len = TRACK_PACKET_HEADER_LEN;
+        m_transfer.last = true;
+        return;
+    }
+    memset(&m_transfer.packet[TRACK_PACKET_HEADER_LEN], BENCH_FILL, len - TRACK_PACKET_HEADER_LEN);
+    m_transfer.next += len;
+    m_transfer.packet_len = len;
+}
+
+/*
+ *@brief Function for queueing packets until the SoftDevice runs out of buffers.
+ */
+static void transfer_pump(void)
+{
+    while (TRANSFER_NONE != m_transfer.mode) {
+        if (0 == m_transfer.packet_len) {
+            if (TRANSFER_DOWNLOAD == m_transfer.mode) {
+                download_packet_build();
+            } else {
+                bench_packet_build();
+            }
+        }
+
+        uint32_t err_code = notify(m_data_handles.value_handle, m_transfer.packet, m_transfer.packet_len);
+        if (NRF_ERROR_RESOURCES == err_code) {
+            // Retried on BLE_GATTS_EVT_HVN_TX_COMPLETE.
+            return;
+        }
+        if (NRF_SUCCESS != err_code) {
+            NRF_LOG_WARNING("Track transfer stopped: 0x%x\n", err_code);
+            m_transfer.mode = TRANSFER_NONE;
+            return;
+        }
+
+        m_transfer.packet_len = 0;
+        if (m_transfer.last) {
+            NRF_LOG_INFO("Track transfer complete\n");
+            m_transfer.mode = TRANSFER_NONE;
+        }
+    }
+}
+
+/*
+ *@brief Function for answering a control point request.
+ */
+static void control_respond(uint8_t opcode, uint8_t status, uint32_t first, uint32_t end)
+{
+    uint8_t rsp[TRACK_CONTROL_RSP_LEN];
+
+    rsp[0] = opcode;
+    rsp[1] = status;
+    put_uint32(&rsp[2], first);
+    put_uint32(&rsp[6], end);
+
+    // Best effort, the client may watch the data characteristic only.
+    UNUSED_RETURN_VALUE(notify(m_control_handles.value_handle, rsp, sizeof(rsp)));
+}
+
+/*
+ *@brief Function for handling a write to the control point.
+ */
+static void control_write(uint8_t const* p_data, uint16_t len)
+{
+    uint8_t opcode = (len > 0) ? p_data[0] : 0;
+    uint32_t arg = 0;
+
+    if (len >= 1 + sizeof(uint32_t)) {
+        arg = uint32_decode(&p_data[1]);
+    }
+
+    switch (opcode) {
+    case TRACK_OP_DOWNLOAD:
+    case TRACK_OP_BENCH:
+        if (TRANSFER_NONE != m_transfer.mode) {
+            control_respond(opcode, TRACK_STATUS_BUSY, m_transfer.next, m_transfer.end);
+            return;
+        }
+        if (len != 1 + sizeof(uint32_t)) {
+            control_respond(opcode, TRACK_STATUS_INVALID, 0, 0);
+            return;
+        }
+        if (!m_data_notify) {
+            control_respond(opcode, TRACK_STATUS_NOTIFY_DISABLED, 0, 0);
+            return;
+        }
+
+        memset(&m_transfer, 0, sizeof(m_transfer));
+        if (TRACK_OP_DOWNLOAD == opcode) {
+            m_transfer.mode = TRANSFER_DOWNLOAD;
+            m_transfer.next = MAX(arg, track_log_first());
+            m_transfer.end = track_log_end();
+        } else {
+            m_transfer.mode = TRANSFER_BENCH;
+            m_transfer.end = arg;
+        }
+        NRF_LOG_INFO("Track transfer %d: %d..%d, %d byte packets\n", opcode, m_transfer.next, m_transfer.end, m_payload_max);
+
+        control_respond(opcode, TRACK_STATUS_OK, m_transfer.next, m_transfer.end);
+        transfer_pump();
+        break;
+    case TRACK_OP_ABORT:
+        m_transfer.mode = TRANSFER_NONE;
+        control_respond(opcode, TRACK_STATUS_OK, track_log_first(), track_log_end());
+        break;
+    default:
+        control_respond(opcode, TRACK_STATUS_INVALID, 0, 0);
+        break;
+    }
+}
+
+/*
+ *@brief Function for handling BLE events.
+ */
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+        m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+        m_payload_max = BLE_GATT_ATT_MTU_DEFAULT - 3;
+        m_data_notify = false;
+        m_transfer.mode = TRANSFER_NONE;
+        break;
+    case BLE_GAP_EVT_DISCONNECTED:
+        m_conn_handle = BLE_CONN_HANDLE_INVALID;
+        m_transfer.mode = TRANSFER_NONE;
+        break;
+    case BLE_GATTS_EVT_WRITE: {
+        ble_gatts_evt_write_t const* p_write = &p_ble_evt->evt.gatts_evt.params.write;
+
+        if (p_write->handle == m_data_handles.cccd_handle && 2 == p_write->len) {
+            m_data_notify = ble_srv_is_notification_enabled(p_write->data);
+        } else if (p_write->handle == m_control_handles.value_handle) {
+            control_write(p_write->data, p_write->len);
+        }
+        break;
+    }
+    case BLE_GATTS_EVT_HVN_TX_COMPLETE:
+        transfer_pump();
+        break;
+    default:
+        break;
+    }
+}
+
+void track_service_init(void)
+{
+    ret_code_t err_code;
+    ble_uuid128_t base_uuid = { TRACK_UUID_BASE };
+    ble_uuid_t ble_uuid;
+    ble_add_char_params_t add_char_params;
+
+    err_code = sd_ble_uuid_vs_add(&base_uuid, &m_uuid_type);
+    APP_ERROR_CHECK(err_code);
+
+    ble_uuid.type = m_uuid_type;
+    ble_uuid.uuid = TRACK_UUID_SERVICE;
+    err_code = sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &ble_uuid, &m_service_handle);
+    APP_ERROR_CHECK(err_code);
+
+    memset(&add_char_params, 0, sizeof(add_char_params));
+    add_char_params.uuid = TRACK_UUID_CONTROL;
+    add_char_params.uuid_type = m_uuid_type;
+    add_char_params.max_len = TRACK_CONTROL_RSP_LEN;
+    add_char_params.is_var_len = true;
+    add_char_params.char_props.write = 1;
+    add_char_params.char_props.notify = 1;
+    add_char_params.write_access = SEC_OPEN;
+    add_char_params.cccd_write_access = SEC_OPEN;
+    err_code = characteristic_add(m_service_handle, &add_char_params, &m_control_handles);
+    APP_ERROR_CHECK(err_code);
+
+    memset(&add_char_params, 0, sizeof(add_char_params));
+    add_char_params.uuid = TRACK_UUID_DATA;
+    add_char_params.uuid_type = m_uuid_type;
+    add_char_params.max_len = PACKET_MAX;
+    add_char_params.is_var_len = true;
+    add_char_params.char_props.notify = 1;
+    add_char_params.cccd_write_access = SEC_OPEN;
+    err_code = characteristic_add(m_service_handle, &add_char_params, &m_data_handles);
+    APP_ERROR_CHECK(err_code);
+}
+
+void track_service_mtu_set(uint16_t att_mtu)
+{
+    m_payload_max = MIN(att_mtu - 3, PACKET_MAX);
+    NRF_LOG_INFO("Track download packets of %d bytes\n", m_payload_max);
+}
+
+#endif // BEACON_CONNECTABLE
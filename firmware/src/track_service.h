@@ -0,0 +1,30 @@
+/*******************************************************************************
+* @brief    GATT service for bulk download of the track log.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*
+* Protocol, see track_format.h. Records are streamed as notifications of the
+* data characteristic, as many records per packet as the ATT MTU allows.
+* Notifications are queued until the SoftDevice reports NRF_ERROR_RESOURCES
+* and refilled on every BLE_GATTS_EVT_HVN_TX_COMPLETE, so each connection
+* event carries as many packets as the event length allows.
+*******************************************************************************/
+#pragma once
+
+#include <stdint.h>
+
+#ifndef TRACK_SERVICE_BLE_OBSERVER_PRIO
+#define TRACK_SERVICE_BLE_OBSERVER_PRIO 2 /**< After nrf_ble_gatt, which reports the MTU. */
+#endif
+
+/*
+ *@brief Function for adding the service and its characteristics to the GATT table.
+ */
+void track_service_init(void);
+
+/*
+ *@brief Function for setting the ATT MTU negotiated for the connection.
+ *
+ * @details Called from the nrf_ble_gatt event handler, the packet size follows the MTU.
+ */
+void track_service_mtu_set(uint16_t att_mtu);
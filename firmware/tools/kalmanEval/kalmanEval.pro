@@ -0,0 +1,21 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+
+TARGET = kalmanEval
+
+QMAKE_CFLAGS += -std=gnu99
+
+INCLUDEPATH += \
+    ../../src \
+    ../../src/minmea
+
+SOURCES += \
+    kalman_eval.c \
+    ../../src/beacon_payload.c \
+    ../../src/kalman.c \
+    ../../src/track_format.c \
+    ../../src/minmea/minmea.c
+
+LIBS += -lm
@@ -0,0 +1,252 @@
+/*******************************************************************************
+* @brief    Evaluation of the position Kalman filter against a recorded track.
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*
+* Every STEP-th RMC fix of an NMEA log is fed to the firmware filter (kalman.c,
+* unchanged), optionally with Gaussian position noise. The fixes in between
+* are the ground truth for the positions the beacon would advertise before the
+* next fix arrives. Errors are compared with advertising the last fix as
+* received, and the host time per filter call is measured; cycles on the
+* device come from the kalman_update/kalman_predict profile spans.
+*******************************************************************************/
+#include "beacon_payload.h"
+#include "kalman.h"
+#include "minmea.h"
+#include "track_format.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define METERS_PER_COORD 0.011131949 /**< Length of 1e-7 degree of latitude, m. */
+#define DEG_TO_RAD 0.017453292519943295
+#define LINE_MAX_LEN 256
+
+/*
+ *@brief Struct that contains one fix of the log.
+ */
+typedef struct {
+    uint32_t time_ms; /**< UTC, ms, wraps at 2^32. */
+    int32_t latitude; /**< 1e-7 degree. */
+    int32_t longitude; /**< 1e-7 degree. */
+    bool has_velocity; /**< Speed and course are present. */
+    uint32_t speed_mmps; /**< Speed over ground, mm/s. */
+    int32_t course; /**< Course over ground, 0.1 degree. */
+} fix_t;
+
+/*
+ *@brief Struct that contains error statistics, m.
+ */
+typedef struct {
+    uint64_t count;
+    double sum_sq;
+    double max;
+} error_stats_t;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ *@brief Function for approximating the distance between two close points (equirectangular), m.
+ */
+static double distance_m(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2)
+{
+    double dlon = fmod((double)lon2 - lon1 + 540.0 * BEACON_COORD_PER_DEGREE, 360.0 * BEACON_COORD_PER_DEGREE) - 180.0 * BEACON_COORD_PER_DEGREE;
+    double dy = (double)(lat2 - lat1) * METERS_PER_COORD;
+    double dx = dlon * METERS_PER_COORD * cos(lat1 / (double)BEACON_COORD_PER_DEGREE * DEG_TO_RAD);
+
+    return sqrt(dx * dx + dy * dy);
+}
+
+static void error_add(error_stats_t* p_stats, double error)
+{
+    p_stats->count++;
+    p_stats->sum_sq += error * error;
+    if (error > p_stats->max) {
+        p_stats->max = error;
+    }
+}
+
+static void error_print(const char* p_name, error_stats_t const* p_stats, error_stats_t const* p_baseline, const char* p_baseline_name)
+{
+    double rms = (p_stats->count > 0) ? sqrt(p_stats->sum_sq / p_stats->count) : 0;
+    double baseline_rms = (p_baseline->count > 0) ? sqrt(p_baseline->sum_sq / p_baseline->count) : 0;
+
+    printf("%s, m: rms %.2f max %.2f (%s: rms %.2f max %.2f), %llu points\n", p_name, rms, p_stats->max,
+        p_baseline_name, baseline_rms, p_baseline->max, (unsigned long long)p_stats->count);
+}
+
+/*
+ *@brief Function for getting a normally distributed random number (Box-Muller).
+ */
+static double gaussian(void)
+{
+    double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/*
+ *@brief Function for reading a valid RMC fix from an NMEA line.
+ */
+static bool fix_parse(const char* p_line, fix_t* p_fix)
+{
+    struct minmea_sentence_rmc frame;
+
+    if (MINMEA_SENTENCE_RMC != minmea_sentence_id(p_line, false) || !minmea_parse_rmc(&frame, p_line)
+        || !frame.valid || frame.time.hours < 0) {
+        return false;
+    }
+
+    p_fix->time_ms = (uint32_t)(frame.time.hours * 3600 + frame.time.minutes * 60 + frame.time.seconds) * 1000u
+        + (uint32_t)frame.time.microseconds / 1000u;
+    if (frame.date.year >= 0) {
+        p_fix->time_ms += track_unix_time(2000 + frame.date.year, frame.date.month, frame.date.day, 0) * 1000u;
+    }
+    p_fix->latitude = beacon_coord_from_nmea(frame.latitude.value, frame.latitude.scale);
+    p_fix->longitude = beacon_coord_from_nmea(frame.longitude.value, frame.longitude.scale);
+    p_fix->has_velocity = (0 != frame.speed.scale);
+    int32_t speed = minmea_rescale(&frame.speed, 1000);
+    // Knots to mm/s, as the firmware does.
+    p_fix->speed_mmps = (speed > 0) ? (uint32_t)((uint64_t)speed * 514u / 1000u) : 0;
+    p_fix->course = minmea_rescale(&frame.course, 10);
+    return true;
+}
+
+static void usage(const char* p_name)
+{
+    fprintf(stderr,
+        "Usage: %s [-k STEP] [-n NOISE] [-s SEED] [-o CSV] <nmea>\n"
+        "  -k STEP   feed every STEP-th fix to the filter, predict the others (default: 5)\n"
+        "  -n NOISE  add Gaussian noise of NOISE m per axis to the fed positions (default: 0)\n"
+        "  -s SEED   random seed of the noise (default: 1)\n"
+        "  -o CSV    write time, truth, advertised and held positions per fix\n",
+        p_name);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned step = 5;
+    double noise_m = 0;
+    unsigned seed = 1;
+    const char* p_csv = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "k:n:s:o:")) != -1) {
+        switch (opt) {
+        case 'k':
+            step = (unsigned)strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            noise_m = strtod(optarg, NULL);
+            break;
+        case 's':
+            seed = (unsigned)strtoul(optarg, NULL, 10);
+            break;
+        case 'o':
+            p_csv = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (argc - optind != 1 || 0 == step) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE* p_input = fopen(argv[optind], "r");
+    if (NULL == p_input) {
+        perror(argv[optind]);
+        return EXIT_FAILURE;
+    }
+    FILE* p_output = NULL;
+    if (NULL != p_csv) {
+        p_output = fopen(p_csv, "w");
+        if (NULL == p_output) {
+            perror(p_csv);
+            return EXIT_FAILURE;
+        }
+        fprintf(p_output, "time_ms,fed,true_lat,true_lon,adv_lat,adv_lon,held_lat,held_lon\n");
+    }
+    srand(seed);
+
+    error_stats_t filtered = { 0 }, raw = { 0 }, predicted = { 0 }, held = { 0 };
+    uint64_t update_ns = 0, position_ns = 0, updates = 0, positions = 0, fixes = 0;
+    fix_t last_fed = { 0 };
+    bool started = false;
+
+    kalman_init();
+
+    char line[LINE_MAX_LEN];
+    while (NULL != fgets(line, sizeof(line), p_input)) {
+        fix_t fix;
+        int32_t latitude, longitude;
+        uint64_t start;
+
+        if (!fix_parse(line, &fix)) {
+            continue;
+        }
+        bool fed = (0 == fixes++ % step);
+
+        if (fed) {
+            fix_t noisy = fix;
+            noisy.latitude += (int32_t)lround(gaussian() * noise_m / METERS_PER_COORD);
+            noisy.longitude += (int32_t)lround(gaussian() * noise_m / METERS_PER_COORD
+                / cos(fix.latitude / (double)BEACON_COORD_PER_DEGREE * DEG_TO_RAD));
+
+            start = now_ns();
+            kalman_update(noisy.time_ms, noisy.latitude, noisy.longitude, noisy.has_velocity, noisy.speed_mmps, noisy.course);
+            update_ns += now_ns() - start;
+            updates++;
+
+            last_fed = noisy;
+            started = true;
+        } else if (!started) {
+            continue;
+        }
+
+        start = now_ns();
+        kalman_position(fix.time_ms, &latitude, &longitude);
+        position_ns += now_ns() - start;
+        positions++;
+
+        double error = distance_m(fix.latitude, fix.longitude, latitude, longitude);
+        double held_error = distance_m(fix.latitude, fix.longitude, last_fed.latitude, last_fed.longitude);
+        if (fed) {
+            error_add(&filtered, error);
+            error_add(&raw, held_error);
+        } else {
+            error_add(&predicted, error);
+            error_add(&held, held_error);
+        }
+
+        if (NULL != p_output) {
+            fprintf(p_output, "%u,%d,%d,%d,%d,%d,%d,%d\n", fix.time_ms, fed, fix.latitude, fix.longitude,
+                latitude, longitude, last_fed.latitude, last_fed.longitude);
+        }
+    }
+    fclose(p_input);
+    if (NULL != p_output) {
+        fclose(p_output);
+    }
+
+    printf("Fixes: %llu, every %u fed to the filter with %.1f m noise\n", (unsigned long long)fixes, step, noise_m);
+    error_print("Filtered at fed fixes", &filtered, &raw, "fed fix");
+    error_print("Predicted between fed fixes", &predicted, &held, "last fed fix held");
+    printf("Host time per call, ns: kalman_update %.0f, kalman_position %.0f\n",
+        (updates > 0) ? (double)update_ns / updates : 0, (positions > 0) ? (double)position_ns / positions : 0);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+"""Decode firmware profiling dumps (PROFILE_ENABLED build) from an RTT log.
+
+Reads the log written by JLinkRTTLogger, JLinkRTTViewer or beaconSim -v 3
+and prints one table per dump, or a single table over all dumps with -t.
+The boot stages are printed first, from the last boot in the log.
+"CPU Usage" lines of nrf_pwr_mgmt are summarized alongside.
+
+    JLinkRTTLogger -Device NRF52832_XXAA -If SWD -Speed 4000 -RTTChannel 0 rtt.log
+    firmware/tools/profile_decode.py rtt.log
+"""
+
+import argparse
+import re
+import sys
+
+HIST_BUCKETS = 16
+
+DUMP_RE = re.compile(r"PROF dump=(\d+) clock=(\d+) window_ms=(\d+)")
+SPAN_RE = re.compile(r"PROF (\w+) n=(\d+) min=(\d+) mean=(\d+) max=(\d+)")
+UNITS_RE = re.compile(r"PROF (\w+) units=(\d+) cycles=(\d+)")
+HIST_RE = re.compile(r"PROF (\w+) h(\d+)=([\d,]+)")
+BOOT_CLOCK_RE = re.compile(r"PROF boot clock=(\d+)")
+BOOT_STAGE_RE = re.compile(r"PROF boot (\w+)=(\d+)")
+CPU_RE = re.compile(r"CPU [Uu]sage: (\d+)%")
+CPU_MAX_RE = re.compile(r"Maximum CPU usage: (\d+)%")
+
+
+class Span:
+    def __init__(self):
+        self.count = 0
+        self.min = None
+        self.max = 0
+        self.sum = 0
+        self.units = 0
+        self.unit_cycles = 0
+        self.hist = [0] * HIST_BUCKETS
+
+    def merge(self, other):
+        self.count += other.count
+        self.min = other.min if self.min is None else min(self.min, other.min)
+        self.max = max(self.max, other.max)
+        self.sum += other.sum
+        self.units += other.units
+        self.unit_cycles += other.unit_cycles
+        self.hist = [a + b for a, b in zip(self.hist, other.hist)]
+
+    def percentile(self, p):
+        """Upper bound of the histogram bucket holding the p-th percentile, cycles."""
+        target = self.count * p / 100.0
+        seen = 0
+        for i, n in enumerate(self.hist):
+            seen += n
+            if n and seen >= target:
+                return min((1 << (i + 1)) - 1, self.max) if i < HIST_BUCKETS - 1 else self.max
+        return self.max
+
+
+class Dump:
+    def __init__(self, seq, clock, window_ms):
+        self.seq = seq
+        self.clock = clock
+        self.window_ms = window_ms
+        self.spans = {}
+        self.cpu = []
+        self.cpu_max = None
+
+    def span(self, name):
+        return self.spans.setdefault(name, Span())
+
+
+class Boot:
+    def __init__(self, clock):
+        self.clock = clock
+        self.stages = []
+
+
+def parse(lines):
+    """Returns the dumps and the last boot, None if the log has no boot stages."""
+    dumps = []
+    boot = None
+    cpu = []
+    cpu_max = None
+    for line in lines:
+        m = BOOT_CLOCK_RE.search(line)
+        if m:
+            boot = Boot(int(m.group(1)))
+            continue
+        m = BOOT_STAGE_RE.search(line)
+        if m and boot:
+            boot.stages.append((m.group(1), int(m.group(2))))
+            continue
+        m = DUMP_RE.search(line)
+        if m:
+            dump = Dump(*map(int, m.groups()))
+            dump.cpu, dump.cpu_max = cpu, cpu_max
+            cpu, cpu_max = [], None
+            dumps.append(dump)
+            continue
+        m = CPU_MAX_RE.search(line)
+        if m:
+            cpu_max = int(m.group(1))
+            continue
+        m = CPU_RE.search(line)
+        if m:
+            cpu.append(int(m.group(1)))
+            continue
+        if not dumps:
+            continue
+        dump = dumps[-1]
+        m = SPAN_RE.search(line)
+        if m:
+            span = dump.span(m.group(1))
+            span.count, span.min, mean, span.max = map(int, m.groups()[1:])
+            span.sum = mean * span.count
+            continue
+        m = UNITS_RE.search(line)
+        if m:
+            span = dump.span(m.group(1))
+            span.units, span.unit_cycles = int(m.group(2)), int(m.group(3))
+            continue
+        m = HIST_RE.search(line)
+        if m:
+            first = int(m.group(2))
+            for i, n in enumerate(m.group(3).split(",")):
+                if first + i < HIST_BUCKETS:
+                    dump.span(m.group(1)).hist[first + i] = int(n)
+    return dumps, boot
+
+
+def print_boot(boot):
+    ms = 1e3 / boot.clock
+    print("boot, from main() entry")
+    print("  {:<16}{:>10}{:>10}".format("stage", "ms", "total ms"))
+    previous = 0
+    for name, cycles in boot.stages:
+        print("  {:<16}{:>10.3f}{:>10.3f}".format(name, (cycles - previous) * ms, cycles * ms))
+        previous = cycles
+
+
+def print_table(title, clock, spans, cpu, cpu_max, busy_window_ms):
+    us = 1e6 / clock
+    print(title)
+    print("  {:<16}{:>8}{:>10}{:>10}{:>10}{:>10}{:>12}{:>8}".format(
+        "span", "count", "min us", "mean us", "p99 us", "max us", "cycles/unit", "busy %"))
+    for name, s in spans.items():
+        if not s.count:
+            continue
+        per_unit = "{:.1f}".format(s.unit_cycles / s.units) if s.units else "-"
+        busy = "{:.3f}".format(s.sum * us / (busy_window_ms * 10.0)) if busy_window_ms else "-"
+        print("  {:<16}{:>8}{:>10.2f}{:>10.2f}{:>10.2f}{:>10.2f}{:>12}{:>8}".format(
+            name, s.count, s.min * us, s.sum / s.count * us, s.percentile(99) * us, s.max * us, per_unit, busy))
+    if cpu:
+        print("  CPU usage: mean {:.1f}% max {}% ({} samples)".format(sum(cpu) / len(cpu), max(cpu), len(cpu)))
+    if cpu_max is not None:
+        print("  CPU usage maximum since boot: {}%".format(cpu_max))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log", nargs="?", help="RTT log file (default: stdin)")
+    parser.add_argument("-t", "--total", action="store_true", help="print one table over all dumps")
+    args = parser.parse_args()
+
+    with (open(args.log, errors="replace") if args.log else sys.stdin) as f:
+        dumps, boot = parse(f)
+
+    if not dumps and not boot:
+        sys.exit("No PROF dumps found, is the firmware built with PROFILE_ENABLED 1?")
+    if boot:
+        print_boot(boot)
+
+    if args.total:
+        spans = {}
+        cpu = []
+        for dump in dumps:
+            cpu += dump.cpu
+            for name, s in dump.spans.items():
+                spans.setdefault(name, Span()).merge(s)
+        window_ms = sum(d.window_ms for d in dumps)
+        cpu_max = max((d.cpu_max for d in dumps if d.cpu_max is not None), default=None)
+        print_table("{} dumps".format(len(dumps)), dumps[-1].clock, spans, cpu, cpu_max, window_ms)
+        return
+
+    for dump in dumps:
+        print_table("dump {}".format(dump.seq), dump.clock, dump.spans, dump.cpu, dump.cpu_max, dump.window_ms)
+
+
+if __name__ == "__main__":
+    main()
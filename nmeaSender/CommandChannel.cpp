@@ -0,0 +1,171 @@
+/*******************************************************************************
+* @brief    Beacon command channel over the NMEA serial line
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*******************************************************************************/
+#include "CommandChannel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+extern "C" {
+#include "serial.h"
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int remainingMs(Clock::time_point deadline)
+{
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+    return static_cast<int>(std::max<decltype(left)>(left, 0));
+}
+
+} // namespace
+
+// Definitions for ODR-uses, e.g. binding to the const reference of std::chrono constructors
+constexpr int CommandChannel::defaultTimeoutMs;
+constexpr int CommandChannel::wakeGuardMs;
+
+void CommandChannel::Stats::add(double value)
+{
+    min = (0 == count) ? value : std::min(min, value);
+    max = (0 == count) ? value : std::max(max, value);
+    sum += value;
+    count++;
+}
+
+std::string CommandChannel::Stats::summary() const
+{
+    char text[96];
+
+    if (0 == count) {
+        return "none";
+    }
+    snprintf(text, sizeof(text), "min %.0f mean %.0f max %.0f (%llu)", min, sum / count, max,
+        static_cast<unsigned long long>(count));
+    return text;
+}
+
+/*
+ * @brief Read until an answer arrives, latency reports on the way are recorded
+ *
+ * @return bool false on timeout or serial error.
+ */
+bool CommandChannel::readReply(command_reply_t& reply, int timeoutMs)
+{
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+
+    for (;;) {
+        size_t end;
+        while (std::string::npos != (end = m_buffer.find('\n'))) {
+            std::string line = m_buffer.substr(0, end + 1);
+            m_buffer.erase(0, end + 1);
+
+            if (command_stats_parse(line.c_str(), &m_linkSeq, &m_link)) {
+                continue;
+            }
+            if (!command_reply_parse(line.c_str(), &reply)) {
+                continue;
+            }
+            if (reply.ack) {
+                return true;
+            }
+            m_ingestToAdvertise.add(static_cast<uint32_t>(reply.time2_us - reply.time1_us));
+        }
+
+        char chunk[256];
+        auto len = serialRead(m_fd, chunk, sizeof(chunk), remainingMs(deadline));
+        if (0 > len) {
+            return false;
+        }
+        m_buffer.append(chunk, static_cast<size_t>(len));
+        if (0 == len && Clock::now() >= deadline) {
+            return false;
+        }
+    }
+}
+
+/*
+ * @brief Send a command and wait for its answer, command.seq is assigned here
+ *
+ * A beacon with UART power gating loses the characters whose start bit wakes
+ * the UART, so a line ending goes first and the sentence follows once the
+ * UART is powered.
+ *
+ * @return bool false if no answer came within timeoutMs.
+ */
+bool CommandChannel::execute(command_t& command, Answer& answer, int timeoutMs)
+{
+    char line[COMMAND_LINE_MAX];
+    const char wake[] = { '\r', '\n' };
+
+    command.seq = m_seq++;
+    auto len = command_format(line, sizeof(line), &command);
+    if (0 == len) {
+        return false;
+    }
+
+    if (0 > serialWrite(m_fd, wake, sizeof(wake))) {
+        return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(wakeGuardMs));
+
+    auto sent = Clock::now();
+    if (0 > serialWrite(m_fd, line, len)) {
+        return false;
+    }
+
+    auto deadline = sent + std::chrono::milliseconds(timeoutMs);
+    command_reply_t reply;
+    do {
+        if (!readReply(reply, remainingMs(deadline))) {
+            return false;
+        }
+    } while (reply.seq != command.seq);
+
+    answer.status = reply.status;
+    answer.roundTripUs = std::chrono::duration<double, std::micro>(Clock::now() - sent).count();
+    answer.beaconUs = reply.time2_us - reply.time1_us;
+    m_roundTrip.add(answer.roundTripUs);
+    m_beaconTime.add(answer.beaconUs);
+    return true;
+}
+
+/*
+ * @brief Ask the beacon for its link statistics, counted since boot
+ *
+ * @return bool false if no answer came, or the beacon does not know the command.
+ */
+bool CommandChannel::linkStats(command_stats_t& stats, int timeoutMs)
+{
+    command_t command = { 0, COMMAND_STATS, 0 };
+    Answer answer;
+
+    if (!execute(command, answer, timeoutMs) || COMMAND_STATUS_OK != answer.status || m_linkSeq != command.seq) {
+        return false;
+    }
+    stats = m_link;
+    return true;
+}
+
+/*
+ * @brief Collect latency reports for timeoutMs, answers to earlier commands are dropped
+ *
+ * @return bool false on serial error.
+ */
+bool CommandChannel::drain(int timeoutMs)
+{
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    command_reply_t reply;
+
+    while (Clock::now() < deadline) {
+        if (!readReply(reply, remainingMs(deadline)) && Clock::now() < deadline) {
+            return false;
+        }
+    }
+    return true;
+}
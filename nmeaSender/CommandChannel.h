@@ -0,0 +1,67 @@
+/*******************************************************************************
+* @brief    Beacon command channel over the NMEA serial line
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "command_format.h"
+
+/*
+ * @brief Sends $PBCN commands, times their answers and collects latency reports.
+ *
+ * The round trip is measured on the host from the first written byte to the
+ * received answer; the beacon part of it comes from the two beacon times in
+ * the answer, the rest is the serial line in both directions. Latency reports
+ * give the time from receiving an RMC sentence to handing its payload to the
+ * SoftDevice, see command_format.h.
+ */
+class CommandChannel {
+public:
+    struct Answer {
+        command_status_t status;
+        double roundTripUs; // Host time from sending to receiving the answer
+        uint32_t beaconUs; // Time between receiving the command and queueing the answer
+    };
+
+    struct Stats {
+        uint64_t count = 0;
+        double sum = 0;
+        double min = 0;
+        double max = 0;
+
+        void add(double value);
+        std::string summary() const;
+    };
+
+    static constexpr int defaultTimeoutMs = 1000;
+    static constexpr int wakeGuardMs = 5; // Power-up time of a gated beacon UART, with margin
+
+    explicit CommandChannel(int fd)
+        : m_fd(fd)
+    {
+    }
+
+    bool execute(command_t& command, Answer& answer, int timeoutMs = defaultTimeoutMs);
+    bool linkStats(command_stats_t& stats, int timeoutMs = defaultTimeoutMs);
+    bool drain(int timeoutMs);
+
+    const Stats& roundTrip() const { return m_roundTrip; }
+    const Stats& beaconTime() const { return m_beaconTime; }
+    const Stats& ingestToAdvertise() const { return m_ingestToAdvertise; }
+
+private:
+    bool readReply(command_reply_t& reply, int timeoutMs);
+
+    int m_fd;
+    uint16_t m_seq = 1;
+    std::string m_buffer;
+    Stats m_roundTrip;
+    Stats m_beaconTime;
+    Stats m_ingestToAdvertise;
+    command_stats_t m_link = {}; // Newest link statistics received
+    uint16_t m_linkSeq = 0; // Command sequence number of m_link, 0 if none
+};
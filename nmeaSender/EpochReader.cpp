@@ -0,0 +1,102 @@
+/*******************************************************************************
+* @brief    Groups NMEA log lines into the epochs of the receiver
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*******************************************************************************/
+#include "EpochReader.h"
+
+#include "minmea.h"
+
+namespace {
+
+int64_t millisOfDay(const minmea_time& time)
+{
+    return ((time.hours * 60 + time.minutes) * 60 + time.seconds) * 1000LL + time.microseconds / 1000;
+}
+
+}
+
+/*
+ * @brief Extracts UTC time of day from RMC, GGA or ZDA sentence.
+ *
+ * @param line NMEA sentence, with or without line ending
+ * @param timeOfDayMs Milliseconds since midnight
+ * @return bool False if sentence has no time.
+ */
+bool EpochReader::sentenceTimeOfDay(const std::string& line, int64_t& timeOfDayMs)
+{
+    minmea_time time;
+    time.hours = -1;
+
+    switch (minmea_sentence_id(line.c_str(), false)) {
+    case MINMEA_SENTENCE_RMC: {
+        struct minmea_sentence_rmc frame;
+        if (minmea_parse_rmc(&frame, line.c_str())) {
+            time = frame.time;
+        }
+        break;
+    }
+    case MINMEA_SENTENCE_GGA: {
+        struct minmea_sentence_gga frame;
+        if (minmea_parse_gga(&frame, line.c_str())) {
+            time = frame.time;
+        }
+        break;
+    }
+    case MINMEA_SENTENCE_ZDA: {
+        struct minmea_sentence_zda frame;
+        if (minmea_parse_zda(&frame, line.c_str())) {
+            time = frame.time;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    if (time.hours == -1) {
+        return false;
+    }
+    timeOfDayMs = millisOfDay(time);
+    return true;
+}
+
+/*
+ * @brief Reads the next epoch, line endings stripped.
+ *
+ * @param epoch Lines and time of the epoch
+ * @return bool False at the end of the log.
+ */
+bool EpochReader::next(Epoch& epoch)
+{
+    epoch.lines.clear();
+    epoch.timeOfDayMs = -1;
+
+    if (m_hasPending) {
+        epoch.lines.push_back(m_pending);
+        epoch.timeOfDayMs = m_pendingTimeMs;
+        m_hasPending = false;
+    }
+
+    for (std::string line; getline(m_input, line);) {
+        if (!line.empty() && '\r' == line.back()) {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+
+        int64_t timeMs;
+        if (sentenceTimeOfDay(line, timeMs)) {
+            if (-1 == epoch.timeOfDayMs) {
+                epoch.timeOfDayMs = timeMs;
+            } else if (timeMs != epoch.timeOfDayMs) {
+                m_pending.swap(line);
+                m_pendingTimeMs = timeMs;
+                m_hasPending = true;
+                return true;
+            }
+        }
+        epoch.lines.push_back(line);
+    }
+    return !epoch.lines.empty();
+}
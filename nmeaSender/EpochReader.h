@@ -0,0 +1,63 @@
+/*******************************************************************************
+* @brief    Groups NMEA log lines into the epochs of the receiver
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * @brief Source of NMEA epochs, a log or a generator.
+ */
+class EpochSource {
+public:
+    struct Epoch {
+        std::vector<std::string> lines;
+        int64_t timeOfDayMs = -1; // UTC, -1 if no line has a time
+    };
+
+    virtual ~EpochSource() = default;
+
+    virtual bool next(Epoch& epoch) = 0;
+};
+
+/*
+ * @brief Reads an NMEA log one epoch at a time.
+ *
+ * A receiver outputs all sentences of a fix (GGA, GSA, GSV, RMC, ...) in one
+ * burst. The RMC, GGA and ZDA sentences of that burst carry the same UTC
+ * time of day; a timed sentence with another time starts the next epoch and
+ * untimed sentences stay with the epoch they follow. Lines preceding the
+ * first timed sentence go with the first epoch.
+ */
+class EpochReader : public EpochSource {
+public:
+    static constexpr int64_t msPerDay = 86400000;
+
+    explicit EpochReader(std::istream& input)
+        : m_input(input)
+    {
+    }
+
+    explicit EpochReader(std::unique_ptr<std::istream> input)
+        : m_owned(std::move(input))
+        , m_input(*m_owned)
+    {
+    }
+
+    static bool sentenceTimeOfDay(const std::string& line, int64_t& timeOfDayMs);
+
+    bool next(Epoch& epoch) override;
+
+private:
+    std::unique_ptr<std::istream> m_owned; // Stream opened for the reader, if any
+    std::istream& m_input;
+    std::string m_pending; // First line of the next epoch
+    int64_t m_pendingTimeMs = -1;
+    bool m_hasPending = false;
+};
@@ -0,0 +1,402 @@
+/*******************************************************************************
+* @brief    Replay to many serial ports from one event loop
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*******************************************************************************/
+#include "FanOut.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <iostream>
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "SerialWriter.h"
+extern "C" {
+#include "serial.h"
+}
+
+namespace {
+
+constexpr int64_t nsPerSecond = 1000000000;
+
+// epoll key of the timer, ports are keyed by their index
+constexpr uint64_t timerKey = UINT64_MAX;
+
+constexpr int maxEvents = 64;
+
+// Epochs queued on a port per wake-up when replaying as fast as possible,
+// so a port that never blocks does not starve the others
+constexpr int burstEpochs = 16;
+
+int64_t toNs(const struct timespec& time)
+{
+    return static_cast<int64_t>(time.tv_sec) * nsPerSecond + time.tv_nsec;
+}
+
+int64_t monotonicNs()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return toNs(time);
+}
+
+double cpuSeconds()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return toNs(time) / 1e9;
+}
+
+}
+
+FanOut::Port::Port(size_t index, int fd, const std::string& name, std::unique_ptr<EpochSource> source, double speed)
+    : index(index)
+    , fd(fd)
+    , name(name)
+    , source(std::move(source))
+    , clock(speed)
+{
+}
+
+FanOut::FanOut(double speed, uint32_t paceBytesPerSecond)
+    : m_speed(speed)
+    , m_pace(paceBytesPerSecond)
+{
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (0 <= m_epoll && 0 <= m_timer) {
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = timerKey;
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_timer, &event);
+    }
+}
+
+FanOut::~FanOut()
+{
+    for (const auto& port : m_ports) {
+        serialClose(port->fd);
+    }
+    if (0 <= m_timer) {
+        close(m_timer);
+    }
+    if (0 <= m_epoll) {
+        close(m_epoll);
+    }
+}
+
+/*
+ * @brief Adds a port, the fan-out takes over the file descriptor.
+ *
+ * @param fd File descriptor to serial port
+ * @param name Port name for the summary
+ * @param source Epochs to send to the port
+ * @return bool
+ */
+bool FanOut::add(int fd, const std::string& name, std::unique_ptr<EpochSource> source)
+{
+    if (0 > m_epoll || 0 > m_timer || 0 > serialSetNonblocking(fd)) {
+        serialClose(fd);
+        return false;
+    }
+
+    // Only errors and hang-ups until a write comes up short
+    struct epoll_event event = {};
+    event.data.u64 = m_ports.size();
+    if (0 > epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event)) {
+        serialClose(fd);
+        return false;
+    }
+
+    m_ports.push_back(std::unique_ptr<Port>(new Port(m_ports.size(), fd, name, std::move(source), m_speed)));
+    return true;
+}
+
+/*
+ * @brief Replays all ports to the end of their sources.
+ *
+ * @return bool False if writing to a port failed, the other ports run to their end.
+ */
+bool FanOut::run()
+{
+    int64_t start = monotonicNs();
+    double cpu = cpuSeconds();
+
+    m_active = m_ports.size();
+    for (size_t i = 0; i < m_ports.size(); i++) {
+        loadEpoch(*m_ports[i]);
+        if (m_ports[i]->done()) {
+            finish(*m_ports[i]);
+        } else {
+            scheduleWake(i, start);
+        }
+    }
+    armTimer();
+
+    struct epoll_event events[maxEvents];
+    while (0 < m_active) {
+        int count = epoll_wait(m_epoll, events, maxEvents, -1);
+        if (0 > count) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return false;
+        }
+        m_wakeups++;
+
+        int64_t now = monotonicNs();
+        for (int i = 0; i < count; i++) {
+            if (timerKey == events[i].data.u64) {
+                uint64_t expirations;
+                while (0 < read(m_timer, &expirations, sizeof(expirations))) {
+                }
+                m_armedNs = 0;
+                continue;
+            }
+            Port& port = *m_ports[events[i].data.u64];
+            if (0 != (events[i].events & (EPOLLERR | EPOLLHUP))) {
+                fail(port);
+            } else {
+                service(events[i].data.u64, now);
+            }
+        }
+
+        while (!m_wakes.empty() && m_wakes.top().ns <= now) {
+            Wake wake = m_wakes.top();
+            m_wakes.pop();
+            if (wake.generation == m_ports[wake.port]->wakeGeneration) {
+                service(wake.port, now);
+            }
+        }
+        armTimer();
+    }
+
+    m_seconds = (monotonicNs() - start) / 1e9;
+    m_cpu = cpuSeconds() - cpu;
+    return std::none_of(m_ports.begin(), m_ports.end(), [](const std::unique_ptr<Port>& port) { return port->failed; });
+}
+
+void FanOut::printSummary() const
+{
+    uint64_t lines = 0;
+    int64_t maxLateNs = 0;
+
+    for (const auto& port : m_ports) {
+        std::cout << port->name << ": " << port->lines << " sentences, " << port->bytes << " bytes";
+        if (0 != m_speed) {
+            std::cout << ", latest " << port->maxLateNs / 1000 << " us after its deadline";
+        }
+        if (port->failed) {
+            std::cout << ", failed";
+        }
+        std::cout << std::endl;
+        lines += port->lines;
+        maxLateNs = std::max(maxLateNs, port->maxLateNs);
+    }
+
+    std::cout << "Fan-out: " << m_ports.size() << " ports, " << lines << " sentences in " << m_seconds << " s, "
+              << m_wakeups << " wake-ups, " << m_calls << " write calls";
+    if (0 != lines) {
+        std::cout << ", " << m_cpu * 1e6 / lines << " us CPU per sentence";
+    }
+    if (0 != m_speed) {
+        std::cout << ", latest " << maxLateNs / 1000 << " us after a deadline";
+    }
+    std::cout << std::endl;
+}
+
+void FanOut::loadEpoch(Port& port)
+{
+    port.hasEpoch = port.source->next(port.epoch);
+    if (port.hasEpoch) {
+        port.clock.schedule(port.epoch.timeOfDayMs);
+    }
+}
+
+/*
+ * @brief Queues the epochs that are due, writes what the port takes and sets its next wake-up.
+ */
+void FanOut::service(size_t index, int64_t now)
+{
+    Port& port = *m_ports[index];
+    if (port.finished) {
+        return;
+    }
+
+    for (int burst = 0; port.hasEpoch && burst < burstEpochs; burst++) {
+        if (0 != m_speed) {
+            int64_t deadline = toNs(port.clock.deadline());
+            if (deadline > now) {
+                break;
+            }
+            port.maxLateNs = std::max(port.maxLateNs, now - deadline);
+        } else if (port.offset != port.queue.size()) {
+            // As fast as possible: the next epoch once the port took the previous one
+            break;
+        }
+
+        if (port.offset == port.queue.size()) {
+            port.queue.clear();
+            port.offset = 0;
+        }
+        for (const auto& line : port.epoch.lines) {
+            port.queue += line;
+            port.queue += "\r\n";
+        }
+        port.lines += port.epoch.lines.size();
+        loadEpoch(port);
+
+        if (0 == m_speed && !flush(port, now)) {
+            fail(port);
+            return;
+        }
+    }
+
+    if (!flush(port, now)) {
+        fail(port);
+        return;
+    }
+    if (port.done()) {
+        finish(port);
+        return;
+    }
+    scheduleWake(index, now);
+}
+
+/*
+ * @brief Writes the queue until it is empty, the port takes no more or, when paced, the chunk is out.
+ *
+ * A port that took no more is written again when EPOLLOUT reports it takes
+ * data, paced ports too: retrying at the chunk deadline would spin on a port
+ * nobody reads.
+ *
+ * @return bool False on serial error.
+ */
+bool FanOut::flush(Port& port, int64_t now)
+{
+    while (port.offset < port.queue.size()) {
+        size_t len = port.queue.size() - port.offset;
+        if (0 != m_pace) {
+            // Waiting for EPOLLOUT the chunk deadline has passed already
+            if (!port.waitOut && port.chunkNs > now) {
+                break;
+            }
+            len = std::min(len, SerialWriter::paceChunk);
+        }
+
+        ssize_t written = write(port.fd, port.queue.data() + port.offset, len);
+        m_calls++;
+        if (0 > written) {
+            if (EINTR == errno) {
+                continue;
+            }
+            if (EAGAIN != errno && EWOULDBLOCK != errno) {
+                return false;
+            }
+            watchOut(port, true);
+            break;
+        }
+
+        port.offset += static_cast<size_t>(written);
+        port.bytes += static_cast<size_t>(written);
+        if (0 != m_pace) {
+            // Same schedule as SerialWriter::sendPaced()
+            int64_t chunkNs = static_cast<int64_t>(SerialWriter::paceChunk) * nsPerSecond / m_pace;
+            if (port.chunkNs + chunkNs < now) {
+                port.chunkNs = now;
+            }
+            port.chunkNs += written * nsPerSecond / m_pace;
+            // Back on the chunk deadlines, EPOLLOUT would fire until the next one
+            watchOut(port, false);
+        }
+    }
+
+    if (port.offset == port.queue.size() && port.waitOut) {
+        watchOut(port, false);
+    }
+    return true;
+}
+
+void FanOut::watchOut(Port& port, bool enable)
+{
+    if (port.waitOut == enable) {
+        return;
+    }
+    struct epoll_event event = {};
+    event.events = enable ? static_cast<uint32_t>(EPOLLOUT) : 0;
+    event.data.u64 = port.index;
+    epoll_ctl(m_epoll, EPOLL_CTL_MOD, port.fd, &event);
+    port.waitOut = enable;
+}
+
+/*
+ * @brief Puts the earliest of the port's epoch and chunk deadlines on the heap.
+ *
+ * A port waiting for EPOLLOUT has no chunk deadline, with no epoch due it is not on the heap.
+ */
+void FanOut::scheduleWake(size_t index, int64_t now)
+{
+    Port& port = *m_ports[index];
+    int64_t ns = INT64_MAX;
+
+    if (port.hasEpoch) {
+        if (0 != m_speed) {
+            ns = toNs(port.clock.deadline());
+        } else if (port.offset == port.queue.size()) {
+            ns = now;
+        }
+    }
+    if (0 != m_pace && port.offset < port.queue.size() && !port.waitOut) {
+        ns = std::min(ns, port.chunkNs);
+    }
+
+    port.wakeGeneration++;
+    if (INT64_MAX != ns) {
+        m_wakes.push({ ns, index, port.wakeGeneration });
+    }
+}
+
+/*
+ * @brief Arms the timer to the earliest current deadline, stale heap entries are dropped on the way.
+ */
+void FanOut::armTimer()
+{
+    while (!m_wakes.empty() && m_wakes.top().generation != m_ports[m_wakes.top().port]->wakeGeneration) {
+        m_wakes.pop();
+    }
+
+    int64_t ns = m_wakes.empty() ? 0 : m_wakes.top().ns;
+    if (ns == m_armedNs) {
+        return;
+    }
+    // A deadline already passed fires at once, 0 disarms
+    struct itimerspec spec = {};
+    spec.it_value.tv_sec = ns / nsPerSecond;
+    spec.it_value.tv_nsec = ns % nsPerSecond;
+    timerfd_settime(m_timer, TFD_TIMER_ABSTIME, &spec, nullptr);
+    m_armedNs = ns;
+}
+
+void FanOut::finish(Port& port)
+{
+    if (port.finished) {
+        return;
+    }
+    port.finished = true;
+    port.wakeGeneration++;
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, port.fd, nullptr);
+    m_active--;
+}
+
+void FanOut::fail(Port& port)
+{
+    if (!port.finished) {
+        std::cerr << "Fail to write data: " << port.name << std::endl;
+    }
+    port.failed = true;
+    finish(port);
+}
@@ -0,0 +1,91 @@
+/*******************************************************************************
+* @brief    Replay to many serial ports from one event loop
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "EpochReader.h"
+#include "ReplayClock.h"
+
+/*
+ * @brief Drives any number of ports, each fed by its own epoch source.
+ *
+ * Every port has a send queue and a deadline: the deadline of its next epoch
+ * (see ReplayClock) or, when paced, of its next chunk. The deadlines of all
+ * ports are kept in one heap, and a single timerfd armed to the earliest one
+ * wakes an epoll loop that also reports the ports that take data again after
+ * a short write. The fds are non-blocking, so a slow port never holds back
+ * the others, and the cost per wake-up is that of the ports due, not of all
+ * of them.
+ */
+class FanOut {
+public:
+    FanOut(double speed, uint32_t paceBytesPerSecond);
+    ~FanOut();
+
+    bool add(int fd, const std::string& name, std::unique_ptr<EpochSource> source);
+    bool run();
+    void printSummary() const;
+
+private:
+    struct Port {
+        size_t index; // epoll key
+        int fd;
+        std::string name;
+        std::unique_ptr<EpochSource> source;
+        ReplayClock clock;
+        EpochSource::Epoch epoch; // Next epoch, scheduled on clock
+        bool hasEpoch = false;
+        std::string queue; // Bytes to write, from offset on
+        size_t offset = 0;
+        int64_t chunkNs = 0; // Deadline of the next paced chunk
+        bool waitOut = false; // Registered for EPOLLOUT after a short write
+        bool finished = false; // Done or failed, off the event loop
+        bool failed = false;
+        uint64_t wakeGeneration = 0; // Tells the current heap entry from stale ones
+        uint64_t lines = 0;
+        uint64_t bytes = 0;
+        int64_t maxLateNs = 0; // Longest queueing of an epoch after its deadline
+
+        Port(size_t index, int fd, const std::string& name, std::unique_ptr<EpochSource> source, double speed);
+        bool done() const { return !hasEpoch && offset == queue.size(); }
+    };
+
+    struct Wake {
+        int64_t ns; // CLOCK_MONOTONIC
+        size_t port;
+        uint64_t generation;
+
+        bool operator>(const Wake& other) const { return ns > other.ns; }
+    };
+
+    void loadEpoch(Port& port);
+    void service(size_t index, int64_t now);
+    bool flush(Port& port, int64_t now);
+    void watchOut(Port& port, bool enable);
+    void scheduleWake(size_t index, int64_t now);
+    void armTimer();
+    void finish(Port& port);
+    void fail(Port& port);
+
+    double m_speed;
+    uint32_t m_pace;
+    int m_epoll = -1;
+    int m_timer = -1;
+    std::vector<std::unique_ptr<Port>> m_ports;
+    std::priority_queue<Wake, std::vector<Wake>, std::greater<Wake>> m_wakes;
+    int64_t m_armedNs = 0; // Timer deadline, 0 if disarmed or expired
+    size_t m_active = 0; // Ports not finished yet
+    uint64_t m_wakeups = 0; // epoll_wait() returns
+    uint64_t m_calls = 0; // write system calls
+    double m_seconds = 0; // Duration of run()
+    double m_cpu = 0; // Process CPU time spent in run(), seconds
+};
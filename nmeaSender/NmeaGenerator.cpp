@@ -0,0 +1,506 @@
+/*******************************************************************************
+* @brief    Synthetic NMEA traffic along a modelled trajectory
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*******************************************************************************/
+#include "NmeaGenerator.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+#include "NmeaIndex.h"
+
+namespace {
+
+constexpr double earthRadiusM = 6371000;
+constexpr double degPerRad = 180 / M_PI;
+constexpr double knotsPerMps = 3600.0 / 1852;
+constexpr double kmhPerMps = 3.6;
+
+// Random walk: standard deviation of heading and speed changes over one second
+constexpr double walkHeadingRad = 20 / degPerRad;
+constexpr double walkSpeedMps = 0.5;
+
+// Road: turns are taken at a lower speed on a fixed radius
+constexpr double roadTurnRadiusM = 15;
+constexpr double roadTurnSpeedMps = 6;
+constexpr double roadAccelerationMps2 = 2;
+constexpr double roadSegmentMinM = 100;
+constexpr double roadSegmentMaxM = 800;
+
+constexpr double pdop = 1.6;
+constexpr double hdop = 0.9;
+constexpr double vdop = 1.3;
+constexpr double geoidSeparationM = 18;
+
+const uint32_t powersOfTen[] = { 1, 10, 100, 1000, 10000, 100000 };
+
+void appendUint(std::string& out, uint64_t value, int width)
+{
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (0 != value);
+    for (int pad = count; pad < width; pad++) {
+        out += '0';
+    }
+    while (0 < count) {
+        out += digits[--count];
+    }
+}
+
+void appendFixed(std::string& out, double value, int decimals)
+{
+    if (value < 0) {
+        out += '-';
+        value = -value;
+    }
+    uint64_t scaled = static_cast<uint64_t>(llround(value * powersOfTen[decimals]));
+    appendUint(out, scaled / powersOfTen[decimals], 1);
+    if (0 < decimals) {
+        out += '.';
+        appendUint(out, scaled % powersOfTen[decimals], decimals);
+    }
+}
+
+// DDMM.MMMMM or DDDMM.MMMMM, then the hemisphere
+void appendCoordinate(std::string& out, double degrees, int degreeDigits, char positive, char negative)
+{
+    uint64_t minutes = static_cast<uint64_t>(llround(std::fabs(degrees) * 60 * 100000));
+    appendUint(out, minutes / 6000000, degreeDigits);
+    appendUint(out, minutes % 6000000 / 100000, 2);
+    out += '.';
+    appendUint(out, minutes % 100000, 5);
+    out += ',';
+    out += (degrees < 0) ? negative : positive;
+}
+
+// HHMMSS.SS
+void appendTime(std::string& out, const struct tm& date, int64_t timeMs)
+{
+    appendUint(out, static_cast<uint64_t>(date.tm_hour), 2);
+    appendUint(out, static_cast<uint64_t>(date.tm_min), 2);
+    appendUint(out, static_cast<uint64_t>(date.tm_sec), 2);
+    out += '.';
+    appendUint(out, static_cast<uint64_t>(timeMs % 1000 / 10), 2);
+}
+
+void begin(std::string& out, const std::string& talker, const char* type)
+{
+    out.assign(1, '$');
+    out += talker;
+    out += type;
+}
+
+void finish(std::string& out)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    uint8_t checksum = 0;
+    for (size_t i = 1; i < out.size(); i++) {
+        checksum ^= static_cast<uint8_t>(out[i]);
+    }
+    out += '*';
+    out += hex[checksum >> 4];
+    out += hex[checksum & 0x0F];
+}
+
+bool toDouble(const std::string& text, double& value)
+{
+    char* end;
+    value = strtod(text.c_str(), &end);
+    return !text.empty() && 0 == *end;
+}
+
+bool toUint(const std::string& text, uint32_t& value)
+{
+    char* end;
+    unsigned long parsed = strtoul(text.c_str(), &end, 10);
+    value = static_cast<uint32_t>(parsed);
+    return !text.empty() && 0 == *end && '-' != text[0] && parsed <= UINT32_MAX;
+}
+
+bool isTalker(const std::string& text)
+{
+    return 2 == text.size() && isupper(static_cast<unsigned char>(text[0])) && isupper(static_cast<unsigned char>(text[1]));
+}
+
+std::vector<std::string> split(const std::string& text, char separator)
+{
+    std::vector<std::string> parts;
+    size_t begin = 0;
+    for (;;) {
+        size_t end = text.find(separator, begin);
+        parts.push_back(text.substr(begin, end - begin));
+        if (std::string::npos == end) {
+            return parts;
+        }
+        begin = end + 1;
+    }
+}
+
+}
+
+/*
+ * @brief Parses "key=value,..."; keys left out keep their defaults.
+ *
+ * Keys: model (line, circle, walk, road), rate (Hz), mix (RMC+GGA+GSA+GSV+VTG),
+ * talker (e.g. GN), sats (constellation talkers, e.g. GP+GL), noise (m),
+ * speed (m/s), heading (degree), radius (m), lat, lon (degree), alt (m),
+ * start (YYYY-MM-DDTHH:MM:SS), duration (s, 0: endless), seed.
+ *
+ * @param spec Configuration
+ * @return bool False on an unknown key or an invalid value.
+ */
+bool NmeaGenerator::Config::parse(const std::string& spec)
+{
+    bool satsGiven = false;
+
+    for (const auto& pair : split(spec, ',')) {
+        if (pair.empty()) {
+            continue;
+        }
+        auto separator = pair.find('=');
+        if (std::string::npos == separator) {
+            return false;
+        }
+        auto key = pair.substr(0, separator);
+        auto value = pair.substr(separator + 1);
+
+        bool ok = true;
+        if ("model" == key) {
+            if ("line" == value) {
+                model = Model::Line;
+            } else if ("circle" == value) {
+                model = Model::Circle;
+            } else if ("walk" == value) {
+                model = Model::Walk;
+            } else if ("road" == value) {
+                model = Model::Road;
+            } else {
+                ok = false;
+            }
+        } else if ("rate" == key) {
+            ok = toUint(value, rateHz) && 1 <= rateHz && rateHz <= maxRateHz;
+        } else if ("mix" == key) {
+            mix = 0;
+            for (const auto& type : split(value, '+')) {
+                if ("RMC" == type) {
+                    mix |= RMC;
+                } else if ("GGA" == type) {
+                    mix |= GGA;
+                } else if ("GSA" == type) {
+                    mix |= GSA;
+                } else if ("GSV" == type) {
+                    mix |= GSV;
+                } else if ("VTG" == type) {
+                    mix |= VTG;
+                } else {
+                    ok = false;
+                }
+            }
+        } else if ("talker" == key) {
+            talker = value;
+            ok = isTalker(value);
+        } else if ("sats" == key) {
+            constellations = split(value, '+');
+            ok = std::all_of(constellations.begin(), constellations.end(), isTalker);
+            satsGiven = true;
+        } else if ("noise" == key) {
+            ok = toDouble(value, noiseM) && 0 <= noiseM;
+        } else if ("speed" == key) {
+            ok = toDouble(value, speedMps) && 0 <= speedMps;
+        } else if ("heading" == key) {
+            ok = toDouble(value, headingDeg);
+        } else if ("radius" == key) {
+            ok = toDouble(value, radiusM) && 0 < radiusM;
+        } else if ("lat" == key) {
+            ok = toDouble(value, latitude) && -90 < latitude && latitude < 90;
+        } else if ("lon" == key) {
+            ok = toDouble(value, longitude) && -180 <= longitude && longitude <= 180;
+        } else if ("alt" == key) {
+            ok = toDouble(value, altitudeM);
+        } else if ("start" == key) {
+            ok = NmeaIndex::parseTime(value, startMs);
+        } else if ("duration" == key) {
+            ok = toUint(value, durationS);
+        } else if ("seed" == key) {
+            ok = toUint(value, seed);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+
+    // A multi-GNSS receiver reports its satellites per constellation
+    if (!satsGiven) {
+        constellations = { "GN" == talker ? std::string("GP") : talker };
+        if ("GN" == talker) {
+            constellations.push_back("GL");
+        }
+    }
+    return true;
+}
+
+NmeaGenerator::NmeaGenerator(const Config& config)
+    : m_config(config)
+    , m_random(config.seed)
+    , m_latitude(config.latitude)
+    , m_longitude(config.longitude)
+    , m_headingRad(config.headingDeg / degPerRad)
+    , m_speedMps(config.speedMps)
+{
+    m_segmentM = std::uniform_real_distribution<double>(roadSegmentMinM, roadSegmentMaxM)(m_random);
+
+    // GLONASS satellites are numbered from 65, the others from 1
+    for (const auto& talker : m_config.constellations) {
+        std::vector<uint8_t> prns(32);
+        for (size_t i = 0; i < prns.size(); i++) {
+            prns[i] = static_cast<uint8_t>(("GL" == talker ? 65 : 1) + i);
+        }
+        std::shuffle(prns.begin(), prns.end(), m_random);
+        std::sort(prns.begin(), prns.begin() + satellitesPerConstellation);
+        m_prns.insert(m_prns.end(), prns.begin(), prns.begin() + satellitesPerConstellation);
+    }
+}
+
+/*
+ * @brief Generates the sentences of the next epoch, GGA, GSA, GSV, RMC and VTG in this order.
+ *
+ * @details The strings of the epoch are overwritten in place, so passing the
+ *          same epoch again reuses their allocations.
+ *
+ * @param epoch Lines and time of the epoch
+ * @return bool False after the configured duration.
+ */
+bool NmeaGenerator::next(Epoch& epoch)
+{
+    if (0 != m_config.durationS && m_epoch >= static_cast<uint64_t>(m_config.durationS) * m_config.rateHz) {
+        return false;
+    }
+    if (0 != m_epoch) {
+        move(1.0 / m_config.rateHz);
+    }
+
+    m_timeMs = m_config.startMs + static_cast<int64_t>(m_epoch * 1000 / m_config.rateHz);
+    time_t seconds = static_cast<time_t>(m_timeMs / 1000);
+    gmtime_r(&seconds, &m_date);
+
+    m_fixLatitude = m_latitude;
+    m_fixLongitude = m_longitude;
+    m_fixAltitudeM = m_config.altitudeM;
+    m_fixSpeedMps = m_speedMps;
+    if (0 < m_config.noiseM) {
+        double northM = m_normal(m_random) * m_config.noiseM;
+        double eastM = m_normal(m_random) * m_config.noiseM;
+        m_fixLatitude += northM / earthRadiusM * degPerRad;
+        m_fixLongitude += eastM / (earthRadiusM * cos(m_latitude / degPerRad)) * degPerRad;
+        m_fixAltitudeM += m_normal(m_random) * m_config.noiseM * 1.5;
+        m_fixSpeedMps = std::max(0.0, m_fixSpeedMps + m_normal(m_random) * m_config.noiseM * 0.1);
+    }
+    // In 0.1 degree, so that 359.96 is reported as 0.0, not 360.0
+    double courseTenths = fmod(round(m_headingRad * degPerRad * 10), 3600);
+    m_fixCourseDeg = ((courseTenths < 0) ? courseTenths + 3600 : courseTenths) / 10;
+
+    m_lines = 0;
+    if (0 != (m_config.mix & GGA)) {
+        formatGga(line(epoch));
+    }
+    for (size_t i = 0; i < m_config.constellations.size(); i++) {
+        if (0 != (m_config.mix & GSA)) {
+            formatGsa(line(epoch), m_config.constellations[i], i);
+        }
+    }
+    for (size_t i = 0; i < m_config.constellations.size(); i++) {
+        const size_t parts = (satellitesPerConstellation + 3) / 4;
+        for (size_t part = 0; 0 != (m_config.mix & GSV) && part < parts; part++) {
+            formatGsv(line(epoch), m_config.constellations[i], i, part, parts);
+        }
+    }
+    if (0 != (m_config.mix & RMC)) {
+        formatRmc(line(epoch));
+    }
+    if (0 != (m_config.mix & VTG)) {
+        formatVtg(line(epoch));
+    }
+    epoch.lines.resize(m_lines);
+    epoch.timeOfDayMs = m_timeMs % EpochReader::msPerDay;
+
+    m_epoch++;
+    return true;
+}
+
+/*
+ * @brief Advances the trajectory by dt seconds.
+ */
+void NmeaGenerator::move(double dt)
+{
+    double turnRadPerS = 0;
+
+    switch (m_config.model) {
+    case Model::Line:
+        break;
+    case Model::Circle:
+        turnRadPerS = m_speedMps / m_config.radiusM;
+        break;
+    case Model::Walk:
+        m_headingRad += m_normal(m_random) * walkHeadingRad * sqrt(dt);
+        m_speedMps += m_normal(m_random) * walkSpeedMps * sqrt(dt);
+        m_speedMps = std::min(std::max(m_speedMps, 0.0), 2 * m_config.speedMps);
+        break;
+    case Model::Road: {
+        double target = (0 != m_turnRad) ? std::min(m_config.speedMps, roadTurnSpeedMps) : m_config.speedMps;
+        double change = roadAccelerationMps2 * dt;
+        m_speedMps += std::max(-change, std::min(change, target - m_speedMps));
+        if (0 != m_turnRad) {
+            turnRadPerS = std::copysign(m_speedMps / roadTurnRadiusM, m_turnRad);
+        }
+        break;
+    }
+    }
+
+    double turnRad = turnRadPerS * dt;
+    if (Model::Road == m_config.model && 0 != m_turnRad && std::fabs(turnRad) >= std::fabs(m_turnRad)) {
+        turnRad = m_turnRad;
+        m_turnRad = 0;
+    } else if (Model::Road == m_config.model) {
+        m_turnRad -= turnRad;
+    }
+
+    // Along the mean heading of the step, exact enough for an arc at up to 50 Hz
+    double distanceM = m_speedMps * dt;
+    double headingRad = m_headingRad + turnRad / 2;
+    m_latitude += distanceM * cos(headingRad) / earthRadiusM * degPerRad;
+    m_longitude += distanceM * sin(headingRad) / (earthRadiusM * cos(m_latitude / degPerRad)) * degPerRad;
+    m_latitude = std::max(-89.9, std::min(89.9, m_latitude));
+    if (m_longitude >= 180) {
+        m_longitude -= 360;
+    } else if (m_longitude < -180) {
+        m_longitude += 360;
+    }
+    m_headingRad += turnRad;
+
+    if (Model::Road == m_config.model && 0 == m_turnRad) {
+        m_segmentM -= distanceM;
+        if (m_segmentM <= 0) {
+            turnRoad();
+        }
+    }
+}
+
+/*
+ * @brief Starts a road turn: a crossing, a fork or a bend, then the next straight segment.
+ */
+void NmeaGenerator::turnRoad()
+{
+    static const double turnsDeg[] = { 90, -90, 45, -45, 15, -15 };
+    size_t turn = std::uniform_int_distribution<size_t>(0, sizeof(turnsDeg) / sizeof(turnsDeg[0]) - 1)(m_random);
+
+    m_turnRad = turnsDeg[turn] / degPerRad;
+    m_segmentM = std::uniform_real_distribution<double>(roadSegmentMinM, roadSegmentMaxM)(m_random);
+}
+
+std::string& NmeaGenerator::line(Epoch& epoch)
+{
+    if (m_lines == epoch.lines.size()) {
+        epoch.lines.emplace_back();
+    }
+    return epoch.lines[m_lines++];
+}
+
+void NmeaGenerator::formatRmc(std::string& out)
+{
+    begin(out, m_config.talker, "RMC,");
+    appendTime(out, m_date, m_timeMs);
+    out += ",A,";
+    appendCoordinate(out, m_fixLatitude, 2, 'N', 'S');
+    out += ',';
+    appendCoordinate(out, m_fixLongitude, 3, 'E', 'W');
+    out += ',';
+    appendFixed(out, m_fixSpeedMps * knotsPerMps, 1);
+    out += ',';
+    appendFixed(out, m_fixCourseDeg, 1);
+    out += ',';
+    appendUint(out, static_cast<uint64_t>(m_date.tm_mday), 2);
+    appendUint(out, static_cast<uint64_t>(m_date.tm_mon + 1), 2);
+    appendUint(out, static_cast<uint64_t>(m_date.tm_year % 100), 2);
+    out += ",,,A";
+    finish(out);
+}
+
+void NmeaGenerator::formatGga(std::string& out)
+{
+    begin(out, m_config.talker, "GGA,");
+    appendTime(out, m_date, m_timeMs);
+    out += ',';
+    appendCoordinate(out, m_fixLatitude, 2, 'N', 'S');
+    out += ',';
+    appendCoordinate(out, m_fixLongitude, 3, 'E', 'W');
+    out += ",1,";
+    appendUint(out, satellitesPerConstellation * m_config.constellations.size(), 2);
+    out += ',';
+    appendFixed(out, hdop, 1);
+    out += ',';
+    appendFixed(out, m_fixAltitudeM, 1);
+    out += ",M,";
+    appendFixed(out, geoidSeparationM, 1);
+    out += ",M,,";
+    finish(out);
+}
+
+void NmeaGenerator::formatGsa(std::string& out, const std::string& talker, size_t constellation)
+{
+    begin(out, talker, "GSA,A,3,");
+    for (size_t i = 0; i < satellitesPerConstellation; i++) {
+        appendUint(out, m_prns[constellation * satellitesPerConstellation + i], 2);
+        out += ',';
+    }
+    appendFixed(out, pdop, 1);
+    out += ',';
+    appendFixed(out, hdop, 1);
+    out += ',';
+    appendFixed(out, vdop, 1);
+    finish(out);
+}
+
+void NmeaGenerator::formatGsv(std::string& out, const std::string& talker, size_t constellation, size_t part, size_t parts)
+{
+    // Satellites drift across the sky at a fraction of a degree per minute
+    double driftDeg = static_cast<double>(m_epoch) / m_config.rateHz / 240;
+
+    begin(out, talker, "GSV,");
+    appendUint(out, parts, 1);
+    out += ',';
+    appendUint(out, part + 1, 1);
+    out += ',';
+    appendUint(out, satellitesPerConstellation, 2);
+    for (size_t i = part * 4; i < std::min(part * 4 + 4, satellitesPerConstellation); i++) {
+        uint32_t prn = m_prns[constellation * satellitesPerConstellation + i];
+        out += ',';
+        appendUint(out, prn, 2);
+        out += ',';
+        appendUint(out, 10 + (prn * 37 + i * 11) % 75, 2);
+        out += ',';
+        appendUint(out, static_cast<uint64_t>(fmod(prn * 97 + driftDeg, 360)), 3);
+        out += ',';
+        appendUint(out, 30 + prn % 20, 2);
+    }
+    finish(out);
+}
+
+void NmeaGenerator::formatVtg(std::string& out)
+{
+    begin(out, m_config.talker, "VTG,");
+    appendFixed(out, m_fixCourseDeg, 1);
+    out += ",T,,M,";
+    appendFixed(out, m_fixSpeedMps * knotsPerMps, 1);
+    out += ",N,";
+    appendFixed(out, m_fixSpeedMps * kmhPerMps, 1);
+    out += ",K,A";
+    finish(out);
+}
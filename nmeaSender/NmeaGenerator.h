@@ -0,0 +1,108 @@
+/*******************************************************************************
+* @brief    Synthetic NMEA traffic along a modelled trajectory
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "EpochReader.h"
+
+/*
+ * @brief Generates the epochs of a receiver moving along a trajectory model.
+ *
+ * Models: a straight line, a circle, a random walk of heading and speed, and
+ * a road of straight segments joined by slowed-down turns. Position noise is
+ * added to the reported fix only, the trajectory itself stays smooth. The
+ * random sequence depends on the seed alone, so a configuration gives the
+ * same sentences on every run.
+ *
+ * The configuration is a comma separated list of key=value pairs, see
+ * Config::parse(); sentences are formatted without printf, to keep up with
+ * millions of sentences per second.
+ */
+class NmeaGenerator : public EpochSource {
+public:
+    enum class Model {
+        Line,
+        Circle,
+        Walk,
+        Road,
+    };
+
+    enum Sentence : uint8_t {
+        RMC = 1 << 0,
+        GGA = 1 << 1,
+        GSA = 1 << 2,
+        GSV = 1 << 3,
+        VTG = 1 << 4,
+    };
+
+    struct Config {
+        Model model = Model::Line;
+        uint32_t rateHz = 1; // Epochs per second, 1..50
+        uint8_t mix = RMC | GGA | GSA; // Sentence bits
+        std::string talker = "GP"; // Talker of RMC, GGA and VTG
+        std::vector<std::string> constellations = { "GP" }; // Talkers of GSA and GSV, one set of satellites each
+        double noiseM = 0; // Standard deviation of the horizontal position noise
+        double speedMps = 10;
+        double headingDeg = 45; // Initial course, clockwise from north
+        double radiusM = 100; // Circle radius
+        double latitude = 59.4370;
+        double longitude = 24.7536;
+        double altitudeM = 30;
+        int64_t startMs = 1563702155000; // 2019-07-21T09:42:35Z
+        uint32_t durationS = 3600; // 0: endless
+        uint32_t seed = 1;
+
+        bool parse(const std::string& spec);
+    };
+
+    static constexpr uint32_t maxRateHz = 50;
+    static constexpr size_t satellitesPerConstellation = 12;
+
+    explicit NmeaGenerator(const Config& config);
+
+    bool next(Epoch& epoch) override;
+
+private:
+    void move(double dt);
+    void turnRoad();
+
+    std::string& line(Epoch& epoch);
+    void formatRmc(std::string& out);
+    void formatGga(std::string& out);
+    void formatGsa(std::string& out, const std::string& talker, size_t constellation);
+    void formatGsv(std::string& out, const std::string& talker, size_t constellation, size_t part, size_t parts);
+    void formatVtg(std::string& out);
+
+    Config m_config;
+    std::mt19937 m_random;
+    std::normal_distribution<double> m_normal { 0, 1 };
+    uint64_t m_epoch = 0; // Epochs generated
+    size_t m_lines = 0; // Lines of the current epoch
+
+    // Trajectory
+    double m_latitude; // Degrees
+    double m_longitude;
+    double m_headingRad;
+    double m_speedMps;
+    double m_segmentM = 0; // Road: straight distance left before the next turn
+    double m_turnRad = 0; // Road: turn angle left, signed
+
+    // Fix of the current epoch, as reported
+    int64_t m_timeMs = 0;
+    double m_fixLatitude = 0;
+    double m_fixLongitude = 0;
+    double m_fixAltitudeM = 0;
+    double m_fixSpeedMps = 0;
+    double m_fixCourseDeg = 0;
+    struct tm m_date = {}; // UTC date and time of m_timeMs
+
+    std::vector<uint8_t> m_prns; // satellitesPerConstellation per constellation
+};
@@ -0,0 +1,359 @@
+/*******************************************************************************
+* @brief    Sparse time index for NMEA logs
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*******************************************************************************/
+#include "NmeaIndex.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+
+#include <sys/stat.h>
+
+#include "minmea.h"
+
+namespace {
+
+const char indexMagic[8] = { 'N', 'M', 'E', 'A', 'I', 'D', 'X', '2' };
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t step;
+    uint32_t reserved;
+    uint64_t logSize;
+    int64_t logMtimeNs;
+    uint64_t logInode;
+    uint64_t count;
+};
+
+// Read buffer used while scanning multi-GB logs
+constexpr size_t readBufferSize = 1 << 20;
+
+/*
+ * @brief Size, modification time and inode of the log.
+ *
+ * A log rewritten or rotated in place may keep its size, the index is only
+ * reused if all three match.
+ */
+bool fileStamp(const std::string& path, uint64_t& size, int64_t& mtimeNs, uint64_t& inode)
+{
+    struct stat st;
+    if (0 != stat(path.c_str(), &st)) {
+        return false;
+    }
+    size = static_cast<uint64_t>(st.st_size);
+    mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    inode = static_cast<uint64_t>(st.st_ino);
+    return true;
+}
+
+/*
+ * @brief Same as minmea_gettime(), which is compiled out for the firmware.
+ */
+bool toUnixMs(const minmea_date& date, const minmea_time& time, int64_t& timeMs)
+{
+    if (date.year == -1 || time.hours == -1) {
+        return false;
+    }
+
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if (date.year < 80) {
+        tm.tm_year = 2000 + date.year - 1900; // 2000-2079
+    } else if (date.year >= 1900) {
+        tm.tm_year = date.year - 1900; // 4 digit year, use directly
+    } else {
+        tm.tm_year = date.year; // 1980-1999
+    }
+    tm.tm_mon = date.month - 1;
+    tm.tm_mday = date.day;
+    tm.tm_hour = time.hours;
+    tm.tm_min = time.minutes;
+    tm.tm_sec = time.seconds;
+
+    time_t timestamp = timegm(&tm);
+    if (timestamp == static_cast<time_t>(-1)) {
+        return false;
+    }
+    timeMs = static_cast<int64_t>(timestamp) * 1000 + time.microseconds / 1000;
+    return true;
+}
+
+}
+
+/*
+ * @brief Returns path of the index file stored next to the log.
+ *
+ * @param logPath Path to NMEA log
+ * @return std::string
+ */
+std::string NmeaIndex::sidecarPath(const std::string& logPath)
+{
+    return logPath + ".idx";
+}
+
+/*
+ * @brief Extracts UTC time from RMC or ZDA sentence.
+ *
+ * @param line NMEA sentence, with or without line ending
+ * @param timeMs Milliseconds since the Unix epoch
+ * @return bool False if sentence has no full date and time.
+ */
+bool NmeaIndex::sentenceTime(const std::string& line, int64_t& timeMs)
+{
+    switch (minmea_sentence_id(line.c_str(), false)) {
+    case MINMEA_SENTENCE_RMC: {
+        struct minmea_sentence_rmc frame;
+        if (minmea_parse_rmc(&frame, line.c_str())) {
+            return toUnixMs(frame.date, frame.time, timeMs);
+        }
+        break;
+    }
+    case MINMEA_SENTENCE_ZDA: {
+        struct minmea_sentence_zda frame;
+        if (minmea_parse_zda(&frame, line.c_str())) {
+            return toUnixMs(frame.date, frame.time, timeMs);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return false;
+}
+
+/*
+ * @brief Parses UTC time given as "YYYY-MM-DDTHH:MM:SS[.sss][Z]".
+ *
+ * @param text Time string
+ * @param timeMs Milliseconds since the Unix epoch
+ * @return bool
+ */
+bool NmeaIndex::parseTime(const std::string& text, int64_t& timeMs)
+{
+    minmea_date date;
+    minmea_time time;
+    char separator = 0;
+    int millis = 0;
+    int consumed = 0;
+
+    int fields = sscanf(text.c_str(), "%4d-%2d-%2d%c%2d:%2d:%2d%n",
+        &date.year, &date.month, &date.day, &separator,
+        &time.hours, &time.minutes, &time.seconds, &consumed);
+    if (7 != fields || ('T' != separator && ' ' != separator)) {
+        return false;
+    }
+
+    const char* tail = text.c_str() + consumed;
+    if ('.' == *tail) {
+        int digits = 0;
+        for (tail++; *tail >= '0' && *tail <= '9'; tail++, digits++) {
+            if (digits < 3) {
+                millis = millis * 10 + (*tail - '0');
+            }
+        }
+        for (; digits < 3; digits++) {
+            millis *= 10;
+        }
+    }
+    if ('Z' == *tail) {
+        tail++;
+    }
+    if (0 != *tail) {
+        return false;
+    }
+
+    time.microseconds = millis * 1000;
+    return toUnixMs(date, time, timeMs);
+}
+
+/*
+ * @brief Scans the whole log and builds the index in memory.
+ *
+ * @param logPath Path to NMEA log
+ * @param stepSeconds Minimal log time between two index entries
+ * @return bool
+ */
+bool NmeaIndex::build(const std::string& logPath, uint32_t stepSeconds)
+{
+    std::vector<char> buffer(readBufferSize);
+    std::ifstream input;
+    input.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    input.open(logPath, std::ios::binary);
+    if (!input || !fileStamp(logPath, m_logSize, m_logMtimeNs, m_logInode)) {
+        return false;
+    }
+
+    m_step = std::max<uint32_t>(stepSeconds, 1);
+    m_entries.clear();
+
+    uint64_t offset = 0;
+    uint64_t epochStart = 0;
+    int64_t nextTimeMs = INT64_MIN;
+
+    for (std::string line; getline(input, line);) {
+        offset += line.length() + 1;
+        if (!line.empty() && '\r' == line.back()) {
+            line.pop_back();
+        }
+
+        int64_t timeMs;
+        if (!sentenceTime(line, timeMs)) {
+            continue;
+        }
+
+        // Entries must stay sorted, time jumps backwards are not indexed
+        if (timeMs >= nextTimeMs) {
+            m_entries.push_back({ timeMs, epochStart });
+            nextTimeMs = timeMs + static_cast<int64_t>(m_step) * 1000;
+        }
+        epochStart = offset;
+    }
+    return true;
+}
+
+/*
+ * @brief Loads the sidecar index. Fails if it is missing or the log has changed (size, mtime or inode).
+ *
+ * @param logPath Path to NMEA log
+ * @return bool
+ */
+bool NmeaIndex::load(const std::string& logPath)
+{
+    std::ifstream input(sidecarPath(logPath), std::ios::binary);
+    if (!input) {
+        return false;
+    }
+
+    IndexHeader header;
+    if (!input.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return false;
+    }
+
+    uint64_t logSize;
+    int64_t logMtimeNs;
+    uint64_t logInode;
+    if (0 != memcmp(header.magic, indexMagic, sizeof(indexMagic))
+        || !fileStamp(logPath, logSize, logMtimeNs, logInode)
+        || logSize != header.logSize || logMtimeNs != header.logMtimeNs || logInode != header.logInode
+        || header.count > logSize) {
+        return false;
+    }
+
+    std::vector<Entry> entries(header.count);
+    if (!input.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(Entry))) {
+        return false;
+    }
+
+    m_step = header.step;
+    m_logSize = header.logSize;
+    m_logMtimeNs = header.logMtimeNs;
+    m_logInode = header.logInode;
+    m_entries.swap(entries);
+    return true;
+}
+
+/*
+ * @brief Writes the index next to the log.
+ *
+ * @param logPath Path to NMEA log
+ * @return bool
+ */
+bool NmeaIndex::save(const std::string& logPath) const
+{
+    std::ofstream output(sidecarPath(logPath), std::ios::binary | std::ios::trunc);
+    if (!output) {
+        return false;
+    }
+
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, indexMagic, sizeof(indexMagic));
+    header.step = m_step;
+    header.logSize = m_logSize;
+    header.logMtimeNs = m_logMtimeNs;
+    header.logInode = m_logInode;
+    header.count = m_entries.size();
+
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char*>(m_entries.data()), m_entries.size() * sizeof(Entry));
+    return static_cast<bool>(output);
+}
+
+/*
+ * @brief Loads the sidecar index, or builds and saves it if it is missing or stale.
+ *
+ * @param logPath Path to NMEA log
+ * @param stepSeconds Step used if the index has to be rebuilt
+ * @return bool
+ */
+bool NmeaIndex::open(const std::string& logPath, uint32_t stepSeconds)
+{
+    if (load(logPath)) {
+        return true;
+    }
+    if (!build(logPath, stepSeconds)) {
+        return false;
+    }
+    // Failing to store the sidecar (e.g. read-only media) is not fatal
+    save(logPath);
+    return true;
+}
+
+/*
+ * @brief Binary search for the last entry not later than given time.
+ *
+ * @param timeMs Milliseconds since the Unix epoch
+ * @return uint64_t Byte offset to start scanning from.
+ */
+uint64_t NmeaIndex::lookup(int64_t timeMs) const
+{
+    auto it = std::upper_bound(m_entries.begin(), m_entries.end(), timeMs,
+        [](int64_t value, const Entry& entry) { return value < entry.timeMs; });
+    if (it == m_entries.begin()) {
+        return 0;
+    }
+    return std::prev(it)->offset;
+}
+
+/*
+ * @brief Positions the stream at the start of the first epoch at or after given time.
+ *
+ * @details At most `step` seconds of log are scanned after the binary search.
+ *
+ * @param input Stream opened on the indexed log
+ * @param timeMs Milliseconds since the Unix epoch
+ * @return bool False if the log ends before given time.
+ */
+bool NmeaIndex::seek(std::istream& input, int64_t timeMs) const
+{
+    uint64_t offset = lookup(timeMs);
+
+    input.clear();
+    if (!input.seekg(static_cast<std::streamoff>(offset))) {
+        return false;
+    }
+
+    uint64_t epochStart = offset;
+    for (std::string line; getline(input, line);) {
+        offset += line.length() + 1;
+        if (!line.empty() && '\r' == line.back()) {
+            line.pop_back();
+        }
+
+        int64_t lineTimeMs;
+        if (!sentenceTime(line, lineTimeMs)) {
+            continue;
+        }
+        if (lineTimeMs >= timeMs) {
+            input.clear();
+            return static_cast<bool>(input.seekg(static_cast<std::streamoff>(epochStart)));
+        }
+        epochStart = offset;
+    }
+    return false;
+}
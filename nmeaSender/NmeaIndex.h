@@ -0,0 +1,50 @@
+/*******************************************************************************
+* @brief    Sparse time index for NMEA logs
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+/*
+ * @brief Maps UTC time of RMC/ZDA sentences to byte offsets in an NMEA log.
+ *
+ * An entry is stored roughly every `step` seconds of log time and points to
+ * the first line of the epoch (the line following the previous timestamped
+ * sentence), so GGA/GSA sentences preceding the RMC are not skipped.
+ * The index lives next to the log as "<log>.idx".
+ */
+class NmeaIndex {
+public:
+    struct Entry {
+        int64_t timeMs; // UTC, milliseconds since the Unix epoch
+        uint64_t offset; // Byte offset of the epoch start in the log
+    };
+
+    static constexpr uint32_t defaultStep = 60;
+
+    static std::string sidecarPath(const std::string& logPath);
+    static bool sentenceTime(const std::string& line, int64_t& timeMs);
+    static bool parseTime(const std::string& text, int64_t& timeMs);
+
+    bool build(const std::string& logPath, uint32_t stepSeconds = defaultStep);
+    bool load(const std::string& logPath);
+    bool save(const std::string& logPath) const;
+    bool open(const std::string& logPath, uint32_t stepSeconds = defaultStep);
+
+    uint64_t lookup(int64_t timeMs) const;
+    bool seek(std::istream& input, int64_t timeMs) const;
+
+    const std::vector<Entry>& entries() const { return m_entries; }
+
+private:
+    uint32_t m_step = defaultStep;
+    uint64_t m_logSize = 0;
+    int64_t m_logMtimeNs = 0;
+    uint64_t m_logInode = 0;
+    std::vector<Entry> m_entries;
+};
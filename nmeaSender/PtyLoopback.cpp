@@ -0,0 +1,127 @@
+/*******************************************************************************
+* @brief    Reader on the far end of a pseudo-terminal, timing what arrives
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*******************************************************************************/
+#include "PtyLoopback.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+extern "C" {
+#include "serial.h"
+}
+
+namespace {
+
+// Poll period of the reader, bounds the time to notice stop
+constexpr int readTimeoutMs = 100;
+
+constexpr size_t readBufferSize = 1 << 16;
+
+}
+
+PtyLoopback::~PtyLoopback()
+{
+    m_stop = true;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    if (0 <= m_fd) {
+        serialClose(m_fd);
+    }
+}
+
+/*
+ * @brief Opens the slave and starts reading it.
+ *
+ * @param slavePath Path printed by serialOpenPty()
+ * @return bool
+ */
+bool PtyLoopback::start(const std::string& slavePath)
+{
+    m_fd = open(slavePath.c_str(), O_RDONLY | O_NOCTTY);
+    if (0 > m_fd) {
+        return false;
+    }
+    m_thread = std::thread(&PtyLoopback::run, this);
+    return true;
+}
+
+/*
+ * @brief Announces a burst, to be called right before writing it.
+ *
+ * @param endBytes Bytes written to the pty once the burst is out
+ */
+void PtyLoopback::sending(uint64_t endBytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto now = Clock::now();
+    if (m_pending.empty() && 0 == m_sent) {
+        m_first = now;
+    }
+    m_pending.push_back({ endBytes, now });
+    m_sent = endBytes;
+}
+
+/*
+ * @brief Waits for the announced bytes and stops the reader.
+ *
+ * @param timeoutMs Time to wait for the last bytes
+ * @return bool False if bytes were lost.
+ */
+bool PtyLoopback::finish(int timeoutMs)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_arrived.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return m_received >= m_sent; });
+    }
+    m_stop = true;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_received == m_sent;
+}
+
+void PtyLoopback::printSummary() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    double seconds = std::chrono::duration<double>(m_last - m_first).count();
+
+    std::cout << "Loopback: " << m_lines << " sentences, " << m_received << " of " << m_sent << " bytes in " << seconds << " s";
+    if (0 < seconds) {
+        std::cout << ": " << static_cast<uint64_t>(m_lines / seconds) << " sentences/s, "
+                  << static_cast<uint64_t>(m_received / seconds) << " bytes/s";
+    }
+    std::cout << std::endl
+              << "Loopback latency, us: " << m_latency.summary() << std::endl;
+}
+
+void PtyLoopback::run()
+{
+    std::string buffer(readBufferSize, 0);
+
+    while (!m_stop) {
+        ssize_t count = serialRead(m_fd, &buffer[0], buffer.size(), readTimeoutMs);
+        if (0 >= count) {
+            continue;
+        }
+        auto now = Clock::now();
+        uint64_t lines = static_cast<uint64_t>(std::count(buffer.begin(), buffer.begin() + count, '\n'));
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_received += static_cast<uint64_t>(count);
+        m_lines += lines;
+        m_last = now;
+        while (!m_pending.empty() && m_pending.front().endBytes <= m_received) {
+            m_latency.add(std::chrono::duration<double, std::micro>(now - m_pending.front().sent).count());
+            m_pending.pop_front();
+        }
+        m_arrived.notify_all();
+    }
+}
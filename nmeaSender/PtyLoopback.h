@@ -0,0 +1,58 @@
+/*******************************************************************************
+* @brief    Reader on the far end of a pseudo-terminal, timing what arrives
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "CommandChannel.h"
+
+/*
+ * @brief Reads the slave of a pty in a thread and times every burst across it.
+ *
+ * The sender announces each burst with the byte count it ends at before
+ * writing it; the latency of the burst is the time from the announcement to
+ * its last byte arriving. Only the pty and the kernel are measured, there is
+ * no other process in the path.
+ */
+class PtyLoopback {
+public:
+    ~PtyLoopback();
+
+    bool start(const std::string& slavePath);
+    void sending(uint64_t endBytes);
+    bool finish(int timeoutMs);
+    void printSummary() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Burst {
+        uint64_t endBytes; // Byte count at the end of the burst
+        Clock::time_point sent;
+    };
+
+    void run();
+
+    int m_fd = -1;
+    std::thread m_thread;
+    std::atomic<bool> m_stop { false };
+    mutable std::mutex m_mutex;
+    std::condition_variable m_arrived;
+    std::deque<Burst> m_pending; // Bursts not fully received yet
+    uint64_t m_sent = 0; // Byte count announced
+    uint64_t m_received = 0;
+    uint64_t m_lines = 0;
+    Clock::time_point m_first; // First announcement
+    Clock::time_point m_last; // Last byte received
+    CommandChannel::Stats m_latency; // us
+};
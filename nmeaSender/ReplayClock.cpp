@@ -0,0 +1,110 @@
+/*******************************************************************************
+* @brief    Replay schedule following the log time
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*******************************************************************************/
+#include "ReplayClock.h"
+
+#include <cerrno>
+
+#include "EpochReader.h"
+
+namespace {
+
+constexpr int64_t nsPerSecond = 1000000000;
+
+// A step back in time of day longer than this is taken as midnight
+constexpr int64_t midnightStepMs = EpochReader::msPerDay / 2;
+
+int64_t diffNs(const struct timespec& a, const struct timespec& b)
+{
+    return (static_cast<int64_t>(a.tv_sec) - b.tv_sec) * nsPerSecond + (a.tv_nsec - b.tv_nsec);
+}
+
+struct timespec now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time;
+}
+
+}
+
+/*
+ * @brief Sets the deadline of the next epoch.
+ *
+ * @param timeOfDayMs UTC time of day of the epoch, -1 if it has none
+ */
+void ReplayClock::schedule(int64_t timeOfDayMs)
+{
+    m_epochs++;
+    if (!m_started) {
+        m_origin = now();
+        m_deadline = m_origin;
+        m_started = true;
+    }
+    if (-1 == timeOfDayMs) {
+        return;
+    }
+
+    if (-1 != m_lastTimeMs) {
+        int64_t stepMs = timeOfDayMs - m_lastTimeMs;
+        if (stepMs < -midnightStepMs) {
+            stepMs += EpochReader::msPerDay;
+        }
+        if (stepMs > 0) {
+            m_logMs += stepMs;
+        }
+    }
+    m_lastTimeMs = timeOfDayMs;
+    if (0 == m_speed) {
+        return;
+    }
+
+    int64_t offsetNs = static_cast<int64_t>(m_logMs * 1e6 / m_speed);
+    m_deadline.tv_sec = m_origin.tv_sec + offsetNs / nsPerSecond;
+    m_deadline.tv_nsec = m_origin.tv_nsec + offsetNs % nsPerSecond;
+    if (m_deadline.tv_nsec >= nsPerSecond) {
+        m_deadline.tv_sec++;
+        m_deadline.tv_nsec -= nsPerSecond;
+    }
+}
+
+/*
+ * @brief Milliseconds left until the deadline of the scheduled epoch, 0 if it passed.
+ */
+int64_t ReplayClock::remainingMs() const
+{
+    if (0 == m_speed) {
+        return 0;
+    }
+    int64_t ns = diffNs(m_deadline, now());
+    return ns > 0 ? ns / 1000000 : 0;
+}
+
+/*
+ * @brief Sleeps until the deadline of the scheduled epoch.
+ */
+void ReplayClock::wait()
+{
+    if (0 == m_speed) {
+        return;
+    }
+    while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &m_deadline, nullptr)) {
+    }
+    int64_t lateNs = diffNs(now(), m_deadline);
+    if (lateNs > m_maxLateNs) {
+        m_maxLateNs = lateNs;
+    }
+}
+
+/*
+ * @brief Seconds from the first epoch to now.
+ */
+double ReplayClock::elapsedSeconds() const
+{
+    if (!m_started) {
+        return 0;
+    }
+    return diffNs(now(), m_origin) / 1e9;
+}
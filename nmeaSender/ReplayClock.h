@@ -0,0 +1,48 @@
+/*******************************************************************************
+* @brief    Replay schedule following the log time
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*******************************************************************************/
+#pragma once
+
+#include <cstdint>
+
+#include <time.h>
+
+/*
+ * @brief Schedules epochs at the log time divided by the replay speed.
+ *
+ * The first timed epoch is sent at once, every later one at an absolute
+ * CLOCK_MONOTONIC deadline computed from the first, so neither sleeping late
+ * nor the time spent writing builds up along the replay. The time of day
+ * wraps at midnight; a small step back in log time, or an epoch without a
+ * time, is sent right after the previous epoch. Speed 0 replays as fast as
+ * the serial line takes the data.
+ */
+class ReplayClock {
+public:
+    explicit ReplayClock(double speed)
+        : m_speed(speed)
+    {
+    }
+
+    void schedule(int64_t timeOfDayMs);
+    int64_t remainingMs() const;
+    void wait();
+    const struct timespec& deadline() const { return m_deadline; }
+
+    uint64_t epochs() const { return m_epochs; }
+    int64_t logMs() const { return m_logMs; }
+    double elapsedSeconds() const;
+    int64_t maxLateUs() const { return m_maxLateNs / 1000; }
+
+private:
+    double m_speed;
+    bool m_started = false;
+    struct timespec m_origin = {}; // Deadline of the first timed epoch
+    struct timespec m_deadline = {}; // Deadline of the scheduled epoch
+    int64_t m_lastTimeMs = -1; // Time of day of the previous timed epoch
+    int64_t m_logMs = 0; // Log time since the first timed epoch
+    uint64_t m_epochs = 0;
+    int64_t m_maxLateNs = 0; // Longest wake-up after a deadline
+};
@@ -0,0 +1,158 @@
+/*******************************************************************************
+* @brief    Sentence writer for the NMEA serial line
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*******************************************************************************/
+#include "SerialWriter.h"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <sys/uio.h>
+
+extern "C" {
+#include "serial.h"
+}
+
+namespace {
+
+constexpr int64_t nsPerSecond = 1000000000;
+
+void addNs(struct timespec& time, int64_t ns)
+{
+    ns += time.tv_nsec;
+    time.tv_sec += ns / nsPerSecond;
+    time.tv_nsec = ns % nsPerSecond;
+}
+
+bool before(const struct timespec& a, const struct timespec& b)
+{
+    return a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec);
+}
+
+} // namespace
+
+// Definition for ODR-uses, e.g. binding to the const reference of std::min
+constexpr size_t SerialWriter::paceChunk;
+
+SerialWriter::SerialWriter(int fd, uint32_t paceBytesPerSecond)
+    : m_fd(fd)
+    , m_pace(paceBytesPerSecond)
+{
+}
+
+/*
+ * @brief Write a sentence and <CR><LF>
+ *
+ * @return bool false on serial error.
+ */
+bool SerialWriter::writeLine(const std::string& line)
+{
+    static const char lineEnd[] = { '\r', '\n' };
+    struct iovec iov[2] = {
+        { const_cast<char*>(line.data()), line.size() },
+        { const_cast<char*>(lineEnd), sizeof(lineEnd) },
+    };
+
+    m_lines++;
+    return send(iov, 2);
+}
+
+/*
+ * @brief Write sentences, each with <CR><LF>, in one burst
+ *
+ * @return bool false on serial error.
+ */
+bool SerialWriter::writeLines(const std::vector<std::string>& lines)
+{
+    m_burst.clear();
+    for (const auto& line : lines) {
+        m_burst += line;
+        m_burst += "\r\n";
+    }
+
+    m_lines += lines.size();
+    return write(m_burst.data(), m_burst.size());
+}
+
+/*
+ * @brief Write data as is, e.g. a burst of formatted sentences
+ *
+ * @return bool false on serial error.
+ */
+bool SerialWriter::write(const char* data, size_t len)
+{
+    struct iovec iov = { const_cast<char*>(data), len };
+
+    return send(&iov, 1);
+}
+
+bool SerialWriter::send(struct iovec* iov, int iovcnt)
+{
+    for (int i = 0; i < iovcnt; i++) {
+        m_bytes += iov[i].iov_len;
+    }
+    if (0 != m_pace) {
+        return sendPaced(iov, iovcnt);
+    }
+    return 0 <= serialWritev(m_fd, iov, iovcnt, &m_calls);
+}
+
+/*
+ * @brief Write in chunks of paceChunk bytes, each at its deadline
+ *
+ * Deadlines follow each other by the time of the bytes sent, so sleeping late
+ * does not add up; after a stall longer than a chunk the schedule restarts
+ * from now instead of catching up in a burst.
+ */
+bool SerialWriter::sendPaced(struct iovec* iov, int iovcnt)
+{
+    const int64_t chunkNs = static_cast<int64_t>(paceChunk) * nsPerSecond / m_pace;
+
+    while (iovcnt > 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        struct timespec late = m_next;
+        addNs(late, chunkNs);
+        if (before(late, now)) {
+            m_next = now;
+        } else if (before(now, m_next)) {
+            while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &m_next, nullptr)) {
+            }
+            m_calls++;
+        }
+
+        // At most paceChunk bytes, taken from the front of the buffers
+        struct iovec chunk[2];
+        int count = 0;
+        size_t left = paceChunk;
+        for (int i = 0; i < iovcnt && count < 2 && left > 0; i++) {
+            chunk[count].iov_base = iov[i].iov_base;
+            chunk[count].iov_len = std::min(iov[i].iov_len, left);
+            left -= chunk[count].iov_len;
+            count++;
+        }
+        size_t sent = paceChunk - left;
+        // A short chunk at the end of a line holds the line for its own bytes only
+        addNs(m_next, static_cast<int64_t>(sent) * nsPerSecond / m_pace);
+        if (0 > serialWritev(m_fd, chunk, count, &m_calls)) {
+            return false;
+        }
+
+        while (sent > 0) {
+            size_t step = std::min(sent, iov->iov_len);
+            iov->iov_base = static_cast<char*>(iov->iov_base) + step;
+            iov->iov_len -= step;
+            sent -= step;
+            if (0 == iov->iov_len) {
+                iov++;
+                iovcnt--;
+            }
+        }
+        while (iovcnt > 0 && 0 == iov->iov_len) {
+            iov++;
+            iovcnt--;
+        }
+    }
+    return true;
+}
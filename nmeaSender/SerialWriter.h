@@ -0,0 +1,49 @@
+/*******************************************************************************
+* @brief    Sentence writer for the NMEA serial line
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*******************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+/*
+ * @brief Writes sentences with their line ending in one writev() each, or
+ * the sentences of an epoch in one write().
+ *
+ * Some adapters, the SEGGER J-Link CDC among them, lose data fed faster than
+ * they pass it on. Paced writing sends chunks of paceChunk bytes on absolute
+ * clock_nanosleep() deadlines, so the mean byte rate stays at the configured
+ * one without a system call per byte.
+ */
+class SerialWriter {
+public:
+    static constexpr size_t paceChunk = 16;
+
+    explicit SerialWriter(int fd, uint32_t paceBytesPerSecond = 0);
+
+    bool writeLine(const std::string& line);
+    bool writeLines(const std::vector<std::string>& lines);
+    bool write(const char* data, size_t len);
+
+    uint64_t lines() const { return m_lines; }
+    uint64_t bytes() const { return m_bytes; }
+    uint64_t calls() const { return m_calls; }
+
+private:
+    bool send(struct iovec* iov, int iovcnt);
+    bool sendPaced(struct iovec* iov, int iovcnt);
+
+    int m_fd;
+    uint32_t m_pace;
+    struct timespec m_next = {}; // Deadline of the next paced chunk
+    uint64_t m_lines = 0;
+    uint64_t m_bytes = 0;
+    uint64_t m_calls = 0; // write and sleep system calls
+    std::string m_burst; // Lines of writeLines(), kept to reuse its allocation
+};
@@ -4,54 +4,641 @@
 * @date     July 22, 2019
 *******************************************************************************/
 #include <chrono>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <string>
 #include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "CommandChannel.h"
+#include "EpochReader.h"
+#include "FanOut.h"
+#include "NmeaGenerator.h"
+#include "NmeaIndex.h"
+#include "PtyLoopback.h"
+#include "ReplayClock.h"
+#include "SerialWriter.h"
+#include "beacon_payload.h"
+#include "minmea.h"
 extern "C" {
 #include "serial.h"
 }
 
-int main(int argc, char** argv)
+static constexpr uint32_t defaultBaudrate = 115200;
+
+static void usage(const char* name)
 {
-    auto serial = argv[1];
-    auto nmea = argv[2];
+    std::cerr << "Usage: " << name << " [-r BAUD] [-R] [-p RATE] [-s START] [-x SPEED] [-c CMD]... [-l] <serial> <nmea>" << std::endl
+              << "       " << name << " [-r BAUD] [-R] [-p RATE] -c CMD [-c CMD]... <serial>" << std::endl
+              << "       " << name << " [-r BAUD] [-R] [-p RATE] -f <serial> <nmea>..." << std::endl
+              << "       " << name << " [-r BAUD] [-R] [-p RATE] -t SECS <serial> <nmea>" << std::endl
+              << "       " << name << " [-r BAUD] [-R] [-p RATE] [-x SPEED] [-c CMD]... [-l] -g SPEC <serial>" << std::endl
+              << "       " << name << " [-x SPEED] -w -g SPEC <file>" << std::endl
+              << "       " << name << " -P [-x SPEED] [-c CMD]... [-l] [-t SECS] <nmea> | -g SPEC" << std::endl
+              << "       " << name << " -L [-x SPEED] [-p RATE] <nmea> | -g SPEC" << std::endl
+              << "       " << name << " [-r BAUD] [-R] [-p RATE] [-x SPEED] -m <serial>=<nmea>|gen:SPEC..." << std::endl
+              << "       " << name << " -b [-n STEP] <nmea>" << std::endl
+              << "  -r BAUD   serial baud rate (default " << defaultBaudrate << "), the beacon takes up to 1000000;" << std::endl
+              << "            rates without a Bxxx constant are set through termios2" << std::endl
+              << "  -R        RTS/CTS hardware flow control" << std::endl
+              << "  -p RATE   pace writes to RATE bytes/s in " << SerialWriter::paceChunk << " byte chunks, for adapters" << std::endl
+              << "            losing data fed faster (SEGGER J-Link CDC)" << std::endl
+              << "  -s START  start replay at UTC time YYYY-MM-DDTHH:MM:SS[.sss]" << std::endl
+              << "  -x SPEED  replay SPEED times faster than the log time (default 1), 0: as fast" << std::endl
+              << "            as the link takes it; every epoch goes out as one burst" << std::endl
+              << "  -c CMD    send a beacon command before the replay and print its answer:" << std::endl
+              << "            PING, INT,<ms> (0: speed-adaptive), TXP,<dBm>, PHY,<1|2|4>, FMT,<history>, LAT,<0|1>" << std::endl
+              << "  -l        time every epoch: round trip of a PING after it and beacon" << std::endl
+              << "            ingest-to-advertise latency of every advertised fix" << std::endl
+              << "  -f        fleet gateway: every <nmea> is an asset, ID 0, 1, ..., its fixes" << std::endl
+              << "            are sent as $PBCA sentences, one per asset and second" << std::endl
+              << "  -g SPEC   generate NMEA instead of reading <nmea>, SPEC is key=value,...:" << std::endl
+              << "            model=line|circle|walk|road, rate=1..50 (Hz), mix=RMC+GGA+GSA+GSV+VTG," << std::endl
+              << "            talker=GP, sats=GP+GL, noise=M, speed=M/S, heading=DEG, radius=M," << std::endl
+              << "            lat=DEG, lon=DEG, alt=M, start=YYYY-MM-DDTHH:MM:SS, duration=SECS (0: endless), seed=N" << std::endl
+              << "  -w        write to a file (or pipe) instead of a serial port" << std::endl
+              << "  -P        create a pty instead of opening <serial>, print its path and wait" << std::endl
+              << "            for a reader, e.g. the firmware simulation" << std::endl
+              << "  -L        pty loopback: read the pty back and report throughput and latency" << std::endl
+              << "  -m        fan-out: replay every <nmea> to its <serial>, all ports from one" << std::endl
+              << "            event loop; gen:SPEC generates instead, port i with seed+i" << std::endl
+              << "  -t SECS   throughput test: send <nmea> over and over as fast as the link" << std::endl
+              << "            takes it and compare with what the beacon received" << std::endl
+              << "  -b        build time index <nmea>.idx and exit" << std::endl
+              << "  -n STEP   seconds of log between index entries (default "
+              << NmeaIndex::defaultStep << ")" << std::endl;
+}
 
-    if (argc != 3) {
-        std::cerr << "Example: TODO" << std::endl;
+/*
+ * @brief Process CPU time, user and system, seconds
+ */
+static double cpuSeconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/*
+ * @brief Print what writing the sentences cost
+ */
+static void printWriteCost(const SerialWriter& writer, uint64_t sentences, double cpu)
+{
+    if (0 == sentences) {
+        return;
     }
+    std::cout << "Serial: " << sentences << " sentences, " << writer.bytes() << " bytes, " << writer.calls()
+              << " system calls (" << static_cast<double>(writer.calls()) / sentences << " per sentence), "
+              << cpu * 1e6 / sentences << " us CPU per sentence" << std::endl;
+}
 
-    // Serial port initialization
-    auto fd = serialOpen(serial, 115200);
-    if (fd < 0) {
-        std::cerr << "Fail to open serial port: " << argv[1] << std::endl;
+/*
+ * @brief Replay many logs, each to its own serial port, from one event loop
+ *
+ * @param pairs "<serial>=<nmea>" or "<serial>=gen:<spec>" arguments
+ * @return int 0, or -1 if a port or log failed.
+ */
+static int runFanOut(const std::vector<std::string>& pairs, uint32_t baudrate, bool rtscts, uint32_t pace, double speed)
+{
+    FanOut fanOut(speed, pace);
+
+    for (const auto& pair : pairs) {
+        auto separator = pair.find('=');
+        if (std::string::npos == separator) {
+            std::cerr << "Expected <serial>=<nmea>: " << pair << std::endl;
+            return -1;
+        }
+        auto serial = pair.substr(0, separator);
+        auto nmea = pair.substr(separator + 1);
+
+        std::unique_ptr<EpochSource> source;
+        if (0 == nmea.compare(0, 4, "gen:")) {
+            NmeaGenerator::Config config;
+            if (!config.parse(nmea.substr(4))) {
+                std::cerr << "Invalid generator: " << nmea << std::endl;
+                return -1;
+            }
+            config.seed += static_cast<uint32_t>(&pair - pairs.data());
+            source.reset(new NmeaGenerator(config));
+        } else {
+            std::unique_ptr<std::istream> input(new std::ifstream(nmea));
+            if (!*input) {
+                std::cerr << "Fail to open NMEA log: " << nmea << std::endl;
+                return -1;
+            }
+            source.reset(new EpochReader(std::move(input)));
+        }
+        auto fd = serialOpen(serial.c_str(), baudrate, rtscts);
+        if (fd < 0) {
+            std::cerr << "Fail to open serial port: " << serial << std::endl;
+            return -1;
+        }
+        if (!fanOut.add(fd, serial, std::move(source))) {
+            std::cerr << "Fail to add serial port: " << serial << std::endl;
+            return -1;
+        }
+    }
+
+    bool ok = fanOut.run();
+    std::cout << "End of files" << std::endl;
+    fanOut.printSummary();
+    return ok ? 0 : -1;
+}
+
+static int buildIndex(const std::string& nmea, uint32_t step)
+{
+    NmeaIndex index;
+    if (!index.build(nmea, step)) {
+        std::cerr << "Fail to read NMEA log: " << nmea << std::endl;
         return -1;
     }
+    if (!index.save(nmea)) {
+        std::cerr << "Fail to write index: " << NmeaIndex::sidecarPath(nmea) << std::endl;
+        return -1;
+    }
+    std::cout << "Indexed " << index.entries().size() << " epochs to "
+              << NmeaIndex::sidecarPath(nmea) << std::endl;
+    return 0;
+}
+
+/*
+ * @brief Read up to the next valid RMC fix of an asset log and format it as $PBCA sentence
+ *
+ * @return size_t sentence length, 0 at the end of the log.
+ */
+static size_t nextAssetLine(std::ifstream& input, uint8_t id, char* line, size_t size)
+{
+    for (std::string text; getline(input, text);) {
+        struct minmea_sentence_rmc frame;
+        if (MINMEA_SENTENCE_RMC != minmea_sentence_id(text.c_str(), false)
+            || !minmea_parse_rmc(&frame, text.c_str()) || !frame.valid) {
+            continue;
+        }
 
-    std::ifstream input(nmea);
+        asset_update_t update;
+        update.id = id;
+        update.latitude = beacon_coord_from_nmea(frame.latitude.value, frame.latitude.scale);
+        update.longitude = beacon_coord_from_nmea(frame.longitude.value, frame.longitude.scale);
+        update.time_ms = ASSET_VALUE_UNKNOWN;
+        if (frame.time.hours >= 0) {
+            update.time_ms = ((frame.time.hours * 60 + frame.time.minutes) * 60 + frame.time.seconds) * 1000
+                + frame.time.microseconds / 1000;
+        }
+        update.speed_mmps = ASSET_VALUE_UNKNOWN;
+        update.course = 0;
+        if (0 != frame.speed.scale) {
+            // Knots to mm/s
+            update.speed_mmps = static_cast<int32_t>(static_cast<int64_t>(minmea_rescale(&frame.speed, 1000)) * 514 / 1000);
+            update.course = minmea_rescale(&frame.course, 10) % 3600;
+        }
+        return asset_format(line, size, &update);
+    }
+    return 0;
+}
 
+/*
+ * @brief Replay one log per asset to a fleet gateway, the fixes of a second go out in one burst
+ *
+ * A line ending goes ahead of the burst, a gateway with UART power gating
+ * loses it while its UART powers up, see CommandChannel::execute().
+ */
+static int runFleet(SerialWriter& writer, const std::vector<std::string>& logs)
+{
+    if (logs.size() > ASSET_ID_MAX + 1) {
+        std::cerr << "Too many assets, at most " << ASSET_ID_MAX + 1 << std::endl;
+        return -1;
+    }
+
+    std::vector<std::ifstream> inputs(logs.size());
+    for (size_t i = 0; i < logs.size(); i++) {
+        inputs[i].open(logs[i]);
+        if (!inputs[i]) {
+            std::cerr << "Fail to open NMEA log: " << logs[i] << std::endl;
+            return -1;
+        }
+    }
+
+    for (;;) {
+        std::string burst;
+        size_t sent = 0;
+        for (size_t i = 0; i < inputs.size(); i++) {
+            char line[COMMAND_LINE_MAX];
+            auto len = nextAssetLine(inputs[i], static_cast<uint8_t>(i), line, sizeof(line));
+            if (0 != len) {
+                burst.append(line, len);
+                sent++;
+            }
+        }
+        if (0 == sent) {
+            break;
+        }
+
+        auto next = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        const char wake[] = { '\r', '\n' };
+        if (!writer.write(wake, sizeof(wake))) {
+            std::cerr << "Fail to write data" << std::endl;
+            return -1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(CommandChannel::wakeGuardMs));
+        if (!writer.write(burst.data(), burst.size())) {
+            std::cerr << "Fail to write data" << std::endl;
+            return -1;
+        }
+        std::cout << "Assets: " << sent << " positions" << std::endl;
+        std::this_thread::sleep_until(next);
+    }
+
+    std::cout << "End of files" << std::endl;
+    return 0;
+}
+
+/*
+ * @brief Send a log over and over as fast as the link takes it, then compare with what the beacon received
+ *
+ * With RTS/CTS the writes block while the beacon holds RTS, so the rate is what
+ * the beacon sustains; without, what the line carries, and a beacon falling
+ * behind drops lines. The beacon counts come from STA commands before and
+ * after; without an answer only the host side is reported.
+ *
+ * @return int 0, or -1 if the beacon lost sentences or saw UART errors.
+ */
+static int runThroughput(int fd, SerialWriter& writer, CommandChannel& channel, std::ifstream& input, int seconds,
+    uint32_t baudrate)
+{
+    std::vector<std::string> sentences;
     for (std::string line; getline(input, line);) {
-        std::cout << "String: " << line.c_str() << std::endl;
+        if (!line.empty() && '\r' == line.back()) {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            sentences.push_back(line);
+        }
+    }
+    if (sentences.empty()) {
+        std::cerr << "No sentences in NMEA log" << std::endl;
+        return -1;
+    }
 
-        // Write NMEA message
-        auto retval = serialWrite(fd, line.c_str(), line.length());
-        if (0 > retval) {
+    command_stats_t before;
+    bool beacon = channel.linkStats(before);
+    if (!beacon) {
+        std::cout << "No answer to STA, the beacon side is not checked" << std::endl;
+    }
+
+    uint64_t sent = 0;
+    uint64_t bytes = writer.bytes();
+    double cpu = cpuSeconds();
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < end) {
+        if (!writer.writeLine(sentences[sent % sentences.size()])) {
             std::cerr << "Fail to write data" << std::endl;
             return -1;
         }
+        sent++;
+    }
+    cpu = cpuSeconds() - cpu;
+    serialDrain(fd);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bytes = writer.bytes() - bytes;
+
+    // 8N1: ten bits per byte.
+    std::cout << "Sent " << sent << " sentences, " << bytes << " bytes in " << elapsed << " s: "
+              << static_cast<uint64_t>(sent / elapsed) << " sentences/s, " << static_cast<uint64_t>(bytes / elapsed)
+              << " bytes/s, " << static_cast<int>(bytes * 10 * 100 / elapsed / baudrate) << "% of the line" << std::endl;
+    printWriteCost(writer, sent, cpu);
+
+    command_stats_t after;
+    if (!beacon) {
+        return 0;
+    }
+    if (!channel.linkStats(after)) {
+        std::cerr << "No answer to STA after the test" << std::endl;
+        return -1;
+    }
+    // The second STA counts itself.
+    uint32_t received = after.lines - before.lines - 1;
+    uint32_t dropped = after.dropped - before.dropped;
+    uint32_t errors = after.errors - before.errors;
+    std::cout << "Beacon: " << received << " sentences received, " << dropped << " lines dropped, "
+              << errors << " UART errors" << std::endl;
+    return (received == sent && 0 == dropped && 0 == errors) ? 0 : -1;
+}
+
+static bool runCommand(CommandChannel& channel, const std::string& text, bool verbose)
+{
+    command_t command;
+    if (!command_from_text(text.c_str(), &command)) {
+        std::cerr << "Invalid command: " << text << std::endl;
+        return false;
+    }
+
+    CommandChannel::Answer answer;
+    if (!channel.execute(command, answer)) {
+        std::cerr << "No answer to command: " << text << std::endl;
+        return false;
+    }
+    if (verbose || COMMAND_STATUS_OK != answer.status) {
+        std::cout << text << ": " << command_status_name(answer.status) << ", round trip "
+                  << static_cast<int64_t>(answer.roundTripUs) << " us, beacon " << answer.beaconUs << " us" << std::endl;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    bool indexOnly = false;
+    bool fleet = false;
+    bool fanOut = false;
+    const char* generator = nullptr;
+    bool toFile = false;
+    bool createPty = false;
+    bool loopback = false;
+    bool latency = false;
+    std::vector<std::string> commands;
+    uint32_t step = NmeaIndex::defaultStep;
+    const char* start = nullptr;
+    uint32_t baudrate = defaultBaudrate;
+    uint32_t pace = 0;
+    bool rtscts = false;
+    int throughputSeconds = 0;
+    double speed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "bc:fg:lLmn:p:Pr:Rs:t:wx:")) != -1) {
+        switch (opt) {
+        case 'b':
+            indexOnly = true;
+            break;
+        case 'c':
+            commands.push_back(optarg);
+            break;
+        case 'f':
+            fleet = true;
+            break;
+        case 'g':
+            generator = optarg;
+            break;
+        case 'l':
+            latency = true;
+            break;
+        case 'L':
+            loopback = true;
+            break;
+        case 'm':
+            fanOut = true;
+            break;
+        case 'n':
+            step = static_cast<uint32_t>(strtoul(optarg, nullptr, 10));
+            break;
+        case 'p':
+            pace = static_cast<uint32_t>(strtoul(optarg, nullptr, 10));
+            break;
+        case 'P':
+            createPty = true;
+            break;
+        case 'r':
+            baudrate = static_cast<uint32_t>(strtoul(optarg, nullptr, 10));
+            break;
+        case 'R':
+            rtscts = true;
+            break;
+        case 's':
+            start = optarg;
+            break;
+        case 't':
+            throughputSeconds = atoi(optarg);
+            if (throughputSeconds <= 0) {
+                usage(argv[0]);
+                return -1;
+            }
+            break;
+        case 'w':
+            toFile = true;
+            break;
+        case 'x':
+            speed = atof(optarg);
+            if (speed < 0) {
+                usage(argv[0]);
+                return -1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
 
-        // Write NMEA EOL sequence
-        char lineEnd[] = { '\r', '\n' };
-        retval = serialWrite(fd, lineEnd, sizeof(lineEnd));
-        if (0 > retval) {
+    if (indexOnly) {
+        if (argc - optind != 1) {
+            usage(argv[0]);
+            return -1;
+        }
+        return buildIndex(argv[optind], step);
+    }
+
+    if (fleet) {
+        if (argc - optind < 2) {
+            usage(argv[0]);
+            return -1;
+        }
+        auto fd = serialOpen(argv[optind], baudrate, rtscts);
+        if (fd < 0) {
+            std::cerr << "Fail to open serial port: " << argv[optind] << std::endl;
+            return -1;
+        }
+        SerialWriter writer(fd, pace);
+        auto retval = runFleet(writer, std::vector<std::string>(argv + optind + 1, argv + argc));
+        serialClose(fd);
+        return retval;
+    }
+
+    if (fanOut) {
+        if (argc - optind < 1) {
+            usage(argv[0]);
+            return -1;
+        }
+        return runFanOut(std::vector<std::string>(argv + optind, argv + argc), baudrate, rtscts, pace, speed);
+    }
+
+    NmeaGenerator::Config generatorConfig;
+    if (nullptr != generator && !generatorConfig.parse(generator)) {
+        std::cerr << "Invalid generator: " << generator << std::endl;
+        return -1;
+    }
+
+    bool pty = createPty || loopback;
+    int serialArgs = pty ? 0 : 1;
+    bool commandsOnly = (argc - optind == serialArgs && !commands.empty() && nullptr == generator);
+    if (argc - optind != serialArgs + (nullptr != generator ? 0 : 1) && !commandsOnly) {
+        usage(argv[0]);
+        return -1;
+    }
+    if ((toFile || loopback) && (!commands.empty() || latency || 0 != throughputSeconds)) {
+        usage(argv[0]);
+        return -1;
+    }
+    if (toFile && pty) {
+        usage(argv[0]);
+        return -1;
+    }
+    auto serial = pty ? "" : argv[optind];
+    auto nmea = (commandsOnly || nullptr != generator) ? "" : argv[optind + serialArgs];
+
+    std::ifstream input;
+    if (!commandsOnly && nullptr == generator) {
+        input.open(nmea);
+        if (!input) {
+            std::cerr << "Fail to open NMEA log: " << nmea << std::endl;
+            return -1;
+        }
+    }
+
+    if (nullptr != start && !commandsOnly && nullptr == generator) {
+        int64_t startMs;
+        if (!NmeaIndex::parseTime(start, startMs)) {
+            std::cerr << "Invalid start time: " << start << std::endl;
+            return -1;
+        }
+
+        NmeaIndex index;
+        if (!index.open(nmea, step)) {
+            std::cerr << "Fail to index NMEA log: " << nmea << std::endl;
+            return -1;
+        }
+        if (!index.seek(input, startMs)) {
+            std::cerr << "Start time is beyond the end of log: " << start << std::endl;
+            return -1;
+        }
+    }
+
+    // Serial port initialization
+    char ptyPath[64];
+    int fd;
+    if (pty) {
+        fd = serialOpenPty(ptyPath, sizeof(ptyPath));
+        if (fd < 0) {
+            std::cerr << "Fail to create pty" << std::endl;
+            return -1;
+        }
+    } else {
+        fd = toFile ? serialOpenFile(serial) : serialOpen(serial, baudrate, rtscts);
+        if (fd < 0) {
+            std::cerr << "Fail to open " << (toFile ? "file: " : "serial port: ") << serial << std::endl;
+            return -1;
+        }
+    }
+
+    PtyLoopback loopbackReader;
+    if (loopback && !loopbackReader.start(ptyPath)) {
+        std::cerr << "Fail to open pty: " << ptyPath << std::endl;
+        serialClose(fd);
+        return -1;
+    }
+    if (createPty && !loopback) {
+        std::cout << "PTY: " << ptyPath << ", waiting for a reader" << std::endl;
+        serialWaitPeer(fd, -1);
+    }
+
+    CommandChannel channel(fd);
+    SerialWriter writer(fd, pace);
+    for (const auto& command : commands) {
+        if (!runCommand(channel, command, true)) {
+            serialClose(fd);
+            return -1;
+        }
+    }
+    if (commandsOnly) {
+        serialClose(fd);
+        return 0;
+    }
+    if (0 != throughputSeconds && nullptr == generator) {
+        auto retval = runThroughput(fd, writer, channel, input, throughputSeconds, baudrate);
+        serialClose(fd);
+        return retval;
+    }
+    if (latency && !runCommand(channel, "LAT,1", false)) {
+        serialClose(fd);
+        return -1;
+    }
+
+    double cpu = 0;
+    std::unique_ptr<EpochSource> source;
+    if (nullptr != generator) {
+        source.reset(new NmeaGenerator(generatorConfig));
+    } else {
+        source.reset(new EpochReader(input));
+    }
+    ReplayClock clock(speed);
+    for (EpochSource::Epoch epoch; source->next(epoch);) {
+        clock.schedule(epoch.timeOfDayMs);
+        if (latency) {
+            channel.drain(static_cast<int>(clock.remainingMs()));
+        }
+        clock.wait();
+
+        if (loopback) {
+            uint64_t endBytes = writer.bytes();
+            for (const auto& line : epoch.lines) {
+                endBytes += line.size() + 2;
+            }
+            loopbackReader.sending(endBytes);
+        }
+
+        // Write the NMEA messages of the epoch with their EOL sequences
+        double burstStart = cpuSeconds();
+        if (!writer.writeLines(epoch.lines)) {
             std::cerr << "Fail to write data" << std::endl;
             return -1;
         }
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        cpu += cpuSeconds() - burstStart;
+
+        for (size_t i = 0; nullptr == generator && i < epoch.lines.size(); i++) {
+            std::cout << "String: " << epoch.lines[i] << std::endl;
+        }
+        // The PING queues behind the epoch, its answer times the epoch through the beacon.
+        if (latency) {
+            runCommand(channel, "PING", false);
+        }
+    }
+    double replaySeconds = clock.elapsedSeconds();
+    if (latency) {
+        channel.drain(CommandChannel::defaultTimeoutMs);
     }
 
     std::cout << "End of file" << std::endl;
+    std::cout << "Replay: " << clock.epochs() << " epochs, " << clock.logMs() / 1000.0 << " s of log in "
+              << replaySeconds << " s";
+    if (0 < replaySeconds) {
+        std::cout << ", " << static_cast<uint64_t>(writer.lines() / replaySeconds) << " sentences/s";
+    }
+    if (0 != speed) {
+        std::cout << ", latest " << clock.maxLateUs() << " us after its deadline";
+    }
+    std::cout << std::endl;
+    printWriteCost(writer, writer.lines(), cpu);
+
+    int retval = 0;
+    if (loopback) {
+        if (!loopbackReader.finish(CommandChannel::defaultTimeoutMs)) {
+            retval = -1;
+        }
+        loopbackReader.printSummary();
+    }
+
+    if (latency) {
+        runCommand(channel, "LAT,0", false);
+        std::cout << "Round trip, us: " << channel.roundTrip().summary() << std::endl
+                  << "Beacon command handling, us: " << channel.beaconTime().summary() << std::endl
+                  << "Beacon ingest to advertise, us: " << channel.ingestToAdvertise().summary() << std::endl;
+    }
 
     serialClose(fd);
 
-    return 0;
+    return retval;
 }
@@ -1,11 +1,35 @@
 TEMPLATE = app
-CONFIG += console c++11
+CONFIG += console c++11 thread
 CONFIG -= app_bundle
 CONFIG -= qt
 
+INCLUDEPATH += \
+    ../firmware/src \
+    ../firmware/src/minmea
+
 SOURCES += \
     main.cpp \
-    serial.c
+    CommandChannel.cpp \
+    EpochReader.cpp \
+    FanOut.cpp \
+    NmeaGenerator.cpp \
+    NmeaIndex.cpp \
+    PtyLoopback.cpp \
+    ReplayClock.cpp \
+    SerialWriter.cpp \
+    serial.c \
+    serial_termios2.c \
+    ../firmware/src/beacon_payload.c \
+    ../firmware/src/command_format.c \
+    ../firmware/src/minmea/minmea.c
 
 HEADERS += \
+    CommandChannel.h \
+    EpochReader.h \
+    FanOut.h \
+    NmeaGenerator.h \
+    NmeaIndex.h \
+    PtyLoopback.h \
+    ReplayClock.h \
+    SerialWriter.h \
     serial.h
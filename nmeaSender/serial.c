@@ -3,14 +3,19 @@
 * @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
 * @date     July 22, 2019
 *******************************************************************************/
+// posix_openpt(), ptsname_r()
+#define _GNU_SOURCE
+
 #include "serial.h"
 
 #include <fcntl.h>
+#include <poll.h>
 #include <termios.h>
 #include <unistd.h>
 
 #include <errno.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
 static speed_t serialBaudrateToBits(uint32_t baudrate)
@@ -72,16 +77,19 @@ static speed_t serialBaudrateToBits(uint32_t baudrate)
 }
 
 /*
- * @brief
+ * @brief Open a serial port, raw 8N1
+ *
+ * Rates without a Bxxx constant are set with termios2, see serialSetBaudrateOther().
  *
  * @param path
  * @param baudrate
+ * @param rtscts RTS/CTS hardware flow control
  * @return int Return the file descriptor ,or -1.
  */
-int serialOpen(const char* path, uint32_t baudrate)
+int serialOpen(const char* path, uint32_t baudrate, bool rtscts)
 {
     bool xonxoff = false;
-    bool rtscts = false;
+    speed_t speed = serialBaudrateToBits(baudrate);
 
     struct termios termios_settings;
 
@@ -118,21 +126,102 @@ int serialOpen(const char* path, uint32_t baudrate)
         termios_settings.c_cflag |= CRTSCTS;
     }
 
-    // Baudrate
-    cfsetispeed(&termios_settings, serialBaudrateToBits(baudrate));
-    cfsetospeed(&termios_settings, serialBaudrateToBits(baudrate));
+    // Baudrate, a placeholder for the other rates
+    cfsetispeed(&termios_settings, (B0 != speed) ? speed : B38400);
+    cfsetospeed(&termios_settings, (B0 != speed) ? speed : B38400);
 
     // Set termios attributes
     if (tcsetattr(fd, TCSANOW, &termios_settings) < 0) {
         close(fd);
         return -1;
     }
+    if (B0 == speed && serialSetBaudrateOther(fd, baudrate) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/*
+ * @brief Create a pseudo-terminal pair, raw, standing in for a serial port
+ *
+ * The slave is opened and closed once, from then on the master reports
+ * POLLHUP until a reader opens it, see serialWaitPeer().
+ *
+ * @param slavePath Buffer for the path a reader opens
+ * @param size Buffer size
+ * @return int Return the file descriptor of the master ,or -1.
+ */
+int serialOpenPty(char* slavePath, size_t size)
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        return -1;
+    }
+    if (grantpt(fd) < 0 || unlockpt(fd) < 0 || 0 != ptsname_r(fd, slavePath, size)) {
+        close(fd);
+        return -1;
+    }
+
+    // Terminal settings set through the master are those of the slave
+    struct termios termios_settings;
+    if (tcgetattr(fd, &termios_settings) < 0) {
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&termios_settings);
+    if (tcsetattr(fd, TCSANOW, &termios_settings) < 0) {
+        close(fd);
+        return -1;
+    }
 
+    int slave = open(slavePath, O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        close(fd);
+        return -1;
+    }
+    close(slave);
     return fd;
 }
 
 /*
- * @brief
+ * @brief Wait until a reader has opened the slave of serialOpenPty()
+ *
+ * @param fd File descriptor of the master
+ * @param timeoutMs Time to wait, -1 for ever
+ * @return int 0, or -1 on timeout.
+ */
+int serialWaitPeer(int fd, int timeoutMs)
+{
+    const int stepMs = 10;
+
+    for (int waited = 0; timeoutMs < 0 || waited < timeoutMs; waited += stepMs) {
+        struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+        if (poll(&pfd, 1, 0) < 0 && EINTR != errno) {
+            return -1;
+        }
+        if (0 == (pfd.revents & POLLHUP)) {
+            return 0;
+        }
+        usleep(stepMs * 1000);
+    }
+    return -1;
+}
+
+/*
+ * @brief Open a file or pipe to write the serial data to, truncated
+ *
+ * @param path
+ * @return int Return the file descriptor ,or -1.
+ */
+int serialOpenFile(const char* path)
+{
+    return open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+}
+
+/*
+ * @brief Write all data, in one write() unless the driver takes less
  *
  * @param fd File descriptor to serial port
  * @param ptr Pointer to data
@@ -141,17 +230,104 @@ int serialOpen(const char* path, uint32_t baudrate)
  */
 ssize_t serialWrite(int fd, const void* ptr, size_t n)
 {
-    ssize_t retval = 0;
-    const uint8_t* buf = (const uint8_t*)ptr;
+    struct iovec iov = { .iov_base = (void*)ptr, .iov_len = n };
+
+    return serialWritev(fd, &iov, 1, NULL);
+}
+
+/*
+ * @brief Write all buffers, in one writev() unless the driver takes less
+ *
+ * A short write continues with the rest, iov is updated on the way.
+ *
+ * @param fd File descriptor to serial port
+ * @param iov Buffers
+ * @param iovcnt Number of buffers
+ * @param calls Incremented per writev() call, may be NULL
+ * @return ssize_t Return the number written, or -1.
+ */
+ssize_t serialWritev(int fd, struct iovec* iov, int iovcnt, uint64_t* calls)
+{
+    ssize_t total = 0;
 
-    // FIXME: Made for keeping SEGGER JLINK alive
-    for (size_t i = 0; i < n; i++) {
-        retval = write(fd, &buf[i], 1);
+    while (iovcnt > 0) {
+        if (0 == iov->iov_len) {
+            iov++;
+            iovcnt--;
+            continue;
+        }
+        ssize_t retval = writev(fd, iov, iovcnt);
+        if (NULL != calls) {
+            (*calls)++;
+        }
         if (0 > retval) {
-            break;
+            if (EINTR == errno) {
+                continue;
+            }
+            return -1;
         }
+        total += retval;
+        for (size_t done = (size_t)retval; done > 0 && iovcnt > 0;) {
+            size_t step = (done < iov->iov_len) ? done : iov->iov_len;
+            iov->iov_base = (uint8_t*)iov->iov_base + step;
+            iov->iov_len -= step;
+            done -= step;
+            if (0 == iov->iov_len) {
+                iov++;
+                iovcnt--;
+            }
+        }
+    }
+    return total;
+}
+
+/*
+ * @brief Read what has arrived, waiting for data at most timeoutMs
+ *
+ * @param fd File descriptor to serial port
+ * @param ptr Pointer to buffer
+ * @param n Buffer length
+ * @param timeoutMs Time to wait for data, ms
+ * @return ssize_t Return the number read, 0 on timeout, or -1.
+ */
+ssize_t serialRead(int fd, void* ptr, size_t n, int timeoutMs)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+    int ready = poll(&pfd, 1, timeoutMs);
+    if (ready < 0) {
+        return (EINTR == errno) ? 0 : -1;
+    }
+    if (0 == ready) {
+        return 0;
+    }
+    return read(fd, ptr, n);
+}
+
+/*
+ * @brief Wait until everything written has been sent.
+ *
+ * @param fd File descriptor to serial port
+ * @return int 0, or -1.
+ */
+int serialDrain(int fd)
+{
+    return tcdrain(fd);
+}
+
+/*
+ * @brief Make writes and reads return at once with EAGAIN instead of blocking.
+ *
+ * @param fd File descriptor to serial port
+ * @return int 0, or -1.
+ */
+int serialSetNonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0) {
+        return -1;
     }
-    return retval;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
 }
 
 /*
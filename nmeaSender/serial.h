@@ -5,9 +5,19 @@
 *******************************************************************************/
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
-int serialOpen(const char* path, uint32_t baudrate);
+int serialOpen(const char* path, uint32_t baudrate, bool rtscts);
+int serialOpenFile(const char* path);
+int serialOpenPty(char* slavePath, size_t size);
+int serialWaitPeer(int fd, int timeoutMs);
+int serialSetBaudrateOther(int fd, uint32_t baudrate);
+int serialDrain(int fd);
+int serialSetNonblocking(int fd);
 ssize_t serialWrite(int fd, const void* ptr, size_t n);
+ssize_t serialWritev(int fd, struct iovec* iov, int iovcnt, uint64_t* calls);
+ssize_t serialRead(int fd, void* ptr, size_t n, int timeoutMs);
 int serialClose(int fd);
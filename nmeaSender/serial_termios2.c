@@ -0,0 +1,33 @@
+/*******************************************************************************
+* @brief    App for sending NMEA messages to serial port
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 22, 2019
+*
+* Arbitrary baud rates through the Linux termios2 interface. Its header clashes
+* with the glibc <termios.h> of serial.c, hence the own translation unit.
+*******************************************************************************/
+#include "serial.h"
+
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+/*
+ * @brief Set a baud rate that has no Bxxx constant, the other settings are kept
+ *
+ * @param fd File descriptor to serial port
+ * @param baudrate
+ * @return int 0, or -1 if the driver rejects the rate.
+ */
+int serialSetBaudrateOther(int fd, uint32_t baudrate)
+{
+    struct termios2 settings;
+
+    if (ioctl(fd, TCGETS2, &settings) < 0) {
+        return -1;
+    }
+    settings.c_cflag &= ~(tcflag_t)CBAUD;
+    settings.c_cflag |= BOTHER;
+    settings.c_ispeed = baudrate;
+    settings.c_ospeed = baudrate;
+    return ioctl(fd, TCSETS2, &settings);
+}
@@ -0,0 +1,325 @@
+/*******************************************************************************
+* @brief    Minimal ATT client over a BlueZ L2CAP LE socket
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#include "AttClient.h"
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/l2cap.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * @brief ATT protocol, Bluetooth Core Specification Vol 3 Part F
+ *
+ */
+enum : uint8_t {
+    ATT_OP_ERROR_RSP = 0x01,
+    ATT_OP_MTU_REQ = 0x02,
+    ATT_OP_MTU_RSP = 0x03,
+    ATT_OP_FIND_INFO_REQ = 0x04,
+    ATT_OP_FIND_INFO_RSP = 0x05,
+    ATT_OP_FIND_BY_TYPE_REQ = 0x06,
+    ATT_OP_FIND_BY_TYPE_RSP = 0x07,
+    ATT_OP_READ_BY_TYPE_REQ = 0x08,
+    ATT_OP_READ_BY_TYPE_RSP = 0x09,
+    ATT_OP_WRITE_REQ = 0x12,
+    ATT_OP_WRITE_RSP = 0x13,
+    ATT_OP_HANDLE_NOTIFY = 0x1B,
+    ATT_OP_HANDLE_IND = 0x1D,
+    ATT_OP_HANDLE_CNF = 0x1E,
+};
+
+enum : uint8_t {
+    ATT_ECODE_ATTR_NOT_FOUND = 0x0A,
+};
+
+enum : uint16_t {
+    ATT_CID = 0x0004,
+    GATT_PRIM_SVC_UUID = 0x2800,
+    GATT_CHARAC_UUID = 0x2803,
+    GATT_CLIENT_CHARAC_CFG_UUID = 0x2902,
+};
+
+static constexpr int requestTimeoutMs = 5000;
+static constexpr size_t pduMax = 1024;
+
+static void putUint16(std::vector<uint8_t>& pdu, uint16_t value)
+{
+    pdu.push_back(static_cast<uint8_t>(value));
+    pdu.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+static uint16_t getUint16(const uint8_t* data)
+{
+    return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+AttClient::~AttClient()
+{
+    close();
+}
+
+bool AttClient::connect(const std::string& address, bool randomAddress)
+{
+    close();
+
+    m_sock = socket(AF_BLUETOOTH, SOCK_SEQPACKET, BTPROTO_L2CAP);
+    if (m_sock < 0) {
+        m_error = std::string("socket: ") + strerror(errno);
+        return false;
+    }
+
+    sockaddr_l2 local;
+    memset(&local, 0, sizeof(local));
+    local.l2_family = AF_BLUETOOTH;
+    local.l2_cid = htobs(ATT_CID);
+    local.l2_bdaddr_type = BDADDR_LE_PUBLIC;
+    bacpy(&local.l2_bdaddr, BDADDR_ANY);
+    if (bind(m_sock, reinterpret_cast<sockaddr*>(&local), sizeof(local)) < 0) {
+        m_error = std::string("bind: ") + strerror(errno);
+        close();
+        return false;
+    }
+
+    bt_security security;
+    memset(&security, 0, sizeof(security));
+    security.level = BT_SECURITY_LOW;
+    setsockopt(m_sock, SOL_BLUETOOTH, BT_SECURITY, &security, sizeof(security));
+
+    sockaddr_l2 remote;
+    memset(&remote, 0, sizeof(remote));
+    remote.l2_family = AF_BLUETOOTH;
+    remote.l2_cid = htobs(ATT_CID);
+    remote.l2_bdaddr_type = randomAddress ? BDADDR_LE_RANDOM : BDADDR_LE_PUBLIC;
+    if (str2ba(address.c_str(), &remote.l2_bdaddr) < 0) {
+        m_error = "invalid address " + address;
+        close();
+        return false;
+    }
+    if (::connect(m_sock, reinterpret_cast<sockaddr*>(&remote), sizeof(remote)) < 0) {
+        m_error = std::string("connect: ") + strerror(errno);
+        close();
+        return false;
+    }
+
+    m_mtu = 23;
+    return true;
+}
+
+void AttClient::close()
+{
+    if (m_sock >= 0) {
+        ::close(m_sock);
+        m_sock = -1;
+    }
+}
+
+bool AttClient::send(const std::vector<uint8_t>& pdu)
+{
+    if (::send(m_sock, pdu.data(), pdu.size(), 0) != static_cast<ssize_t>(pdu.size())) {
+        m_error = std::string("send: ") + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool AttClient::receive(std::vector<uint8_t>& pdu, int timeoutMs)
+{
+    pollfd pfd = { m_sock, POLLIN, 0 };
+
+    int ret = ::poll(&pfd, 1, timeoutMs);
+    if (0 == ret) {
+        m_error = "timeout";
+        return false;
+    }
+    if (ret < 0) {
+        m_error = std::string("poll: ") + strerror(errno);
+        return false;
+    }
+
+    pdu.resize(pduMax);
+    ssize_t len = recv(m_sock, pdu.data(), pdu.size(), 0);
+    if (len <= 0) {
+        m_error = (0 == len) ? "disconnected" : std::string("recv: ") + strerror(errno);
+        return false;
+    }
+    pdu.resize(static_cast<size_t>(len));
+
+    // Server initiated PDUs are handled here, whatever the caller waits for.
+    if (pdu[0] == ATT_OP_HANDLE_NOTIFY || pdu[0] == ATT_OP_HANDLE_IND) {
+        if (pdu.size() >= 3 && m_notificationHandler) {
+            m_notificationHandler(getUint16(&pdu[1]), pdu.data() + 3, pdu.size() - 3);
+        }
+        if (pdu[0] == ATT_OP_HANDLE_IND) {
+            send({ ATT_OP_HANDLE_CNF });
+        }
+        pdu.clear();
+    }
+    return true;
+}
+
+bool AttClient::poll(int timeoutMs)
+{
+    std::vector<uint8_t> pdu;
+    return receive(pdu, timeoutMs);
+}
+
+bool AttClient::request(const std::vector<uint8_t>& pdu, uint8_t responseOpcode, std::vector<uint8_t>& response)
+{
+    if (!send(pdu)) {
+        return false;
+    }
+
+    for (;;) {
+        if (!receive(response, requestTimeoutMs)) {
+            return false;
+        }
+        if (response.empty()) {
+            continue; // Notification
+        }
+        if (response[0] == responseOpcode) {
+            return true;
+        }
+        if (response[0] == ATT_OP_ERROR_RSP && response.size() >= 5 && response[1] == pdu[0]) {
+            m_error = "ATT error " + std::to_string(response[4]);
+            return false;
+        }
+    }
+}
+
+uint16_t AttClient::exchangeMtu(uint16_t clientMtu)
+{
+    std::vector<uint8_t> pdu = { ATT_OP_MTU_REQ };
+    std::vector<uint8_t> response;
+
+    putUint16(pdu, clientMtu);
+    if (!request(pdu, ATT_OP_MTU_RSP, response) || response.size() < 3) {
+        return 0;
+    }
+    m_mtu = std::max<uint16_t>(23, std::min(clientMtu, getUint16(&response[1])));
+    return m_mtu;
+}
+
+bool AttClient::findService(const std::vector<uint8_t>& uuid, uint16_t& start, uint16_t& end)
+{
+    std::vector<uint8_t> pdu = { ATT_OP_FIND_BY_TYPE_REQ };
+    std::vector<uint8_t> response;
+
+    putUint16(pdu, 0x0001);
+    putUint16(pdu, 0xFFFF);
+    putUint16(pdu, GATT_PRIM_SVC_UUID);
+    pdu.insert(pdu.end(), uuid.begin(), uuid.end());
+
+    if (!request(pdu, ATT_OP_FIND_BY_TYPE_RSP, response) || response.size() < 5) {
+        return false;
+    }
+    start = getUint16(&response[1]);
+    end = getUint16(&response[3]);
+    return true;
+}
+
+bool AttClient::findCccd(uint16_t start, uint16_t end, uint16_t& cccdHandle)
+{
+    while (start <= end) {
+        std::vector<uint8_t> pdu = { ATT_OP_FIND_INFO_REQ };
+        std::vector<uint8_t> response;
+
+        putUint16(pdu, start);
+        putUint16(pdu, end);
+        if (!request(pdu, ATT_OP_FIND_INFO_RSP, response) || response.size() < 2) {
+            return false;
+        }
+
+        size_t entryLen = (1 == response[1]) ? 4 : 18;
+        uint16_t handle = start;
+        for (size_t offset = 2; offset + entryLen <= response.size(); offset += entryLen) {
+            handle = getUint16(&response[offset]);
+            if (4 == entryLen && GATT_CLIENT_CHARAC_CFG_UUID == getUint16(&response[offset + 2])) {
+                cccdHandle = handle;
+                return true;
+            }
+        }
+        if (handle == 0xFFFF) {
+            break;
+        }
+        start = handle + 1;
+    }
+    return false;
+}
+
+bool AttClient::discoverCharacteristics(uint16_t start, uint16_t end, std::vector<Characteristic>& characteristics)
+{
+    std::vector<uint16_t> declarations;
+
+    characteristics.clear();
+    for (uint16_t next = start; next <= end;) {
+        std::vector<uint8_t> pdu = { ATT_OP_READ_BY_TYPE_REQ };
+        std::vector<uint8_t> response;
+
+        putUint16(pdu, next);
+        putUint16(pdu, end);
+        putUint16(pdu, GATT_CHARAC_UUID);
+        if (!request(pdu, ATT_OP_READ_BY_TYPE_RSP, response)) {
+            if (m_error == "ATT error " + std::to_string(ATT_ECODE_ATTR_NOT_FOUND)) {
+                break;
+            }
+            return false;
+        }
+
+        size_t entryLen = (response.size() > 1) ? response[1] : 0;
+        if (entryLen < 7) {
+            break;
+        }
+        uint16_t handle = next;
+        for (size_t offset = 2; offset + entryLen <= response.size(); offset += entryLen) {
+            const uint8_t* entry = &response[offset];
+            Characteristic characteristic;
+            handle = getUint16(entry);
+            characteristic.properties = entry[2];
+            characteristic.valueHandle = getUint16(&entry[3]);
+            characteristic.uuid.assign(entry + 5, entry + entryLen);
+            characteristics.push_back(characteristic);
+            declarations.push_back(handle);
+        }
+        if (handle == 0xFFFF) {
+            break;
+        }
+        next = handle + 1;
+    }
+
+    // Descriptors of a characteristic lie between its value and the next declaration.
+    for (size_t i = 0; i < characteristics.size(); i++) {
+        uint16_t descEnd = (i + 1 < characteristics.size()) ? declarations[i + 1] - 1 : end;
+        Characteristic& characteristic = characteristics[i];
+        if (characteristic.valueHandle < descEnd) {
+            findCccd(characteristic.valueHandle + 1, descEnd, characteristic.cccdHandle);
+        }
+    }
+    return true;
+}
+
+bool AttClient::write(uint16_t handle, const std::vector<uint8_t>& value)
+{
+    std::vector<uint8_t> pdu = { ATT_OP_WRITE_REQ };
+    std::vector<uint8_t> response;
+
+    putUint16(pdu, handle);
+    pdu.insert(pdu.end(), value.begin(), value.end());
+    return request(pdu, ATT_OP_WRITE_RSP, response);
+}
+
+bool AttClient::enableNotifications(const Characteristic& characteristic)
+{
+    if (0 == characteristic.cccdHandle) {
+        m_error = "no CCCD";
+        return false;
+    }
+    return write(characteristic.cccdHandle, { 0x01, 0x00 });
+}
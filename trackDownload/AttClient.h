@@ -0,0 +1,68 @@
+/*******************************************************************************
+* @brief    Minimal ATT client over a BlueZ L2CAP LE socket
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class AttClient {
+public:
+    /**
+     * @brief Characteristic found by discoverCharacteristics()
+     *
+     */
+    struct Characteristic {
+        uint16_t valueHandle = 0;
+        uint16_t cccdHandle = 0; // 0 if the characteristic has no CCCD
+        uint8_t properties = 0;
+        std::vector<uint8_t> uuid; // 2 or 16 bytes, little endian
+    };
+
+    using NotificationHandler = std::function<void(uint16_t handle, const uint8_t* data, size_t len)>;
+
+    AttClient() = default;
+    ~AttClient();
+    AttClient(const AttClient&) = delete;
+    AttClient& operator=(const AttClient&) = delete;
+
+    bool connect(const std::string& address, bool randomAddress);
+    void close();
+
+    /**
+     * @brief Exchange ATT MTU, returns the MTU in use or 0 on error
+     *
+     */
+    uint16_t exchangeMtu(uint16_t clientMtu);
+    uint16_t mtu() const { return m_mtu; }
+
+    bool findService(const std::vector<uint8_t>& uuid, uint16_t& start, uint16_t& end);
+    bool discoverCharacteristics(uint16_t start, uint16_t end, std::vector<Characteristic>& characteristics);
+    bool write(uint16_t handle, const std::vector<uint8_t>& value);
+    bool enableNotifications(const Characteristic& characteristic);
+
+    /**
+     * @brief Wait for one PDU and dispatch notifications, false on timeout or disconnect
+     *
+     */
+    bool poll(int timeoutMs);
+
+    void setNotificationHandler(NotificationHandler handler) { m_notificationHandler = handler; }
+    const std::string& error() const { return m_error; }
+
+private:
+    bool send(const std::vector<uint8_t>& pdu);
+    bool receive(std::vector<uint8_t>& pdu, int timeoutMs);
+    bool request(const std::vector<uint8_t>& pdu, uint8_t responseOpcode, std::vector<uint8_t>& response);
+    bool findCccd(uint16_t start, uint16_t end, uint16_t& cccdHandle);
+
+    int m_sock = -1;
+    uint16_t m_mtu = 23; // ATT default
+    std::string m_error;
+    NotificationHandler m_notificationHandler;
+};
@@ -0,0 +1,238 @@
+/*******************************************************************************
+* @brief    App for downloading the beacon track log over BLE
+* @author   Taras Zaporozhets <zaporozhets.taras@gmail.com>
+* @date     July 23, 2019
+*******************************************************************************/
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <unistd.h>
+
+#include "AttClient.h"
+#include "beacon_payload.h"
+#include "track_format.h"
+
+static constexpr uint16_t defaultMtu = 247;
+static constexpr int packetTimeoutMs = 10000;
+
+static void usage(const char* name)
+{
+    std::cerr << "Usage: " << name << " [-p] [-m MTU] [-f FIRST] [-o CSV] <address>" << std::endl
+              << "       " << name << " [-p] [-m MTU] -b BYTES <address>" << std::endl
+              << "  -p        peer uses a public address (default random static)" << std::endl
+              << "  -m MTU    ATT MTU to request (default " << defaultMtu << ")" << std::endl
+              << "  -f FIRST  first record index to download (default 0, oldest kept)" << std::endl
+              << "  -o CSV    write records to CSV (default stdout)" << std::endl
+              << "  -b BYTES  throughput test, beacon streams BYTES of filler" << std::endl;
+}
+
+static uint32_t getUint32(const uint8_t* data)
+{
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8)
+        | (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+static std::vector<uint8_t> uuid128(uint16_t uuid)
+{
+    std::vector<uint8_t> bytes = TRACK_UUID_BASE;
+    bytes[12] = static_cast<uint8_t>(uuid);
+    bytes[13] = static_cast<uint8_t>(uuid >> 8);
+    return bytes;
+}
+
+static void writeRecord(std::ostream& out, uint32_t index, const track_record_t& record)
+{
+    out << index << ',';
+    if (TRACK_TIME_UNKNOWN != record.time) {
+        time_t time = record.time;
+        struct tm utc;
+        char text[32];
+        gmtime_r(&time, &utc);
+        strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", &utc);
+        out << text;
+    }
+    out << ',' << std::fixed << std::setprecision(7)
+        << static_cast<double>(record.latitude) / BEACON_COORD_PER_DEGREE << ','
+        << static_cast<double>(record.longitude) / BEACON_COORD_PER_DEGREE << ','
+        << std::setprecision(2) << record.speed * BEACON_SPEED_UNIT_MMPS / 1000.0 << ','
+        << std::setprecision(1) << record.course * 360.0 / 256.0 << '\n';
+}
+
+int main(int argc, char** argv)
+{
+    bool randomAddress = true;
+    uint16_t mtu = defaultMtu;
+    uint32_t first = 0;
+    uint32_t benchBytes = 0;
+    const char* csv = nullptr;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "pm:f:o:b:")) != -1) {
+        switch (opt) {
+        case 'p':
+            randomAddress = false;
+            break;
+        case 'm':
+            mtu = static_cast<uint16_t>(strtoul(optarg, nullptr, 10));
+            break;
+        case 'f':
+            first = static_cast<uint32_t>(strtoul(optarg, nullptr, 10));
+            break;
+        case 'o':
+            csv = optarg;
+            break;
+        case 'b':
+            benchBytes = static_cast<uint32_t>(strtoul(optarg, nullptr, 10));
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    if (argc - optind != 1) {
+        usage(argv[0]);
+        return -1;
+    }
+    auto address = argv[optind];
+
+    std::ofstream file;
+    if (nullptr != csv) {
+        file.open(csv);
+        if (!file) {
+            std::cerr << "Fail to open CSV: " << csv << std::endl;
+            return -1;
+        }
+    }
+    std::ostream& out = (nullptr != csv) ? file : std::cout;
+
+    AttClient client;
+    if (!client.connect(address, randomAddress)) {
+        std::cerr << "Fail to connect to " << address << ": " << client.error() << std::endl;
+        return -1;
+    }
+    if (0 == client.exchangeMtu(mtu)) {
+        std::cerr << "Fail to exchange MTU: " << client.error() << std::endl;
+        return -1;
+    }
+
+    uint16_t start, end;
+    if (!client.findService(uuid128(TRACK_UUID_SERVICE), start, end)) {
+        std::cerr << "Track service not found: " << client.error() << std::endl;
+        return -1;
+    }
+
+    std::vector<AttClient::Characteristic> characteristics;
+    if (!client.discoverCharacteristics(start, end, characteristics)) {
+        std::cerr << "Fail to discover characteristics: " << client.error() << std::endl;
+        return -1;
+    }
+    const AttClient::Characteristic* control = nullptr;
+    const AttClient::Characteristic* data = nullptr;
+    for (const auto& characteristic : characteristics) {
+        if (characteristic.uuid == uuid128(TRACK_UUID_CONTROL)) {
+            control = &characteristic;
+        } else if (characteristic.uuid == uuid128(TRACK_UUID_DATA)) {
+            data = &characteristic;
+        }
+    }
+    if (nullptr == control || nullptr == data) {
+        std::cerr << "Track service is incomplete" << std::endl;
+        return -1;
+    }
+
+    // Transfer state, updated from notifications
+    bool responded = false;
+    bool done = false;
+    uint8_t status = TRACK_STATUS_OK;
+    uint32_t rangeFirst = 0, rangeEnd = 0, endIndex = 0;
+    size_t bytes = 0, packets = 0, records = 0, torn = 0;
+    auto startTime = std::chrono::steady_clock::now();
+
+    client.setNotificationHandler([&](uint16_t handle, const uint8_t* value, size_t len) {
+        if (handle == control->valueHandle && len >= TRACK_CONTROL_RSP_LEN) {
+            status = value[1];
+            rangeFirst = getUint32(&value[2]);
+            rangeEnd = getUint32(&value[6]);
+            responded = true;
+            startTime = std::chrono::steady_clock::now();
+            return;
+        }
+        if (handle != data->valueHandle || len < TRACK_PACKET_HEADER_LEN) {
+            return;
+        }
+
+        uint32_t index = getUint32(value);
+        bytes += len;
+        packets++;
+        if (TRACK_PACKET_HEADER_LEN == len) {
+            endIndex = index;
+            done = true;
+            return;
+        }
+        if (0 != benchBytes) {
+            return;
+        }
+        for (size_t offset = TRACK_PACKET_HEADER_LEN; offset + TRACK_RECORD_SIZE <= len; offset += TRACK_RECORD_SIZE) {
+            track_record_t record;
+            if (track_record_decode(&value[offset], &record)) {
+                writeRecord(out, index, record);
+                records++;
+            } else {
+                torn++;
+            }
+            index++;
+        }
+    });
+
+    if (!client.enableNotifications(*control) || !client.enableNotifications(*data)) {
+        std::cerr << "Fail to enable notifications: " << client.error() << std::endl;
+        return -1;
+    }
+
+    std::vector<uint8_t> command = { static_cast<uint8_t>((0 != benchBytes) ? TRACK_OP_BENCH : TRACK_OP_DOWNLOAD) };
+    uint32_t arg = (0 != benchBytes) ? benchBytes : first;
+    for (int i = 0; i < 4; i++) {
+        command.push_back(static_cast<uint8_t>(arg >> (8 * i)));
+    }
+    if (0 == benchBytes) {
+        out << "index,time,latitude,longitude,speed,course\n";
+    }
+    if (!client.write(control->valueHandle, command)) {
+        std::cerr << "Fail to write command: " << client.error() << std::endl;
+        return -1;
+    }
+
+    while (!done) {
+        if (!client.poll(packetTimeoutMs)) {
+            std::cerr << "Transfer interrupted: " << client.error() << std::endl;
+            return -1;
+        }
+        if (responded && TRACK_STATUS_OK != status) {
+            std::cerr << "Beacon refused the transfer, status " << static_cast<int>(status) << std::endl;
+            return -1;
+        }
+    }
+
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    out.flush();
+
+    std::cerr << std::fixed << std::setprecision(2);
+    if (0 == benchBytes) {
+        std::cerr << "Records " << rangeFirst << ".." << rangeEnd << ": " << records << " downloaded, "
+                  << torn << " torn" << std::endl;
+    }
+    std::cerr << bytes << " bytes in " << packets << " packets, " << seconds << " s, "
+              << bytes / seconds / 1000.0 << " kB/s (" << bytes * 8 / seconds / 1000.0 << " kbit/s), ATT MTU "
+              << client.mtu() << std::endl;
+    if (0 == benchBytes) {
+        std::cerr << "Resume with -f " << endIndex << std::endl;
+    }
+
+    client.close();
+
+    return 0;
+}
@@ -0,0 +1,19 @@
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+CONFIG -= qt
+
+INCLUDEPATH += \
+    ../firmware/src
+
+SOURCES += \
+    main.cpp \
+    AttClient.cpp \
+    ../firmware/src/track_format.c
+
+HEADERS += \
+    AttClient.h \
+    ../firmware/src/track_format.h
+
+LIBS += \
+    -lbluetooth